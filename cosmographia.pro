@@ -8,6 +8,7 @@ OBJECTS_DIR = obj
 QT += opengl
 QT += network
 QT += declarative
+greaterThan(QT_MAJOR_VERSION, 4): QT += concurrent
 
 
 #### App sources ####
@@ -27,20 +28,39 @@ APP_SOURCES = \
     $$MAIN_PATH/LocalImageLoader.cpp \
     $$MAIN_PATH/DateUtility.cpp \
     $$MAIN_PATH/RotationUtility.cpp \
+    $$MAIN_PATH/AdaptiveChebyshevTrajectory.cpp \
+    $$MAIN_PATH/CachingChebyshevTrajectory.cpp \
+    $$MAIN_PATH/ChebyshevCombinationTrajectory.cpp \
     $$MAIN_PATH/ChebyshevPolyTrajectory.cpp \
+    $$MAIN_PATH/CompactChebyshevGranules.cpp \
+    $$MAIN_PATH/EventFinder.cpp \
+    $$MAIN_PATH/BuiltinModels.cpp \
+    $$MAIN_PATH/EphemerisServer.cpp \
+    $$MAIN_PATH/BatchStateEvaluator.cpp \
+    $$MAIN_PATH/EpochRanges.cpp \
     $$MAIN_PATH/GalleryView.cpp \
     $$MAIN_PATH/InterpolatedRotation.cpp \
     $$MAIN_PATH/InterpolatedStateTrajectory.cpp \
+    $$MAIN_PATH/SampledTimeIndex.cpp \
     $$MAIN_PATH/JPLEphemeris.cpp \
+    $$MAIN_PATH/KeplerianBatchPropagator.cpp \
     $$MAIN_PATH/KeplerianSwarm.cpp \
     $$MAIN_PATH/LinearCombinationTrajectory.cpp \
+    $$MAIN_PATH/MappedChebyshevGranules.cpp \
+    $$MAIN_PATH/MappedFile.cpp \
     $$MAIN_PATH/MarkerLayer.cpp \
     $$MAIN_PATH/MultiLabelVisualizer.cpp \
     $$MAIN_PATH/NumberFormat.cpp \
     $$MAIN_PATH/ObserverAction.cpp \
+    $$MAIN_PATH/SharedEphemerisCache.cpp \
     $$MAIN_PATH/SkyLabelLayer.cpp \
+    $$MAIN_PATH/SwarmPointRenderer.cpp \
+    $$MAIN_PATH/TleBatchPropagator.cpp \
+    $$MAIN_PATH/TleSetRequester.cpp \
+    $$MAIN_PATH/TleSwarm.cpp \
     $$MAIN_PATH/TleTrajectory.cpp \
     $$MAIN_PATH/TwoVectorFrame.cpp \
+    $$MAIN_PATH/EquatorOfDateFrame.cpp \
     $$MAIN_PATH/UnitConversion.cpp \
     $$MAIN_PATH/WMSRequester.cpp \
     $$MAIN_PATH/WMSTiledMap.cpp \
@@ -51,12 +71,15 @@ APP_SOURCES = \
     $$MAIN_PATH/astro/Nutation.cpp \
     $$MAIN_PATH/astro/OsculatingElements.cpp \
     $$MAIN_PATH/astro/Precession.cpp \
+    $$MAIN_PATH/astro/PrecessionNutation.cpp \
     $$MAIN_PATH/astro/L1.cpp \
     $$MAIN_PATH/astro/MarsSat.cpp \
     $$MAIN_PATH/astro/TASS17.cpp \
     $$MAIN_PATH/catalog/AstorbLoader.cpp \
     $$MAIN_PATH/catalog/BodyInfo.cpp \
     $$MAIN_PATH/catalog/ChebyshevPolyFileLoader.cpp \
+    $$MAIN_PATH/catalog/NumericTableReader.cpp \
+    $$MAIN_PATH/catalog/TleLoader.cpp \
     $$MAIN_PATH/catalog/UniverseCatalog.cpp \
     $$MAIN_PATH/catalog/UniverseLoader.cpp \
     $$MAIN_PATH/geometry/FeatureLabelSetGeometry.cpp \
@@ -92,20 +115,39 @@ APP_HEADERS = \
     $$MAIN_PATH/LocalImageLoader.h \
     $$MAIN_PATH/DateUtility.h \
     $$MAIN_PATH/RotationUtility.h \
+    $$MAIN_PATH/AdaptiveChebyshevTrajectory.h \
+    $$MAIN_PATH/CachingChebyshevTrajectory.h \
+    $$MAIN_PATH/ChebyshevCombinationTrajectory.h \
     $$MAIN_PATH/ChebyshevPolyTrajectory.h \
+    $$MAIN_PATH/CompactChebyshevGranules.h \
+    $$MAIN_PATH/EventFinder.h \
+    $$MAIN_PATH/BuiltinModels.h \
+    $$MAIN_PATH/EphemerisServer.h \
+    $$MAIN_PATH/BatchStateEvaluator.h \
+    $$MAIN_PATH/EpochRanges.h \
     $$MAIN_PATH/GalleryView.h \
     $$MAIN_PATH/InterpolatedRotation.h \
     $$MAIN_PATH/InterpolatedStateTrajectory.h \
+    $$MAIN_PATH/SampledTimeIndex.h \
     $$MAIN_PATH/JPLEphemeris.h \
+    $$MAIN_PATH/KeplerianBatchPropagator.h \
     $$MAIN_PATH/KeplerianSwarm.h \
     $$MAIN_PATH/LinearCombinationTrajectory.h \
+    $$MAIN_PATH/MappedChebyshevGranules.h \
+    $$MAIN_PATH/MappedFile.h \
     $$MAIN_PATH/MarkerLayer.h \
     $$MAIN_PATH/MultiLabelVisualizer.h \
     $$MAIN_PATH/NumberFormat.h \
     $$MAIN_PATH/ObserverAction.h \
+    $$MAIN_PATH/SharedEphemerisCache.h \
     $$MAIN_PATH/SkyLabelLayer.h \
+    $$MAIN_PATH/SwarmPointRenderer.h \
+    $$MAIN_PATH/TleBatchPropagator.h \
+    $$MAIN_PATH/TleSetRequester.h \
+    $$MAIN_PATH/TleSwarm.h \
     $$MAIN_PATH/TleTrajectory.h \
     $$MAIN_PATH/TwoVectorFrame.h \
+    $$MAIN_PATH/EquatorOfDateFrame.h \
     $$MAIN_PATH/UnitConversion.h \
     $$MAIN_PATH/WMSRequester.h \
     $$MAIN_PATH/WMSTiledMap.h \
@@ -117,12 +159,16 @@ APP_HEADERS = \
     $$MAIN_PATH/astro/Nutation.h \
     $$MAIN_PATH/astro/OsculatingElements.h \
     $$MAIN_PATH/astro/Precession.h \
+    $$MAIN_PATH/astro/PrecessionNutation.h \
     $$MAIN_PATH/astro/Rotation.h \
+    $$MAIN_PATH/astro/SatelliteTheoryCache.h \
     $$MAIN_PATH/astro/L1.h \
     $$MAIN_PATH/astro/TASS17.h \
     $$MAIN_PATH/catalog/AstorbLoader.h \
     $$MAIN_PATH/catalog/BodyInfo.h \
     $$MAIN_PATH/catalog/ChebyshevPolyFileLoader.h \
+    $$MAIN_PATH/catalog/NumericTableReader.h \
+    $$MAIN_PATH/catalog/TleLoader.h \
     $$MAIN_PATH/catalog/UniverseCatalog.h \
     $$MAIN_PATH/catalog/UniverseLoader.h \
     $$MAIN_PATH/geometry/FeatureLabelSetGeometry.h \
@@ -174,6 +220,7 @@ VESTA_SOURCES = \
     $$VESTA_PATH/DDSLoader.cpp \
     $$VESTA_PATH/Debug.cpp \
     $$VESTA_PATH/Entity.cpp \
+    $$VESTA_PATH/EvaluationContext.cpp \
     $$VESTA_PATH/FixedPointTrajectory.cpp \
     $$VESTA_PATH/FixedRotationModel.cpp \
     $$VESTA_PATH/Frame.cpp \
@@ -258,6 +305,7 @@ VESTA_HEADERS = \
     $$VESTA_PATH/Debug.h \
     $$VESTA_PATH/DDSLoader.h \
     $$VESTA_PATH/Entity.h \
+    $$VESTA_PATH/EvaluationContext.h \
     $$VESTA_PATH/FadeRange.h \
     $$VESTA_PATH/Frame.h \
     $$VESTA_PATH/Framebuffer.h \
@@ -570,7 +618,7 @@ spice {
     SPICE_LIB_PATH = /Users/claurel/dev/spice/mac64/cspice/lib
     INCLUDEPATH += $$SPICE_HEADER_PATH
     DEFINES += SPICE_ENABLED
-    SOURCES += $$MAIN_PATH/spice/SpiceTrajectory.cpp $$MAIN_PATH/spice/SpiceRotationModel.cpp
+    SOURCES += $$MAIN_PATH/spice/SpiceTrajectory.cpp $$MAIN_PATH/spice/SpiceRotationModel.cpp $$MAIN_PATH/spice/SpiceGateway.cpp
     LIBS += $$SPICE_LIB_PATH/cspice.a
 }
 
@@ -0,0 +1,296 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "AdaptiveChebyshevTrajectory.h"
+#include <vesta/Units.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+const double AdaptiveChebyshevTrajectory::MaxSegmentDuration = 86400.0;
+const double AdaptiveChebyshevTrajectory::MinSegmentDuration = 1.0;
+
+
+// Evaluate the position and its derivative with respect to u for a Chebyshev
+// polynomial segment using Clenshaw's recurrence. The coefficients are arranged
+// as in a ChebyshevPolyTrajectory granule: x0 x1 ... xn y0 y1 ... yn z0 z1 ... zn
+static void
+evaluateSegment(const double* coeffs, unsigned int coeffCount, double u, Vector3d* position, Vector3d* derivative)
+{
+    for (unsigned int j = 0; j < 3; ++j)
+    {
+        const double* c = coeffs + j * coeffCount;
+        double b1 = 0.0;
+        double b2 = 0.0;
+        double d1 = 0.0;
+        double d2 = 0.0;
+        for (unsigned int k = coeffCount - 1; k >= 1; --k)
+        {
+            double b0 = c[k] + 2.0 * u * b1 - b2;
+            double d0 = 2.0 * b1 + 2.0 * u * d1 - d2;
+            b2 = b1;
+            b1 = b0;
+            d2 = d1;
+            d1 = d0;
+        }
+
+        (*position)[j] = c[0] + u * b1 - b2;
+        if (derivative)
+        {
+            (*derivative)[j] = b1 + u * d1 - d2;
+        }
+    }
+}
+
+
+/** Create an empty trajectory; segments are added by calling fit().
+  *
+  * \param degree the degree of the Chebyshev polynomial used for each segment
+  */
+AdaptiveChebyshevTrajectory::AdaptiveChebyshevTrajectory(unsigned int degree) :
+    m_degree(max(1u, min(MaxDegree, degree))),
+    m_boundingRadius(0.0),
+    m_period(0.0),
+    m_maxFitError(0.0)
+{
+}
+
+
+AdaptiveChebyshevTrajectory::~AdaptiveChebyshevTrajectory()
+{
+}
+
+
+StateVector
+AdaptiveChebyshevTrajectory::state(double tdbSec) const
+{
+    if (m_segmentStartTimes.empty())
+    {
+        return StateVector(Vector3d::Zero(), Vector3d::Zero());
+    }
+
+    // Find the last segment that begins at or before the requested time
+    vector<double>::const_iterator iter = upper_bound(m_segmentStartTimes.begin(), m_segmentStartTimes.end(), tdbSec);
+    unsigned int segment = 0;
+    if (iter != m_segmentStartTimes.begin())
+    {
+        segment = (iter - m_segmentStartTimes.begin()) - 1;
+    }
+
+    // Times outside the fitted spans (including any gaps between them) are
+    // clamped to the nearest segment. A time in a gap falls after the end of
+    // the segment found above; use the following one if it's closer.
+    if (segment + 1 < m_segmentStartTimes.size())
+    {
+        double segmentEnd = m_segmentStartTimes[segment] + m_segmentDurations[segment];
+        if (m_segmentStartTimes[segment + 1] - tdbSec < tdbSec - segmentEnd)
+        {
+            ++segment;
+        }
+    }
+
+    double duration = m_segmentDurations[segment];
+    double u = 2.0 * (tdbSec - m_segmentStartTimes[segment]) / duration - 1.0;
+    u = max(-1.0, min(1.0, u));
+
+    Vector3d position;
+    Vector3d derivative;
+    evaluateSegment(&m_coeffs[segment * (m_degree + 1) * 3], m_degree + 1, u, &position, &derivative);
+
+    return StateVector(position, derivative * (2.0 / duration));
+}
+
+
+double
+AdaptiveChebyshevTrajectory::boundingSphereRadius() const
+{
+    return m_boundingRadius;
+}
+
+
+bool
+AdaptiveChebyshevTrajectory::isPeriodic() const
+{
+    return m_period != 0.0;
+}
+
+
+/** Return the period of the trajectory in seconds (or zero if the
+  * trajectory is not approximately periodic.
+  */
+double
+AdaptiveChebyshevTrajectory::period() const
+{
+    return m_period;
+}
+
+
+/** Set the period of the trajectory in seconds. If the period is set
+  * to zero, the trajectory is treated as aperiodic. The period is
+  * relevant for plotting.
+  */
+void
+AdaptiveChebyshevTrajectory::setPeriod(double period)
+{
+    m_period = period;
+}
+
+
+/** Approximate the source trajectory over a span of time, appending as many
+  * segments as are required to keep the position error below the tolerance.
+  * The error is checked at points between the interpolation nodes of each
+  * segment; segments that exceed the tolerance are split in half. Segments
+  * are never made shorter than MinSegmentDuration, and splitting stops when
+  * it doesn't reduce the error, so the tolerance may not be met when it is
+  * below the precision of the source or when the source is discontinuous;
+  * check maxFitError() after fitting.
+  *
+  * fit() may be called more than once in order to approximate a trajectory
+  * with gaps in its coverage, but the spans must be given in increasing
+  * time order and must not overlap.
+  *
+  * \param trajectory the trajectory to approximate
+  * \param startTimeTdbSec the start of the span, in seconds since J2000 (TDB)
+  * \param endTimeTdbSec the end of the span, in seconds since J2000 (TDB)
+  * \param tolerance the maximum allowed position error in kilometers
+  *
+  * \return false if the span is empty or out of order, true otherwise
+  */
+bool
+AdaptiveChebyshevTrajectory::fit(const Trajectory* trajectory,
+                                 double startTimeTdbSec,
+                                 double endTimeTdbSec,
+                                 double tolerance)
+{
+    if (!trajectory || !(endTimeTdbSec > startTimeTdbSec) || !(tolerance > 0.0))
+    {
+        return false;
+    }
+
+    if (!m_segmentStartTimes.empty() && startTimeTdbSec < endTime())
+    {
+        return false;
+    }
+
+    double span = endTimeTdbSec - startTimeTdbSec;
+    unsigned int pieceCount = (unsigned int) ceil(span / MaxSegmentDuration);
+    double pieceDuration = span / pieceCount;
+    for (unsigned int i = 0; i < pieceCount; ++i)
+    {
+        fitSegment(trajectory, startTimeTdbSec + i * pieceDuration, pieceDuration, tolerance, -1.0);
+    }
+
+    if (!m_segmentStartTimes.empty())
+    {
+        setStartTime(m_segmentStartTimes.front());
+        setEndTime(m_segmentStartTimes.back() + m_segmentDurations.back());
+    }
+
+    return true;
+}
+
+
+void
+AdaptiveChebyshevTrajectory::fitSegment(const Trajectory* trajectory,
+                                        double startTime,
+                                        double duration,
+                                        double tolerance,
+                                        double parentError)
+{
+    const unsigned int coeffCount = m_degree + 1;
+    double coeffs[(MaxDegree + 1) * 3];
+    computeCoefficients(trajectory, startTime, duration, coeffs);
+
+    // Check the approximation at the extrema of the Chebyshev polynomial,
+    // which lie between the interpolation nodes and include the endpoints.
+    double maxError = 0.0;
+    for (unsigned int k = 0; k <= coeffCount; ++k)
+    {
+        double u = cos(PI * k / coeffCount);
+        Vector3d position;
+        evaluateSegment(coeffs, coeffCount, u, &position, NULL);
+        Vector3d exact = trajectory->position(startTime + (u + 1.0) * 0.5 * duration);
+        maxError = max(maxError, (position - exact).norm());
+    }
+
+    // Split the segment if the tolerance isn't met. Stop splitting when it
+    // no longer reduces the error, which happens when the error is dominated
+    // by round-off in the source trajectory.
+    bool converging = parentError < 0.0 || maxError < parentError * 0.9;
+    if (maxError > tolerance && converging && duration >= 2.0 * MinSegmentDuration)
+    {
+        double halfDuration = duration * 0.5;
+        fitSegment(trajectory, startTime, halfDuration, tolerance, maxError);
+        fitSegment(trajectory, startTime + halfDuration, halfDuration, tolerance, maxError);
+        return;
+    }
+
+    m_maxFitError = max(m_maxFitError, maxError);
+
+    // Conservative bounding radius: |T_i(u)| <= 1 on [-1, 1]
+    Vector3d extent = Vector3d::Zero();
+    for (unsigned int j = 0; j < 3; ++j)
+    {
+        for (unsigned int i = 0; i < coeffCount; ++i)
+        {
+            extent[j] += abs(coeffs[j * coeffCount + i]);
+        }
+    }
+    m_boundingRadius = max(m_boundingRadius, extent.norm());
+
+    m_segmentStartTimes.push_back(startTime);
+    m_segmentDurations.push_back(duration);
+    m_coeffs.insert(m_coeffs.end(), coeffs, coeffs + coeffCount * 3);
+}
+
+
+// Compute the coefficients of the Chebyshev polynomial that interpolates the
+// source trajectory at the Chebyshev nodes of a segment.
+void
+AdaptiveChebyshevTrajectory::computeCoefficients(const Trajectory* trajectory,
+                                                 double startTime,
+                                                 double duration,
+                                                 double* coeffs) const
+{
+    const unsigned int n = m_degree + 1;
+
+    Vector3d samples[MaxDegree + 1];
+    for (unsigned int k = 0; k < n; ++k)
+    {
+        double u = cos(PI * (k + 0.5) / n);
+        samples[k] = trajectory->position(startTime + (u + 1.0) * 0.5 * duration);
+    }
+
+    for (unsigned int i = 0; i < n; ++i)
+    {
+        Vector3d sum = Vector3d::Zero();
+        for (unsigned int k = 0; k < n; ++k)
+        {
+            sum += samples[k] * cos(PI * i * (k + 0.5) / n);
+        }
+
+        double scale = (i == 0) ? 1.0 / n : 2.0 / n;
+        for (unsigned int j = 0; j < 3; ++j)
+        {
+            coeffs[j * n + i] = sum[j] * scale;
+        }
+    }
+}
@@ -0,0 +1,101 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef _ADAPTIVE_CHEBYSHEV_TRAJECTORY_H_
+#define _ADAPTIVE_CHEBYSHEV_TRAJECTORY_H_
+
+#include <vesta/Trajectory.h>
+#include <vector>
+
+
+/** AdaptiveChebyshevTrajectory approximates another trajectory with a table
+  * of Chebyshev polynomial segments. Unlike ChebyshevPolyTrajectory, the
+  * segments need not all have the same length: each segment is made only as
+  * long as it can be while keeping the error below a specified tolerance.
+  *
+  * It is used to replace trajectories that are expensive to evaluate (e.g.
+  * SPICE trajectories, which call into CSPICE for every state) with a table
+  * that is computed once at load time. Evaluation requires a binary search
+  * for the segment followed by the evaluation of a single Chebyshev
+  * polynomial.
+  */
+class AdaptiveChebyshevTrajectory : public vesta::Trajectory
+{
+public:
+    AdaptiveChebyshevTrajectory(unsigned int degree = DefaultDegree);
+    ~AdaptiveChebyshevTrajectory();
+
+    virtual vesta::StateVector state(double tdbSec) const;
+    virtual double boundingSphereRadius() const;
+    virtual bool isPeriodic() const;
+    virtual double period() const;
+
+    void setPeriod(double period);
+
+    bool fit(const vesta::Trajectory* trajectory,
+             double startTimeTdbSec,
+             double endTimeTdbSec,
+             double tolerance);
+
+    /** Get the number of polynomial segments in the trajectory.
+      */
+    unsigned int segmentCount() const
+    {
+        return m_segmentStartTimes.size();
+    }
+
+    /** Get the largest position error found when fitting any of the
+      * segments.
+      */
+    double maxFitError() const
+    {
+        return m_maxFitError;
+    }
+
+    static const unsigned int DefaultDegree = 11;
+    static const unsigned int MaxDegree = 32;
+
+    // Longest span covered by a single segment, in seconds; this keeps
+    // short features (e.g. a planetary flyby) from falling entirely between
+    // the points checked when fitting a long segment.
+    static const double MaxSegmentDuration;
+
+    // Shortest span that will be split when the tolerance isn't met
+    static const double MinSegmentDuration;
+
+private:
+    void fitSegment(const vesta::Trajectory* trajectory,
+                    double startTime,
+                    double duration,
+                    double tolerance,
+                    double parentError);
+    void computeCoefficients(const vesta::Trajectory* trajectory,
+                             double startTime,
+                             double duration,
+                             double* coeffs) const;
+
+private:
+    unsigned int m_degree;
+    std::vector<double> m_segmentStartTimes;
+    std::vector<double> m_segmentDurations;
+    std::vector<double> m_coeffs;
+    double m_boundingRadius;
+    double m_period;
+    double m_maxFitError;
+};
+
+#endif // _ADAPTIVE_CHEBYSHEV_TRAJECTORY_H_
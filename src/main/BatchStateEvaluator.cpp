@@ -0,0 +1,317 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "BatchStateEvaluator.h"
+#include <vesta/Arc.h>
+#include <vesta/Chronology.h>
+#include <vesta/Frame.h>
+#include <vesta/Trajectory.h>
+#include <algorithm>
+#include <map>
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+// Evaluates the states for one range of epochs
+struct BatchStateEvaluator::RangeEvaluator
+{
+    const BatchStateEvaluator* evaluator;
+    const double* epochs;
+    double* states;
+
+    void operator()(const EpochRange& range) const
+    {
+        evaluator->evaluateRange(epochs, range, states);
+    }
+};
+
+
+BatchStateEvaluator::BatchStateEvaluator() :
+    m_threadCount(0)
+{
+}
+
+
+BatchStateEvaluator::~BatchStateEvaluator()
+{
+}
+
+
+/** Set the bodies to evaluate and build the graph of their dependencies.
+  */
+void
+BatchStateEvaluator::setBodies(const std::vector<const Entity*>& bodies)
+{
+    m_bodies = bodies;
+    m_nodes.clear();
+    m_bodyNodes.clear();
+
+    // Collect the bodies and, recursively, the centers of all of their arcs
+    std::vector<const Entity*> entities;
+    std::map<const Entity*, unsigned int> entityIndex;
+    for (unsigned int i = 0; i < bodies.size(); ++i)
+    {
+        if (entityIndex.find(bodies[i]) == entityIndex.end())
+        {
+            entityIndex[bodies[i]] = entities.size();
+            entities.push_back(bodies[i]);
+        }
+    }
+
+    std::vector<std::vector<unsigned int> > dependents;
+    std::vector<unsigned int> centerCounts;
+    for (unsigned int i = 0; i < entities.size(); ++i)
+    {
+        const Chronology* chronology = entities[i]->chronology();
+        std::vector<unsigned int> centers;
+        for (unsigned int arcIndex = 0; arcIndex < chronology->arcCount(); ++arcIndex)
+        {
+            const Entity* center = chronology->arc(arcIndex)->center();
+            if (center)
+            {
+                std::map<const Entity*, unsigned int>::const_iterator iter = entityIndex.find(center);
+                if (iter == entityIndex.end())
+                {
+                    iter = entityIndex.insert(make_pair(center, unsigned(entities.size()))).first;
+                    entities.push_back(center);
+                }
+                centers.push_back(iter->second);
+            }
+        }
+
+        sort(centers.begin(), centers.end());
+        centers.erase(unique(centers.begin(), centers.end()), centers.end());
+
+        dependents.resize(entities.size());
+        centerCounts.push_back(centers.size());
+        for (unsigned int j = 0; j < centers.size(); ++j)
+        {
+            dependents[centers[j]].push_back(i);
+        }
+    }
+
+    // Sort the graph so that centers come before their dependents. Whatever
+    // can't be sorted is part of or depends on a cycle.
+    std::vector<unsigned int> order;
+    std::vector<bool> sorted(entities.size(), false);
+    for (unsigned int i = 0; i < entities.size(); ++i)
+    {
+        if (centerCounts[i] == 0)
+        {
+            order.push_back(i);
+            sorted[i] = true;
+        }
+    }
+
+    for (unsigned int next = 0; next < order.size(); ++next)
+    {
+        const std::vector<unsigned int>& d = dependents[order[next]];
+        for (unsigned int j = 0; j < d.size(); ++j)
+        {
+            if (--centerCounts[d[j]] == 0)
+            {
+                order.push_back(d[j]);
+                sorted[d[j]] = true;
+            }
+        }
+    }
+
+    unsigned int sortedCount = order.size();
+    for (unsigned int i = 0; i < entities.size(); ++i)
+    {
+        if (!sorted[i])
+        {
+            order.push_back(i);
+        }
+    }
+
+    // Create the nodes in topological order
+    std::vector<unsigned int> nodeIndex(entities.size());
+    for (unsigned int i = 0; i < order.size(); ++i)
+    {
+        nodeIndex[order[i]] = i;
+    }
+
+    m_nodes.resize(order.size());
+    for (unsigned int i = 0; i < order.size(); ++i)
+    {
+        Node& node = m_nodes[i];
+        node.entity = entities[order[i]];
+        node.cyclic = i >= sortedCount;
+
+        const Chronology* chronology = node.entity->chronology();
+        for (unsigned int arcIndex = 0; arcIndex < chronology->arcCount(); ++arcIndex)
+        {
+            const Arc* arc = chronology->arc(arcIndex);
+            int center = arc->center() ? int(nodeIndex[entityIndex[arc->center()]]) : -1;
+            node.arcCenters.push_back(make_pair(arc, center));
+        }
+        sort(node.arcCenters.begin(), node.arcCenters.end());
+    }
+
+    for (unsigned int i = 0; i < bodies.size(); ++i)
+    {
+        m_bodyNodes.push_back(nodeIndex[entityIndex[bodies[i]]]);
+    }
+}
+
+
+/** Set the number of threads used for evaluation. Zero means one thread per
+  * processor; with one thread, states are computed entirely on the calling
+  * thread.
+  */
+void
+BatchStateEvaluator::setThreadCount(unsigned int count)
+{
+    m_threadCount = count;
+}
+
+
+/** Compute the states of the bodies at a list of epochs.
+  *
+  * \param epochs times in seconds since J2000 TDB
+  * \param epochCount the number of epochs
+  * \param states array of epochCount * bodies().size() * StateSize doubles
+  *        that receives the states, epoch-major: all bodies at the first
+  *        epoch, then all bodies at the second, and so on. Each state is the
+  *        position and velocity in the fundamental frame (ICRF) relative to
+  *        the origin, as returned by Entity::state.
+  */
+void
+BatchStateEvaluator::evaluate(const double* epochs, unsigned int epochCount, double* states) const
+{
+    if (epochCount == 0 || m_bodies.empty())
+    {
+        return;
+    }
+
+    RangeEvaluator rangeEvaluator;
+    rangeEvaluator.evaluator = this;
+    rangeEvaluator.epochs = epochs;
+    rangeEvaluator.states = states;
+    ForEachEpochRange(epochCount, m_threadCount, rangeEvaluator);
+}
+
+
+int
+BatchStateEvaluator::centerNode(const Node& node, const Arc* arc) const
+{
+    std::vector<std::pair<const Arc*, int> >::const_iterator iter =
+            lower_bound(node.arcCenters.begin(), node.arcCenters.end(), make_pair(arc, -1));
+    if (iter != node.arcCenters.end() && iter->first == arc)
+    {
+        return iter->second;
+    }
+    else
+    {
+        return -1;
+    }
+}
+
+
+void
+BatchStateEvaluator::evaluateRange(const double* epochs, const EpochRange& range, double* states) const
+{
+    const std::vector<Node>& nodes = m_nodes;
+    const std::vector<unsigned int>& bodyNodes = m_bodyNodes;
+    unsigned int nodeCount = nodes.size();
+
+    std::vector<double> nodeStates(nodeCount * StateSize);
+    std::vector<const Arc*> activeArcs(nodeCount);
+    std::vector<int> centers(nodeCount);
+    std::vector<char> needed(nodeCount);
+    const double zero[StateSize] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+    for (unsigned int epochIndex = range.first; epochIndex < range.end; ++epochIndex)
+    {
+        double t = epochs[epochIndex];
+
+        // Find the nodes needed at this epoch. Dependents come after their
+        // centers, so a reverse pass sees every dependent of a node before
+        // the node itself.
+        std::fill(needed.begin(), needed.end(), 0);
+        for (unsigned int i = 0; i < bodyNodes.size(); ++i)
+        {
+            needed[bodyNodes[i]] = 1;
+        }
+
+        for (unsigned int i = nodeCount; i-- > 0; )
+        {
+            if (needed[i] && !nodes[i].cyclic)
+            {
+                const Arc* arc = nodes[i].entity->chronology()->activeArc(t);
+                activeArcs[i] = arc;
+                centers[i] = arc ? centerNode(nodes[i], arc) : -1;
+                if (centers[i] >= 0)
+                {
+                    needed[centers[i]] = 1;
+                }
+            }
+        }
+
+        // Compute the states in topological order. This is the same
+        // arithmetic as Entity::state.
+        for (unsigned int i = 0; i < nodeCount; ++i)
+        {
+            if (!needed[i])
+            {
+                continue;
+            }
+
+            double* s = &nodeStates[i * StateSize];
+            if (nodes[i].cyclic)
+            {
+                StateVector state = nodes[i].entity->state(t);
+                for (unsigned int j = 0; j < 3; ++j)
+                {
+                    s[j] = state.position()[j];
+                    s[j + 3] = state.velocity()[j];
+                }
+            }
+            else if (!activeArcs[i])
+            {
+                std::fill(s, s + StateSize, 0.0);
+            }
+            else
+            {
+                const Arc* arc = activeArcs[i];
+                const double* centerState = centers[i] >= 0 ? &nodeStates[centers[i] * StateSize] : zero;
+
+                StateVector state = arc->trajectory()->state(t);
+
+                Matrix3d m = arc->trajectoryFrame()->orientation(t).toRotationMatrix();
+                Vector3d omega = arc->trajectoryFrame()->angularVelocity(t);
+                Vector3d position = m * state.position();
+                Vector3d velocity = m * state.velocity() + omega.cross(state.position());
+
+                for (unsigned int j = 0; j < 3; ++j)
+                {
+                    s[j] = centerState[j] + position[j];
+                    s[j + 3] = centerState[j + 3] + velocity[j];
+                }
+            }
+        }
+
+        double* out = states + size_t(epochIndex) * bodyNodes.size() * StateSize;
+        for (unsigned int i = 0; i < bodyNodes.size(); ++i)
+        {
+            const double* s = &nodeStates[bodyNodes[i] * StateSize];
+            std::copy(s, s + StateSize, out + i * StateSize);
+        }
+    }
+}
@@ -0,0 +1,120 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _BATCH_STATE_EVALUATOR_H_
+#define _BATCH_STATE_EVALUATOR_H_
+
+#include "EpochRanges.h"
+#include <vesta/Entity.h>
+#include <vector>
+#include <utility>
+
+namespace vesta
+{
+    class Arc;
+}
+
+
+/** BatchStateEvaluator computes the states of a set of bodies at many
+  * epochs. Calling Entity::state for each body recomputes the whole chain
+  * of centers every time; the batch evaluator instead builds the graph of
+  * dependencies implied by the centers of all arcs of the bodies (and of
+  * their centers, recursively), sorts it so that every center comes before
+  * the bodies that refer to it, and then computes each state once per epoch
+  * in that order. Only the centers that the arcs active at an epoch
+  * actually refer to are evaluated.
+  *
+  * States are computed with exactly the same operations as Entity::state,
+  * so the results are identical to it bit for bit. Trajectory frames are
+  * evaluated through their own interfaces, as Entity::state does. If the
+  * center graph contains a cycle (possible when arcs at different times
+  * swap the roles of two bodies), the bodies in the cycle and those that
+  * depend on them fall back to Entity::state.
+  *
+  * The epochs are divided into ranges (see SplitEpochs) that are evaluated
+  * in parallel by threads from the global thread pool, so the trajectories
+  * involved must be safe to evaluate from multiple threads. The graph is
+  * built by setBodies(), which must be called again if the chronologies of
+  * any of the bodies or centers change.
+  */
+class BatchStateEvaluator
+{
+public:
+    BatchStateEvaluator();
+    ~BatchStateEvaluator();
+
+    void setBodies(const std::vector<const vesta::Entity*>& bodies);
+
+    /** Get the bodies whose states are computed, in the order in which they
+      * appear in the output.
+      */
+    const std::vector<const vesta::Entity*>& bodies() const
+    {
+        return m_bodies;
+    }
+
+    /** Get the number of entities in the dependency graph: the bodies and
+      * all of their centers.
+      */
+    unsigned int nodeCount() const
+    {
+        return m_nodes.size();
+    }
+
+    /** Get the number of threads used for evaluation. Zero means one thread
+      * per processor.
+      */
+    unsigned int threadCount() const
+    {
+        return m_threadCount;
+    }
+
+    void setThreadCount(unsigned int count);
+
+    void evaluate(const double* epochs, unsigned int epochCount, double* states) const;
+
+    // Number of doubles in each state: position (km) and velocity (km/s)
+    static const unsigned int StateSize = 6;
+
+private:
+    struct Node
+    {
+        const vesta::Entity* entity;
+
+        // The node of the center of each arc (or -1 if the arc has no
+        // center), sorted by arc for lookup
+        std::vector<std::pair<const vesta::Arc*, int> > arcCenters;
+
+        // Set for nodes that are part of or depend on a cycle
+        bool cyclic;
+    };
+
+    struct RangeEvaluator;
+    void evaluateRange(const double* epochs, const EpochRange& range, double* states) const;
+    int centerNode(const Node& node, const vesta::Arc* arc) const;
+
+private:
+    std::vector<const vesta::Entity*> m_bodies;
+
+    // Nodes of the dependency graph in topological order, and the node of
+    // each body
+    std::vector<Node> m_nodes;
+    std::vector<unsigned int> m_bodyNodes;
+
+    unsigned int m_threadCount;
+};
+
+#endif // _BATCH_STATE_EVALUATOR_H_
@@ -0,0 +1,188 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "BuiltinModels.h"
+#include "catalog/UniverseLoader.h"
+#include "JPLEphemeris.h"
+#include "LinearCombinationTrajectory.h"
+#include "ChebyshevCombinationTrajectory.h"
+#include "SharedEphemerisCache.h"
+#include "astro/IAULunarRotationModel.h"
+#include "astro/MarsSat.h"
+#include "astro/L1.h"
+#include "astro/TASS17.h"
+#include "astro/Gust86.h"
+#include <vesta/Trajectory.h>
+
+using namespace vesta;
+
+
+// Version of the tables baked from the ephemeris. Shared cache entries are
+// only checked against the ephemeris file, so this is part of their kind and
+// must be incremented whenever the tables would be computed differently
+// (e.g. a change to the combinations below or to how they're baked.)
+static const int BakedTableVersion = 1;
+
+
+// Replace a linear combination of ephemeris trajectories with a single
+// Chebyshev trajectory, so that evaluating it requires summing just one
+// series instead of two or three. Granules of the baked table are computed
+// as they're used. When the ephemeris cache is enabled, the whole table is
+// instead computed once and shared with other processes, which map it just
+// like the ephemeris itself; tableName identifies the table among those
+// derived from the ephemeris. The weights of the combination depend only on
+// the ephemeris, so the name and BakedTableVersion are enough to identify a
+// cached table.
+static Trajectory*
+bakeLinearCombination(LinearCombinationTrajectory* trajectory, const JPLEphemeris* eph, const QString& tableName)
+{
+    QString ephemerisFileName(eph->fileName().c_str());
+
+    // Cache kinds are limited to 23 characters
+    QString cacheKind = QString("%1-v%2").arg(tableName).arg(BakedTableVersion);
+    Trajectory* shared = SharedEphemerisCache::OpenChebyshevTrajectory(ephemerisFileName, cacheKind);
+    if (shared)
+    {
+        delete trajectory;
+        return shared;
+    }
+
+    Trajectory* baked = ChebyshevCombinationTrajectory::Simplify(trajectory);
+    if (baked)
+    {
+        delete trajectory;
+
+        ChebyshevPolyTrajectory* table = dynamic_cast<ChebyshevPolyTrajectory*>(baked);
+        if (table && SharedEphemerisCache::IsEnabled())
+        {
+            shared = SharedEphemerisCache::PublishChebyshevTrajectory(ephemerisFileName, cacheKind, table);
+            if (shared)
+            {
+                delete baked;
+                return shared;
+            }
+        }
+
+        return baked;
+    }
+    else
+    {
+        return trajectory;
+    }
+}
+
+
+// Convert a JPL ephemeris orbit from SSB-centered to Sun-centered
+static Trajectory*
+createSunRelativeTrajectory(const JPLEphemeris* eph, JPLEphemeris::JplObjectId id)
+{
+    LinearCombinationTrajectory* orbit = new LinearCombinationTrajectory(eph->trajectory(id), 1.0,
+                                                                         eph->trajectory(JPLEphemeris::Sun), -1.0);
+    orbit->setPeriod(eph->trajectory(id)->period());
+    return bakeLinearCombination(orbit, eph, QString("sunrel%1").arg(int(id)));
+}
+
+
+/** Register the orbits and rotation models that catalogs refer to as builtin:
+  * the planets, Sun, and Moon from the JPL ephemeris, and analytic theories
+  * for the major planetary satellites. This must be called before any
+  * catalogs are loaded. The ephemeris file is found relative to the current
+  * directory, which should be the data directory.
+  */
+void
+AddBuiltinModels(UniverseLoader* loader)
+{
+    // Set up builtin orbits
+    JPLEphemeris* eph = JPLEphemeris::load("de406_1800-2100.dat");
+    if (eph)
+    {
+        loader->addBuiltinOrbit("Sun",     eph->trajectory(JPLEphemeris::Sun));
+        loader->addBuiltinOrbit("Moon",    eph->trajectory(JPLEphemeris::Moon));
+
+        // The code below will create planet trajectories relative to the SSB
+        /*
+        loader->addBuiltinOrbit("Mercury", eph->trajectory(JPLEphemeris::Mercury));
+        loader->addBuiltinOrbit("Venus",   eph->trajectory(JPLEphemeris::Venus));
+        loader->addBuiltinOrbit("EMB",     eph->trajectory(JPLEphemeris::EarthMoonBarycenter));
+        loader->addBuiltinOrbit("Mars",    eph->trajectory(JPLEphemeris::Mars));
+        loader->addBuiltinOrbit("Jupiter", eph->trajectory(JPLEphemeris::Jupiter));
+        loader->addBuiltinOrbit("Saturn",  eph->trajectory(JPLEphemeris::Saturn));
+        loader->addBuiltinOrbit("Uranus",  eph->trajectory(JPLEphemeris::Uranus));
+        loader->addBuiltinOrbit("Neptune", eph->trajectory(JPLEphemeris::Neptune));
+        loader->addBuiltinOrbit("Pluto",   eph->trajectory(JPLEphemeris::Pluto));
+        */
+
+        Trajectory* embTrajectory = createSunRelativeTrajectory(eph, JPLEphemeris::EarthMoonBarycenter);
+        loader->addBuiltinOrbit("EMB", embTrajectory);
+
+        loader->addBuiltinOrbit("Mercury", createSunRelativeTrajectory(eph, JPLEphemeris::Mercury));
+        loader->addBuiltinOrbit("Venus",   createSunRelativeTrajectory(eph, JPLEphemeris::Venus));
+        loader->addBuiltinOrbit("Mars",    createSunRelativeTrajectory(eph, JPLEphemeris::Mars));
+        loader->addBuiltinOrbit("Jupiter", createSunRelativeTrajectory(eph, JPLEphemeris::Jupiter));
+        loader->addBuiltinOrbit("Saturn",  createSunRelativeTrajectory(eph, JPLEphemeris::Saturn));
+        loader->addBuiltinOrbit("Uranus",  createSunRelativeTrajectory(eph, JPLEphemeris::Uranus));
+        loader->addBuiltinOrbit("Neptune", createSunRelativeTrajectory(eph, JPLEphemeris::Neptune));
+        loader->addBuiltinOrbit("Pluto",   createSunRelativeTrajectory(eph, JPLEphemeris::Pluto));
+
+        // m = the ratio of the Moon's to the mass of the Earth-Moon system
+        double m = 1.0 / (1.0 + eph->earthMoonMassRatio());
+        LinearCombinationTrajectory* earthTrajectory =
+                new LinearCombinationTrajectory(embTrajectory, 1.0,
+                                                eph->trajectory(JPLEphemeris::Moon), -m);
+        earthTrajectory->setPeriod(embTrajectory->period());
+        loader->addBuiltinOrbit("Earth", bakeLinearCombination(earthTrajectory, eph, "sunrel-earth"));
+
+        // JPL HORIZONS results for position of Moon with respect to Earth at 1 Jan 2000 12:00
+        // position: -2.916083884571964E+05 -2.667168292374240E+05 -7.610248132320160E+04
+        // velocity:  6.435313736079528E-01 -6.660876955662288E-01 -3.013257066079174E-01
+        //std::cout << "Moon @ J2000:  " << eph->trajectory(JPLEphemeris::Moon)->position(0.0).transpose().format(16) << std::endl;
+
+        // JPL HORIZONS results for position of Earth with respect to Sun at 1 Jan 2000 12:00
+        // position: -2.649903422886233E+07  1.327574176646856E+08  5.755671744790662E+07
+        // velocity: -2.979426004836674E+01 -5.018052460415045E+00 -2.175393728607054E+00
+        //std::cout << "Earth @ J2000: " << earthTrajectory->position(0.0).transpose().format(16) << std::endl;
+    }
+
+    // Martian satellites
+    loader->addBuiltinOrbit("Phobos", MarsSatOrbit::Create(MarsSatOrbit::Phobos));
+    loader->addBuiltinOrbit("Deimos", MarsSatOrbit::Create(MarsSatOrbit::Deimos));
+
+    // Galilean satellites
+    loader->addBuiltinOrbit("Io", L1Orbit::Create(L1Orbit::Io));
+    loader->addBuiltinOrbit("Europa", L1Orbit::Create(L1Orbit::Europa));
+    loader->addBuiltinOrbit("Ganymede", L1Orbit::Create(L1Orbit::Ganymede));
+    loader->addBuiltinOrbit("Callisto", L1Orbit::Create(L1Orbit::Callisto));
+
+    // Saturnian satellites
+    loader->addBuiltinOrbit("Mimas",     TASS17Orbit::Create(TASS17Orbit::Mimas));
+    loader->addBuiltinOrbit("Enceladus", TASS17Orbit::Create(TASS17Orbit::Enceladus));
+    loader->addBuiltinOrbit("Tethys",    TASS17Orbit::Create(TASS17Orbit::Tethys));
+    loader->addBuiltinOrbit("Dione",     TASS17Orbit::Create(TASS17Orbit::Dione));
+    loader->addBuiltinOrbit("Rhea",      TASS17Orbit::Create(TASS17Orbit::Rhea));
+    loader->addBuiltinOrbit("Titan",     TASS17Orbit::Create(TASS17Orbit::Titan));
+    loader->addBuiltinOrbit("Hyperion",  TASS17Orbit::Create(TASS17Orbit::Hyperion));
+    loader->addBuiltinOrbit("Iapetus",   TASS17Orbit::Create(TASS17Orbit::Iapetus));
+
+    // Uranian satellites
+    loader->addBuiltinOrbit("Miranda",   Gust86Orbit::Create(Gust86Orbit::Miranda));
+    loader->addBuiltinOrbit("Ariel",     Gust86Orbit::Create(Gust86Orbit::Ariel));
+    loader->addBuiltinOrbit("Umbriel",   Gust86Orbit::Create(Gust86Orbit::Umbriel));
+    loader->addBuiltinOrbit("Titania",   Gust86Orbit::Create(Gust86Orbit::Titania));
+    loader->addBuiltinOrbit("Oberon",    Gust86Orbit::Create(Gust86Orbit::Oberon));
+
+    // Set up builtin rotation models
+    loader->addBuiltinRotationModel("IAU Moon", new IAULunarRotationModel());
+}
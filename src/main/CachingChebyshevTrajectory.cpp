@@ -0,0 +1,243 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CachingChebyshevTrajectory.h"
+#include "AdaptiveChebyshevTrajectory.h"
+#include <QMutexLocker>
+#include <algorithm>
+#include <cmath>
+
+using namespace vesta;
+using namespace std;
+
+
+const double CachingChebyshevTrajectory::DefaultTolerance = 0.01;
+const double CachingChebyshevTrajectory::DefaultWindowDuration = 86400.0;
+
+// Periodic trajectories are fit in pieces no longer than this fraction of
+// the period.
+static const double PiecesPerPeriod = 8.0;
+
+
+/** Create a new caching trajectory.
+  *
+  * \param trajectory the trajectory to approximate
+  * \param tolerance the maximum allowed position error in kilometers
+  * \param windowDuration the length of the fitted windows in seconds
+  * \param maxWindowCount the maximum number of fitted windows kept in the cache
+  */
+CachingChebyshevTrajectory::CachingChebyshevTrajectory(Trajectory* trajectory,
+                                                       double tolerance,
+                                                       double windowDuration,
+                                                       unsigned int maxWindowCount) :
+    m_trajectory(trajectory),
+    m_tolerance(tolerance),
+    m_windowDuration(windowDuration),
+    m_maxWindowCount(max(1u, maxWindowCount)),
+    m_useCounter(0),
+    m_generation(0)
+{
+    setValidTimeRange(trajectory->startTime(), trajectory->endTime());
+}
+
+
+CachingChebyshevTrajectory::~CachingChebyshevTrajectory()
+{
+}
+
+
+StateVector
+CachingChebyshevTrajectory::state(double tdbSec) const
+{
+    // The fits only cover the valid time range of the source trajectory
+    if (tdbSec < m_trajectory->startTime() || tdbSec > m_trajectory->endTime())
+    {
+        return m_trajectory->state(tdbSec);
+    }
+
+    double index = floor(tdbSec / m_windowDuration);
+
+    unsigned int generation = 0;
+    FitPtr fit = findWindow(index, &generation);
+    if (fit.isNull())
+    {
+        // The window hasn't been fit yet. Do the fitting without holding the
+        // lock, since it requires many evaluations of the source trajectory.
+        fit = FitPtr(fitWindow(index));
+        if (fit.isNull())
+        {
+            return m_trajectory->state(tdbSec);
+        }
+
+        fit = addWindow(index, generation, fit);
+    }
+
+    return fit->state(tdbSec);
+}
+
+
+// Find the fit for a window, or return null if the window isn't cached. Also
+// returns the current generation of the cache.
+CachingChebyshevTrajectory::FitPtr
+CachingChebyshevTrajectory::findWindow(double index, unsigned int* generation) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    *generation = m_generation;
+    ++m_useCounter;
+    for (vector<Window>::iterator iter = m_windows.begin(); iter != m_windows.end(); ++iter)
+    {
+        if (iter->index == index)
+        {
+            iter->lastUsed = m_useCounter;
+            return iter->fit;
+        }
+    }
+
+    return FitPtr();
+}
+
+
+// Add a newly fit window to the cache, replacing the least recently used
+// window if the cache is full. Returns the fit to use: if another thread has
+// fit the same window in the meantime, that one is returned instead. Nothing
+// is added if the cache was invalidated since the fit was started.
+CachingChebyshevTrajectory::FitPtr
+CachingChebyshevTrajectory::addWindow(double index, unsigned int generation, const FitPtr& fit) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (generation != m_generation)
+    {
+        return fit;
+    }
+
+    ++m_useCounter;
+    for (vector<Window>::iterator iter = m_windows.begin(); iter != m_windows.end(); ++iter)
+    {
+        if (iter->index == index)
+        {
+            iter->lastUsed = m_useCounter;
+            return iter->fit;
+        }
+    }
+
+    Window window;
+    window.index = index;
+    window.lastUsed = m_useCounter;
+    window.fit = fit;
+
+    if (m_windows.size() < m_maxWindowCount)
+    {
+        m_windows.push_back(window);
+    }
+    else
+    {
+        // Replace the least recently used window. Threads that are still
+        // evaluating its fit keep their own references to it.
+        vector<Window>::iterator lru = m_windows.begin();
+        for (vector<Window>::iterator iter = m_windows.begin(); iter != m_windows.end(); ++iter)
+        {
+            if (m_useCounter - iter->lastUsed > m_useCounter - lru->lastUsed)
+            {
+                lru = iter;
+            }
+        }
+
+        *lru = window;
+    }
+
+    return fit;
+}
+
+
+double
+CachingChebyshevTrajectory::boundingSphereRadius() const
+{
+    return m_trajectory->boundingSphereRadius();
+}
+
+
+bool
+CachingChebyshevTrajectory::isPeriodic() const
+{
+    return m_trajectory->isPeriodic();
+}
+
+
+double
+CachingChebyshevTrajectory::period() const
+{
+    return m_trajectory->period();
+}
+
+
+/** Discard all fitted windows. This must be called whenever the wrapped
+  * trajectory is modified (e.g. when new elements are received for a TLE
+  * trajectory.) The valid time range is also updated from the wrapped
+  * trajectory.
+  */
+void
+CachingChebyshevTrajectory::invalidate()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_windows.clear();
+    ++m_generation;
+    setValidTimeRange(m_trajectory->startTime(), m_trajectory->endTime());
+}
+
+
+// Fit a window of the source trajectory. The window is clipped to the valid
+// time range of the source. Returns NULL if nothing is left after clipping
+// or if the fit fails.
+AdaptiveChebyshevTrajectory*
+CachingChebyshevTrajectory::fitWindow(double index) const
+{
+    double startTime = max(index * m_windowDuration, m_trajectory->startTime());
+    double endTime = min((index + 1.0) * m_windowDuration, m_trajectory->endTime());
+    if (endTime - startTime < AdaptiveChebyshevTrajectory::MinSegmentDuration)
+    {
+        return NULL;
+    }
+
+    // Fit periodic trajectories in pieces no longer than a fraction of the
+    // period. A polynomial can't follow several revolutions, and splitting a
+    // segment that spans many revolutions may not reduce the error enough for
+    // the adaptive fit to keep splitting it.
+    unsigned int pieceCount = 1;
+    if (m_trajectory->isPeriodic() && m_trajectory->period() > 0.0)
+    {
+        double maxPieceDuration = m_trajectory->period() / PiecesPerPeriod;
+        pieceCount = (unsigned int) ceil((endTime - startTime) / maxPieceDuration);
+    }
+
+    AdaptiveChebyshevTrajectory* fit = new AdaptiveChebyshevTrajectory();
+    double pieceDuration = (endTime - startTime) / pieceCount;
+    for (unsigned int i = 0; i < pieceCount; ++i)
+    {
+        double pieceEnd = i == pieceCount - 1 ? endTime : startTime + (i + 1) * pieceDuration;
+        fit->fit(m_trajectory.ptr(), startTime + i * pieceDuration, pieceEnd, m_tolerance);
+    }
+
+    if (fit->segmentCount() == 0)
+    {
+        delete fit;
+        return NULL;
+    }
+
+    return fit;
+}
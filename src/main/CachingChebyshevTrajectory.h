@@ -0,0 +1,119 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _CACHING_CHEBYSHEV_TRAJECTORY_H_
+#define _CACHING_CHEBYSHEV_TRAJECTORY_H_
+
+#include <vesta/Trajectory.h>
+#include <QMutex>
+#include <QSharedPointer>
+#include <vector>
+
+class AdaptiveChebyshevTrajectory;
+
+
+/** CachingChebyshevTrajectory wraps a trajectory that is expensive to
+  * evaluate (e.g. an analytical satellite theory or an SGP4 propagator) and
+  * serves states from Chebyshev polynomial fits of it.
+  *
+  * Time is divided into fixed length windows. The first time that a state
+  * within a window is requested, the window is fit with an
+  * AdaptiveChebyshevTrajectory to within the error tolerance. Fitted windows
+  * are kept in a small cache; when the cache is full, the least recently
+  * used window is discarded. Plotting a trajectory or playing back time at
+  * a high rate thus requires only occasional evaluations of the wrapped
+  * trajectory.
+  *
+  * States may be requested from multiple threads, but the wrapped trajectory
+  * must then also be safe to evaluate from multiple threads. Fits are never
+  * modified once they're created, and they're shared with the threads that
+  * evaluate them, so the lock is only held to find or add a window.
+  */
+class CachingChebyshevTrajectory : public vesta::Trajectory
+{
+public:
+    CachingChebyshevTrajectory(vesta::Trajectory* trajectory,
+                               double tolerance = DefaultTolerance,
+                               double windowDuration = DefaultWindowDuration,
+                               unsigned int maxWindowCount = DefaultMaxWindowCount);
+    ~CachingChebyshevTrajectory();
+
+    virtual vesta::StateVector state(double tdbSec) const;
+    virtual double boundingSphereRadius() const;
+    virtual bool isPeriodic() const;
+    virtual double period() const;
+
+    /** Get the trajectory that is approximated.
+      */
+    vesta::Trajectory* trajectory() const
+    {
+        return m_trajectory.ptr();
+    }
+
+    /** Get the maximum allowed position error in kilometers.
+      */
+    double tolerance() const
+    {
+        return m_tolerance;
+    }
+
+    /** Get the length of a fitted window in seconds.
+      */
+    double windowDuration() const
+    {
+        return m_windowDuration;
+    }
+
+    void invalidate();
+
+    // Default tolerance in kilometers
+    static const double DefaultTolerance;
+
+    // Default window length in seconds
+    static const double DefaultWindowDuration;
+
+    static const unsigned int DefaultMaxWindowCount = 32;
+
+private:
+    typedef QSharedPointer<const AdaptiveChebyshevTrajectory> FitPtr;
+
+    struct Window
+    {
+        double index;
+        unsigned int lastUsed;
+        FitPtr fit;
+    };
+
+    FitPtr findWindow(double index, unsigned int* generation) const;
+    FitPtr addWindow(double index, unsigned int generation, const FitPtr& fit) const;
+    AdaptiveChebyshevTrajectory* fitWindow(double index) const;
+
+private:
+    vesta::counted_ptr<vesta::Trajectory> m_trajectory;
+    double m_tolerance;
+    double m_windowDuration;
+    unsigned int m_maxWindowCount;
+
+    mutable QMutex m_mutex;
+    mutable std::vector<Window> m_windows;
+    mutable unsigned int m_useCounter;
+
+    // Incremented by invalidate(), so that windows fit before the wrapped
+    // trajectory changed aren't added to the cache afterward.
+    unsigned int m_generation;
+};
+
+#endif // _CACHING_CHEBYSHEV_TRAJECTORY_H_
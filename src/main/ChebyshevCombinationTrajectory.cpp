@@ -0,0 +1,476 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ChebyshevCombinationTrajectory.h"
+#include "LinearCombinationTrajectory.h"
+#include <vesta/Units.h>
+#include <Eigen/StdVector>
+#include <QAtomicPointer>
+#include <algorithm>
+#include <cmath>
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+// Compute the matrix that converts the coefficients of a Chebyshev series
+// on [-1, 1] to the coefficients of the same polynomial on the subinterval
+// [-1 + 2 * j / r, -1 + 2 * (j + 1) / r], i.e. the series in x of
+// p(x / r + b). The polynomial is sampled at the Chebyshev nodes and
+// converted back to coefficients with a discrete cosine transform, which
+// is exact (apart from roundoff) because the number of nodes exceeds the
+// degree.
+//
+// The result is a matrix with outCount rows and inCount columns, stored
+// by rows.
+static void
+subintervalTransform(unsigned int inCount, unsigned int outCount,
+                     unsigned int r, unsigned int j,
+                     double* m)
+{
+    double a = 1.0 / r;
+    double b = -1.0 + (2.0 * j + 1.0) / r;
+
+    for (unsigned int i = 0; i < inCount * outCount; ++i)
+    {
+        m[i] = 0.0;
+    }
+
+    for (unsigned int node = 0; node < outCount; ++node)
+    {
+        double theta = PI * (node + 0.5) / outCount;
+        double y = a * cos(theta) + b;
+
+        // Value of T_i(y) for each input coefficient
+        double t0 = 1.0;
+        double t1 = y;
+        for (unsigned int i = 0; i < inCount; ++i)
+        {
+            double ti = i == 0 ? t0 : t1;
+            if (i >= 1)
+            {
+                double t2 = 2.0 * y * t1 - t0;
+                t0 = t1;
+                t1 = t2;
+            }
+
+            for (unsigned int l = 0; l < outCount; ++l)
+            {
+                double scale = (l == 0 ? 1.0 : 2.0) / outCount;
+                m[l * inCount + i] += scale * ti * cos(l * theta);
+            }
+        }
+    }
+}
+
+
+/** CombinedGranules supplies the coefficients of a weighted sum of Chebyshev
+  * trajectories whose granules line up. Each granule is computed from the
+  * granules of the terms the first time that it's requested and kept from
+  * then on, so that the cost of baking a sum is spread over its use instead
+  * of paid up front for the whole span of the terms.
+  */
+class CombinedGranules : public ChebyshevGranuleSource
+{
+public:
+    CombinedGranules(unsigned int degree, unsigned int granuleCount) :
+        m_coeffCount(degree + 1),
+        m_granuleCount(granuleCount),
+        m_granules(new QAtomicPointer<double>[granuleCount])
+    {
+    }
+
+    ~CombinedGranules()
+    {
+        for (unsigned int i = 0; i < m_granuleCount; ++i)
+        {
+            delete[] m_granules[i].load();
+        }
+        delete[] m_granules;
+    }
+
+    /** Add a term to the sum.
+      *
+      * \param ratio the number of granules of the sum covered by each granule of the term
+      */
+    void addTerm(const ChebyshevPolyTrajectory* trajectory, double weight, unsigned int ratio)
+    {
+        Term term;
+        term.trajectory = const_cast<ChebyshevPolyTrajectory*>(trajectory);
+        term.weight = weight;
+        term.ratio = ratio;
+
+        // Compute the transforms from the coefficients of a term's granule to
+        // the coefficients of each of the granules of the sum that it covers
+        if (ratio > 1)
+        {
+            unsigned int termCoeffCount = trajectory->degree() + 1;
+            unsigned int matrixSize = m_coeffCount * termCoeffCount;
+            term.transforms.resize(ratio * matrixSize);
+            for (unsigned int j = 0; j < ratio; ++j)
+            {
+                subintervalTransform(termCoeffCount, m_coeffCount, ratio, j, &term.transforms[j * matrixSize]);
+            }
+        }
+
+        m_terms.push_back(term);
+    }
+
+    virtual const double* granule(unsigned int index, double* /* buffer */) const
+    {
+        const double* coeffs = m_granules[index].loadAcquire();
+        if (coeffs)
+        {
+            return coeffs;
+        }
+        else
+        {
+            return computeGranule(index);
+        }
+    }
+
+private:
+    // Sum the terms into a newly allocated granule and publish it. As with
+    // MappedChebyshevGranules, no lock is required: if two threads compute
+    // the same granule at the same time, the loser discards its copy.
+    const double* computeGranule(unsigned int index) const
+    {
+        double buffer[ChebyshevGranuleSource::MaxGranuleSize];
+        double* out = new double[m_coeffCount * 3];
+        std::fill(out, out + m_coeffCount * 3, 0.0);
+
+        for (vector<Term>::const_iterator iter = m_terms.begin(); iter != m_terms.end(); ++iter)
+        {
+            unsigned int r = iter->ratio;
+            unsigned int termCoeffCount = iter->trajectory->degree() + 1;
+            const double* in = iter->trajectory->granuleCoefficients(index / r, buffer);
+
+            for (unsigned int c = 0; c < 3; ++c)
+            {
+                const double* inc = in + c * termCoeffCount;
+                double* outc = out + c * m_coeffCount;
+
+                if (r == 1)
+                {
+                    // Same granule; just add the coefficients
+                    for (unsigned int i = 0; i < termCoeffCount; ++i)
+                    {
+                        outc[i] += iter->weight * inc[i];
+                    }
+                }
+                else
+                {
+                    const double* m = &iter->transforms[(index % r) * m_coeffCount * termCoeffCount];
+                    for (unsigned int l = 0; l < m_coeffCount; ++l)
+                    {
+                        double sum = 0.0;
+                        for (unsigned int i = 0; i < termCoeffCount; ++i)
+                        {
+                            sum += m[l * termCoeffCount + i] * inc[i];
+                        }
+                        outc[l] += iter->weight * sum;
+                    }
+                }
+            }
+        }
+
+        if (m_granules[index].testAndSetOrdered(NULL, out))
+        {
+            return out;
+        }
+        else
+        {
+            delete[] out;
+            return m_granules[index].loadAcquire();
+        }
+    }
+
+private:
+    struct Term
+    {
+        counted_ptr<ChebyshevPolyTrajectory> trajectory;
+        double weight;
+        unsigned int ratio;
+        vector<double> transforms;
+    };
+
+    vector<Term> m_terms;
+    unsigned int m_coeffCount;
+    unsigned int m_granuleCount;
+    mutable QAtomicPointer<double>* m_granules;
+};
+
+
+ChebyshevCombinationTrajectory::ChebyshevCombinationTrajectory() :
+    m_period(0.0)
+{
+}
+
+
+ChebyshevCombinationTrajectory::~ChebyshevCombinationTrajectory()
+{
+}
+
+
+/** Add a term to the sum. The state of the trajectory is multiplied by weight.
+  */
+void
+ChebyshevCombinationTrajectory::addTerm(ChebyshevPolyTrajectory* trajectory, double weight)
+{
+    Term term;
+    term.trajectory = trajectory;
+    term.weight = weight;
+    m_terms.push_back(term);
+}
+
+
+StateVector
+ChebyshevCombinationTrajectory::state(double tdbSec) const
+{
+    Vector6d sum = Vector6d::Zero();
+    for (vector<Term>::const_iterator iter = m_terms.begin(); iter != m_terms.end(); ++iter)
+    {
+        // Call ChebyshevPolyTrajectory::state directly rather than through the vtable
+        sum += iter->weight * iter->trajectory->ChebyshevPolyTrajectory::state(tdbSec).state();
+    }
+
+    return StateVector(sum);
+}
+
+
+/** Compute states at n times, passing the whole batch on to each term.
+  */
+void
+ChebyshevCombinationTrajectory::states(const double* t, size_t n, StateVector* out) const
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        out[i] = StateVector(Vector6d::Zero());
+    }
+
+    if (n == 0)
+    {
+        return;
+    }
+
+    std::vector<StateVector, aligned_allocator<StateVector> > termStates(n);
+    for (vector<Term>::const_iterator iter = m_terms.begin(); iter != m_terms.end(); ++iter)
+    {
+        iter->trajectory->ChebyshevPolyTrajectory::states(t, n, &termStates[0]);
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i] = StateVector(out[i].state() + iter->weight * termStates[i].state());
+        }
+    }
+}
+
+
+double
+ChebyshevCombinationTrajectory::boundingSphereRadius() const
+{
+    double radius = 0.0;
+    for (vector<Term>::const_iterator iter = m_terms.begin(); iter != m_terms.end(); ++iter)
+    {
+        radius += abs(iter->weight) * iter->trajectory->boundingSphereRadius();
+    }
+
+    return radius;
+}
+
+
+bool
+ChebyshevCombinationTrajectory::isPeriodic() const
+{
+    return m_period != 0.0;
+}
+
+
+double
+ChebyshevCombinationTrajectory::period() const
+{
+    return m_period;
+}
+
+
+/** Set the period of the trajectory in seconds. If the period is set
+  * to zero, the trajectory is treated as aperiodic.
+  */
+void
+ChebyshevCombinationTrajectory::setPeriod(double period)
+{
+    m_period = period;
+}
+
+
+/** Replace a linear combination of Chebyshev polynomial trajectories with
+  * a trajectory that is cheaper to evaluate. Nested LinearCombinationTrajectory
+  * objects are flattened into a single weighted sum. If the granules of all
+  * the terms line up (every granule length is a whole multiple of the
+  * shortest, and the terms cover the same time span), the sum is baked into
+  * a single ChebyshevPolyTrajectory with the shortest granule length and the
+  * highest degree of the terms; the coefficients are exact apart from
+  * roundoff. Otherwise the terms are evaluated together by a
+  * ChebyshevCombinationTrajectory.
+  *
+  * Baking itself is cheap: each granule of the baked table is computed from
+  * the terms the first time that it's used.
+  *
+  * \return a new trajectory, or NULL if the trajectory isn't a linear
+  * combination of Chebyshev polynomial trajectories
+  */
+Trajectory*
+ChebyshevCombinationTrajectory::Simplify(const Trajectory* trajectory)
+{
+    if (!dynamic_cast<const LinearCombinationTrajectory*>(trajectory) &&
+        !dynamic_cast<const ChebyshevCombinationTrajectory*>(trajectory))
+    {
+        return NULL;
+    }
+
+    vector<Term> terms;
+    if (!addTerms(trajectory, 1.0, &terms) || terms.empty())
+    {
+        return NULL;
+    }
+
+    ChebyshevPolyTrajectory* baked = bake(terms);
+    if (baked)
+    {
+        // The baked trajectory is only valid where all of the terms are; it
+        // clamps times outside that range just as the terms do.
+        baked->setPeriod(trajectory->period());
+        baked->setValidTimeRange(max(baked->startTime(), trajectory->startTime()),
+                                 min(baked->endTime(), trajectory->endTime()));
+        return baked;
+    }
+
+    ChebyshevCombinationTrajectory* combination = new ChebyshevCombinationTrajectory();
+    combination->m_terms = terms;
+    combination->setPeriod(trajectory->period());
+    combination->setValidTimeRange(trajectory->startTime(), trajectory->endTime());
+
+    return combination;
+}
+
+
+// Flatten a linear combination into a list of weighted Chebyshev terms. Terms
+// that refer to the same trajectory are merged. Returns false if a trajectory
+// in the combination isn't a Chebyshev polynomial trajectory.
+bool
+ChebyshevCombinationTrajectory::addTerms(const Trajectory* trajectory, double weight, vector<Term>* terms)
+{
+    if (!trajectory)
+    {
+        // Null trajectories in a linear combination have a state of zero
+        return true;
+    }
+
+    if (const LinearCombinationTrajectory* lct = dynamic_cast<const LinearCombinationTrajectory*>(trajectory))
+    {
+        return addTerms(lct->trajectory0(), weight * lct->weight0(), terms) &&
+               addTerms(lct->trajectory1(), weight * lct->weight1(), terms);
+    }
+
+    if (const ChebyshevCombinationTrajectory* combination = dynamic_cast<const ChebyshevCombinationTrajectory*>(trajectory))
+    {
+        for (vector<Term>::const_iterator iter = combination->m_terms.begin(); iter != combination->m_terms.end(); ++iter)
+        {
+            if (!addTerms(iter->trajectory.ptr(), weight * iter->weight, terms))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const ChebyshevPolyTrajectory* chebyshev = dynamic_cast<const ChebyshevPolyTrajectory*>(trajectory);
+    if (!chebyshev)
+    {
+        return false;
+    }
+
+    for (vector<Term>::iterator iter = terms->begin(); iter != terms->end(); ++iter)
+    {
+        if (iter->trajectory.ptr() == chebyshev)
+        {
+            iter->weight += weight;
+            return true;
+        }
+    }
+
+    Term term;
+    term.trajectory = const_cast<ChebyshevPolyTrajectory*>(chebyshev);
+    term.weight = weight;
+    terms->push_back(term);
+
+    return true;
+}
+
+
+// Combine the coefficients of the terms into a single Chebyshev trajectory.
+// The granules of the result are computed when they're first used. Returns
+// NULL if the granules of the terms don't line up.
+ChebyshevPolyTrajectory*
+ChebyshevCombinationTrajectory::bake(const vector<Term>& terms)
+{
+    // The shortest granule determines the granule length of the result
+    const ChebyshevPolyTrajectory* reference = terms.front().trajectory.ptr();
+    unsigned int degree = 0;
+    for (vector<Term>::const_iterator iter = terms.begin(); iter != terms.end(); ++iter)
+    {
+        if (iter->trajectory->granuleLength() < reference->granuleLength())
+        {
+            reference = iter->trajectory.ptr();
+        }
+        degree = max(degree, iter->trajectory->degree());
+    }
+
+    double granuleLength = reference->granuleLength();
+    double startTime = reference->firstGranuleStartTime();
+    unsigned int granuleCount = reference->granuleCount();
+
+    if (granuleCount == 0)
+    {
+        return NULL;
+    }
+
+    // Number of output granules covered by a granule of each term
+    vector<unsigned int> ratios;
+    for (vector<Term>::const_iterator iter = terms.begin(); iter != terms.end(); ++iter)
+    {
+        const ChebyshevPolyTrajectory* t = iter->trajectory.ptr();
+        double r = floor(t->granuleLength() / granuleLength + 0.5);
+        if (r < 1.0 ||
+            abs(r * granuleLength - t->granuleLength()) > 1.0e-9 * t->granuleLength() ||
+            abs(t->firstGranuleStartTime() - startTime) > 1.0e-9 * granuleLength ||
+            double(t->granuleCount()) * r != double(granuleCount))
+        {
+            return NULL;
+        }
+        ratios.push_back((unsigned int) r);
+    }
+
+    CombinedGranules* granules = new CombinedGranules(degree, granuleCount);
+    double boundingRadius = 0.0;
+    for (unsigned int k = 0; k < terms.size(); ++k)
+    {
+        granules->addTerm(terms[k].trajectory.ptr(), terms[k].weight, ratios[k]);
+        boundingRadius += abs(terms[k].weight) * terms[k].trajectory->boundingSphereRadius();
+    }
+
+    return new ChebyshevPolyTrajectory(granules, degree, granuleCount, startTime, granuleLength, boundingRadius);
+}
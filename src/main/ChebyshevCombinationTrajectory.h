@@ -0,0 +1,65 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _CHEBYSHEV_COMBINATION_TRAJECTORY_H_
+#define _CHEBYSHEV_COMBINATION_TRAJECTORY_H_
+
+#include "ChebyshevPolyTrajectory.h"
+#include <vector>
+
+
+/** ChebyshevCombinationTrajectory is a weighted sum of any number of
+  * Chebyshev polynomial trajectories. It computes the same states as a tree
+  * of LinearCombinationTrajectory objects, but evaluates all of the terms in
+  * a single loop.
+  *
+  * Usually it's better still to combine the coefficients of the terms into a
+  * single table; Simplify() does this when the granules of the terms line
+  * up, and falls back to a ChebyshevCombinationTrajectory when they don't.
+  */
+class ChebyshevCombinationTrajectory : public vesta::Trajectory
+{
+public:
+    ChebyshevCombinationTrajectory();
+    ~ChebyshevCombinationTrajectory();
+
+    void addTerm(ChebyshevPolyTrajectory* trajectory, double weight);
+
+    virtual vesta::StateVector state(double tdbSec) const;
+    virtual void states(const double* t, std::size_t n, vesta::StateVector* out) const;
+    virtual double boundingSphereRadius() const;
+    virtual bool isPeriodic() const;
+    virtual double period() const;
+    void setPeriod(double period);
+
+    static vesta::Trajectory* Simplify(const vesta::Trajectory* trajectory);
+
+private:
+    struct Term
+    {
+        vesta::counted_ptr<ChebyshevPolyTrajectory> trajectory;
+        double weight;
+    };
+
+    static bool addTerms(const vesta::Trajectory* trajectory, double weight, std::vector<Term>* terms);
+    static ChebyshevPolyTrajectory* bake(const std::vector<Term>& terms);
+
+private:
+    std::vector<Term> m_terms;
+    double m_period;
+};
+
+#endif // _CHEBYSHEV_COMBINATION_TRAJECTORY_H_
@@ -17,15 +17,37 @@
 #include "ChebyshevPolyTrajectory.h"
 #include <vesta/Debug.h>
 #include <algorithm>
+#include <cmath>
 
 using namespace vesta;
 using namespace Eigen;
 using namespace std;
 
 
+// Get the radius of a sphere centered at the origin that contains the
+// trajectory over the span of a single granule. Since |T_i(u)| <= 1 on
+// [-1, 1], the sum of the absolute values of the coefficients bounds each
+// component.
+static double
+granuleBoundingRadius(const double* coeffs, unsigned int degree)
+{
+    Vector3d extent = Vector3d::Zero();
+    for (unsigned int j = 0; j < 3; ++j)
+    {
+        for (unsigned int i = 0; i <= degree; ++i)
+        {
+            extent[j] += abs(coeffs[j * (degree + 1) + i]);
+        }
+    }
+
+    return extent.norm();
+}
+
+
 /** Create a new Chebyshev polynomial trajectory.
-  * The coefficients array must contain (degree + 1) * granuleCount * 3 values. They should be arranged
-  * as an array of triples with low-order coefficients first: x0 y0 z0 x1 y1 z1 ...
+  * The coefficients array must contain (degree + 1) * granuleCount * 3 values. The coefficients
+  * for each granule are arranged by component with low-order coefficients first:
+  * x0 x1 ... xn y0 y1 ... yn z0 z1 ... zn
   *
   * \param coeffs the array of Chebyshev coefficients for interpolating the position
   * \param degree the degree of the polynomial (there will be degree + 1 coefficients)
@@ -44,7 +66,8 @@ ChebyshevPolyTrajectory::ChebyshevPolyTrajectory(const double coeffs[],
     m_startTime(startTimeTdbSec),
     m_granuleLength(granuleLengthSec),
     m_period(0.0),
-    m_boundingRadius(0.0)
+    m_boundingRadius(0.0),
+    m_evaluator(evaluatorForDegree(degree))
 {
     // assert(degree <= MaxChebyshevDegree);
     unsigned int coeffCount = (degree + 1) * granuleCount * 3;
@@ -58,16 +81,62 @@ ChebyshevPolyTrajectory::ChebyshevPolyTrajectory(const double coeffs[],
     // large enough to contain the trajectory.)
     for (unsigned int granule = 0; granule < granuleCount; ++granule)
     {
-        const double* granuleCoeffs = m_coeffs + granule * (degree + 1) * 3;
-        Vector3d x0(granuleCoeffs[0], granuleCoeffs[1], granuleCoeffs[2]);
-        Vector3d ext = Vector3d::Zero();
-        for (unsigned int i = 1; i <= degree; ++i)
-        {
-            ext += Vector3d(granuleCoeffs[i * 3 + 0], granuleCoeffs[i * 3 + 1], granuleCoeffs[i * 3 + 2]).cwise().abs();
-        }
+        m_boundingRadius = max(m_boundingRadius, granuleBoundingRadius(m_coeffs + granule * (degree + 1) * 3, degree));
+    }
+}
 
-        m_boundingRadius = max(m_boundingRadius, (x0 + ext).norm());
+
+/** Create a new Chebyshev polynomial trajectory with coefficients supplied
+  * by a granule source. The trajectory doesn't copy the coefficients, and
+  * the bounding radius must be given by the caller because computing it
+  * would require visiting every granule.
+  *
+  * \param source the object that provides coefficients for each granule
+  * \param degree the degree of the polynomial (there will be degree + 1 coefficients)
+  * \param granuleCount the number of granules in the trajectory
+  * \param startTimeTdbSec the first instant of the trajectory in seconds since J2000 (TDB time scale)
+  * \param granuleLengthSec the time span covered by each granule
+  * \param boundingRadius radius of a sphere large enough to contain the trajectory
+  */
+ChebyshevPolyTrajectory::ChebyshevPolyTrajectory(ChebyshevGranuleSource* source,
+                                                 unsigned int degree,
+                                                 unsigned int granuleCount,
+                                                 double startTimeTdbSec,
+                                                 double granuleLengthSec,
+                                                 double boundingRadius) :
+    m_coeffs(NULL),
+    m_granuleSource(source),
+    m_degree(degree),
+    m_granuleCount(granuleCount),
+    m_startTime(startTimeTdbSec),
+    m_granuleLength(granuleLengthSec),
+    m_period(0.0),
+    m_boundingRadius(boundingRadius),
+    m_evaluator(evaluatorForDegree(degree))
+{
+    setStartTime(startTimeTdbSec);
+    setEndTime(startTimeTdbSec + granuleCount * granuleLengthSec);
+}
+
+
+/** Calculate a conservative bounding radius for a trajectory with coefficients
+  * supplied by a granule source. Every granule is visited, so when the source is a
+  * memory mapped file, the whole file will be read; callers should store the result
+  * rather than calling this each time that the trajectory is loaded.
+  */
+double
+ChebyshevPolyTrajectory::computeBoundingRadius(const ChebyshevGranuleSource* source,
+                                               unsigned int degree,
+                                               unsigned int granuleCount)
+{
+    double buffer[ChebyshevGranuleSource::MaxGranuleSize];
+    double boundingRadius = 0.0;
+    for (unsigned int granule = 0; granule < granuleCount; ++granule)
+    {
+        boundingRadius = max(boundingRadius, granuleBoundingRadius(source->granule(granule, buffer), degree));
     }
+
+    return boundingRadius;
 }
 
 
@@ -77,52 +146,198 @@ ChebyshevPolyTrajectory::~ChebyshevPolyTrajectory()
 }
 
 
-StateVector
-ChebyshevPolyTrajectory::state(double tdbSec) const
+// Number of samples evaluated together by the batch Clenshaw kernel. The
+// innermost loops run across samples, which lets the compiler vectorize them.
+static const unsigned int SampleBlockSize = 4;
+
+
+// Evaluate position and velocity for exactly BlockSize values of the
+// interpolation parameter u using Clenshaw's recurrence, which sums the high
+// order terms first. The derivative is evaluated with the differentiated
+// recurrence:
+//    b[k] = c[k] + 2u b[k+1] - b[k+2]            f(u) = c[0] + u b[1] - b[2]
+//    d[k] = 2 b[k+1] + 2u d[k+1] - d[k+2]       f'(u) = b[1] + u d[1] - d[2]
+//
+// CoeffCount is the number of coefficients per component, or zero when it is
+// only known at runtime. Making it a template parameter lets the compiler fully
+// unroll the recurrence for the common polynomial degrees.
+template<unsigned int CoeffCount, unsigned int BlockSize>
+static inline void
+clenshawBlock(const double* coeffs, unsigned int coeffCount,
+              const double* u,
+              double velocityScale,
+              StateVector* out)
+{
+    const unsigned int n = CoeffCount == 0 ? coeffCount : CoeffCount;
+
+    double twoU[BlockSize];
+    for (unsigned int s = 0; s < BlockSize; ++s)
+    {
+        twoU[s] = 2.0 * u[s];
+    }
+
+    double result[6][BlockSize];
+    for (unsigned int j = 0; j < 3; ++j)
+    {
+        const double* c = coeffs + j * n;
+
+        double b1[BlockSize];
+        double b2[BlockSize];
+        double d1[BlockSize];
+        double d2[BlockSize];
+        for (unsigned int s = 0; s < BlockSize; ++s)
+        {
+            b1[s] = b2[s] = d1[s] = d2[s] = 0.0;
+        }
+
+        for (unsigned int k = n - 1; k >= 1; --k)
+        {
+            const double ck = c[k];
+            for (unsigned int s = 0; s < BlockSize; ++s)
+            {
+                double b0 = ck + twoU[s] * b1[s] - b2[s];
+                double d0 = 2.0 * b1[s] + twoU[s] * d1[s] - d2[s];
+                b2[s] = b1[s];
+                b1[s] = b0;
+                d2[s] = d1[s];
+                d1[s] = d0;
+            }
+        }
+
+        for (unsigned int s = 0; s < BlockSize; ++s)
+        {
+            result[j][s] = c[0] + u[s] * b1[s] - b2[s];
+            result[j + 3][s] = (b1[s] + u[s] * d1[s] - d2[s]) * velocityScale;
+        }
+    }
+
+    for (unsigned int s = 0; s < BlockSize; ++s)
+    {
+        out[s] = StateVector(Vector3d(result[0][s], result[1][s], result[2][s]),
+                             Vector3d(result[3][s], result[4][s], result[5][s]));
+    }
+}
+
+
+// Evaluate any number of samples from a single granule: full blocks first,
+// then the remainder one sample at a time.
+template<unsigned int CoeffCount>
+static void
+evaluateGranule(const double* coeffs, unsigned int coeffCount,
+                const double* u, unsigned int sampleCount,
+                double velocityScale,
+                StateVector* out)
+{
+    unsigned int i = 0;
+    for (; i + SampleBlockSize <= sampleCount; i += SampleBlockSize)
+    {
+        clenshawBlock<CoeffCount, SampleBlockSize>(coeffs, coeffCount, u + i, velocityScale, out + i);
+    }
+
+    for (; i < sampleCount; ++i)
+    {
+        clenshawBlock<CoeffCount, 1>(coeffs, coeffCount, u + i, velocityScale, out + i);
+    }
+}
+
+
+// Choose an evaluation function specialized for the polynomial degree. The
+// specializations cover the degrees used by the JPL DE ephemerides and the
+// Chebyshev trajectory files distributed with Cosmographia.
+ChebyshevPolyTrajectory::GranuleEvaluator
+ChebyshevPolyTrajectory::evaluatorForDegree(unsigned int degree)
+{
+    switch (degree + 1)
+    {
+    case 6:  return evaluateGranule<6>;
+    case 7:  return evaluateGranule<7>;
+    case 8:  return evaluateGranule<8>;
+    case 9:  return evaluateGranule<9>;
+    case 10: return evaluateGranule<10>;
+    case 11: return evaluateGranule<11>;
+    case 12: return evaluateGranule<12>;
+    case 13: return evaluateGranule<13>;
+    case 14: return evaluateGranule<14>;
+    default: return evaluateGranule<0>;
+    }
+}
+
+
+// Find the granule containing the specified time and compute the interpolation
+// parameter u, which has a value in [-1, 1]
+unsigned int
+ChebyshevPolyTrajectory::findGranule(double tdbSec, double* u) const
 {
     tdbSec = max(startTime(), min(endTime(), tdbSec));
 
     int granuleIndex = int((tdbSec - m_startTime) / m_granuleLength);
     double granuleStartTime = m_startTime + m_granuleLength * granuleIndex;
 
-    // The interpolation parameter is u, which has a value in [-1, 1]
-    double u = 2.0 * (tdbSec - granuleStartTime) / m_granuleLength - 1.0;
+    *u = 2.0 * (tdbSec - granuleStartTime) / m_granuleLength - 1.0;
 
     // Clamp times outside the time span covered by the trajectory
     if (granuleIndex < 0)
     {
-        u = -1.0;
+        *u = -1.0;
         granuleIndex = 0;
     }
     else if (granuleIndex >= int(m_granuleCount))
     {
-        u = 1.0;
+        *u = 1.0;
         granuleIndex = m_granuleCount - 1;
     }
 
-    // Position terms
-    double x[MaxChebyshevDegree + 1];
-    x[0] = 1.0;
-    x[1] = u;
+    return (unsigned int) granuleIndex;
+}
 
-    // Velocity terms (derivatives of position)
-    double v[MaxChebyshevDegree + 1];
-    v[0] = 0.0;
-    v[1] = 1.0;
 
-    for (unsigned int i = 2; i <= m_degree; ++i)
-    {
-        x[i] = 2.0 * u * x[i - 1] - x[i - 2];
-        v[i] = 2.0 * u * v[i - 1] - v[i - 2] + 2.0 * x[i - 1];
-    }
+StateVector
+ChebyshevPolyTrajectory::state(double tdbSec) const
+{
+    double u = 0.0;
+    unsigned int granuleIndex = findGranule(tdbSec, &u);
 
-    // TODO: We can reduce numerical errors by summing high order terms first; should
-    // find out if this matters enough to be worth the trouble.
-    double* granuleCoeffs = m_coeffs + granuleIndex * (m_degree + 1) * 3;
-    Vector3d position = Map<MatrixXd>(granuleCoeffs, m_degree + 1, 3).transpose() * Map<MatrixXd>(x, m_degree + 1, 1);
-    Vector3d velocity = Map<MatrixXd>(granuleCoeffs, m_degree + 1, 3).transpose() * Map<MatrixXd>(v, m_degree + 1, 1);
+    double buffer[ChebyshevGranuleSource::MaxGranuleSize];
+    StateVector result;
+    m_evaluator(granuleCoefficients(granuleIndex, buffer), m_degree + 1, &u, 1, 2.0 / m_granuleLength, &result);
 
-    return StateVector(position, velocity * (2.0 / m_granuleLength));
+    return result;
+}
+
+
+/** Compute states at n different times. Runs of consecutive times that fall
+  * within the same granule are evaluated together, so sampling a trajectory
+  * at increasing times (e.g. for plotting) is considerably faster than calling
+  * state() for each time. Times in arbitrary order give correct results, but
+  * without the speedup.
+  */
+void
+ChebyshevPolyTrajectory::states(const double* t, size_t n, StateVector* out) const
+{
+    // Maximum number of samples gathered before calling the evaluator
+    const unsigned int MaxRunLength = 64;
+    double u[MaxRunLength];
+    double buffer[ChebyshevGranuleSource::MaxGranuleSize];
+
+    const double velocityScale = 2.0 / m_granuleLength;
+
+    size_t i = 0;
+    while (i < n)
+    {
+        unsigned int granuleIndex = findGranule(t[i], &u[0]);
+        unsigned int runLength = 1;
+        while (runLength < MaxRunLength && i + runLength < n)
+        {
+            if (findGranule(t[i + runLength], &u[runLength]) != granuleIndex)
+            {
+                break;
+            }
+            ++runLength;
+        }
+
+        m_evaluator(granuleCoefficients(granuleIndex, buffer), m_degree + 1, u, runLength, velocityScale, out + i);
+        i += runLength;
+    }
 }
 
 
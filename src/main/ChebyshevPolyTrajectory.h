@@ -20,6 +20,34 @@
 #include <vesta/Trajectory.h>
 
 
+/** A ChebyshevGranuleSource supplies the coefficients for the granules
+  * of a Chebyshev polynomial trajectory that doesn't keep its own copy of
+  * the coefficients, e.g. when they live in a memory mapped ephemeris
+  * file. The coefficients for each granule must be arranged as in a
+  * CHEBPOLY file: x0 x1 ... xn y0 y1 ... yn z0 z1 ... zn
+  *
+  * Sources that store coefficients in some other form (e.g. compacted to
+  * fewer bits) decode each granule into a buffer supplied by the caller.
+  */
+class ChebyshevGranuleSource : public vesta::Object
+{
+public:
+    virtual ~ChebyshevGranuleSource() {}
+
+    /** Return a pointer to the 3 * (degree + 1) coefficients of the
+      * specified granule. The source may either return a pointer to its own
+      * storage or decode the coefficients into buffer, which has room for
+      * MaxGranuleSize values and remains valid until the caller's next
+      * request. This method may be called from multiple threads
+      * simultaneously.
+      */
+    virtual const double* granule(unsigned int index, double* buffer) const = 0;
+
+    // Largest number of coefficients in a granule (3 * (MaxChebyshevDegree + 1))
+    static const unsigned int MaxGranuleSize = 99;
+};
+
+
 class ChebyshevPolyTrajectory : public vesta::Trajectory
 {
 public:
@@ -28,26 +56,93 @@ public:
                             double granuleCount,
                             double startTimeTdbSec,
                             double granuleLengthSec);
+    ChebyshevPolyTrajectory(ChebyshevGranuleSource* source,
+                            unsigned int degree,
+                            unsigned int granuleCount,
+                            double startTimeTdbSec,
+                            double granuleLengthSec,
+                            double boundingRadius);
 
     ~ChebyshevPolyTrajectory();
 
     virtual vesta::StateVector state(double tdbSec) const;
+    virtual void states(const double* t, std::size_t n, vesta::StateVector* out) const;
     virtual double boundingSphereRadius() const;
     virtual bool isPeriodic() const;
     virtual double period() const;
 
     void setPeriod(double period);
 
+    /** Get the degree of the polynomials (there are degree + 1 coefficients
+      * per component.)
+      */
+    unsigned int degree() const
+    {
+        return m_degree;
+    }
+
+    /** Get the number of granules in the trajectory.
+      */
+    unsigned int granuleCount() const
+    {
+        return m_granuleCount;
+    }
+
+    /** Get the start time of the first granule in seconds since J2000 TDB.
+      */
+    double firstGranuleStartTime() const
+    {
+        return m_startTime;
+    }
+
+    /** Get the time span covered by each granule in seconds.
+      */
+    double granuleLength() const
+    {
+        return m_granuleLength;
+    }
+
+    /** Get the coefficients of a granule, arranged as x0 ... xn y0 ... yn z0 ... zn
+      * The coefficients may be decoded into buffer, which must have room for
+      * ChebyshevGranuleSource::MaxGranuleSize values.
+      */
+    const double* granuleCoefficients(unsigned int granuleIndex, double* buffer) const
+    {
+        if (m_coeffs)
+        {
+            return m_coeffs + granuleIndex * (m_degree + 1) * 3;
+        }
+        else
+        {
+            return m_granuleSource->granule(granuleIndex, buffer);
+        }
+    }
+
+    static double computeBoundingRadius(const ChebyshevGranuleSource* source,
+                                        unsigned int degree,
+                                        unsigned int granuleCount);
+
     static const unsigned int MaxChebyshevDegree = 32;
 
+private:
+    typedef void (*GranuleEvaluator)(const double* coeffs, unsigned int coeffCount,
+                                     const double* u, unsigned int sampleCount,
+                                     double velocityScale,
+                                     vesta::StateVector* out);
+    static GranuleEvaluator evaluatorForDegree(unsigned int degree);
+
+    unsigned int findGranule(double tdbSec, double* u) const;
+
 private:
     double* m_coeffs;
+    vesta::counted_ptr<ChebyshevGranuleSource> m_granuleSource;
     unsigned int m_degree;
     unsigned int m_granuleCount;
     double m_startTime;
     double m_granuleLength;
     double m_period;
     double m_boundingRadius;
+    GranuleEvaluator m_evaluator;
 };
 
 #endif // _CHEBYSHEV_POLY_TRAJECTORY_H_
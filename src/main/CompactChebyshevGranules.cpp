@@ -0,0 +1,149 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CompactChebyshevGranules.h"
+#include <QtEndian>
+#include <cstring>
+
+
+static double
+readLittleEndianDouble(const uchar* p)
+{
+    quint64 bits = qFromLittleEndian<quint64>(p);
+    double x = 0.0;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+
+static float
+readLittleEndianFloat(const uchar* p)
+{
+    quint32 bits = qFromLittleEndian<quint32>(p);
+    float x = 0.0f;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+
+/** Create a new granule source for compact coefficients in a mapped file.
+  *
+  * \param file the mapped file containing the coefficients
+  * \param firstGranuleOffset offset in bytes of the first granule record
+  * \param degree the degree of the Chebyshev polynomials
+  * \param granuleCount the total number of granules
+  * \param doubleTermCount the number of coefficients per component stored as doubles
+  * \param encoding the encoding of the remaining coefficients
+  */
+CompactChebyshevGranules::CompactChebyshevGranules(MappedFile* file,
+                                                   qint64 firstGranuleOffset,
+                                                   unsigned int degree,
+                                                   unsigned int granuleCount,
+                                                   unsigned int doubleTermCount,
+                                                   Encoding encoding) :
+    m_file(file),
+    m_firstGranuleOffset(firstGranuleOffset),
+    m_degree(degree),
+    m_granuleCount(granuleCount),
+    m_doubleTermCount(doubleTermCount),
+    m_encoding(encoding),
+    m_recordSize(RecordSize(degree, doubleTermCount, encoding))
+{
+}
+
+
+CompactChebyshevGranules::~CompactChebyshevGranules()
+{
+}
+
+
+/** Return true if the layout is valid and all granules lie within the bounds
+  * of the mapped file.
+  */
+bool
+CompactChebyshevGranules::isValid() const
+{
+    if (m_granuleCount == 0 ||
+        m_doubleTermCount > m_degree + 1 ||
+        (m_encoding != Float32 && m_encoding != ScaledInt32))
+    {
+        return false;
+    }
+
+    return m_file->contains(m_firstGranuleOffset, qint64(m_recordSize) * m_granuleCount);
+}
+
+
+const double*
+CompactChebyshevGranules::granule(unsigned int index, double* buffer) const
+{
+    const unsigned int n = m_degree + 1;
+    const unsigned int lowCount = m_doubleTermCount;
+    const unsigned int highCount = n - lowCount;
+
+    const uchar* record = m_file->data() + m_firstGranuleOffset + qint64(index) * m_recordSize;
+    for (unsigned int c = 0; c < 3; ++c)
+    {
+        for (unsigned int i = 0; i < lowCount; ++i)
+        {
+            buffer[c * n + i] = readLittleEndianDouble(record + (c * lowCount + i) * sizeof(double));
+        }
+    }
+
+    const uchar* high = record + 3 * lowCount * sizeof(double);
+    if (m_encoding == Float32)
+    {
+        for (unsigned int c = 0; c < 3; ++c)
+        {
+            for (unsigned int i = 0; i < highCount; ++i)
+            {
+                buffer[c * n + lowCount + i] = readLittleEndianFloat(high + (c * highCount + i) * 4);
+            }
+        }
+    }
+    else
+    {
+        const uchar* values = high + 3 * sizeof(double);
+        for (unsigned int c = 0; c < 3; ++c)
+        {
+            double scale = readLittleEndianDouble(high + c * sizeof(double));
+            for (unsigned int i = 0; i < highCount; ++i)
+            {
+                qint32 value = qFromLittleEndian<qint32>(values + (c * highCount + i) * 4);
+                buffer[c * n + lowCount + i] = scale * value;
+            }
+        }
+    }
+
+    return buffer;
+}
+
+
+/** Get the size in bytes of a granule record.
+  */
+unsigned int
+CompactChebyshevGranules::RecordSize(unsigned int degree, unsigned int doubleTermCount, Encoding encoding)
+{
+    unsigned int highCount = degree + 1 - doubleTermCount;
+    unsigned int size = 3 * doubleTermCount * sizeof(double) + 3 * highCount * 4;
+    if (encoding == ScaledInt32)
+    {
+        size += 3 * sizeof(double);
+    }
+
+    // Pad to a multiple of 8 bytes so that every record is aligned
+    return (size + 7) & ~7u;
+}
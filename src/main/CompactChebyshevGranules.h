@@ -0,0 +1,74 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _COMPACT_CHEBYSHEV_GRANULES_H_
+#define _COMPACT_CHEBYSHEV_GRANULES_H_
+
+#include "ChebyshevPolyTrajectory.h"
+#include "MappedFile.h"
+
+
+/** CompactChebyshevGranules provides Chebyshev polynomial coefficients
+  * stored in compact form in a memory mapped file. The high order
+  * coefficients of a trajectory are many orders of magnitude smaller than
+  * the leading ones and don't need double precision: in each granule, the
+  * first few coefficients of each component are stored as doubles and
+  * the rest are stored in 32 bits, either as floats or as integers
+  * multiplied by a scale factor (one per component per granule.)
+  *
+  * A granule record contains:
+  *   3 * doubleTermCount doubles - low order terms: x0 ... y0 ... z0 ...
+  *   3 doubles                   - scale factors for x, y, and z (ScaledInt32 only)
+  *   3 * (degree + 1 - doubleTermCount) floats or int32s - high order terms
+  * padded to a multiple of 8 bytes. All values are little endian.
+  *
+  * Granules are decoded into the caller's buffer each time that they're
+  * requested; decoding is cheap compared to evaluating the polynomials.
+  */
+class CompactChebyshevGranules : public ChebyshevGranuleSource
+{
+public:
+    enum Encoding
+    {
+        Float32     = 0,
+        ScaledInt32 = 1,
+    };
+
+    CompactChebyshevGranules(MappedFile* file,
+                             qint64 firstGranuleOffset,
+                             unsigned int degree,
+                             unsigned int granuleCount,
+                             unsigned int doubleTermCount,
+                             Encoding encoding);
+    ~CompactChebyshevGranules();
+
+    virtual const double* granule(unsigned int index, double* buffer) const;
+
+    bool isValid() const;
+
+    static unsigned int RecordSize(unsigned int degree, unsigned int doubleTermCount, Encoding encoding);
+
+private:
+    vesta::counted_ptr<MappedFile> m_file;
+    qint64 m_firstGranuleOffset;
+    unsigned int m_degree;
+    unsigned int m_granuleCount;
+    unsigned int m_doubleTermCount;
+    Encoding m_encoding;
+    unsigned int m_recordSize;
+};
+
+#endif // _COMPACT_CHEBYSHEV_GRANULES_H_
@@ -27,14 +27,11 @@
 #elif QTKIT_SUPPORT
 #include "../video/VideoEncoder.h"
 #endif
-#include "JPLEphemeris.h"
+#include "BuiltinModels.h"
 #include "NetworkTextureLoader.h"
-#include "LinearCombinationTrajectory.h"
-#include "astro/IAULunarRotationModel.h"
-#include "astro/MarsSat.h"
-#include "astro/L1.h"
-#include "astro/TASS17.h"
-#include "astro/Gust86.h"
+#include "TleSetRequester.h"
+#include "CachingChebyshevTrajectory.h"
+#include "SharedEphemerisCache.h"
 #include "DateUtility.h"
 #include "NumberFormat.h"
 #include "SkyLabelLayer.h"
@@ -69,7 +66,7 @@
 #include <QStackedLayout>
 #include <QDialogButtonBox>
 #include <QDesktopServices>
-#include <QNetworkDiskCache>
+#include <QThread>
 #include <QNetworkRequest>
 #include <QDeclarativeEngine>
 #include <QDeclarativeComponent>
@@ -91,6 +88,8 @@ Cosmographia::Cosmographia() :
     m_helpCatalog(NULL),
     m_fullScreenAction(NULL),
     m_networkManager(NULL),
+    m_tleRequester(NULL),
+    m_tleRequestThread(NULL),
     m_catalogWrapper(NULL),
     m_autoHideToolBar(false),
     m_videoSize("wvga")
@@ -152,6 +151,14 @@ Cosmographia::~Cosmographia()
 {
     saveSettings();
     delete m_catalogWrapper;
+
+    if (m_tleRequestThread)
+    {
+        m_tleRequestThread->exit();
+        m_tleRequestThread->wait();
+        delete m_tleRequestThread;
+    }
+    delete m_tleRequester;
 }
 
 
@@ -582,17 +589,6 @@ Cosmographia::initializeUniverse()
 }
 
 
-// Convert a JPL ephemeris orbit from SSB-centered to Sun-centered
-static Trajectory*
-createSunRelativeTrajectory(const JPLEphemeris* eph, JPLEphemeris::JplObjectId id)
-{
-    LinearCombinationTrajectory* orbit = new LinearCombinationTrajectory(eph->trajectory(id), 1.0,
-                                                                         eph->trajectory(JPLEphemeris::Sun), -1.0);
-    orbit->setPeriod(eph->trajectory(id)->period());
-    return orbit;
-}
-
-
 static QString cacheFilePath(const QString& fileName)
 {
 #if 0
@@ -635,101 +631,23 @@ static QString documentFilePath(const QString& fileName)
 void
 Cosmographia::initialize()
 {
-    // Set up builtin orbits
-    JPLEphemeris* eph = JPLEphemeris::load("de406_1800-2100.dat");
-    if (eph)
-    {
-        m_loader->addBuiltinOrbit("Sun",     eph->trajectory(JPLEphemeris::Sun));
-        m_loader->addBuiltinOrbit("Moon",    eph->trajectory(JPLEphemeris::Moon));
-
-        // The code below will create planet trajectories relative to the SSB
-        /*
-        m_loader->addBuiltinOrbit("Mercury", eph->trajectory(JPLEphemeris::Mercury));
-        m_loader->addBuiltinOrbit("Venus",   eph->trajectory(JPLEphemeris::Venus));
-        m_loader->addBuiltinOrbit("EMB",     eph->trajectory(JPLEphemeris::EarthMoonBarycenter));
-        m_loader->addBuiltinOrbit("Mars",    eph->trajectory(JPLEphemeris::Mars));
-        m_loader->addBuiltinOrbit("Jupiter", eph->trajectory(JPLEphemeris::Jupiter));
-        m_loader->addBuiltinOrbit("Saturn",  eph->trajectory(JPLEphemeris::Saturn));
-        m_loader->addBuiltinOrbit("Uranus",  eph->trajectory(JPLEphemeris::Uranus));
-        m_loader->addBuiltinOrbit("Neptune", eph->trajectory(JPLEphemeris::Neptune));
-        m_loader->addBuiltinOrbit("Pluto",   eph->trajectory(JPLEphemeris::Pluto));
-        */
-
-        Trajectory* embTrajectory = createSunRelativeTrajectory(eph, JPLEphemeris::EarthMoonBarycenter);
-        m_loader->addBuiltinOrbit("EMB", embTrajectory);
-
-        m_loader->addBuiltinOrbit("Mercury", createSunRelativeTrajectory(eph, JPLEphemeris::Mercury));
-        m_loader->addBuiltinOrbit("Venus",   createSunRelativeTrajectory(eph, JPLEphemeris::Venus));
-        m_loader->addBuiltinOrbit("Mars",    createSunRelativeTrajectory(eph, JPLEphemeris::Mars));
-        m_loader->addBuiltinOrbit("Jupiter", createSunRelativeTrajectory(eph, JPLEphemeris::Jupiter));
-        m_loader->addBuiltinOrbit("Saturn",  createSunRelativeTrajectory(eph, JPLEphemeris::Saturn));
-        m_loader->addBuiltinOrbit("Uranus",  createSunRelativeTrajectory(eph, JPLEphemeris::Uranus));
-        m_loader->addBuiltinOrbit("Neptune", createSunRelativeTrajectory(eph, JPLEphemeris::Neptune));
-        m_loader->addBuiltinOrbit("Pluto",   createSunRelativeTrajectory(eph, JPLEphemeris::Pluto));
-
-        // m = the ratio of the Moon's to the mass of the Earth-Moon system
-        double m = 1.0 / (1.0 + eph->earthMoonMassRatio());
-        LinearCombinationTrajectory* earthTrajectory =
-                new LinearCombinationTrajectory(embTrajectory, 1.0,
-                                                eph->trajectory(JPLEphemeris::Moon), -m);
-        earthTrajectory->setPeriod(embTrajectory->period());
-        m_loader->addBuiltinOrbit("Earth", earthTrajectory);
-
-        // JPL HORIZONS results for position of Moon with respect to Earth at 1 Jan 2000 12:00
-        // position: -2.916083884571964E+05 -2.667168292374240E+05 -7.610248132320160E+04
-        // velocity:  6.435313736079528E-01 -6.660876955662288E-01 -3.013257066079174E-01
-        //std::cout << "Moon @ J2000:  " << eph->trajectory(JPLEphemeris::Moon)->position(0.0).transpose().format(16) << std::endl;
-
-        // JPL HORIZONS results for position of Earth with respect to Sun at 1 Jan 2000 12:00
-        // position: -2.649903422886233E+07  1.327574176646856E+08  5.755671744790662E+07
-        // velocity: -2.979426004836674E+01 -5.018052460415045E+00 -2.175393728607054E+00
-        //std::cout << "Earth @ J2000: " << earthTrajectory->position(0.0).transpose().format(16) << std::endl;
-    }
+    AddBuiltinModels(m_loader);
 
-    // Martian satellites
-    m_loader->addBuiltinOrbit("Phobos", MarsSatOrbit::Create(MarsSatOrbit::Phobos));
-    m_loader->addBuiltinOrbit("Deimos", MarsSatOrbit::Create(MarsSatOrbit::Deimos));
-
-    // Galilean satellites
-    m_loader->addBuiltinOrbit("Io", L1Orbit::Create(L1Orbit::Io));
-    m_loader->addBuiltinOrbit("Europa", L1Orbit::Create(L1Orbit::Europa));
-    m_loader->addBuiltinOrbit("Ganymede", L1Orbit::Create(L1Orbit::Ganymede));
-    m_loader->addBuiltinOrbit("Callisto", L1Orbit::Create(L1Orbit::Callisto));
-
-    // Saturnian satellites
-    m_loader->addBuiltinOrbit("Mimas",     TASS17Orbit::Create(TASS17Orbit::Mimas));
-    m_loader->addBuiltinOrbit("Enceladus", TASS17Orbit::Create(TASS17Orbit::Enceladus));
-    m_loader->addBuiltinOrbit("Tethys",    TASS17Orbit::Create(TASS17Orbit::Tethys));
-    m_loader->addBuiltinOrbit("Dione",     TASS17Orbit::Create(TASS17Orbit::Dione));
-    m_loader->addBuiltinOrbit("Rhea",      TASS17Orbit::Create(TASS17Orbit::Rhea));
-    m_loader->addBuiltinOrbit("Titan",     TASS17Orbit::Create(TASS17Orbit::Titan));
-    m_loader->addBuiltinOrbit("Hyperion",  TASS17Orbit::Create(TASS17Orbit::Hyperion));
-    m_loader->addBuiltinOrbit("Iapetus",   TASS17Orbit::Create(TASS17Orbit::Iapetus));
-
-    // Uranian satellites
-    m_loader->addBuiltinOrbit("Miranda",   Gust86Orbit::Create(Gust86Orbit::Miranda));
-    m_loader->addBuiltinOrbit("Ariel",     Gust86Orbit::Create(Gust86Orbit::Ariel));
-    m_loader->addBuiltinOrbit("Umbriel",   Gust86Orbit::Create(Gust86Orbit::Umbriel));
-    m_loader->addBuiltinOrbit("Titania",   Gust86Orbit::Create(Gust86Orbit::Titania));
-    m_loader->addBuiltinOrbit("Oberon",    Gust86Orbit::Create(Gust86Orbit::Oberon));
-
-    // Set up builtin rotation models
-    m_loader->addBuiltinRotationModel("IAU Moon", new IAULunarRotationModel());
-
-    // Set up the network manager. Eventually, the texture tile loader and resource loader should share
-    // the same QNetworkAccessManager. However, there is a noticeable lag when loading a TLE orbit
-    // over the network, and it disappears when the cache is disabled. Although reading over the network
-    // is asynchronous, loading the cache the directory for the first time blocks for about a second.
-    // Using a second network manager with its own cache directory with many fewer entries solves the
-    // problem. The lag could return if the resource loader has thousands of files in its cache, but
-    // since it currently is used just for TLEs, it's not a problem now.
+    // Set up the network manager. This is only used for the announcement, which is always read from
+    // the network.
     m_networkManager = new QNetworkAccessManager();
-    QNetworkDiskCache* cache = new QNetworkDiskCache();    
-    //cache->setCacheDirectory(QDesktopServices::storageLocation(QDesktopServices::CacheLocation) + "/catalog");
-    cache->setCacheDirectory(cacheDirectoryPath("catalog"));
-    m_networkManager->setCache(cache);
     connect(m_networkManager, SIGNAL(finished(QNetworkReply*)), this, SLOT(processReceivedResource(QNetworkReply*)));
 
+    // TLE sets are requested, parsed, and validated in a separate thread. Only the element sets that
+    // have changed are delivered to the loader. The TLE requester has its own cache directory; loading
+    // a cache directory with many entries for the first time blocks for about a second.
+    m_tleRequester = new TleSetRequester(cacheDirectoryPath("catalog"));
+    connect(m_tleRequester, SIGNAL(tleRecordsChanged(const QList<TleRecord>&)),
+            m_loader, SLOT(applyTleUpdates(const QList<TleRecord>&)));
+    m_tleRequestThread = new QThread();
+    m_tleRequester->moveToThread(m_tleRequestThread);
+    m_tleRequestThread->start();
+
     // Set up the texture loader
     m_loader->setTextureLoader(dynamic_cast<PathRelativeTextureLoader*>(m_view3d->textureLoader()));
 
@@ -1100,6 +1018,20 @@ Cosmographia::loadSettings()
 
     setVideoSize(settings.value("videoSize", "wvga").toString());
 
+    // Approximate expensive trajectories with cached Chebyshev polynomials. This
+    // must be set before any catalogs are loaded.
+    m_loader->setTrajectoryCache(settings.value("trajectoryCache", false).toBool(),
+                                 settings.value("trajectoryCacheTolerance", CachingChebyshevTrajectory::DefaultTolerance).toDouble());
+
+    // Share decoded ephemerides and sampled trajectories with other instances
+    // running on the same machine. This must be set before the ephemerides are
+    // loaded.
+    if (settings.value("sharedEphemerisCache", false).toBool())
+    {
+        QString defaultCacheDirectory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/ephemeris";
+        SharedEphemerisCache::SetDirectory(settings.value("sharedEphemerisCacheDirectory", defaultCacheDirectory).toString());
+    }
+
     settings.beginGroup("ui");
     setMeasurementSystem(settings.value("measurementSystem", "metric").toString());
     setAutoHideToolBar(settings.value("autoHideToolBar", false).toBool());
@@ -1578,11 +1510,8 @@ Cosmographia::loadCatalogFile(const QString& fileName)
         qDebug() << "Resource requests:";
         foreach (QString resource, resourceRequests)
         {
-            QNetworkRequest request(resource);
-            request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferNetwork);
-            QNetworkReply* reply = m_networkManager->get(request);
-
-            qDebug() << resource << " -> " << reply->url().toString();
+            QMetaObject::invokeMethod(m_tleRequester, "requestTleSet", Qt::QueuedConnection, Q_ARG(QString, resource));
+            qDebug() << resource;
         }
     }
 
@@ -1676,7 +1605,8 @@ Cosmographia::processReceivedResource(QNetworkReply* reply)
     if (reply->open(QIODevice::ReadOnly))
     {
         // If the originating object is the main window, it indicates that the
-        // requested resource was the announcement.
+        // requested resource was the announcement. TLE sets are handled by the
+        // TLE requester.
         if (reply->request().originatingObject() == this && reply->error() == QNetworkReply::NoError)
         {
             QString text = reply->readAll();
@@ -1692,12 +1622,6 @@ Cosmographia::processReceivedResource(QNetworkReply* reply)
 #endif
             }
         }
-        else
-        {
-            QTextStream stream(reply);
-            m_loader->processTleSet(reply->url().toString(), stream);
-            m_loader->processUpdates();
-        }
     }
 }
 
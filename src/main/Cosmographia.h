@@ -29,6 +29,8 @@
 class UniverseView;
 class UniverseCatalog;
 class UniverseLoader;
+class TleSetRequester;
+class QThread;
 class HelpCatalog;
 
 class UniverseCatalogObject;
@@ -140,6 +142,8 @@ private:
     QAction* m_fullScreenAction;
 
     QNetworkAccessManager* m_networkManager;
+    TleSetRequester* m_tleRequester;
+    QThread* m_tleRequestThread;
 
     QList<AddOn*> m_loadedAddOns;
     QAction* m_unloadLastCatalogAction;
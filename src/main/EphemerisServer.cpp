@@ -0,0 +1,412 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "EphemerisServer.h"
+#include "BatchStateEvaluator.h"
+#include "catalog/UniverseLoader.h"
+#include "catalog/UniverseCatalog.h"
+#include <vesta/Entity.h>
+#include <vesta/Chronology.h>
+#include <vesta/Frame.h>
+#include <vesta/InertialFrame.h>
+#include <qjson/parser.h>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QDebug>
+#include <algorithm>
+#include <vector>
+#include <limits>
+#include <cstring>
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+static const char RequestMagic[] = "COSMOREQ";
+static const char ResponseMagic[] = "COSMORSP";
+static const unsigned int MagicLength = 8;
+
+// Response flags
+static const quint32 OrientationIncluded = 0x1;
+
+// Converts the states computed by the batch evaluator for one range of
+// epochs into response records
+struct EphemerisServer::RecordEvaluator
+{
+    const std::vector<const Entity*>* bodies;
+    const Entity* center;
+    const Frame* frame;
+    const double* epochs;
+    unsigned int epochCount;
+    const double* states;
+    unsigned int recordSize;
+    double* records;
+
+    void operator()(const EpochRange& range) const
+    {
+        evaluateRecords(*this, range);
+    }
+};
+
+
+static void
+appendUInt32(QByteArray* data, quint32 value)
+{
+    data->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+
+static quint32
+readUInt32(const char* data)
+{
+    quint32 value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+
+// Create the header of a response, including the message and its padding
+static QByteArray
+responseHeader(quint32 status, quint32 bodyCount, quint32 epochCount, quint32 flags, quint32 recordSize,
+               const QString& message)
+{
+    QByteArray messageData = message.toUtf8();
+
+    QByteArray header(ResponseMagic, MagicLength);
+    appendUInt32(&header, status);
+    appendUInt32(&header, bodyCount);
+    appendUInt32(&header, epochCount);
+    appendUInt32(&header, flags);
+    appendUInt32(&header, messageData.size());
+    appendUInt32(&header, recordSize);
+
+    header.append(messageData);
+    int padding = (8 - messageData.size() % 8) % 8;
+    header.append(QByteArray(padding, '\0'));
+
+    return header;
+}
+
+
+/** Create a new ephemeris server for the bodies in a catalog. The loader
+  * is used to load the frames given in requests. The server doesn't accept
+  * connections until listen() is called.
+  */
+EphemerisServer::EphemerisServer(UniverseLoader* loader, UniverseCatalog* catalog, QObject* parent) :
+    QObject(parent),
+    m_loader(loader),
+    m_catalog(catalog),
+    m_server(NULL),
+    m_threadCount(0)
+{
+    m_server = new QLocalServer(this);
+    connect(m_server, SIGNAL(newConnection()), this, SLOT(acceptConnection()));
+}
+
+
+EphemerisServer::~EphemerisServer()
+{
+}
+
+
+/** Start accepting connections on the local socket with the specified
+  * name. A stale socket left by a server that wasn't shut down cleanly is
+  * removed first.
+  *
+  * \return true if the server is listening, false if there was an error
+  */
+bool
+EphemerisServer::listen(const QString& socketName)
+{
+    QLocalServer::removeServer(socketName);
+    return m_server->listen(socketName);
+}
+
+
+/** Get a description of the last error that occurred when listening.
+  */
+QString
+EphemerisServer::errorString() const
+{
+    return m_server->errorString();
+}
+
+
+/** Set the number of threads used to evaluate requests. Zero means one
+  * thread per processor; with one thread, requests are evaluated entirely on
+  * the server's thread.
+  */
+void
+EphemerisServer::setThreadCount(unsigned int count)
+{
+    m_threadCount = count;
+}
+
+
+/** Answer a single query, returning the complete response (including the
+  * header.) The query is the JSON object described in the class
+  * documentation.
+  */
+QByteArray
+EphemerisServer::processRequest(const QByteArray& query, const double* epochs, unsigned int epochCount)
+{
+    QJson::Parser parser;
+    bool parseOk = false;
+    QVariant queryVar = parser.parse(query, &parseOk);
+    if (!parseOk)
+    {
+        return errorResponse(BadRequest, QString("Error in query, line %1: %2").arg(parser.errorLine()).arg(parser.errorString()));
+    }
+
+    if (queryVar.type() != QVariant::Map)
+    {
+        return errorResponse(BadRequest, "Query must be a JSON object");
+    }
+
+    QVariantMap queryMap = queryVar.toMap();
+    QVariant bodiesVar = queryMap.value("bodies");
+    if (bodiesVar.type() != QVariant::List)
+    {
+        return errorResponse(BadRequest, "Query is missing list of bodies");
+    }
+
+    std::vector<const Entity*> bodies;
+    foreach (QVariant bodyVar, bodiesVar.toList())
+    {
+        const Entity* body = m_catalog->find(bodyVar.toString());
+        if (!body)
+        {
+            return errorResponse(UnknownBody, QString("Unknown body '%1'").arg(bodyVar.toString()));
+        }
+        bodies.push_back(body);
+    }
+
+    if (quint64(bodies.size()) * epochCount > MaxRecordCount)
+    {
+        return errorResponse(BadRequest, QString("Too many records requested (limit is %1)").arg(MaxRecordCount));
+    }
+
+    const Entity* center = NULL;
+    if (queryMap.contains("center"))
+    {
+        QString centerName = queryMap.value("center").toString();
+        center = m_catalog->find(centerName);
+        if (!center)
+        {
+            return errorResponse(UnknownBody, QString("Unknown center body '%1'").arg(centerName));
+        }
+    }
+
+    counted_ptr<Frame> frame(InertialFrame::equatorJ2000());
+    if (queryMap.contains("frame"))
+    {
+        m_loader->clearMessageLog();
+        frame = m_loader->loadFrameDefinition(queryMap.value("frame"), m_catalog);
+        if (frame.isNull())
+        {
+            QString message = m_loader->messageLog().trimmed();
+            return errorResponse(BadFrame, message.isEmpty() ? QString("Invalid frame") : message);
+        }
+    }
+
+    bool includeOrientation = queryMap.value("orientation", false).toBool();
+    unsigned int recordSize = includeOrientation ? 10 : 6;
+
+    // Compute the states of the bodies and the center, which comes last
+    std::vector<const Entity*> evaluatedBodies = bodies;
+    if (center)
+    {
+        evaluatedBodies.push_back(center);
+    }
+
+    BatchStateEvaluator evaluator;
+    evaluator.setBodies(evaluatedBodies);
+    evaluator.setThreadCount(m_threadCount);
+
+    std::vector<double> states(evaluatedBodies.size() * epochCount * BatchStateEvaluator::StateSize);
+    std::vector<double> records(bodies.size() * epochCount * recordSize);
+    if (!records.empty())
+    {
+        evaluator.evaluate(epochs, epochCount, &states[0]);
+
+        RecordEvaluator recordEvaluator;
+        recordEvaluator.bodies = &evaluatedBodies;
+        recordEvaluator.center = center;
+        recordEvaluator.frame = frame.ptr();
+        recordEvaluator.epochs = epochs;
+        recordEvaluator.epochCount = epochCount;
+        recordEvaluator.states = &states[0];
+        recordEvaluator.recordSize = recordSize;
+        recordEvaluator.records = &records[0];
+        ForEachEpochRange(epochCount, m_threadCount, recordEvaluator);
+    }
+
+    QByteArray response = responseHeader(Ok, bodies.size(), epochCount,
+                                         includeOrientation ? OrientationIncluded : 0, recordSize,
+                                         QString());
+    if (!records.empty())
+    {
+        response.append(reinterpret_cast<const char*>(&records[0]), int(records.size() * sizeof(double)));
+    }
+
+    return response;
+}
+
+
+// Compute the records for a range of epochs from the states of the bodies
+// and the center, which are relative to the origin in the fundamental frame.
+void
+EphemerisServer::evaluateRecords(const RecordEvaluator& evaluator, const EpochRange& range)
+{
+    const std::vector<const Entity*>& evaluatedBodies = *evaluator.bodies;
+    unsigned int bodyCount = evaluator.center ? evaluatedBodies.size() - 1 : evaluatedBodies.size();
+    const unsigned int stateSize = BatchStateEvaluator::StateSize;
+    const double nan = numeric_limits<double>::quiet_NaN();
+
+    for (unsigned int i = range.first; i < range.end; ++i)
+    {
+        double t = evaluator.epochs[i];
+        const double* epochStates = evaluator.states + size_t(i) * evaluatedBodies.size() * stateSize;
+
+        bool centerValid = true;
+        Vector3d centerPosition = Vector3d::Zero();
+        Vector3d centerVelocity = Vector3d::Zero();
+        if (evaluator.center)
+        {
+            const double* centerState = epochStates + bodyCount * stateSize;
+            centerValid = evaluator.center->chronology()->includesTime(t);
+            centerPosition = Vector3d(centerState[0], centerState[1], centerState[2]);
+            centerVelocity = Vector3d(centerState[3], centerState[4], centerState[5]);
+        }
+
+        // Transform from ICRF to the target frame
+        Quaterniond toFrame = evaluator.frame->orientation(t).conjugate();
+        Vector3d omega = evaluator.frame->angularVelocity(t);
+
+        for (unsigned int bodyIndex = 0; bodyIndex < bodyCount; ++bodyIndex)
+        {
+            const Entity* body = evaluatedBodies[bodyIndex];
+            double* record = evaluator.records + (size_t(bodyIndex) * evaluator.epochCount + i) * evaluator.recordSize;
+
+            if (!centerValid || !body->chronology()->includesTime(t))
+            {
+                std::fill(record, record + evaluator.recordSize, nan);
+                continue;
+            }
+
+            const double* state = epochStates + bodyIndex * stateSize;
+            Vector3d position = Vector3d(state[0], state[1], state[2]) - centerPosition;
+            Vector3d velocity = Vector3d(state[3], state[4], state[5]) - centerVelocity;
+
+            Vector3d framePosition = toFrame * position;
+            Vector3d frameVelocity = toFrame * (velocity - omega.cross(position));
+            record[0] = framePosition.x();
+            record[1] = framePosition.y();
+            record[2] = framePosition.z();
+            record[3] = frameVelocity.x();
+            record[4] = frameVelocity.y();
+            record[5] = frameVelocity.z();
+
+            if (evaluator.recordSize > 6)
+            {
+                Quaterniond q = toFrame * body->orientation(t);
+                record[6] = q.w();
+                record[7] = q.x();
+                record[8] = q.y();
+                record[9] = q.z();
+            }
+        }
+    }
+}
+
+
+QByteArray
+EphemerisServer::errorResponse(Status status, const QString& message)
+{
+    qDebug() << "Ephemeris request failed: " << message;
+    return responseHeader(status, 0, 0, 0, 0, message);
+}
+
+
+/** Apply changed TLE records. Requests are evaluated synchronously on the
+  * server's thread, so updates delivered to this slot never touch a
+  * trajectory while it is being evaluated.
+  */
+void
+EphemerisServer::applyTleUpdates(const QList<TleRecord>& records)
+{
+    m_loader->applyTleUpdates(records);
+}
+
+
+void
+EphemerisServer::acceptConnection()
+{
+    while (m_server->hasPendingConnections())
+    {
+        QLocalSocket* socket = m_server->nextPendingConnection();
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readRequests()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+
+// Answer all complete requests waiting on a socket. Partial requests are
+// left in the socket's buffer until the rest arrives.
+void
+EphemerisServer::readRequests()
+{
+    QLocalSocket* socket = qobject_cast<QLocalSocket*>(sender());
+    if (!socket)
+    {
+        return;
+    }
+
+    while (socket->bytesAvailable() >= RequestHeaderSize)
+    {
+        QByteArray header = socket->peek(RequestHeaderSize);
+        quint32 queryLength = readUInt32(header.constData() + 8);
+        quint32 epochCount = readUInt32(header.constData() + 12);
+
+        if (header.left(MagicLength) != QByteArray(RequestMagic, MagicLength) ||
+            queryLength > MaxQueryLength || epochCount > MaxRecordCount)
+        {
+            // There's no way to find the start of the next request, so the
+            // connection is dropped.
+            socket->write(errorResponse(BadRequest, "Malformed request header"));
+            socket->disconnectFromServer();
+            return;
+        }
+
+        qint64 requestSize = qint64(RequestHeaderSize) + queryLength + qint64(epochCount) * sizeof(double);
+        if (socket->bytesAvailable() < requestSize)
+        {
+            break;
+        }
+
+        QByteArray request = socket->read(requestSize);
+        std::vector<double> epochs(epochCount);
+        if (epochCount > 0)
+        {
+            memcpy(&epochs[0], request.constData() + RequestHeaderSize + queryLength, epochCount * sizeof(double));
+        }
+
+        QByteArray response = processRequest(request.mid(RequestHeaderSize, queryLength),
+                                             epochs.empty() ? NULL : &epochs[0], epochCount);
+        socket->write(response);
+    }
+}
@@ -0,0 +1,147 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _EPHEMERIS_SERVER_H_
+#define _EPHEMERIS_SERVER_H_
+
+#include "TleSetRequester.h"
+#include "EpochRanges.h"
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QList>
+
+class QLocalServer;
+class UniverseLoader;
+class UniverseCatalog;
+
+
+/** EphemerisServer answers batched queries for the states and orientations
+  * of catalog bodies over a local socket (a Unix domain socket, or a named
+  * pipe on Windows.) It evaluates the same trajectories, rotation models,
+  * and frames that Cosmographia renders, so scripts can use them without
+  * reimplementing the catalog logic. A client may send any number of
+  * requests over one connection; each is answered in turn.
+  *
+  * A request is a 16 byte header, a JSON query, and a list of epochs:
+  *
+  *   offset  size  contents
+  *        0     8  "COSMOREQ"
+  *        8     4  length of the query in bytes (J)
+  *       12     4  number of epochs (N)
+  *       16     J  query, UTF-8 encoded JSON
+  *     16+J   8*N  epochs as doubles, in seconds since J2000 TDB
+  *
+  * The query is an object with these properties:
+  *
+  *   bodies       list of body names (required)
+  *   center       name of the body that states are relative to; by default,
+  *                states are relative to the origin of the universe (the
+  *                Solar System barycenter)
+  *   frame        the frame of the states, either the name of an inertial
+  *                frame or a frame definition in the same form as catalog
+  *                files; the default is EquatorJ2000
+  *   orientation  true to also return the orientation of each body
+  *
+  * The response is a 32 byte header, a message, and the records:
+  *
+  *   offset  size  contents
+  *        0     8  "COSMORSP"
+  *        8     4  status: 0 for success, otherwise an error code
+  *       12     4  number of bodies (B)
+  *       16     4  number of epochs (N)
+  *       20     4  flags: bit 0 is set when orientations are included
+  *       24     4  length of the message in bytes (M)
+  *       28     4  number of doubles in each record (R)
+  *       32     M  message, UTF-8; padded with zeros to a multiple of 8
+  *                 bytes. Empty when the request succeeded.
+  *      ...  8*R*B*N  records, body-major: all epochs of the first body,
+  *                 then all epochs of the second, and so on.
+  *
+  * Each record holds the position (km) and velocity (km/s) of the body with
+  * respect to the center in the target frame. When orientations are
+  * requested, these are followed by the quaternion (w, x, y, z) that rotates
+  * vectors from the body frame to the target frame. The record of a body
+  * (or center) that doesn't exist at an epoch is all NaNs. Integers and
+  * doubles are in the byte order of the host, since clients always run on
+  * the same machine as the server.
+  *
+  * States are computed by a BatchStateEvaluator, so the state of a center
+  * shared by several bodies is computed once per epoch, and then converted
+  * to the requested center and frame. Both steps divide the epochs into
+  * ranges that are evaluated in parallel by threads from the global thread
+  * pool. Requests are evaluated on the thread that owns the server, and TLE
+  * updates are only applied between requests.
+  */
+class EphemerisServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    EphemerisServer(UniverseLoader* loader, UniverseCatalog* catalog, QObject* parent = NULL);
+    ~EphemerisServer();
+
+    enum Status
+    {
+        Ok             = 0,
+        BadRequest     = 1,
+        UnknownBody    = 2,
+        BadFrame       = 3,
+    };
+
+    bool listen(const QString& socketName);
+    QString errorString() const;
+
+    /** Get the number of threads used to evaluate requests. Zero means one
+      * thread per processor.
+      */
+    unsigned int threadCount() const
+    {
+        return m_threadCount;
+    }
+
+    void setThreadCount(unsigned int count);
+
+    QByteArray processRequest(const QByteArray& query, const double* epochs, unsigned int epochCount);
+
+    // Sizes of the request and response headers in bytes
+    static const unsigned int RequestHeaderSize = 16;
+    static const unsigned int ResponseHeaderSize = 32;
+
+    // Limits on requests; larger requests are rejected
+    static const unsigned int MaxQueryLength = 1 << 20;
+    static const unsigned int MaxRecordCount = 1 << 24;
+
+public slots:
+    void applyTleUpdates(const QList<TleRecord>& records);
+
+private slots:
+    void acceptConnection();
+    void readRequests();
+
+private:
+    struct RecordEvaluator;
+    static void evaluateRecords(const RecordEvaluator& evaluator, const EpochRange& range);
+    static QByteArray errorResponse(Status status, const QString& message);
+
+private:
+    UniverseLoader* m_loader;
+    UniverseCatalog* m_catalog;
+    QLocalServer* m_server;
+    unsigned int m_threadCount;
+};
+
+#endif // _EPHEMERIS_SERVER_H_
@@ -0,0 +1,63 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "EpochRanges.h"
+#include <QThread>
+#include <algorithm>
+
+using namespace std;
+
+
+// Each thread gets a few ranges of the epochs, since the cost of evaluating
+// a trajectory varies over its span
+static const unsigned int RangesPerThread = 4;
+
+// Smallest number of epochs that's worth handing to another thread
+static const unsigned int MinRangeEpochs = 64;
+
+
+/** Divide a list of epochs into ranges for evaluation by the specified
+  * number of threads; zero means one thread per processor. The ranges are
+  * in order and together cover all epochs. A single thread (or a short
+  * list) gives just one range, and an empty list gives none.
+  */
+std::vector<EpochRange>
+SplitEpochs(unsigned int epochCount, unsigned int threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = unsigned(max(1, QThread::idealThreadCount()));
+    }
+
+    unsigned int rangeCount = 1;
+    if (threadCount > 1)
+    {
+        rangeCount = max(1u, min(threadCount * RangesPerThread, epochCount / MinRangeEpochs));
+    }
+
+    std::vector<EpochRange> ranges;
+    if (epochCount > 0)
+    {
+        ranges.resize(rangeCount);
+        for (unsigned int i = 0; i < rangeCount; ++i)
+        {
+            ranges[i].first = unsigned((unsigned long long) epochCount * i / rangeCount);
+            ranges[i].end = unsigned((unsigned long long) epochCount * (i + 1) / rangeCount);
+        }
+    }
+
+    return ranges;
+}
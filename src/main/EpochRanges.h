@@ -0,0 +1,57 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _EPOCH_RANGES_H_
+#define _EPOCH_RANGES_H_
+
+#include <QtConcurrentMap>
+#include <vector>
+
+
+/** A range of consecutive epochs [first, end) in a list of epochs that's
+  * evaluated as one task.
+  */
+struct EpochRange
+{
+    unsigned int first;
+    unsigned int end;
+};
+
+std::vector<EpochRange> SplitEpochs(unsigned int epochCount, unsigned int threadCount);
+
+
+/** Call a function for every range of a list of epochs split by
+  * SplitEpochs(). With more than one range, the ranges are evaluated in
+  * parallel by threads from the global thread pool and this function returns
+  * once all of them are finished; with a single range, the function is just
+  * called on this thread. The function must be safe to call from multiple
+  * threads at once, and is invoked as f(const EpochRange&).
+  */
+template<typename RangeFunction>
+void ForEachEpochRange(unsigned int epochCount, unsigned int threadCount, const RangeFunction& f)
+{
+    std::vector<EpochRange> ranges = SplitEpochs(epochCount, threadCount);
+    if (ranges.size() == 1)
+    {
+        f(ranges[0]);
+    }
+    else if (!ranges.empty())
+    {
+        QtConcurrent::blockingMap(ranges, f);
+    }
+}
+
+#endif // _EPOCH_RANGES_H_
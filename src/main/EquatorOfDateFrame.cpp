@@ -0,0 +1,78 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "EquatorOfDateFrame.h"
+#include "astro/PrecessionNutation.h"
+
+using namespace vesta;
+using namespace Eigen;
+
+
+EquatorOfDateFrame::EquatorOfDateFrame(EquatorType equatorType) :
+    m_equatorType(equatorType)
+{
+}
+
+
+EquatorOfDateFrame::~EquatorOfDateFrame()
+{
+}
+
+
+Quaterniond
+EquatorOfDateFrame::orientation(double tdbSec) const
+{
+    PrecessionNutationAngles angles = PrecessionNutation::shared()->angles(tdbSec);
+    if (m_equatorType == TrueEquator)
+    {
+        return PrecessionNutation::trueEquatorOrientation(angles);
+    }
+    else
+    {
+        return PrecessionNutation::meanEquatorOrientation(angles);
+    }
+}
+
+
+Vector3d
+EquatorOfDateFrame::angularVelocity(double tdbSec) const
+{
+    // Differentiate numerically; the frame rotates by well under an
+    // arcsecond per hour.
+    const double h = 3600.0;
+
+    double t[3] = { tdbSec - h, tdbSec, tdbSec + h };
+    PrecessionNutationAngles angles[3];
+    PrecessionNutation::shared()->angles(3, t, angles);
+
+    Quaterniond q[3];
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        if (m_equatorType == TrueEquator)
+        {
+            q[i] = PrecessionNutation::trueEquatorOrientation(angles[i]);
+        }
+        else
+        {
+            q[i] = PrecessionNutation::meanEquatorOrientation(angles[i]);
+        }
+    }
+
+    Quaterniond dq;
+    dq.coeffs() = (q[2].coeffs() - q[0].coeffs()) / (2.0 * h);
+
+    return 2.0 * (dq * q[1].conjugate()).vec();
+}
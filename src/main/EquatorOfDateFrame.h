@@ -0,0 +1,52 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _EQUATOR_OF_DATE_FRAME_H_
+#define _EQUATOR_OF_DATE_FRAME_H_
+
+#include <vesta/Frame.h>
+
+
+/** EquatorOfDateFrame is the frame of the Earth's equator and equinox at
+  * the current date. The mean equator frame includes only precession; the
+  * true equator frame also includes nutation. Angles come from the shared
+  * PrecessionNutation table.
+  */
+class EquatorOfDateFrame : public vesta::Frame
+{
+public:
+    enum EquatorType
+    {
+        MeanEquator,
+        TrueEquator,
+    };
+
+    explicit EquatorOfDateFrame(EquatorType equatorType);
+    ~EquatorOfDateFrame();
+
+    virtual Eigen::Quaterniond orientation(double tdbSec) const;
+    virtual Eigen::Vector3d angularVelocity(double tdbSec) const;
+
+    EquatorType equatorType() const
+    {
+        return m_equatorType;
+    }
+
+private:
+    EquatorType m_equatorType;
+};
+
+#endif // _EQUATOR_OF_DATE_FRAME_H_
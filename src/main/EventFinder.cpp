@@ -0,0 +1,1223 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "EventFinder.h"
+#include "ChebyshevPolyTrajectory.h"
+#include <vesta/Arc.h>
+#include <vesta/Chronology.h>
+#include <vesta/Frame.h>
+#include <vesta/InertialFrame.h>
+#include <vesta/Trajectory.h>
+#include <vesta/Units.h>
+#include <QThread>
+#include <QtConcurrentRun>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+const double EventFinder::DefaultStepFactor = 0.1;
+const double EventFinder::DefaultMinStep = 1.0;
+const double EventFinder::DefaultMaxStep = 86400.0 * 10.0;
+const double EventFinder::DefaultTimeTolerance = 1.0e-3;
+
+// Maximum depth of the tree of centers searched for a common ancestor
+static const unsigned int MaxCenterChainLength = 16;
+
+// Position bounds spanning more Chebyshev granules than this are not
+// computed
+static const int MaxBoundGranuleCount = 64;
+
+// Pruning isn't attempted for spans shorter than this (in seconds) or than
+// this many sampling steps
+static const double MinPruneInterval = 3600.0;
+static const double MinPruneSteps = 4.0;
+
+// Each thread gets several chunks of the search span, since pruning makes
+// the work in chunks uneven
+static const unsigned int ChunksPerThread = 8;
+
+// Shortest chunk (in seconds) that's worth handing to another thread
+static const double MinChunkLength = 86400.0;
+
+// Fraction of the time for the event function to reach zero at its
+// largest possible rate that's used as the step for occultation searches
+static const double ApproachStepFactor = 0.5;
+
+static const unsigned int MaxRefinementIterations = 100;
+
+
+// A sample of an event function. The time scale is a rough measure of how
+// long it takes for the geometry to change significantly. When the rate bound
+// is positive, it's an upper bound on the rate of change of the value over
+// the next step.
+struct EventSample
+{
+    double t;
+    double value;
+    double rate;
+    double timeScale;
+    double rateBound;
+};
+
+
+class EventFinder::EventFunction
+{
+public:
+    EventFunction() :
+        threshold(0.0)
+    {
+    }
+
+    virtual ~EventFunction() {}
+
+    virtual EventSample sample(double t) const = 0;
+
+    /** Compute a lower bound for the value of the function over a span of
+      * time. Returns false if no bound could be found.
+      */
+    virtual bool lowerBound(double /* startTime */, double /* endTime */, double* /* bound */) const
+    {
+        return false;
+    }
+
+    /** Get the value reported in the event found at time t.
+      */
+    virtual double eventValue(double t) const = 0;
+
+    /** Return true if the event with a peak at time t should be reported.
+      */
+    virtual bool accept(double /* t */) const
+    {
+        return true;
+    }
+
+    // Events may occur only where the value is less than the threshold
+    double threshold;
+};
+
+
+// The distance between two bodies, negated when searching for maxima.
+class EventFinder::DistanceFunction : public EventFinder::EventFunction
+{
+public:
+    DistanceFunction(const Entity* target, const Entity* observer, bool maximum) :
+        m_target(target),
+        m_observer(observer),
+        m_sign(maximum ? -1.0 : 1.0)
+    {
+        threshold = numeric_limits<double>::infinity();
+    }
+
+    EventSample sample(double t) const
+    {
+        StateVector s = relativeState(m_target, m_observer, t);
+        double distance = s.position().norm();
+        double speed = s.velocity().norm();
+
+        EventSample result;
+        result.t = t;
+        result.value = m_sign * distance;
+        result.rate = distance > 0.0 ? m_sign * s.position().dot(s.velocity()) / distance : 0.0;
+        result.timeScale = speed > 0.0 ? distance / speed : numeric_limits<double>::infinity();
+        result.rateBound = 0.0;
+
+        return result;
+    }
+
+    bool lowerBound(double startTime, double endTime, double* bound) const
+    {
+        Vector3d center = Vector3d::Zero();
+        double radius = 0.0;
+        if (m_sign < 0.0 || !relativePositionBound(m_target, m_observer, startTime, endTime, &center, &radius))
+        {
+            return false;
+        }
+
+        *bound = center.norm() - radius;
+        return true;
+    }
+
+    double eventValue(double t) const
+    {
+        return relativeState(m_target, m_observer, t).position().norm();
+    }
+
+private:
+    const Entity* m_target;
+    const Entity* m_observer;
+    double m_sign;
+};
+
+
+// The angular separation of the target and occulter as seen by the observer,
+// less the sum of their apparent radii (the outer contacts) or less the
+// difference of the apparent radii (the inner contacts.)
+class EventFinder::SeparationFunction : public EventFinder::EventFunction
+{
+public:
+    SeparationFunction(const Entity* target, double targetRadius,
+                       const Entity* occulter, double occulterRadius,
+                       const Entity* observer,
+                       bool inner) :
+        m_target(target),
+        m_targetRadius(targetRadius),
+        m_occulter(occulter),
+        m_occulterRadius(occulterRadius),
+        m_observer(observer),
+        m_inner(inner)
+    {
+    }
+
+    EventSample sample(double t) const
+    {
+        StateVector target = relativeState(m_target, m_observer, t);
+        StateVector occulter = relativeState(m_occulter, m_observer, t);
+
+        double targetDistance = target.position().norm();
+        double occulterDistance = occulter.position().norm();
+        Vector3d targetDir = target.position() / targetDistance;
+        Vector3d occulterDir = occulter.position() / occulterDistance;
+
+        // Rates of change of the directions to the target and occulter
+        Vector3d targetDirRate = (target.velocity() - targetDir * targetDir.dot(target.velocity())) / targetDistance;
+        Vector3d occulterDirRate = (occulter.velocity() - occulterDir * occulterDir.dot(occulter.velocity())) / occulterDistance;
+
+        double sinSeparation = targetDir.cross(occulterDir).norm();
+        double separation = atan2(sinSeparation, targetDir.dot(occulterDir));
+        double separationRate = 0.0;
+        if (sinSeparation > 0.0)
+        {
+            separationRate = -(targetDirRate.dot(occulterDir) + targetDir.dot(occulterDirRate)) / sinSeparation;
+        }
+
+        double targetAngle = apparentRadius(m_targetRadius, targetDistance);
+        double occulterAngle = apparentRadius(m_occulterRadius, occulterDistance);
+        double targetAngleRate = apparentRadiusRate(m_targetRadius, targetDistance, targetDir.dot(target.velocity()));
+        double occulterAngleRate = apparentRadiusRate(m_occulterRadius, occulterDistance, occulterDir.dot(occulter.velocity()));
+
+        EventSample result;
+        result.t = t;
+        if (m_inner)
+        {
+            double sign = occulterAngle > targetAngle ? 1.0 : -1.0;
+            result.value = separation - sign * (occulterAngle - targetAngle);
+            result.rate = separationRate - sign * (occulterAngleRate - targetAngleRate);
+        }
+        else
+        {
+            result.value = separation - (occulterAngle + targetAngle);
+            result.rate = separationRate - (occulterAngleRate + targetAngleRate);
+        }
+        result.timeScale = min(targetDistance / target.velocity().norm(), occulterDistance / occulter.velocity().norm());
+        result.rateBound = targetDirRate.norm() + occulterDirRate.norm() + abs(targetAngleRate) + abs(occulterAngleRate);
+
+        return result;
+    }
+
+    bool lowerBound(double startTime, double endTime, double* bound) const
+    {
+        Vector3d targetCenter = Vector3d::Zero();
+        Vector3d occulterCenter = Vector3d::Zero();
+        double targetRadius = 0.0;
+        double occulterRadius = 0.0;
+        if (!relativePositionBound(m_target, m_observer, startTime, endTime, &targetCenter, &targetRadius) ||
+            !relativePositionBound(m_occulter, m_observer, startTime, endTime, &occulterCenter, &occulterRadius))
+        {
+            return false;
+        }
+
+        double targetDistance = targetCenter.norm();
+        double occulterDistance = occulterCenter.norm();
+        if (targetDistance <= targetRadius + m_targetRadius || occulterDistance <= occulterRadius + m_occulterRadius)
+        {
+            return false;
+        }
+
+        // The directions to the target and occulter stay within cones about
+        // the directions to the centers of their bounding spheres. The
+        // difference of the apparent radii is never more than their sum, so
+        // the same bound works for the inner contacts.
+        double separation = atan2(targetCenter.cross(occulterCenter).norm(), targetCenter.dot(occulterCenter));
+        double minSeparation = separation - asin(targetRadius / targetDistance) - asin(occulterRadius / occulterDistance);
+        double maxTargetAngle = apparentRadius(m_targetRadius, targetDistance - targetRadius);
+        double maxOcculterAngle = apparentRadius(m_occulterRadius, occulterDistance - occulterRadius);
+
+        *bound = minSeparation - maxTargetAngle - maxOcculterAngle;
+        return true;
+    }
+
+    double eventValue(double t) const
+    {
+        Vector3d target = relativeState(m_target, m_observer, t).position();
+        Vector3d occulter = relativeState(m_occulter, m_observer, t).position();
+        return atan2(target.cross(occulter).norm(), target.dot(occulter));
+    }
+
+    // Only report occultations where the occulter is in front of the target
+    bool accept(double t) const
+    {
+        double targetDistance = relativeState(m_target, m_observer, t).position().norm();
+        double occulterDistance = relativeState(m_occulter, m_observer, t).position().norm();
+        return occulterDistance < targetDistance;
+    }
+
+    // Return true if the occulter appears larger than the target at time t
+    bool occulterAppearsLarger(double t) const
+    {
+        double targetDistance = relativeState(m_target, m_observer, t).position().norm();
+        double occulterDistance = relativeState(m_occulter, m_observer, t).position().norm();
+        return apparentRadius(m_occulterRadius, occulterDistance) > apparentRadius(m_targetRadius, targetDistance);
+    }
+
+private:
+    static double apparentRadius(double radius, double distance)
+    {
+        return radius < distance ? asin(radius / distance) : 0.5 * PI;
+    }
+
+    static double apparentRadiusRate(double radius, double distance, double distanceRate)
+    {
+        if (radius >= distance)
+        {
+            return 0.0;
+        }
+        else
+        {
+            return -radius * distanceRate / (distance * sqrt(distance * distance - radius * radius));
+        }
+    }
+
+private:
+    const Entity* m_target;
+    double m_targetRadius;
+    const Entity* m_occulter;
+    double m_occulterRadius;
+    const Entity* m_observer;
+    bool m_inner;
+};
+
+
+// A window of time in which an event function is below its threshold
+struct EventWindow
+{
+    double startTime;
+    double endTime;
+    double peakTime;
+    double peakValue;
+    bool openStart;
+    bool openEnd;
+};
+
+
+// A part of the search span and the events found in it
+struct EventFinder::SearchChunk
+{
+    const EventFunction* function;
+    double startTime;
+    double endTime;
+    bool windows;
+    std::vector<double> extrema;
+    std::vector<EventWindow> eventWindows;
+};
+
+
+// ChunkScanner samples an event function over one chunk of the search span,
+// skipping the parts that can be pruned.
+class EventFinder::ChunkScanner
+{
+public:
+    ChunkScanner(const EventFinder* finder, SearchChunk* chunk) :
+        m_finder(finder),
+        m_chunk(chunk),
+        m_function(chunk->function),
+        m_havePrevious(false),
+        m_resumeTime(chunk->startTime),
+        m_inWindow(false)
+    {
+        m_lastStep = stepSize(m_function->sample(chunk->startTime));
+    }
+
+    // Search the whole chunk. When bounds are available, the scanner tries
+    // to skip ahead over a span of time, doubling the span after every
+    // success. After a failure it tries shorter spans, and once spans get
+    // as short as a few steps it samples through one instead.
+    void scan()
+    {
+        double endTime = m_chunk->endTime;
+
+        // Nothing can be pruned when events are possible at any value
+        if (!m_finder->isPruningEnabled() || m_function->threshold == numeric_limits<double>::infinity())
+        {
+            advance(endTime);
+            return;
+        }
+
+        double t = m_chunk->startTime;
+        double span = 0.0;
+        while (t < endTime)
+        {
+            double minSpan = max(MinPruneInterval, MinPruneSteps * m_lastStep);
+            span = max(span, minSpan);
+
+            double bound = 0.0;
+            double t1 = min(endTime, t + span);
+            if (m_function->lowerBound(t, t1, &bound) && bound > m_function->threshold)
+            {
+                prune(t1);
+                t = t1;
+                span *= 2.0;
+            }
+            else if (span > minSpan)
+            {
+                span *= 0.5;
+            }
+            else
+            {
+                advance(t1);
+                t = m_previous.t;
+                span = 0.0;
+            }
+        }
+    }
+
+    void finish()
+    {
+        if (m_inWindow)
+        {
+            m_window.endTime = m_chunk->endTime;
+            m_window.openEnd = true;
+            m_chunk->eventWindows.push_back(m_window);
+            m_inWindow = false;
+        }
+    }
+
+    // Find the time between samples a and b at which either the value of f
+    // (less the threshold) or its rate crosses zero. The sign of the quantity
+    // must differ at a and b. The Illinois variant of regula falsi is used.
+    static double refineCrossing(const EventFunction* f, const EventSample& a, const EventSample& b,
+                                 bool rate, double tolerance)
+    {
+        double ta = a.t;
+        double tb = b.t;
+        double fa = rate ? a.rate : a.value - f->threshold;
+        double fb = rate ? b.rate : b.value - f->threshold;
+        int side = 0;
+
+        for (unsigned int i = 0; i < MaxRefinementIterations && tb - ta > tolerance; ++i)
+        {
+            double t = (fa * tb - fb * ta) / (fa - fb);
+            if (!(t > ta && t < tb))
+            {
+                t = 0.5 * (ta + tb);
+            }
+
+            EventSample s = f->sample(t);
+            double ft = rate ? s.rate : s.value - f->threshold;
+            if (ft == 0.0)
+            {
+                return t;
+            }
+            else if ((ft < 0.0) == (fa < 0.0))
+            {
+                ta = t;
+                fa = ft;
+                if (side == -1)
+                {
+                    fb *= 0.5;
+                }
+                side = -1;
+            }
+            else
+            {
+                tb = t;
+                fb = ft;
+                if (side == 1)
+                {
+                    fa *= 0.5;
+                }
+                side = 1;
+            }
+        }
+
+        return 0.5 * (ta + tb);
+    }
+
+    // Compute the step to take after a sample
+    double stepSize(const EventSample& s) const
+    {
+        double step = m_finder->stepFactor() * s.timeScale;
+        if (s.rateBound > 0.0)
+        {
+            step = min(step, ApproachStepFactor * abs(s.value - m_function->threshold) / s.rateBound);
+        }
+
+        return max(m_finder->minStep(), min(m_finder->maxStep(), step));
+    }
+
+    // No event can occur before t1; sampling resumes there.
+    void prune(double t1)
+    {
+        if (m_inWindow)
+        {
+            // Only possible when a window ends exactly at the start of the
+            // pruned span.
+            m_window.endTime = m_havePrevious ? m_previous.t : t1;
+            m_window.openEnd = false;
+            m_chunk->eventWindows.push_back(m_window);
+            m_inWindow = false;
+        }
+
+        m_havePrevious = false;
+        m_resumeTime = t1;
+    }
+
+    void advance(double t1)
+    {
+        if (!m_havePrevious)
+        {
+            start(m_function->sample(m_resumeTime));
+        }
+
+        while (m_previous.t < t1)
+        {
+            m_lastStep = stepSize(m_previous);
+
+            double t = min(m_chunk->endTime, m_previous.t + m_lastStep);
+            EventSample current = m_function->sample(t);
+            processStep(m_previous, current);
+            m_previous = current;
+        }
+    }
+
+    void start(const EventSample& s)
+    {
+        m_previous = s;
+        m_havePrevious = true;
+        if (m_chunk->windows && s.value < m_function->threshold)
+        {
+            m_inWindow = true;
+            m_window.startTime = s.t;
+            m_window.openStart = s.t == m_chunk->startTime;
+            m_window.peakTime = s.t;
+            m_window.peakValue = s.value;
+        }
+    }
+
+    void processStep(const EventSample& previous, const EventSample& current)
+    {
+        double tolerance = m_finder->timeTolerance();
+        double threshold = m_function->threshold;
+
+        if (!m_chunk->windows)
+        {
+            // A minimum lies between samples where the rate changes from
+            // negative to positive.
+            if (previous.rate < 0.0 && current.rate >= 0.0)
+            {
+                double t = refineCrossing(m_function, previous, current, true, tolerance);
+                if (m_function->sample(t).value <= threshold)
+                {
+                    m_chunk->extrema.push_back(t);
+                }
+            }
+            return;
+        }
+
+        if (!m_inWindow && current.value < threshold)
+        {
+            m_inWindow = true;
+            m_window.startTime = refineCrossing(m_function, previous, current, false, tolerance);
+            m_window.openStart = false;
+            m_window.peakTime = current.t;
+            m_window.peakValue = current.value;
+        }
+
+        if (m_inWindow)
+        {
+            if (previous.rate < 0.0 && current.rate >= 0.0)
+            {
+                double t = refineCrossing(m_function, previous, current, true, tolerance);
+                EventSample s = m_function->sample(t);
+                if (s.value < m_window.peakValue)
+                {
+                    m_window.peakTime = t;
+                    m_window.peakValue = s.value;
+                }
+            }
+
+            if (current.value < threshold)
+            {
+                if (current.value < m_window.peakValue)
+                {
+                    m_window.peakTime = current.t;
+                    m_window.peakValue = current.value;
+                }
+            }
+            else
+            {
+                m_window.endTime = refineCrossing(m_function, previous, current, false, tolerance);
+                m_window.openEnd = false;
+                m_window.peakTime = max(m_window.startTime, min(m_window.endTime, m_window.peakTime));
+                m_chunk->eventWindows.push_back(m_window);
+                m_inWindow = false;
+            }
+        }
+    }
+
+private:
+    const EventFinder* m_finder;
+    SearchChunk* m_chunk;
+    const EventFunction* m_function;
+
+    bool m_havePrevious;
+    double m_resumeTime;
+    EventSample m_previous;
+    double m_lastStep;
+
+    bool m_inWindow;
+    EventWindow m_window;
+};
+
+
+EventFinder::EventFinder() :
+    m_stepFactor(DefaultStepFactor),
+    m_minStep(DefaultMinStep),
+    m_maxStep(DefaultMaxStep),
+    m_timeTolerance(DefaultTimeTolerance),
+    m_threadCount(0),
+    m_pruningEnabled(true)
+{
+}
+
+
+EventFinder::~EventFinder()
+{
+}
+
+
+/** Set the fraction of the time scale (distance / relative speed) used as
+  * the search step. Smaller values make searches slower but less likely to
+  * miss events that are close together.
+  */
+void
+EventFinder::setStepFactor(double factor)
+{
+    m_stepFactor = factor;
+}
+
+
+/** Set the smallest and largest steps (in seconds) used when sampling.
+  * Events shorter than the minimum step may be missed.
+  */
+void
+EventFinder::setStepLimits(double minStep, double maxStep)
+{
+    m_minStep = minStep;
+    m_maxStep = max(minStep, maxStep);
+}
+
+
+/** Set the precision to which event times are computed (in seconds.)
+  */
+void
+EventFinder::setTimeTolerance(double seconds)
+{
+    m_timeTolerance = seconds;
+}
+
+
+/** Set the number of threads used for searches. Zero means one thread per
+  * processor.
+  */
+void
+EventFinder::setThreadCount(unsigned int count)
+{
+    m_threadCount = count;
+}
+
+
+/** Enable or disable pruning of spans of time in which no event is
+  * possible. Pruning never changes the events found; disabling it is only
+  * useful for testing.
+  */
+void
+EventFinder::setPruningEnabled(bool enabled)
+{
+    m_pruningEnabled = enabled;
+}
+
+
+/** Find the local minima of the distance between two bodies at which the
+  * distance is no more than maxDistance (in km.)
+  */
+std::vector<EventFinder::Event>
+EventFinder::findClosestApproaches(const Entity* target,
+                                   const Entity* observer,
+                                   double startTime,
+                                   double endTime,
+                                   double maxDistance) const
+{
+    DistanceFunction f(target, observer, false);
+    f.threshold = maxDistance;
+    return findExtrema(&f, startTime, endTime, ClosestApproach);
+}
+
+
+/** Find the periapsis passages of a body about a center, i.e. the local
+  * minima of the distance between them.
+  */
+std::vector<EventFinder::Event>
+EventFinder::findPeriapses(const Entity* body,
+                           const Entity* center,
+                           double startTime,
+                           double endTime) const
+{
+    DistanceFunction f(body, center, false);
+    return findExtrema(&f, startTime, endTime, Periapsis);
+}
+
+
+/** Find the apoapsis passages of a body about a center, i.e. the local
+  * maxima of the distance between them.
+  */
+std::vector<EventFinder::Event>
+EventFinder::findApoapses(const Entity* body,
+                          const Entity* center,
+                          double startTime,
+                          double endTime) const
+{
+    DistanceFunction f(body, center, true);
+    return findExtrema(&f, startTime, endTime, Apoapsis);
+}
+
+
+/** Find the occultations of a target body by an occulter as seen from the
+  * center of an observer. Both bodies are treated as spheres. Every
+  * occultation produces a PartialOccultation event spanning the outer
+  * contacts. Occultations in which one body appears entirely within the
+  * other also produce a TotalOccultation (the target is completely hidden)
+  * or an AnnularOccultation event spanning the inner contacts. Events are
+  * sorted by start time.
+  */
+std::vector<EventFinder::Event>
+EventFinder::findOccultations(const Entity* target,
+                              double targetRadius,
+                              const Entity* occulter,
+                              double occulterRadius,
+                              const Entity* observer,
+                              double startTime,
+                              double endTime) const
+{
+    SeparationFunction outer(target, targetRadius, occulter, occulterRadius, observer, false);
+    SeparationFunction inner(target, targetRadius, occulter, occulterRadius, observer, true);
+
+    std::vector<Event> partialEvents = findWindows(&outer, startTime, endTime);
+
+    // Inner contacts can only occur during the partial phase, so only those
+    // spans are searched for them.
+    std::vector<Event> events;
+    for (unsigned int i = 0; i < partialEvents.size(); ++i)
+    {
+        const Event& partial = partialEvents[i];
+        events.push_back(partial);
+
+        std::vector<Event> innerEvents = findWindows(&inner, partial.startTime, partial.endTime);
+        for (unsigned int j = 0; j < innerEvents.size(); ++j)
+        {
+            Event e = innerEvents[j];
+            e.type = inner.occulterAppearsLarger(e.peakTime) ? TotalOccultation : AnnularOccultation;
+            events.push_back(e);
+        }
+    }
+
+    return events;
+}
+
+
+/** Find the eclipses of a body by an occulter. These are occultations of
+  * the Sun as seen from the center of the eclipsed body: a partial
+  * occultation means that the center of the body is in the occulter's
+  * penumbra, a total occultation means that it's in the umbra. For example,
+  * lunar eclipses are eclipses of the Moon by the Earth.
+  */
+std::vector<EventFinder::Event>
+EventFinder::findEclipses(const Entity* body,
+                          const Entity* occulter,
+                          double occulterRadius,
+                          const Entity* sun,
+                          double sunRadius,
+                          double startTime,
+                          double endTime) const
+{
+    return findOccultations(sun, sunRadius, occulter, occulterRadius, body, startTime, endTime);
+}
+
+
+std::vector<EventFinder::Event>
+EventFinder::findExtrema(const EventFunction* f, double startTime, double endTime, EventType type) const
+{
+    std::vector<SearchChunk> chunks;
+    search(f, startTime, endTime, false, &chunks);
+
+    std::vector<Event> events;
+    for (unsigned int i = 0; i < chunks.size(); ++i)
+    {
+        for (unsigned int j = 0; j < chunks[i].extrema.size(); ++j)
+        {
+            double t = chunks[i].extrema[j];
+            if (f->accept(t))
+            {
+                Event e;
+                e.type = type;
+                e.startTime = t;
+                e.endTime = t;
+                e.peakTime = t;
+                e.value = f->eventValue(t);
+                events.push_back(e);
+            }
+        }
+    }
+
+    return events;
+}
+
+
+std::vector<EventFinder::Event>
+EventFinder::findWindows(const EventFunction* f, double startTime, double endTime) const
+{
+    std::vector<SearchChunk> chunks;
+    search(f, startTime, endTime, true, &chunks);
+
+    // Join windows that were split at chunk boundaries
+    std::vector<EventWindow> windows;
+    for (unsigned int i = 0; i < chunks.size(); ++i)
+    {
+        for (unsigned int j = 0; j < chunks[i].eventWindows.size(); ++j)
+        {
+            const EventWindow& w = chunks[i].eventWindows[j];
+            if (!windows.empty() && w.openStart && windows.back().openEnd && windows.back().endTime == w.startTime)
+            {
+                EventWindow& last = windows.back();
+                last.endTime = w.endTime;
+                last.openEnd = w.openEnd;
+                if (w.peakValue < last.peakValue)
+                {
+                    last.peakTime = w.peakTime;
+                    last.peakValue = w.peakValue;
+                }
+            }
+            else
+            {
+                windows.push_back(w);
+            }
+        }
+    }
+
+    std::vector<Event> events;
+    for (unsigned int i = 0; i < windows.size(); ++i)
+    {
+        const EventWindow& w = windows[i];
+        if (f->accept(w.peakTime))
+        {
+            Event e;
+            e.type = PartialOccultation;
+            e.startTime = w.startTime;
+            e.endTime = w.endTime;
+            e.peakTime = w.peakTime;
+            e.value = f->eventValue(w.peakTime);
+            events.push_back(e);
+        }
+    }
+
+    return events;
+}
+
+
+// Divide the search span into chunks and search them in parallel.
+void
+EventFinder::search(const EventFunction* f, double startTime, double endTime, bool windows,
+                    std::vector<SearchChunk>* chunks) const
+{
+    if (!(endTime > startTime))
+    {
+        return;
+    }
+
+    unsigned int threadCount = m_threadCount;
+    if (threadCount == 0)
+    {
+        threadCount = unsigned(max(1, QThread::idealThreadCount()));
+    }
+
+    double maxChunkCount = (endTime - startTime) / MinChunkLength;
+    unsigned int chunkCount = threadCount * ChunksPerThread;
+    if (threadCount == 1)
+    {
+        chunkCount = 1;
+    }
+    else if (maxChunkCount < chunkCount)
+    {
+        chunkCount = unsigned(max(1.0, maxChunkCount));
+    }
+
+    chunks->resize(chunkCount);
+    for (unsigned int i = 0; i < chunkCount; ++i)
+    {
+        SearchChunk& chunk = (*chunks)[i];
+        chunk.function = f;
+        chunk.startTime = i == 0 ? startTime : (*chunks)[i - 1].endTime;
+        chunk.endTime = i == chunkCount - 1 ? endTime : startTime + (endTime - startTime) * (i + 1) / chunkCount;
+        chunk.windows = windows;
+    }
+
+    if (chunkCount == 1)
+    {
+        searchChunk(this, &(*chunks)[0]);
+    }
+    else
+    {
+        // The thread pool runs the chunks; this thread waits for them.
+        std::vector<QFuture<void> > futures;
+        for (unsigned int i = 0; i < chunkCount; ++i)
+        {
+            futures.push_back(QtConcurrent::run(&EventFinder::searchChunk, this, &(*chunks)[i]));
+        }
+        for (unsigned int i = 0; i < futures.size(); ++i)
+        {
+            futures[i].waitForFinished();
+        }
+    }
+}
+
+
+void
+EventFinder::searchChunk(const EventFinder* finder, SearchChunk* chunk)
+{
+    ChunkScanner scanner(finder, chunk);
+    scanner.scan();
+    scanner.finish();
+}
+
+
+// Get the state of an entity relative to the center of its active arc, in
+// the fundamental coordinate system.
+static StateVector
+arcState(const Entity* entity, double t, const Entity** center)
+{
+    const Arc* arc = entity->chronology()->activeArc(t);
+    if (!arc)
+    {
+        *center = NULL;
+        return StateVector(Vector3d::Zero(), Vector3d::Zero());
+    }
+
+    *center = arc->center();
+
+    StateVector state = arc->trajectory()->state(t);
+    Matrix3d m = arc->trajectoryFrame()->orientation(t).toRotationMatrix();
+    Vector3d omega = arc->trajectoryFrame()->angularVelocity(t);
+
+    return StateVector(m * state.position(), m * state.velocity() + omega.cross(state.position()));
+}
+
+
+/** Get the state of a target body relative to an observer. This gives the
+  * same result as subtracting the states of the two bodies, but only
+  * evaluates trajectories up to the nearest common center, which is faster
+  * and more precise.
+  */
+StateVector
+EventFinder::relativeState(const Entity* target, const Entity* observer, double tdbSec)
+{
+    // The chain of centers of the observer, ending with NULL (the origin),
+    // and the state of the observer relative to each one.
+    const Entity* centers[MaxCenterChainLength];
+    StateVector offsets[MaxCenterChainLength];
+    unsigned int chainLength = 0;
+
+    const Entity* e = observer;
+    StateVector s(Vector3d::Zero(), Vector3d::Zero());
+    while (chainLength < MaxCenterChainLength)
+    {
+        centers[chainLength] = e;
+        offsets[chainLength] = s;
+        ++chainLength;
+        if (!e)
+        {
+            break;
+        }
+
+        const Entity* center = NULL;
+        s = s + arcState(e, tdbSec, &center);
+        e = center;
+    }
+
+    e = target;
+    s = StateVector(Vector3d::Zero(), Vector3d::Zero());
+    for (unsigned int depth = 0; depth < MaxCenterChainLength; ++depth)
+    {
+        for (unsigned int i = 0; i < chainLength; ++i)
+        {
+            if (centers[i] == e)
+            {
+                return s - offsets[i];
+            }
+        }
+
+        if (!e)
+        {
+            break;
+        }
+
+        const Entity* center = NULL;
+        s = s + arcState(e, tdbSec, &center);
+        e = center;
+    }
+
+    // Centers nested too deeply
+    return target->state(tdbSec) - observer->state(tdbSec);
+}
+
+
+// Evaluate a Chebyshev series and its derivative at u. The derivatives of
+// the Chebyshev polynomials are computed from T_i'(u) = i * U_{i-1}(u), where
+// U is a Chebyshev polynomial of the second kind.
+static void
+chebyshevSum(const double* coeffs, unsigned int n, double u, double* value, double* derivative)
+{
+    double t0 = 1.0;
+    double t1 = u;
+    double u0 = 1.0;
+    double u1 = 2.0 * u;
+
+    double v = coeffs[0] + (n > 1 ? coeffs[1] * u : 0.0);
+    double d = n > 1 ? coeffs[1] : 0.0;
+    for (unsigned int i = 2; i < n; ++i)
+    {
+        double t2 = 2.0 * u * t1 - t0;
+        v += coeffs[i] * t2;
+        d += coeffs[i] * i * u1;
+
+        double u2 = 2.0 * u * u1 - u0;
+        t0 = t1;
+        t1 = t2;
+        u0 = u1;
+        u1 = u2;
+    }
+
+    *value = v;
+    *derivative = d;
+}
+
+
+// Bound the position of a Chebyshev polynomial trajectory over a span of
+// time. The position is within a box about its value at the middle of the
+// span in each granule. The size of the box is bounded by the sum of the
+// magnitudes of the coefficients (since |T_i(u)| <= 1), and by a Taylor
+// expansion about the middle of the span with the largest possible second
+// derivative (|T_i''(u)| <= i^2 (i^2 - 1) / 3.)
+static bool
+chebyshevPositionBound(const ChebyshevPolyTrajectory* trajectory, double t0, double t1,
+                       Vector3d* center, double* radius)
+{
+    // States are clamped to the valid time range
+    t0 = max(trajectory->startTime(), min(trajectory->endTime(), t0));
+    t1 = max(trajectory->startTime(), min(trajectory->endTime(), t1));
+
+    double granuleLength = trajectory->granuleLength();
+    double startTime = trajectory->firstGranuleStartTime();
+    int lastGranule = int(trajectory->granuleCount()) - 1;
+    int first = max(0, min(lastGranule, int(floor((t0 - startTime) / granuleLength))));
+    int last = max(0, min(lastGranule, int(floor((t1 - startTime) / granuleLength))));
+    if (last - first >= MaxBoundGranuleCount)
+    {
+        return false;
+    }
+
+    unsigned int n = trajectory->degree() + 1;
+    double buffer[ChebyshevGranuleSource::MaxGranuleSize];
+
+    for (int granule = first; granule <= last; ++granule)
+    {
+        const double* coeffs = trajectory->granuleCoefficients(granule, buffer);
+        double granuleStart = startTime + granule * granuleLength;
+        double u0 = max(-1.0, min(1.0, 2.0 * (t0 - granuleStart) / granuleLength - 1.0));
+        double u1 = max(-1.0, min(1.0, 2.0 * (t1 - granuleStart) / granuleLength - 1.0));
+        double um = 0.5 * (u0 + u1);
+        double halfWidth = 0.5 * (u1 - u0);
+
+        Vector3d p = Vector3d::Zero();
+        Vector3d extent = Vector3d::Zero();
+        for (unsigned int axis = 0; axis < 3; ++axis)
+        {
+            const double* c = coeffs + axis * n;
+            double tail = 0.0;
+            double secondDerivativeBound = 0.0;
+            for (unsigned int i = 1; i < n; ++i)
+            {
+                double i2 = double(i * i);
+                tail += abs(c[i]);
+                secondDerivativeBound += i2 * (i2 - 1.0) / 3.0 * abs(c[i]);
+            }
+
+            double derivative = 0.0;
+            chebyshevSum(c, n, um, &p[axis], &derivative);
+            double taylorBound = halfWidth * (abs(derivative) + 0.5 * halfWidth * secondDerivativeBound);
+            extent[axis] = min(taylorBound, abs(p[axis] - c[0]) + tail);
+        }
+
+        double r = extent.norm();
+        if (granule == first)
+        {
+            *center = p;
+            *radius = r;
+        }
+        else
+        {
+            *radius = max(*radius, (p - *center).norm() + r);
+        }
+    }
+
+    return true;
+}
+
+
+// Bound the position of an entity relative to the center of its active arc
+// over a span of time. Fails if the arc changes during the span.
+static bool
+arcPositionBound(const Entity* entity, double t0, double t1,
+                 const Entity** center, Vector3d* boundCenter, double* boundRadius)
+{
+    const Arc* arc = entity->chronology()->activeArc(t0);
+    if (!arc || entity->chronology()->activeArc(t1) != arc)
+    {
+        return false;
+    }
+
+    *center = arc->center();
+
+    const Trajectory* trajectory = arc->trajectory();
+    const ChebyshevPolyTrajectory* chebyshev = dynamic_cast<const ChebyshevPolyTrajectory*>(trajectory);
+    Vector3d c = Vector3d::Zero();
+    double r = trajectory->boundingSphereRadius();
+    if (chebyshev)
+    {
+        if (!chebyshevPositionBound(chebyshev, t0, t1, &c, &r))
+        {
+            c = Vector3d::Zero();
+            r = trajectory->boundingSphereRadius();
+        }
+    }
+
+    const InertialFrame* inertialFrame = dynamic_cast<const InertialFrame*>(arc->trajectoryFrame());
+    if (inertialFrame)
+    {
+        *boundCenter = inertialFrame->orientation() * c;
+        *boundRadius = r;
+    }
+    else
+    {
+        // Any orientation is possible in a rotating frame
+        *boundCenter = Vector3d::Zero();
+        *boundRadius = c.norm() + r;
+    }
+
+    return true;
+}
+
+
+/** Compute a sphere containing all positions of a target body relative to
+  * an observer over a span of time. Returns false if no bound could be
+  * found.
+  */
+bool
+EventFinder::relativePositionBound(const Entity* target, const Entity* observer,
+                                   double startTime, double endTime,
+                                   Vector3d* center, double* radius)
+{
+    const Entity* centers[MaxCenterChainLength];
+    Vector3d offsetCenters[MaxCenterChainLength];
+    double offsetRadii[MaxCenterChainLength];
+    unsigned int chainLength = 0;
+
+    const Entity* e = observer;
+    Vector3d c = Vector3d::Zero();
+    double r = 0.0;
+    while (chainLength < MaxCenterChainLength)
+    {
+        centers[chainLength] = e;
+        offsetCenters[chainLength] = c;
+        offsetRadii[chainLength] = r;
+        ++chainLength;
+        if (!e)
+        {
+            break;
+        }
+
+        const Entity* arcCenter = NULL;
+        Vector3d arcBoundCenter = Vector3d::Zero();
+        double arcBoundRadius = 0.0;
+        if (!arcPositionBound(e, startTime, endTime, &arcCenter, &arcBoundCenter, &arcBoundRadius))
+        {
+            // The rest of the chain is unknown
+            break;
+        }
+
+        c += arcBoundCenter;
+        r += arcBoundRadius;
+        e = arcCenter;
+    }
+
+    e = target;
+    c = Vector3d::Zero();
+    r = 0.0;
+    for (unsigned int depth = 0; depth < MaxCenterChainLength; ++depth)
+    {
+        for (unsigned int i = 0; i < chainLength; ++i)
+        {
+            if (centers[i] == e)
+            {
+                *center = c - offsetCenters[i];
+                *radius = r + offsetRadii[i];
+                return true;
+            }
+        }
+
+        if (!e)
+        {
+            break;
+        }
+
+        const Entity* arcCenter = NULL;
+        Vector3d arcBoundCenter = Vector3d::Zero();
+        double arcBoundRadius = 0.0;
+        if (!arcPositionBound(e, startTime, endTime, &arcCenter, &arcBoundCenter, &arcBoundRadius))
+        {
+            return false;
+        }
+
+        c += arcBoundCenter;
+        r += arcBoundRadius;
+        e = arcCenter;
+    }
+
+    return false;
+}
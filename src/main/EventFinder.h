@@ -0,0 +1,203 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _EVENT_FINDER_H_
+#define _EVENT_FINDER_H_
+
+#include <vesta/Entity.h>
+#include <vector>
+
+
+/** EventFinder searches a span of time for geometric events: closest
+  * approaches, periapsis and apoapsis passages, and occultations and
+  * eclipses. It works directly with the entities of a universe and needs
+  * no view, so it may be used from scripts and command line tools.
+  *
+  * Each search samples a function of time (a distance, or an angular
+  * separation) with a step that adapts to the motion: the step is a fraction
+  * of the time scale distance / relative speed, and for occultations is also
+  * limited so that the separation can't pass through zero between samples.
+  * Extrema and crossings found between samples are refined by root finding.
+  * Positions are geometric; light time is ignored.
+  *
+  * Spans of time in which an event is impossible are skipped without
+  * sampling. Every trajectory bounds the position of a body about its
+  * center, and Chebyshev polynomial trajectories (including JPL ephemerides)
+  * give much tighter bounds from the magnitudes of their coefficients. When
+  * a bound shows that two bodies stay farther apart than the maximum
+  * distance of a closest approach search, or that an occulter stays well
+  * clear of the target, the span is pruned.
+  *
+  * The search span is divided into chunks that are searched in parallel
+  * by threads from the global thread pool, so the trajectories involved must
+  * be safe to evaluate from multiple threads. Set the thread count to one to
+  * search on the calling thread only.
+  */
+class EventFinder
+{
+public:
+    EventFinder();
+    ~EventFinder();
+
+    enum EventType
+    {
+        ClosestApproach,
+        Periapsis,
+        Apoapsis,
+        PartialOccultation,
+        TotalOccultation,
+        AnnularOccultation,
+    };
+
+    /** A geometric event. Closest approaches and apsides are instants, and
+      * their start, end, and peak times are identical. For occultations,
+      * start and end are the times of the contacts and peak is the time of
+      * the smallest separation between the centers of the target and the
+      * occulter. All times are in seconds since J2000 TDB.
+      */
+    struct Event
+    {
+        EventType type;
+        double startTime;
+        double endTime;
+        double peakTime;
+
+        // Distance in km for closest approaches and apsides, angular
+        // separation in radians at the peak for occultations
+        double value;
+    };
+
+    /** Get the fraction of the time scale (distance / relative speed) used
+      * as the search step.
+      */
+    double stepFactor() const
+    {
+        return m_stepFactor;
+    }
+
+    void setStepFactor(double factor);
+
+    /** Get the smallest step used when sampling (in seconds.)
+      */
+    double minStep() const
+    {
+        return m_minStep;
+    }
+
+    /** Get the largest step used when sampling (in seconds.)
+      */
+    double maxStep() const
+    {
+        return m_maxStep;
+    }
+
+    void setStepLimits(double minStep, double maxStep);
+
+    /** Get the precision to which event times are computed (in seconds.)
+      */
+    double timeTolerance() const
+    {
+        return m_timeTolerance;
+    }
+
+    void setTimeTolerance(double seconds);
+
+    /** Get the number of threads used for searches. Zero means one thread
+      * per processor.
+      */
+    unsigned int threadCount() const
+    {
+        return m_threadCount;
+    }
+
+    void setThreadCount(unsigned int count);
+
+    /** Return true if spans of time in which no event is possible are
+      * skipped.
+      */
+    bool isPruningEnabled() const
+    {
+        return m_pruningEnabled;
+    }
+
+    void setPruningEnabled(bool enabled);
+
+    std::vector<Event> findClosestApproaches(const vesta::Entity* target,
+                                             const vesta::Entity* observer,
+                                             double startTime,
+                                             double endTime,
+                                             double maxDistance) const;
+    std::vector<Event> findPeriapses(const vesta::Entity* body,
+                                     const vesta::Entity* center,
+                                     double startTime,
+                                     double endTime) const;
+    std::vector<Event> findApoapses(const vesta::Entity* body,
+                                    const vesta::Entity* center,
+                                    double startTime,
+                                    double endTime) const;
+    std::vector<Event> findOccultations(const vesta::Entity* target,
+                                        double targetRadius,
+                                        const vesta::Entity* occulter,
+                                        double occulterRadius,
+                                        const vesta::Entity* observer,
+                                        double startTime,
+                                        double endTime) const;
+    std::vector<Event> findEclipses(const vesta::Entity* body,
+                                    const vesta::Entity* occulter,
+                                    double occulterRadius,
+                                    const vesta::Entity* sun,
+                                    double sunRadius,
+                                    double startTime,
+                                    double endTime) const;
+
+    static vesta::StateVector relativeState(const vesta::Entity* target, const vesta::Entity* observer, double tdbSec);
+    static bool relativePositionBound(const vesta::Entity* target, const vesta::Entity* observer,
+                                      double startTime, double endTime,
+                                      Eigen::Vector3d* center, double* radius);
+
+    // Default fraction of the time scale used as the step
+    static const double DefaultStepFactor;
+
+    // Default limits on the sampling step in seconds
+    static const double DefaultMinStep;
+    static const double DefaultMaxStep;
+
+    // Default precision of event times in seconds
+    static const double DefaultTimeTolerance;
+
+private:
+    class EventFunction;
+    class DistanceFunction;
+    class SeparationFunction;
+    struct SearchChunk;
+    class ChunkScanner;
+
+    std::vector<Event> findExtrema(const EventFunction* f, double startTime, double endTime, EventType type) const;
+    std::vector<Event> findWindows(const EventFunction* f, double startTime, double endTime) const;
+    void search(const EventFunction* f, double startTime, double endTime, bool windows,
+                std::vector<SearchChunk>* chunks) const;
+    static void searchChunk(const EventFinder* finder, SearchChunk* chunk);
+
+private:
+    double m_stepFactor;
+    double m_minStep;
+    double m_maxStep;
+    double m_timeTolerance;
+    unsigned int m_threadCount;
+    bool m_pruningEnabled;
+};
+
+#endif // _EVENT_FINDER_H_
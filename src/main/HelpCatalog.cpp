@@ -17,6 +17,7 @@
 #include "HelpCatalog.h"
 #include "UnitConversion.h"
 #include "TleTrajectory.h"
+#include "CachingChebyshevTrajectory.h"
 #include "DateUtility.h"
 #include "NumberFormat.h"
 #include "catalog/UniverseCatalog.h"
@@ -325,7 +326,14 @@ HelpCatalog::getObjectDataText(const QString &name) const
         // Special case for TLE orbits: use the current system time instead
         if (body->chronology()->arcCount() > 0)
         {
-            TleTrajectory* tle = dynamic_cast<TleTrajectory*>(body->chronology()->firstArc()->trajectory());
+            vesta::Trajectory* trajectory = body->chronology()->firstArc()->trajectory();
+            CachingChebyshevTrajectory* cache = dynamic_cast<CachingChebyshevTrajectory*>(trajectory);
+            if (cache)
+            {
+                trajectory = cache->trajectory();
+            }
+
+            TleTrajectory* tle = dynamic_cast<TleTrajectory*>(trajectory);
             if (tle)
             {
                 vesta::GregorianDate now = QtDateToVestaDate(QDateTime::currentDateTimeUtc());
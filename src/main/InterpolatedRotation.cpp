@@ -17,31 +17,42 @@
 #include "InterpolatedRotation.h"
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 
 using namespace vesta;
 using namespace Eigen;
 using namespace std;
 
 
-// A weak ordering on time/state records used for binary search by
-// time.
-class TimeOrientationOrdering
+/** Create a new interpolated rotation model with the specified list
+  * of time/orientation records.
+  */
+InterpolatedRotation::InterpolatedRotation(const TimeOrientationList& orientations) :
+    m_interpolation(Slerp)
 {
-public:
-    bool operator()(const InterpolatedRotation::TimeOrientation& t0,
-                    const InterpolatedRotation::TimeOrientation& t1)
+    m_orientations = orientations;
+
+    std::vector<double> times;
+    times.reserve(orientations.size());
+    for (TimeOrientationList::const_iterator iter = orientations.begin(); iter != orientations.end(); ++iter)
     {
-        return t0.tsec < t1.tsec;
+        times.push_back(iter->tsec);
     }
-};
+    m_times.setTimes(times);
+}
 
 
-/** Create a new interpolated rotation model with the specified list
-  * of time/orientation records.
+/** Create a new interpolated rotation model with records stored in separate
+  * arrays. The arrays aren't copied; they must remain valid for the lifetime
+  * of the storage object, which the rotation model keeps a reference to (e.g.
+  * a memory mapped file.) The quaternions must have unit length.
   */
-InterpolatedRotation::InterpolatedRotation(const TimeOrientationList& orientations)
+InterpolatedRotation::InterpolatedRotation(const OrientationArrays& arrays, vesta::Object* storage) :
+    m_arrays(arrays),
+    m_storage(storage),
+    m_interpolation(Slerp)
 {
-    m_orientations = orientations;
+    m_times.setTimes(m_arrays.tsec, m_arrays.count, m_arrays.index, m_arrays.indexStride, m_arrays.indexCount);
 }
 
 
@@ -50,98 +61,302 @@ InterpolatedRotation::~InterpolatedRotation()
 }
 
 
-/** Calculate the orientation at the specified time (seconds since J2000 TDB).
-  * The interpolation technique is spherical linear (slerp).
-  *
-  * The input time is clamped to so that it lies within the range between
-  * the first and last record.
+/** Set the method used to interpolate between records. Setting the method
+  * to Cubic computes the cubic coefficients for every interval.
   */
+void
+InterpolatedRotation::setInterpolation(InterpolationMethod method)
+{
+    m_interpolation = method;
+    computeCubicCoefficients();
+}
+
+
+/** Get the number of records in the orientation table.
+  */
+unsigned int
+InterpolatedRotation::orientationCount() const
+{
+    return m_times.count();
+}
+
+
+/** Get the time of the record at the specified index.
+  */
+double
+InterpolatedRotation::time(unsigned int index) const
+{
+    if (index < m_times.count())
+    {
+        return m_times[index];
+    }
+    else
+    {
+        return 0.0;
+    }
+}
+
+
 Quaterniond
-InterpolatedRotation::orientation(double tdbSec) const
+InterpolatedRotation::recordOrientation(unsigned int index) const
 {
-    if (!m_orientations.empty())
+    if (m_arrays.tsec)
+    {
+        return Quaterniond(m_arrays.w[index], m_arrays.x[index], m_arrays.y[index], m_arrays.z[index]);
+    }
+    else
     {
-        TimeOrientation t;
-        t.tsec = tdbSec;
-        TimeOrientationList::const_iterator iter = lower_bound(m_orientations.begin(), m_orientations.end(), t, TimeOrientationOrdering());
+        return m_orientations[index].orientation;
+    }
+}
 
-        if (iter == m_orientations.begin())
-        {
-            return m_orientations.front().orientation;
-        }
-        else if (iter == m_orientations.end())
-        {
-            return m_orientations.back().orientation;
-        }
-        else
-        {
-            TimeOrientation s0 = *(iter - 1);
-            TimeOrientation s1 = *iter;
-            double t = (tdbSec - s0.tsec) / (s1.tsec - s0.tsec);
 
-            return s0.orientation.slerp(t, s1.orientation);
-        }
+// Get the rotation vector (rotation axis scaled by the angle in radians) of
+// a unit quaternion. Of the two equivalent rotations, the one with an angle
+// less than or equal to pi is chosen.
+static Vector3d
+rotationVector(const Quaterniond& q)
+{
+    double w = q.w();
+    Vector3d v = q.vec();
+    if (w < 0.0)
+    {
+        w = -w;
+        v = -v;
+    }
+
+    double s = v.norm();
+    if (s < 1.0e-12)
+    {
+        return v * (2.0 / w);
     }
     else
     {
-        return Quaterniond::Identity();
+        return v * (2.0 * atan2(s, w) / s);
     }
 }
 
 
-Vector3d
-InterpolatedRotation::angularVelocity(double tdbSec) const
+// Get the unit quaternion for the rotation given by a rotation vector.
+static Quaterniond
+rotationVectorToQuaternion(const Vector3d& r)
+{
+    double theta = r.norm();
+    double k = theta < 1.0e-6 ? 0.5 - theta * theta / 48.0 : sin(0.5 * theta) / theta;
+    return Quaterniond(cos(0.5 * theta), k * r.x(), k * r.y(), k * r.z());
+}
+
+
+// Compute Jr(r) * v, where Jr is the right Jacobian of the rotation vector r.
+// If q(t) = q0 * exp(r(t)), the angular velocity in body coordinates is
+// Jr(r) * dr/dt.
+static Vector3d
+rightJacobianProduct(const Vector3d& r, const Vector3d& v)
 {
-    if (m_orientations.size() > 1)
+    double theta2 = r.squaredNorm();
+    double a;
+    double b;
+    if (theta2 < 1.0e-8)
     {
-        TimeOrientation t0;
-        TimeOrientation t1;
+        a = 0.5 - theta2 / 24.0;
+        b = 1.0 / 6.0 - theta2 / 120.0;
+    }
+    else
+    {
+        double theta = sqrt(theta2);
+        a = (1.0 - cos(theta)) / theta2;
+        b = (theta - sin(theta)) / (theta2 * theta);
+    }
+
+    Vector3d rv = r.cross(v);
+    return v - a * rv + b * r.cross(rv);
+}
 
-        TimeOrientation t;
-        t.tsec = tdbSec;
-        TimeOrientationList::const_iterator iter = lower_bound(m_orientations.begin(), m_orientations.end(), t, TimeOrientationOrdering());
 
-        if (iter == m_orientations.begin())
+// Compute the inverse of rightJacobianProduct: the rate of change of the
+// rotation vector r that gives body angular velocity v.
+static Vector3d
+inverseRightJacobianProduct(const Vector3d& r, const Vector3d& v)
+{
+    double theta2 = r.squaredNorm();
+    double c;
+    if (theta2 < 1.0e-8)
+    {
+        c = 1.0 / 12.0 + theta2 / 720.0;
+    }
+    else
+    {
+        double theta = sqrt(theta2);
+        double s = sin(theta);
+        c = s < 1.0e-9 ? 1.0 / theta2 : 1.0 / theta2 - (1.0 + cos(theta)) / (2.0 * theta * s);
+    }
+
+    Vector3d rv = r.cross(v);
+    return v + 0.5 * rv + c * r.cross(rv);
+}
+
+
+/** Compute the coefficients of the cubic interpolating function for each
+  * interval. Over interval i, the orientation is q(u) = q_i * exp(r(u)),
+  * where u runs from 0 to 1 and r(u) = c1 u + c2 u^2 + c3 u^3 is a cubic
+  * Hermite polynomial with r(1) giving the rotation from q_i to q_i+1.
+  * The derivatives at the ends are chosen so that the angular velocity
+  * at each record matches an estimate from the neighboring records.
+  */
+void
+InterpolatedRotation::computeCubicCoefficients()
+{
+    m_cubicCoeffs.clear();
+    if (m_interpolation != Cubic || m_times.count() < 2)
+    {
+        return;
+    }
+
+    unsigned int intervalCount = m_times.count() - 1;
+
+    // Rotation vector for each interval (the same in the body frames of both
+    // records, since it is the rotation axis.)
+    std::vector<Vector3d> deltas(intervalCount);
+    for (unsigned int i = 0; i < intervalCount; ++i)
+    {
+        deltas[i] = rotationVector(recordOrientation(i).conjugate() * recordOrientation(i + 1));
+    }
+
+    // Estimate the body angular velocity at each record. The estimate is
+    // one-sided at the ends, and the derivative of a parabola through the
+    // neighboring records at other points.
+    std::vector<Vector3d> rates(m_times.count());
+    rates[0] = deltas[0] / (m_times[1] - m_times[0]);
+    rates[m_times.count() - 1] = deltas[intervalCount - 1] / (m_times[intervalCount] - m_times[intervalCount - 1]);
+    for (unsigned int i = 1; i < intervalCount; ++i)
+    {
+        double h0 = m_times[i] - m_times[i - 1];
+        double h1 = m_times[i + 1] - m_times[i];
+        rates[i] = (deltas[i - 1] * (h1 / h0) + deltas[i] * (h0 / h1)) / (h0 + h1);
+    }
+
+    m_cubicCoeffs.resize(intervalCount * 9);
+    for (unsigned int i = 0; i < intervalCount; ++i)
+    {
+        double h = m_times[i + 1] - m_times[i];
+        Vector3d d = deltas[i];
+        Vector3d m0 = rates[i] * h;
+        Vector3d m1 = inverseRightJacobianProduct(d, rates[i + 1] * h);
+
+        Vector3d c1 = m0;
+        Vector3d c2 = 3.0 * d - 2.0 * m0 - m1;
+        Vector3d c3 = m0 + m1 - 2.0 * d;
+
+        double* c = &m_cubicCoeffs[i * 9];
+        for (unsigned int j = 0; j < 3; ++j)
         {
-            t0 = m_orientations[0];
-            t1 = m_orientations[1];
+            c[j] = c1[j];
+            c[j + 3] = c2[j];
+            c[j + 6] = c3[j];
         }
-        else if (iter == m_orientations.end())
+    }
+}
+
+
+// Compute the interpolated orientation and/or angular velocity at a time. The
+// time is clamped to the range covered by the records. Angular velocity is
+// in the coordinates of the base frame.
+void
+InterpolatedRotation::interpolate(double tdbSec, Quaterniond* q, Vector3d* w) const
+{
+    if (m_times.count() < 2)
+    {
+        if (q)
         {
-            unsigned int n = m_orientations.size();
-            t0 = m_orientations[n - 2];
-            t1 = m_orientations[n - 1];
+            *q = m_times.count() == 0 ? Quaterniond::Identity() : recordOrientation(0);
         }
-        else
+        if (w)
         {
-            t0 = *(iter - 1);
-            t1 = *iter;
+            *w = Vector3d::Zero();
         }
+        return;
+    }
 
-        double h = t1.tsec - t0.tsec;
+    unsigned int i = 0;
+    double t = tdbSec;
+    if (t <= m_times[0])
+    {
+        t = m_times[0];
+        i = 0;
+    }
+    else if (t >= m_times[m_times.count() - 1])
+    {
+        t = m_times[m_times.count() - 1];
+        i = m_times.count() - 2;
+    }
+    else
+    {
+        i = m_times.findInterval(t);
+    }
 
-        // The derivative of a quaternion function q(t) (where t is a scalar) is
-        // given by:
-        //  1/2 w(t) q(t)
-        //
-        // Where w(t) given by a * v(t), with a the scalar angular velocity and
-        // v(t) a unit direction vector.
+    double h = m_times[i + 1] - m_times[i];
+    double u = (t - m_times[i]) / h;
+    Quaterniond q0 = recordOrientation(i);
 
-        Quaterniond dq = t1.orientation * t0.orientation.conjugate();
-        const double one = 1.0 - machine_epsilon<double>();
+    if (m_interpolation == Cubic && !m_cubicCoeffs.empty())
+    {
+        const double* c = &m_cubicCoeffs[i * 9];
+        Vector3d c1(c[0], c[1], c[2]);
+        Vector3d c2(c[3], c[4], c[5]);
+        Vector3d c3(c[6], c[7], c[8]);
 
-        if (abs(dq.w()) > one)
+        Vector3d r = ((c3 * u + c2) * u + c1) * u;
+        Quaterniond qt = q0 * rotationVectorToQuaternion(r);
+        if (q)
         {
-            return Vector3d::Zero();
+            *q = qt;
         }
-        else
+        if (w)
         {
-            double halfTheta = acos(dq.w());
-            return dq.vec().normalized() * (2.0 * halfTheta / h);
+            Vector3d dr = ((3.0 * u * c3 + 2.0 * c2) * u + c1) / h;
+            *w = qt * rightJacobianProduct(r, dr);
         }
     }
     else
     {
-        return Vector3d::Zero();
+        Quaterniond q1 = recordOrientation(i + 1);
+        if (q)
+        {
+            *q = q0.slerp(u, q1);
+        }
+        if (w)
+        {
+            // Constant over the interval: the rotation between the records
+            // divided by the interval length.
+            *w = q0 * (rotationVector(q0.conjugate() * q1) / h);
+        }
     }
 }
+
+
+/** Calculate the orientation at the specified time (seconds since J2000 TDB).
+  *
+  * The input time is clamped to so that it lies within the range between
+  * the first and last record.
+  */
+Quaterniond
+InterpolatedRotation::orientation(double tdbSec) const
+{
+    Quaterniond q;
+    interpolate(tdbSec, &q, NULL);
+    return q;
+}
+
+
+/** Calculate the angular velocity at the specified time (seconds since J2000
+  * TDB.) This is the derivative of the interpolating function, not a
+  * finite difference approximation. Outside the range of the records, the
+  * angular velocity at the nearest end is returned.
+  */
+Vector3d
+InterpolatedRotation::angularVelocity(double tdbSec) const
+{
+    Vector3d w;
+    interpolate(tdbSec, NULL, &w);
+    return w;
+}
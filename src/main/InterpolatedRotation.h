@@ -18,26 +18,44 @@
 #define _INTERPOLATED_ROTATION_H_
 
 #include <vesta/RotationModel.h>
+#include "SampledTimeIndex.h"
 #include <Eigen/StdVector>
 #include <vector>
 
 
-/** An InterpolatedStateTrajectory computes state vectors by interpolating
-  * between entries in a table of time/state vector pairs or time/position
-  * pairs with estimated velocities. Because the records are time-tagged,
-  * they need not be evenly spaced in time.
+/** An InterpolatedRotation computes orientations by interpolating between
+  * entries in a table of time/quaternion pairs. Because the records are
+  * time-tagged, they need not be evenly spaced in time.
   *
-  * Currently, the interpolation method is always cubic Hermite.
+  * Two interpolation methods are available. Slerp (the default) is
+  * spherical linear interpolation between adjacent records; the angular
+  * velocity is constant over each interval and discontinuous at the
+  * records. Cubic interpolation fits a cubic to the rotation vector
+  * relative to the start of each interval, with the angular velocity at
+  * each record estimated from its neighbors. The result is smooth
+  * (continuous angular velocity) and is accurate to third order, so a
+  * table can typically be sampled far more sparsely than with slerp for
+  * the same accuracy. The cubic coefficients are computed once when the
+  * interpolation method is set. With either method, angular velocity is
+  * computed analytically from the interpolating function.
   *
-  * Note that providing velocities greatly improves the accuracy of the
-  * interpolated approximation with respect to the original trajectory. When
-  * available, velocities should be given; if memory is constrained, it is
-  * better accuracy can be achieved by reducing the number of records by
-  * half rather than using postions instead of state vectors.
+  * The records may also be stored outside the rotation model as separate
+  * arrays of times and quaternion components; this is used to refer to
+  * records in a memory mapped file without copying them.
+  *
+  * Each thread remembers the last interval in which it found a time, so that
+  * the usual sequence of increasing times can be evaluated without searching
+  * the table.
   */
 class InterpolatedRotation : public vesta::RotationModel
 {
 public:
+    enum InterpolationMethod
+    {
+        Slerp,
+        Cubic,
+    };
+
     struct TimeOrientation
     {
         EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -46,14 +64,70 @@ public:
     };
     typedef std::vector<TimeOrientation, Eigen::aligned_allocator<TimeOrientation> > TimeOrientationList;
 
+    /** Records stored as separate arrays of times (seconds since J2000 TDB)
+      * and unit quaternion components. An optional coarse index gives the time
+      * of every indexStride-th record and is used to narrow the search for a
+      * time in very long tables.
+      */
+    struct OrientationArrays
+    {
+        OrientationArrays() :
+            count(0),
+            tsec(NULL),
+            w(NULL), x(NULL), y(NULL), z(NULL),
+            index(NULL), indexStride(0), indexCount(0)
+        {
+        }
+
+        unsigned int count;
+        const double* tsec;
+        const double* w;
+        const double* x;
+        const double* y;
+        const double* z;
+        const double* index;
+        unsigned int indexStride;
+        unsigned int indexCount;
+    };
+
     InterpolatedRotation(const TimeOrientationList& orientations);
+    InterpolatedRotation(const OrientationArrays& arrays, vesta::Object* storage);
     ~InterpolatedRotation();
 
     virtual Eigen::Quaterniond orientation(double tdbSec) const;
     virtual Eigen::Vector3d angularVelocity(double tdbSec) const;
 
+    InterpolationMethod interpolation() const
+    {
+        return m_interpolation;
+    }
+
+    void setInterpolation(InterpolationMethod method);
+
+    unsigned int orientationCount() const;
+    double time(unsigned int index) const;
+
+private:
+    Eigen::Quaterniond recordOrientation(unsigned int index) const;
+    void computeCubicCoefficients();
+    void interpolate(double tdbSec, Eigen::Quaterniond* q, Eigen::Vector3d* w) const;
+
 private:
     TimeOrientationList m_orientations;
+
+    // Externally stored records and the object that owns them
+    OrientationArrays m_arrays;
+    vesta::counted_ptr<vesta::Object> m_storage;
+
+    // Record times, either from m_arrays or copied from the record list so
+    // that searching is the same for all storage types.
+    SampledTimeIndex m_times;
+
+    InterpolationMethod m_interpolation;
+
+    // Coefficients c1, c2, c3 of the cubic rotation vector for each interval
+    // (nine values per interval); only used for cubic interpolation.
+    std::vector<double> m_cubicCoeffs;
 };
 
 #endif // _INTERPOLATED_ROTATION_H_
@@ -23,38 +23,15 @@ using namespace Eigen;
 using namespace std;
 
 
-// A weak ordering on time/orientation records used for binary search by
-// time.
-class TimeStateOrdering
-{
-public:
-    bool operator()(const InterpolatedStateTrajectory::TimeState& t0,
-                    const InterpolatedStateTrajectory::TimeState& t1)
-    {
-        return t0.tsec < t1.tsec;
-    }
-};
-
-
-// A weak ordering on time/position records used for binary search by
-// time.
-class TimePositionOrdering
-{
-public:
-    bool operator()(const InterpolatedStateTrajectory::TimePosition& t0,
-                    const InterpolatedStateTrajectory::TimePosition& t1)
-    {
-        return t0.tsec < t1.tsec;
-    }
-};
-
-
 /** Create a new interpolated state trajectory with the specified list
   * of time/state records.
   */
 InterpolatedStateTrajectory::InterpolatedStateTrajectory(const TimeStateList& states) :
     m_period(0.0),
-    m_boundingRadius(0.0)
+    m_boundingRadius(0.0),
+    m_interpolation(CubicHermite),
+    m_interpolationOrder(3),
+    m_windowSize(2)
 {
     m_states = states;
     if (!states.empty())
@@ -62,6 +39,14 @@ InterpolatedStateTrajectory::InterpolatedStateTrajectory(const TimeStateList& st
         setValidTimeRange(states.front().tsec, states.back().tsec);
     }
 
+    std::vector<double> times;
+    times.reserve(states.size());
+    for (TimeStateList::const_iterator iter = states.begin(); iter != states.end(); ++iter)
+    {
+        times.push_back(iter->tsec);
+    }
+    m_times.setTimes(times);
+
     for (TimeStateList::const_iterator iter = states.begin(); iter != states.end(); ++iter)
     {
         m_boundingRadius = std::max(m_boundingRadius, iter->state.position().norm());
@@ -75,7 +60,10 @@ InterpolatedStateTrajectory::InterpolatedStateTrajectory(const TimeStateList& st
   */
 InterpolatedStateTrajectory::InterpolatedStateTrajectory(const TimePositionList& positions) :
     m_period(0.0),
-    m_boundingRadius(0.0)
+    m_boundingRadius(0.0),
+    m_interpolation(CubicHermite),
+    m_interpolationOrder(3),
+    m_windowSize(2)
 {
     m_positions = positions;
     if (!positions.empty())
@@ -83,6 +71,14 @@ InterpolatedStateTrajectory::InterpolatedStateTrajectory(const TimePositionList&
         setValidTimeRange(positions.front().tsec, positions.back().tsec);
     }
 
+    std::vector<double> times;
+    times.reserve(positions.size());
+    for (TimePositionList::const_iterator iter = positions.begin(); iter != positions.end(); ++iter)
+    {
+        times.push_back(iter->tsec);
+    }
+    m_times.setTimes(times);
+
     for (TimePositionList::const_iterator iter = positions.begin(); iter != positions.end(); ++iter)
     {
         m_boundingRadius = std::max(m_boundingRadius, iter->position.norm());
@@ -90,6 +86,33 @@ InterpolatedStateTrajectory::InterpolatedStateTrajectory(const TimePositionList&
 }
 
 
+/** Create a new interpolated state trajectory with records stored in
+  * separate arrays. The arrays aren't copied; they must remain valid for
+  * the lifetime of the storage object, which the trajectory keeps a
+  * reference to (e.g. a memory mapped file.) Since computing the bounding
+  * radius would require reading every record, it must be supplied by the
+  * caller.
+  */
+InterpolatedStateTrajectory::InterpolatedStateTrajectory(const StateArrays& arrays,
+                                                         vesta::Object* storage,
+                                                         double boundingRadius) :
+    m_period(0.0),
+    m_boundingRadius(boundingRadius),
+    m_interpolation(CubicHermite),
+    m_interpolationOrder(3),
+    m_windowSize(2),
+    m_arrays(arrays),
+    m_storage(storage)
+{
+    if (arrays.count > 0)
+    {
+        setValidTimeRange(arrays.tsec[0], arrays.tsec[arrays.count - 1]);
+    }
+
+    m_times.setTimes(m_arrays.tsec, m_arrays.count, m_arrays.index, m_arrays.indexStride, m_arrays.indexCount);
+}
+
+
 InterpolatedStateTrajectory::~InterpolatedStateTrajectory()
 {
 }
@@ -124,40 +147,149 @@ cubicHermitInterpolate(const Vector3d& r0, const Vector3d& v0,
 }
 
 
-static Vector3d
-estimateVelocity(const InterpolatedStateTrajectory::TimePositionList& positions, unsigned int index)
+Vector3d
+InterpolatedStateTrajectory::recordPosition(unsigned int index) const
+{
+    if (m_arrays.tsec)
+    {
+        return Vector3d(m_arrays.x[index], m_arrays.y[index], m_arrays.z[index]);
+    }
+    else if (!m_states.empty())
+    {
+        return m_states[index].state.position();
+    }
+    else
+    {
+        return m_positions[index].position;
+    }
+}
+
+
+Vector3d
+InterpolatedStateTrajectory::recordVelocity(unsigned int index) const
 {
-    assert(index < positions.size());
+    if (m_arrays.tsec)
+    {
+        if (m_arrays.vx)
+        {
+            return Vector3d(m_arrays.vx[index], m_arrays.vy[index], m_arrays.vz[index]);
+        }
+        else
+        {
+            return estimateVelocity(index);
+        }
+    }
+    else if (!m_states.empty())
+    {
+        return m_states[index].state.velocity();
+    }
+    else
+    {
+        return estimateVelocity(index);
+    }
+}
+
 
-    if (index == 0)
+Vector3d
+InterpolatedStateTrajectory::estimateVelocity(unsigned int index) const
+{
+    assert(index < m_times.count());
+
+    if (m_times.count() < 2)
     {
-        assert(positions.size() > 1);
+        return Vector3d::Zero();
+    }
+
+    // Two records with the same time mark a boundary between segments, so
+    // differences are only taken between neighbors within the same segment:
+    // a one-sided difference at the first and last point of a segment.
+    bool hasPrevious = index > 0 && m_times[index] > m_times[index - 1];
+    bool hasNext = index < m_times.count() - 1 && m_times[index + 1] > m_times[index];
 
+    if (hasPrevious && hasNext)
+    {
+        // Three-point difference for points in the middle
+        double h0 = m_times[index] - m_times[index - 1];
+        double h1 = m_times[index + 1] - m_times[index];
+        Vector3d p = recordPosition(index);
+        return 0.5 * ((p - recordPosition(index - 1)) / h0 +
+                      (recordPosition(index + 1) - p) / h1);
+    }
+    else if (hasNext)
+    {
         // One-sided difference for first point
-        double h = positions[1].tsec - positions[0].tsec;
-        return (positions[1].position - positions[0].position) / h;
+        double h = m_times[index + 1] - m_times[index];
+        return (recordPosition(index + 1) - recordPosition(index)) / h;
     }
-    else if (index == positions.size() - 1)
+    else if (hasPrevious)
     {
-        assert(index > 0);
-
         // One-sided difference for last point
-        double h = positions[index].tsec - positions[index - 1].tsec;
-        return (positions[index].position - positions[index - 1].position) / h;
+        double h = m_times[index] - m_times[index - 1];
+        return (recordPosition(index) - recordPosition(index - 1)) / h;
     }
     else
     {
-        assert(index > 0 && index + 1 < positions.size());
+        // Segment consisting of a single record
+        return Vector3d::Zero();
+    }
+}
 
-        // Three-point difference for points in the middle
-        double h0 = positions[index].tsec - positions[index - 1].tsec;
-        double h1 = positions[index + 1].tsec - positions[index].tsec;
-        return 0.5 * ((positions[index].position - positions[index - 1].position) / h0 +
-                      (positions[index + 1].position - positions[index].position) / h1);
+
+bool
+InterpolatedStateTrajectory::hasVelocities() const
+{
+    if (m_arrays.tsec)
+    {
+        return m_arrays.vx != NULL;
+    }
+    else
+    {
+        return !m_states.empty();
     }
 }
 
 
+// Compute the coefficients of the Newton form of the polynomial that
+// interpolates the values c at the nodes z. The coefficients replace the
+// values. When derivatives is not null, nodes come in pairs of equal values
+// and derivatives[k] is the derivative at the kth pair (Hermite interpolation.)
+static void
+dividedDifferences(const double* z, Vector3d* c, unsigned int n, const Vector3d* derivatives)
+{
+    for (unsigned int j = 1; j < n; ++j)
+    {
+        for (unsigned int i = n - 1; i >= j; --i)
+        {
+            if (derivatives && j == 1 && (i & 1) != 0)
+            {
+                c[i] = derivatives[i / 2];
+            }
+            else
+            {
+                c[i] = (c[i] - c[i - 1]) / (z[i] - z[i - j]);
+            }
+        }
+    }
+}
+
+
+// Evaluate a polynomial in Newton form and its derivative at zero.
+static void
+evaluateNewtonForm(const double* z, const Vector3d* c, unsigned int n, Vector3d* value, Vector3d* derivative)
+{
+    Vector3d p = c[n - 1];
+    Vector3d dp = Vector3d::Zero();
+    for (int j = int(n) - 2; j >= 0; --j)
+    {
+        dp = dp * -z[j] + p;
+        p = p * -z[j] + c[j];
+    }
+
+    *value = p;
+    *derivative = dp;
+}
+
+
 /** Calculate the state vector at the specified time (seconds since J2000 TDB).
   *
   * The input time is clamped to so that it lies within the range between
@@ -166,70 +298,114 @@ estimateVelocity(const InterpolatedStateTrajectory::TimePositionList& positions,
 StateVector
 InterpolatedStateTrajectory::state(double tdbSec) const
 {
-    if (!m_states.empty())
+    if (m_times.count() == 0)
     {
-        // Use state vector table
-        TimeState ts;
-        ts.tsec = tdbSec;
-        TimeStateList::const_iterator iter = lower_bound(m_states.begin(), m_states.end(), ts, TimeStateOrdering());
-
-        if (iter == m_states.begin())
-        {
-            return m_states.front().state;
-        }
-        else if (iter == m_states.end())
+        return StateVector(Vector3d::Zero(), Vector3d::Zero());
+    }
+    else if (tdbSec <= m_times[0])
+    {
+        return StateVector(recordPosition(0), recordVelocity(0));
+    }
+    else if (tdbSec >= m_times[m_times.count() - 1])
+    {
+        unsigned int lastIndex = m_times.count() - 1;
+        return StateVector(recordPosition(lastIndex), recordVelocity(lastIndex));
+    }
+    else
+    {
+        unsigned int i = m_times.findInterval(tdbSec);
+        if (m_interpolation != CubicHermite)
         {
-            return m_states.back().state;
+            return interpolateWindow(tdbSec, i);
         }
-        else
-        {
-            TimeState s0 = *(iter - 1);
-            TimeState s1 = *iter;
-            double h = s1.tsec - s0.tsec;
-            double t = (tdbSec - s0.tsec) / h;
 
+        double h = m_times[i + 1] - m_times[i];
+        double t = (tdbSec - m_times[i]) / h;
 
-            StateVector s = cubicHermitInterpolate(s0.state.position(), s0.state.velocity() * h,
-                                                   s1.state.position(), s1.state.velocity() * h,
-                                                   t);
-            return StateVector(s.position(), s.velocity() / h);
-        }
+        StateVector s = cubicHermitInterpolate(recordPosition(i), recordVelocity(i) * h,
+                                               recordPosition(i + 1), recordVelocity(i + 1) * h,
+                                               t);
+        return StateVector(s.position(), s.velocity() / h);
+    }
+}
+
+
+// Interpolate with a Lagrange or Hermite polynomial through a window of
+// records centered on the interval containing the time. Two records with the
+// same time mark a boundary between segments (e.g. before and after a
+// maneuver), and the window never extends across one.
+StateVector
+InterpolatedStateTrajectory::interpolateWindow(double tdbSec, unsigned int interval) const
+{
+    const unsigned int MaxWindowSize = MaxInterpolationOrder + 1;
+
+    // Find the records of the segment that lie within a window's width of
+    // the interval.
+    unsigned int segmentStart = interval;
+    while (segmentStart > 0 && interval - segmentStart + 2 < m_windowSize && m_times[segmentStart - 1] < m_times[segmentStart])
+    {
+        --segmentStart;
     }
-    else if (!m_positions.empty())
+
+    unsigned int segmentEnd = interval + 1;
+    while (segmentEnd < m_times.count() - 1 && segmentEnd - interval + 1 < m_windowSize && m_times[segmentEnd] < m_times[segmentEnd + 1])
     {
-        // Use position table
+        ++segmentEnd;
+    }
+
+    unsigned int windowSize = min(m_windowSize, segmentEnd - segmentStart + 1);
+    unsigned int first = interval + 1 >= segmentStart + windowSize / 2 ? interval + 1 - windowSize / 2 : segmentStart;
+    first = min(first, segmentEnd + 1 - windowSize);
 
-        TimePosition ts;
-        ts.tsec = tdbSec;
-        TimePositionList::const_iterator iter = lower_bound(m_positions.begin(), m_positions.end(), ts, TimePositionOrdering());
+    // Node times are measured from the interpolation time in units of the
+    // interval length, which keeps the divided differences well scaled.
+    double h = m_times[interval + 1] - m_times[interval];
 
-        if (iter == m_positions.begin())
+    double z[2 * MaxWindowSize];
+    Vector3d c[2 * MaxWindowSize];
+    Vector3d position;
+    Vector3d velocity;
+
+    if (m_interpolation == Hermite)
+    {
+        Vector3d derivatives[MaxWindowSize];
+        for (unsigned int k = 0; k < windowSize; ++k)
         {
-            Vector3d velocity = estimateVelocity(m_positions, 0);
-            return StateVector(m_positions.front().position, velocity);
+            z[2 * k] = z[2 * k + 1] = (m_times[first + k] - tdbSec) / h;
+            c[2 * k] = c[2 * k + 1] = recordPosition(first + k);
+            derivatives[k] = recordVelocity(first + k) * h;
         }
-        else if (iter == m_positions.end())
+
+        dividedDifferences(z, c, 2 * windowSize, derivatives);
+        evaluateNewtonForm(z, c, 2 * windowSize, &position, &velocity);
+        velocity /= h;
+    }
+    else
+    {
+        for (unsigned int k = 0; k < windowSize; ++k)
         {
-            Vector3d velocity = estimateVelocity(m_positions, m_positions.size() - 1);
-            return StateVector(m_positions.back().position, velocity);
+            z[k] = (m_times[first + k] - tdbSec) / h;
+            c[k] = recordPosition(first + k);
         }
-        else
+
+        dividedDifferences(z, c, windowSize, NULL);
+        evaluateNewtonForm(z, c, windowSize, &position, &velocity);
+        velocity /= h;
+
+        if (hasVelocities())
         {
-            TimePosition s0 = *(iter - 1);
-            TimePosition s1 = *iter;
-            Vector3d v0 = estimateVelocity(m_positions, iter - m_positions.begin() - 1);
-            Vector3d v1 = estimateVelocity(m_positions, iter - m_positions.begin());
-            double h = s1.tsec - s0.tsec;
-            double t = (tdbSec - s0.tsec) / h;
-
-            StateVector s = cubicHermitInterpolate(s0.position, v0 * h, s1.position, v1 * h, t);
-            return StateVector(s.position(), s.velocity() / h);
+            for (unsigned int k = 0; k < windowSize; ++k)
+            {
+                c[k] = recordVelocity(first + k);
+            }
+
+            Vector3d acceleration;
+            dividedDifferences(z, c, windowSize, NULL);
+            evaluateNewtonForm(z, c, windowSize, &velocity, &acceleration);
         }
     }
-    else
-    {
-        return StateVector(Vector3d::Zero(), Vector3d::Zero());
-    }
+
+    return StateVector(position, velocity);
 }
 
 
@@ -261,43 +437,57 @@ InterpolatedStateTrajectory::setPeriod(double period)
 }
 
 
-unsigned int
-InterpolatedStateTrajectory::stateCount() const
+/** Set the interpolation method and the degree of the interpolating
+  * polynomials. The order is ignored for cubic Hermite interpolation, and
+  * rounded up to an odd number for Hermite interpolation. Orders higher
+  * than MaxInterpolationOrder are reduced to it.
+  */
+void
+InterpolatedStateTrajectory::setInterpolation(InterpolationMethod method, unsigned int order)
 {
-    if (!m_states.empty())
+    if (order > MaxInterpolationOrder)
     {
-        return m_states.size();
+        order = MaxInterpolationOrder;
     }
-    else
+    order = max(1u, order);
+
+    m_interpolation = method;
+    switch (method)
     {
-        return m_positions.size();
+    case Lagrange:
+        m_interpolationOrder = order;
+        m_windowSize = order + 1;
+        break;
+
+    case Hermite:
+        m_interpolationOrder = max(3u, order | 1u);
+        m_windowSize = (m_interpolationOrder + 1) / 2;
+        break;
+
+    default:
+        m_interpolationOrder = 3;
+        m_windowSize = 2;
+        break;
     }
 }
 
 
+unsigned int
+InterpolatedStateTrajectory::stateCount() const
+{
+    return m_times.count();
+}
+
+
 double
 InterpolatedStateTrajectory::time(unsigned int index) const
 {
-    if (!m_states.empty())
+    if (index < m_times.count())
     {
-        if (index < m_states.size())
-        {
-            return m_states[index].tsec;
-        }
-        else
-        {
-            return 0.0;
-        }
+        return m_times[index];
     }
     else
     {
-        if (index < m_positions.size())
-        {
-            return m_positions[index].tsec;
-        }
-        else
-        {
-            return 0.0;
-        }
+        return 0.0;
     }
 }
@@ -18,6 +18,7 @@
 #define _INTERPOLATED_STATE_TRAJECTORY_H_
 
 #include <vesta/Trajectory.h>
+#include "SampledTimeIndex.h"
 #include <Eigen/StdVector>
 #include <vector>
 
@@ -27,17 +28,45 @@
   * pairs with estimated velocities. Because the records are time-tagged,
   * they need not be evenly spaced in time.
   *
-  * Currently, the interpolation method is always cubic Hermite.
+  * By default, cubic Hermite interpolation is used between adjacent
+  * records. Higher order interpolation over a sliding window of records
+  * (as in SPICE SPK types 9 and 13) may be selected with setInterpolation():
+  *
+  * Lagrange - a polynomial of the given degree through degree + 1 records.
+  *   Positions and velocities are interpolated separately; when the
+  *   records have no velocities, velocity is the derivative of the
+  *   interpolated position.
+  * Hermite - a polynomial of the given (odd) degree that matches the
+  *   positions and velocities of (degree + 1) / 2 records.
+  *
+  * For smooth trajectories, high order interpolation gives the same accuracy
+  * as cubic interpolation with a much sparser table; the decimation tool in
+  * tools/xyzv finds the sparsest table that meets a tolerance.
   *
   * Note that providing velocities greatly improves the accuracy of the
   * interpolated approximation with respect to the original trajectory. When
-  * available, velocities should be given; if memory is constrained, it is
-  * better accuracy can be achieved by reducing the number of records by
-  * half rather than using postions instead of state vectors.
+  * available, velocities should be given; if memory is constrained, better
+  * accuracy can be achieved by reducing the number of records by half
+  * rather than using positions instead of state vectors.
+  *
+  * The records may also be stored outside the trajectory as separate arrays
+  * of times, positions, and (optionally) velocities; this is used to refer to
+  * records in a memory mapped file without copying them.
+  *
+  * Each thread remembers the last interval in which it found a time, so that
+  * the usual sequence of increasing times can be evaluated without searching
+  * the table.
   */
 class InterpolatedStateTrajectory : public vesta::Trajectory
 {
 public:
+    enum InterpolationMethod
+    {
+        CubicHermite,
+        Lagrange,
+        Hermite,
+    };
+
     struct TimeState
     {
         EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
@@ -53,8 +82,40 @@ public:
     };
     typedef std::vector<TimePosition> TimePositionList;
 
+    /** Records stored as separate arrays of times (seconds since J2000 TDB),
+      * position components (km), and velocity components (km/s). The velocity
+      * arrays may be null, in which case velocities are estimated from the
+      * positions. An optional coarse index gives the time of every
+      * indexStride-th record and is used to narrow the search for a time
+      * in very long tables.
+      */
+    struct StateArrays
+    {
+        StateArrays() :
+            count(0),
+            tsec(NULL),
+            x(NULL), y(NULL), z(NULL),
+            vx(NULL), vy(NULL), vz(NULL),
+            index(NULL), indexStride(0), indexCount(0)
+        {
+        }
+
+        unsigned int count;
+        const double* tsec;
+        const double* x;
+        const double* y;
+        const double* z;
+        const double* vx;
+        const double* vy;
+        const double* vz;
+        const double* index;
+        unsigned int indexStride;
+        unsigned int indexCount;
+    };
+
     InterpolatedStateTrajectory(const TimeStateList& states);
     InterpolatedStateTrajectory(const TimePositionList& positions);
+    InterpolatedStateTrajectory(const StateArrays& arrays, vesta::Object* storage, double boundingRadius);
     ~InterpolatedStateTrajectory();
 
     virtual vesta::StateVector state(double tdbSec) const;
@@ -67,11 +128,47 @@ public:
     unsigned int stateCount() const;
     double time(unsigned int index) const;
 
+    /** Get the interpolation method.
+      */
+    InterpolationMethod interpolation() const
+    {
+        return m_interpolation;
+    }
+
+    /** Get the degree of the interpolating polynomials.
+      */
+    unsigned int interpolationOrder() const
+    {
+        return m_interpolationOrder;
+    }
+
+    void setInterpolation(InterpolationMethod method, unsigned int order);
+
+    static const unsigned int MaxInterpolationOrder = 31;
+
+private:
+    Eigen::Vector3d recordPosition(unsigned int index) const;
+    Eigen::Vector3d recordVelocity(unsigned int index) const;
+    Eigen::Vector3d estimateVelocity(unsigned int index) const;
+    bool hasVelocities() const;
+    vesta::StateVector interpolateWindow(double tdbSec, unsigned int interval) const;
+
 private:
     double m_period;
     double m_boundingRadius;
+    InterpolationMethod m_interpolation;
+    unsigned int m_interpolationOrder;
+    unsigned int m_windowSize;
     TimeStateList m_states;
     TimePositionList m_positions;
+
+    // Externally stored records and the object that owns them
+    StateArrays m_arrays;
+    vesta::counted_ptr<vesta::Object> m_storage;
+
+    // Record times, either from m_arrays or copied from the record lists so
+    // that searching is the same for all storage types.
+    SampledTimeIndex m_times;
 };
 
 #endif // _INTERPOLATED_STATE_TRAJECTORY_H_
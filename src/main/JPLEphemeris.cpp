@@ -15,17 +15,21 @@
 // limitations under the License.
 
 #include "JPLEphemeris.h"
+#include "MappedChebyshevGranules.h"
+#include "SharedEphemerisCache.h"
 #include <vesta/Units.h>
-#include <QDataStream>
-#include <QFile>
+#include <QIODevice>
 #include <QDebug>
+#include <algorithm>
+#include <cstring>
 
 using namespace vesta;
 using namespace std;
 
 
 JPLEphemeris::JPLEphemeris() :
-    m_earthMoonMassRatio(0.0)
+    m_earthMoonMassRatio(0.0),
+    m_ephemerisNumber(0)
 {
 }
 
@@ -59,6 +63,22 @@ JPLEphemeris::setTrajectory(JplObjectId id, ChebyshevPolyTrajectory* trajectory)
 }
 
 
+// Layout of the header record shared by all binary JPL DE ephemerides
+static const unsigned int JplEph_LabelSize              =   84;
+static const unsigned int JplEph_ConstantCount          =  400;
+static const unsigned int JplEph_ConstantNameLength     =    6;
+static const unsigned int JplEph_ObjectCount            =   12; // Sun, Moon, planets (incl. Pluto), Earth-Moon bary., nutations
+static const unsigned int JplEph_TimeSpanOffset         = JplEph_LabelSize * 3 + JplEph_ConstantCount * JplEph_ConstantNameLength;
+static const unsigned int JplEph_ConstantCountOffset    = JplEph_TimeSpanOffset + 3 * 8;
+static const unsigned int JplEph_AuOffset               = JplEph_ConstantCountOffset + 4;
+static const unsigned int JplEph_EmratOffset            = JplEph_AuOffset + 8;
+static const unsigned int JplEph_CoeffInfoOffset        = JplEph_EmratOffset + 8;
+static const unsigned int JplEph_EphemNumberOffset      = JplEph_CoeffInfoOffset + JplEph_ObjectCount * 3 * 4;
+static const unsigned int JplEph_LibrationInfoOffset    = JplEph_EphemNumberOffset + 4;
+static const unsigned int JplEph_ExtraConstantsOffset   = JplEph_LibrationInfoOffset + 3 * 4;
+static const unsigned int JplEph_NutationIndex          =   11;
+
+
 struct JplEphCoeffInfo
 {
     quint32 offset;
@@ -67,133 +87,281 @@ struct JplEphCoeffInfo
 };
 
 
-JPLEphemeris*
-JPLEphemeris::load(const string& filename)
+// Helper class for reading values from the header of a mapped ephemeris file
+// in either byte order.
+class JplHeaderReader
 {
-    const int JplEph_LabelSize                      =   84;
-    const unsigned int JplEph_ConstantCount         =  400;
-    const unsigned int JplEph_ConstantNameLength    =    6;
-    const unsigned int JplEph_ObjectCount           =   12; // Sun, Moon, planets (incl. Pluto), Earth-Moon bary.
+public:
+    JplHeaderReader(const MappedFile* file, bool swapBytes) :
+        m_file(file),
+        m_swapBytes(swapBytes)
+    {
+    }
 
-    const unsigned int DE406_RecordSize             =  728;
+    quint32 readUInt32(qint64 offset) const
+    {
+        quint32 x = 0;
+        if (m_file->contains(offset, sizeof(x)))
+        {
+            memcpy(&x, m_file->data() + offset, sizeof(x));
+        }
+        return m_swapBytes ? SwapBytes32(x) : x;
+    }
 
-    QFile ephemFile(filename.c_str());
-    if (!ephemFile.open(QIODevice::ReadOnly))
+    double readDouble(qint64 offset) const
     {
-        qDebug() << "Ephemeris file is missing!";
-        return NULL;
+        quint64 bits = 0;
+        if (m_file->contains(offset, sizeof(bits)))
+        {
+            memcpy(&bits, m_file->data() + offset, sizeof(bits));
+        }
+        if (m_swapBytes)
+        {
+            bits = SwapBytes64(bits);
+        }
+
+        double x = 0.0;
+        memcpy(&x, &bits, sizeof(x));
+        return x;
     }
 
-    QDataStream in(&ephemFile);
-    in.setByteOrder(QDataStream::BigEndian);
+    JplEphCoeffInfo readCoeffInfo(qint64 offset) const
+    {
+        JplEphCoeffInfo info;
+        info.offset = readUInt32(offset);
+        info.coeffCount = readUInt32(offset + 4);
+        info.granuleCount = readUInt32(offset + 8);
+        return info;
+    }
+
+private:
+    const MappedFile* m_file;
+    bool m_swapBytes;
+};
+
 
-    in.skipRawData(JplEph_LabelSize * 3);
-    if (in.status() != QDataStream::Ok)
+// Writes the coefficient records of an ephemeris file converted to the host
+// byte order.
+class JplSwappedRecordWriter : public SharedEphemerisCache::PayloadWriter
+{
+public:
+    JplSwappedRecordWriter(const MappedFile* file, qint64 offset, qint64 size) :
+        m_file(file),
+        m_offset(offset),
+        m_size(size)
     {
-        return NULL;
     }
 
-    // Skip past the constant names
-    in.skipRawData(JplEph_ConstantCount * JplEph_ConstantNameLength);
-    if (in.status() != QDataStream::Ok)
+    bool write(QIODevice* device) const
     {
+        const unsigned int blockDoubles = 8192;
+        quint64 block[blockDoubles];
+        const uchar* src = m_file->data() + m_offset;
+        qint64 doubleCount = m_size / sizeof(double);
+
+        for (qint64 i = 0; i < doubleCount; i += blockDoubles)
+        {
+            unsigned int n = (unsigned int) std::min(qint64(blockDoubles), doubleCount - i);
+            memcpy(block, src + i * sizeof(double), n * sizeof(double));
+            for (unsigned int j = 0; j < n; ++j)
+            {
+                block[j] = SwapBytes64(block[j]);
+            }
+
+            qint64 blockBytes = n * sizeof(double);
+            if (device->write(reinterpret_cast<const char*>(block), blockBytes) != blockBytes)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+private:
+    const MappedFile* m_file;
+    qint64 m_offset;
+    qint64 m_size;
+};
+
+
+// Radius of a sphere centered on the SSB that will contain each object over
+// any time span covered by the DE ephemerides (geocentric for the Moon). The
+// values are aphelion distances with a generous margin. They are used instead
+// of computing the bounding radius from the coefficients, which would require
+// reading every record in the file.
+static double
+objectBoundingRadius(unsigned int objectIndex, double kmPerAu)
+{
+    const double boundingRadii[] =
+    {
+        0.5, 0.75, 1.05, 1.7, 5.6, 10.4, 20.5, 31.0, 50.0,
+        410000.0, // Moon (km)
+        0.03,     // Sun
+    };
+
+    if (objectIndex == JPLEphemeris::Moon)
+    {
+        return boundingRadii[objectIndex] * 1.1;
+    }
+    else
+    {
+        return boundingRadii[objectIndex] * kmPerAu * 1.1;
+    }
+}
+
+
+/** Load a binary JPL DE ephemeris file. Any of the DE ephemerides in the
+  * standard binary format (e.g. DE405, DE406, DE421, DE430, DE440) may be
+  * used, stored in either little or big endian byte order.
+  *
+  * The file is memory mapped rather than read; coefficients are only read
+  * (and converted to the host byte order if necessary) for the records that
+  * are actually used. The cost of loading is thus independent of the time
+  * span covered by the ephemeris.
+  *
+  * Files in the opposite of the host byte order (e.g. the big endian DE406
+  * file distributed with Cosmographia on x86 hosts) would otherwise be byte
+  * swapped privately by every process. When the SharedEphemerisCache is
+  * enabled, the coefficient records are converted once and published to the
+  * cache, and all processes use the converted copy in place.
+  */
+JPLEphemeris*
+JPLEphemeris::load(const string& filename)
+{
+    counted_ptr<MappedFile> ephemFile(MappedFile::Open(filename.c_str()));
+    if (ephemFile.isNull())
+    {
+        qDebug() << "Ephemeris file is missing!";
         return NULL;
     }
 
-    double startJd = 0.0;
-    double endJd = 0.0;
-    double daysPerRecord = 0.0;
-    in >> startJd;
-    in >> endJd;
-    in >> daysPerRecord;
-    if (in.status() != QDataStream::Ok)
+    if (!ephemFile->contains(0, JplEph_ExtraConstantsOffset))
     {
+        qDebug() << "Ephemeris file is truncated.";
         return NULL;
     }
 
-    // Skip number of constants with values
-    in.skipRawData(sizeof(quint32));
+    // Detect the byte order of the file from the ephemeris number: it's a
+    // small integer, so only one of the two interpretations is plausible.
+    bool swapBytes = false;
+    quint32 ephemNumber = JplHeaderReader(ephemFile.ptr(), false).readUInt32(JplEph_EphemNumberOffset);
+    if (ephemNumber == 0 || ephemNumber > 0xffff)
+    {
+        swapBytes = true;
+        ephemNumber = SwapBytes32(ephemNumber);
+        if (ephemNumber == 0 || ephemNumber > 0xffff)
+        {
+            qDebug() << "File" << filename.c_str() << "is not a JPL DE ephemeris.";
+            return NULL;
+        }
+    }
+
+    JplHeaderReader header(ephemFile.ptr(), swapBytes);
 
-    double kmPerAu = 0.0;
-    in >> kmPerAu;
-    double earthMoonMassRatio = 0.0;
-    in >> earthMoonMassRatio;
+    double startJd = header.readDouble(JplEph_TimeSpanOffset);
+    double endJd = header.readDouble(JplEph_TimeSpanOffset + 8);
+    double daysPerRecord = header.readDouble(JplEph_TimeSpanOffset + 16);
+    quint32 constantCount = header.readUInt32(JplEph_ConstantCountOffset);
+    double kmPerAu = header.readDouble(JplEph_AuOffset);
+    double earthMoonMassRatio = header.readDouble(JplEph_EmratOffset);
+
+    if (!(daysPerRecord > 0.0) || !(endJd > startJd))
+    {
+        qDebug() << "Bad time span in JPL ephemeris DE" << ephemNumber;
+        return NULL;
+    }
 
     JplEphCoeffInfo coeffInfo[JplEph_ObjectCount];
     for (unsigned int objectIndex = 0; objectIndex < JplEph_ObjectCount; ++objectIndex)
     {
-        in >> coeffInfo[objectIndex].offset;
-        in >> coeffInfo[objectIndex].coeffCount;
-        in >> coeffInfo[objectIndex].granuleCount;
+        coeffInfo[objectIndex] = header.readCoeffInfo(JplEph_CoeffInfoOffset + objectIndex * 12);
+    }
 
-        if (in.status() != QDataStream::Ok)
+    // Additional items appear in the header after the ephemeris number: librations,
+    // then in DE430 and later (following the names of any constants beyond the
+    // first 400) lunar mantle angular velocity and TT-TDB. These aren't used, but
+    // they're required to compute the record size. The rest of the header record
+    // isn't necessarily zero filled in older ephemerides.
+    JplEphCoeffInfo libration = header.readCoeffInfo(JplEph_LibrationInfoOffset);
+    JplEphCoeffInfo mantleVelocity = { 0, 0, 0 };
+    JplEphCoeffInfo ttMinusTdb = { 0, 0, 0 };
+    if (ephemNumber >= 430)
+    {
+        qint64 extraInfoOffset = JplEph_ExtraConstantsOffset;
+        if (constantCount > JplEph_ConstantCount)
         {
-            return NULL;
+            extraInfoOffset += (constantCount - JplEph_ConstantCount) * JplEph_ConstantNameLength;
         }
+        mantleVelocity = header.readCoeffInfo(extraInfoOffset);
+        ttMinusTdb = header.readCoeffInfo(extraInfoOffset + 12);
+    }
 
-        // Convert to a zero-based offset
-        coeffInfo[objectIndex].offset--;
+    // Each record contains the start and end Julian dates followed by the coefficients
+    // for all items.
+    qint64 recordDoubles = 2;
+    for (unsigned int objectIndex = 0; objectIndex < JplEph_ObjectCount; ++objectIndex)
+    {
+        unsigned int components = objectIndex == JplEph_NutationIndex ? 2 : 3;
+        recordDoubles += qint64(coeffInfo[objectIndex].coeffCount) * coeffInfo[objectIndex].granuleCount * components;
     }
+    recordDoubles += qint64(libration.coeffCount) * libration.granuleCount * 3;
+    recordDoubles += qint64(mantleVelocity.coeffCount) * mantleVelocity.granuleCount * 3;
+    recordDoubles += qint64(ttMinusTdb.coeffCount) * ttMinusTdb.granuleCount * 1;
 
-    qint32 ephemNumber = 0;
-    in >> ephemNumber;
-    if (ephemNumber != 406)
+    qint64 recordSize = recordDoubles * sizeof(double);
+    if (recordSize < JplEph_ExtraConstantsOffset)
     {
+        qDebug() << "Invalid record size in JPL ephemeris DE" << ephemNumber;
         return NULL;
     }
 
-    // Skip libration information (offset, coeff. count, granule count)
-    in.skipRawData(sizeof(quint32) * 3);
-    if (in.status() != QDataStream::Ok)
+    // The first two records contain the header and the values of constants; the
+    // rest contain coefficients. Don't trust the time span in the header if the
+    // file is shorter than expected.
+    unsigned int recordCount = (unsigned int) ((endJd - startJd) / daysPerRecord + 0.5);
+    qint64 recordsInFile = ephemFile->size() / recordSize - 2;
+    if (recordsInFile < 1)
     {
+        qDebug() << "JPL ephemeris DE" << ephemNumber << "contains no records.";
         return NULL;
     }
+    recordCount = (unsigned int) std::min(qint64(recordCount), recordsInFile);
 
-    // Skip the rest of the record
-    in.skipRawData(DE406_RecordSize * 8 - 2856);
-    // Skip the constants
-    in.skipRawData(DE406_RecordSize * 8);
-    if (in.status() != QDataStream::Ok)
+    // Verify the record size by checking that the first coefficient record begins at
+    // the start time of the ephemeris.
+    qint64 firstRecordOffset = recordSize * 2;
+    if (header.readDouble(firstRecordOffset) != startJd)
     {
+        qDebug() << "Unrecognized record layout in JPL ephemeris DE" << ephemNumber;
         return NULL;
     }
 
-    unsigned int recordCount = (unsigned int) ((endJd - startJd) / daysPerRecord);
-
-    vector<double> objectCoeffs[JplEph_ObjectCount];
-
-    for (unsigned int i = 0; i < recordCount; ++i)
+    // Use coefficients converted to the host byte order from the shared cache
+    // when possible.
+    counted_ptr<MappedFile> coeffFile = ephemFile;
+    qint64 coeffRecordOffset = firstRecordOffset;
+    if (swapBytes && SharedEphemerisCache::IsEnabled())
     {
-        double startTime = 0.0;
-        double endTime = 0.0;
-        in >> startTime >> endTime;
-
-        for (unsigned int objectIndex = 0; objectIndex < JplEph_ObjectCount; ++objectIndex)
+        const QString cacheKind = "jplde";
+        qint64 recordBytes = qint64(recordCount) * recordSize;
+        counted_ptr<MappedFile> hostOrderFile(SharedEphemerisCache::Open(filename.c_str(), cacheKind));
+        if (hostOrderFile.isNull())
         {
-            unsigned int coeffCount = coeffInfo[objectIndex].coeffCount * coeffInfo[objectIndex].granuleCount;
-            if (coeffCount != 0)
-            {
-                for (unsigned int j = 0; j < coeffCount; ++j)
-                {
-                    double x = 0.0;
-                    double y = 0.0;
-                    double z = 0.0;
-                    in >> x >> y >> z;
-                    objectCoeffs[objectIndex].push_back(x);
-                    objectCoeffs[objectIndex].push_back(y);
-                    objectCoeffs[objectIndex].push_back(z);
-                }
-            }
+            hostOrderFile = SharedEphemerisCache::Publish(filename.c_str(), cacheKind, recordBytes,
+                                                          JplSwappedRecordWriter(ephemFile.ptr(), firstRecordOffset, recordBytes));
         }
 
-        // Make sure that we read this record successfully
-        if (in.status() != QDataStream::Ok)
+        if (hostOrderFile.isValid() && hostOrderFile->size() == SharedEphemerisCache::PayloadOffset + recordBytes)
         {
-            return NULL;
+            coeffFile = hostOrderFile;
+            coeffRecordOffset = SharedEphemerisCache::PayloadOffset;
+            swapBytes = false;
         }
     }
 
     JPLEphemeris* eph = new JPLEphemeris;
+    eph->m_fileName = filename;
     double startSec = daysToSeconds(startJd - vesta::J2000);
     double secsPerRecord = daysToSeconds(daysPerRecord);
 
@@ -205,20 +373,46 @@ JPLEphemeris::load(const string& filename)
         27.32158 / 365.25 // Earth, about Earth-Moon barycenter
     };
 
-    for (unsigned int objectIndex = 0; objectIndex < JplEph_ObjectCount - 1; ++objectIndex)
+    // Nutations are the last item in the coefficient records; we don't create a
+    // trajectory for them.
+    for (unsigned int objectIndex = 0; objectIndex < JplEph_NutationIndex; ++objectIndex)
     {
+        const JplEphCoeffInfo& info = coeffInfo[objectIndex];
+        if (info.coeffCount == 0 || info.granuleCount == 0 || info.coeffCount - 1 > ChebyshevPolyTrajectory::MaxChebyshevDegree)
+        {
+            qDebug() << "Bad coefficient information for object" << objectIndex << "in JPL ephemeris DE" << ephemNumber;
+            continue;
+        }
+
+        // Offsets in the file are one-based, counted in doubles from the start of the record
+        qint64 firstGranuleOffset = coeffRecordOffset + qint64(info.offset - 1) * sizeof(double);
+        counted_ptr<MappedChebyshevGranules> granules(new MappedChebyshevGranules(coeffFile.ptr(),
+                                                                                  firstGranuleOffset,
+                                                                                  (unsigned int) recordSize,
+                                                                                  info.granuleCount,
+                                                                                  info.coeffCount - 1,
+                                                                                  info.granuleCount * recordCount,
+                                                                                  swapBytes));
+        if (!granules->isValid())
+        {
+            qDebug() << "Coefficients for object" << objectIndex << "lie outside JPL ephemeris file DE" << ephemNumber;
+            continue;
+        }
+
         ChebyshevPolyTrajectory* trajectory =
-                new ChebyshevPolyTrajectory(&objectCoeffs[objectIndex][0],
-                                            coeffInfo[objectIndex].coeffCount - 1,
-                                            coeffInfo[objectIndex].granuleCount * recordCount,
+                new ChebyshevPolyTrajectory(granules.ptr(),
+                                            info.coeffCount - 1,
+                                            info.granuleCount * recordCount,
                                             startSec,
-                                            secsPerRecord / coeffInfo[objectIndex].granuleCount);
+                                            secsPerRecord / info.granuleCount,
+                                            objectBoundingRadius(objectIndex, kmPerAu));
         trajectory->setPeriod(daysToSeconds(orbitalPeriods[objectIndex] * 365.25));
         eph->setTrajectory(JplObjectId(objectIndex), trajectory);
     }
 
     // Set constants
     eph->m_earthMoonMassRatio = earthMoonMassRatio;
+    eph->m_ephemerisNumber = ephemNumber;
 
     return eph;
 }
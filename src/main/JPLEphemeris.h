@@ -54,9 +54,25 @@ public:
         return m_earthMoonMassRatio;
     }
 
+    /** Get the JPL DE number of the ephemeris, e.g. 406 for DE406.
+      */
+    unsigned int ephemerisNumber() const
+    {
+        return m_ephemerisNumber;
+    }
+
+    /** Get the name of the file from which the ephemeris was loaded.
+      */
+    const std::string& fileName() const
+    {
+        return m_fileName;
+    }
+
 private:
     vesta::counted_ptr<ChebyshevPolyTrajectory> m_trajectories[int(ObjectCount)];
     double m_earthMoonMassRatio;
+    unsigned int m_ephemerisNumber;
+    std::string m_fileName;
 };
 
 #endif // _JPL_EPHEMERIS_H_
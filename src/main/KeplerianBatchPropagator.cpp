@@ -0,0 +1,292 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "KeplerianBatchPropagator.h"
+#include "astro/OsculatingElements.h"
+#include <vesta/Units.h>
+#include <Eigen/Geometry>
+#include <QtConcurrentRun>
+#include <QThread>
+#include <algorithm>
+#include <cmath>
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+// Number of objects processed together. Intermediate results for a block are
+// kept in small arrays so that the compiler can vectorize the inner loops.
+static const unsigned int EvaluationBlockSize = 64;
+
+// Don't bother splitting the evaluation into tasks smaller than this
+static const unsigned int MinObjectsPerTask = 8192;
+
+
+// Compute the sine and cosine of a single precision value. Accuracy is
+// comparable to the standard library sinf and cosf for arguments of modest
+// magnitude (a few multiples of pi, as needed for anomalies.) There are no
+// branches, so loops calling this function can be vectorized.
+static inline void
+sinCos(float x, float& s, float& c)
+{
+    const float TwoOverPi = 0.636619772367581343f;
+    const float PiOver2a = 1.5703125f;
+    const float PiOver2b = 4.837512969970703125e-4f;
+    const float PiOver2c = 7.54978995489188216e-8f;
+    const float RoundingConstant = 12582912.0f; // 1.5 * 2^23
+
+    // Reduce to [-pi/4, pi/4] and find the quadrant
+    float fq = (x * TwoOverPi + RoundingConstant) - RoundingConstant;
+    int q = int(fq);
+    float r = ((x - fq * PiOver2a) - fq * PiOver2b) - fq * PiOver2c;
+    float r2 = r * r;
+
+    float sr = r + r * r2 * (-1.6666654611e-1f + r2 * (8.3321608736e-3f + r2 * -1.9515295891e-4f));
+    float cr = 1.0f - 0.5f * r2 + r2 * r2 * (4.166664568298827e-2f + r2 * (-1.388731625493765e-3f + r2 * 2.443315711809948e-5f));
+
+    // Select and negate according to quadrant using arithmetic rather
+    // than conditionals.
+    float swap = float(q & 1);
+    s = (sr + swap * (cr - sr)) * float(1 - (q & 2));
+    c = (cr + swap * (sr - cr)) * float(1 - ((q + 1) & 2));
+}
+
+
+// Rotate a position in the orbital plane by the orbit orientation of k
+static inline void
+rotateToOrbit(const KeplerianBatchPropagator::KeplerianObject& k, float x, float y, float* p)
+{
+    p[0] = (1.0f - 2.0f * (k.qy * k.qy + k.qz * k.qz)) * x + 2.0f * (k.qx * k.qy - k.qw * k.qz) * y;
+    p[1] = 2.0f * (k.qx * k.qy + k.qw * k.qz) * x + (1.0f - 2.0f * (k.qx * k.qx + k.qz * k.qz)) * y;
+    p[2] = 2.0f * (k.qx * k.qz - k.qw * k.qy) * x + 2.0f * (k.qy * k.qz + k.qw * k.qx) * y;
+}
+
+
+KeplerianBatchPropagator::KeplerianBatchPropagator() :
+    m_epoch(vesta::J2000),
+    m_maxApoapsis(0.0f)
+{
+}
+
+
+KeplerianBatchPropagator::~KeplerianBatchPropagator()
+{
+}
+
+
+/** Create the compact representation of an object for the specified
+  * epoch. This doesn't depend on any propagator state, so it may be called
+  * from any thread.
+  */
+KeplerianBatchPropagator::KeplerianObject
+KeplerianBatchPropagator::makeObject(const OrbitalElements& elements, double discoveryTime, double epoch)
+{
+    Quaterniond orbitOrientation = OrbitalElements::orbitOrientation(elements.inclination,
+                                                                     elements.longitudeOfAscendingNode,
+                                                                     elements.argumentOfPeriapsis);
+    double semiMajorAxis = elements.periapsisDistance / (1.0 - elements.eccentricity);
+
+    // Change of epoch when computing mean anomaly
+    double meanAnomaly = elements.meanAnomalyAtEpoch + (epoch - elements.epoch) * elements.meanMotion;
+
+    KeplerianObject k;
+    k.sma = float(semiMajorAxis);
+    k.ecc = float(elements.eccentricity);
+    k.meanAnomaly = float(meanAnomaly);
+    k.meanMotion = float(elements.meanMotion);
+    k.qw = float(orbitOrientation.w());
+    k.qx = float(orbitOrientation.x());
+    k.qy = float(orbitOrientation.y());
+    k.qz = float(orbitOrientation.z());
+    k.discoveryDate = discoveryTime - epoch;
+
+    return k;
+}
+
+
+void
+KeplerianBatchPropagator::addObject(const OrbitalElements& elements, double discoveryTime)
+{
+    KeplerianObject k = makeObject(elements, discoveryTime, m_epoch);
+    addObjects(&k, 1);
+}
+
+
+/** Add objects that were created for the same epoch as this propagator's
+  * (see makeObject().)
+  */
+void
+KeplerianBatchPropagator::addObjects(const KeplerianObject* objects, unsigned int count)
+{
+    m_objects.insert(m_objects.end(), objects, objects + count);
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        m_maxApoapsis = max(m_maxApoapsis, objects[i].sma * (1.0f + objects[i].ecc));
+    }
+}
+
+
+/** Remove all objects.
+  */
+void
+KeplerianBatchPropagator::clear()
+{
+    m_maxApoapsis = 0.0f;
+    m_objects.clear();
+}
+
+
+// Evaluate objects begin through end - 1. Each block of objects is processed
+// in several passes over small arrays; the passes that solve Kepler's equation
+// have no branches or function calls, so that they can be vectorized.
+void
+KeplerianBatchPropagator::propagateRange(double t, unsigned int begin, unsigned int end, float* positions, unsigned int stride) const
+{
+    const double InvTwoPi = 1.0 / (2.0 * PI);
+
+    // A fixed number of iterations, as in the shader. Four Newton iterations
+    // reach single precision accuracy for e < 0.9. For nearly parabolic
+    // orbits, the error close to periapsis may be a few thousandths of the
+    // semimajor axis.
+    const unsigned int NewtonIterations = 4;
+
+    float M[EvaluationBlockSize];
+    float ecc[EvaluationBlockSize];
+    float E[EvaluationBlockSize];
+    float sinE[EvaluationBlockSize];
+    float cosE[EvaluationBlockSize];
+
+    double dt = t - m_epoch;
+
+    for (unsigned int blockStart = begin; blockStart < end; blockStart += EvaluationBlockSize)
+    {
+        unsigned int count = min(EvaluationBlockSize, end - blockStart);
+        const KeplerianObject* objects = &m_objects[blockStart];
+
+        // Mean anomaly is computed in double precision and reduced to
+        // [-pi, pi] before conversion to float.
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            double meanAnomaly = double(objects[i].meanAnomaly) + dt * double(objects[i].meanMotion);
+            meanAnomaly -= 2.0 * PI * floor(meanAnomaly * InvTwoPi + 0.5);
+            M[i] = float(meanAnomaly);
+            ecc[i] = objects[i].ecc;
+        }
+        for (unsigned int i = count; i < EvaluationBlockSize; ++i)
+        {
+            M[i] = 0.0f;
+            ecc[i] = 0.0f;
+        }
+
+        // Starting guess E = M + 0.85 * e * sign(sin M) (from Danby)
+        for (unsigned int i = 0; i < EvaluationBlockSize; ++i)
+        {
+            float sign = 2.0f * float(M[i] >= 0.0f) - 1.0f;
+            E[i] = M[i] + 0.85f * ecc[i] * sign;
+        }
+
+        for (unsigned int iter = 0; iter < NewtonIterations; ++iter)
+        {
+            for (unsigned int i = 0; i < EvaluationBlockSize; ++i)
+            {
+                float s, c;
+                sinCos(E[i], s, c);
+                E[i] = E[i] - (E[i] - ecc[i] * s - M[i]) / (1.0f - ecc[i] * c);
+            }
+        }
+
+        for (unsigned int i = 0; i < EvaluationBlockSize; ++i)
+        {
+            sinCos(E[i], sinE[i], cosE[i]);
+        }
+
+        // Position in the orbital plane, rotated by the orbit orientation
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            const KeplerianObject& k = objects[i];
+            float x = k.sma * (cosE[i] - k.ecc);
+            float y = k.sma * sqrt(1.0f - k.ecc * k.ecc) * sinE[i];
+            rotateToOrbit(k, x, y, positions + (blockStart + i) * stride);
+        }
+
+        // Hyperbolic orbits are rare, so rather than complicating the passes
+        // above, their (meaningless) results are overwritten here. The mean
+        // anomaly isn't periodic, so it is kept in double precision.
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            const KeplerianObject& k = objects[i];
+            if (k.ecc > 1.0f)
+            {
+                double H = HyperbolicAnomaly(k.ecc, double(k.meanAnomaly) + dt * double(k.meanMotion));
+                float x = k.sma * (float(cosh(H)) - k.ecc);
+                float y = -k.sma * sqrt(k.ecc * k.ecc - 1.0f) * float(sinh(H));
+                rotateToOrbit(k, x, y, positions + (blockStart + i) * stride);
+            }
+        }
+    }
+}
+
+
+void
+KeplerianBatchPropagator::propagateTask(const KeplerianBatchPropagator* propagator, const PositionBatch* batch, unsigned int task)
+{
+    unsigned int objectCount = propagator->m_objects.size();
+    propagator->propagateRange(batch->t,
+                               unsigned(quint64(objectCount) * task / batch->taskCount),
+                               unsigned(quint64(objectCount) * (task + 1) / batch->taskCount),
+                               batch->positions,
+                               batch->stride);
+}
+
+
+/** Compute the positions of all objects at time t (seconds since J2000 TDB.)
+  * Positions are in the same units as the orbital elements (usually km),
+  * and stored in the order that objects were added. Consecutive positions
+  * are stride floats apart, so positions may be written directly into
+  * vertex data with other attributes.
+  *
+  * Elliptical orbits are computed the same way as the KeplerianSwarm shader:
+  * positions are single precision, and Kepler's equation is solved with a
+  * fixed number of iterations.
+  */
+void
+KeplerianBatchPropagator::propagate(double t, float* positions, unsigned int stride) const
+{
+    unsigned int objectCount = m_objects.size();
+    if (objectCount == 0)
+    {
+        return;
+    }
+
+    PositionBatch batch;
+    batch.t = t;
+    batch.positions = positions;
+    batch.stride = stride;
+    batch.taskCount = max(1u, min(unsigned(max(1, QThread::idealThreadCount())), objectCount / MinObjectsPerTask));
+
+    // Run the first task on this thread and the rest in the thread pool
+    std::vector<QFuture<void> > futures;
+    for (unsigned int task = 1; task < batch.taskCount; ++task)
+    {
+        futures.push_back(QtConcurrent::run(&KeplerianBatchPropagator::propagateTask, this, (const PositionBatch*) &batch, task));
+    }
+    propagateTask(this, &batch, 0);
+    for (unsigned int i = 0; i < futures.size(); ++i)
+    {
+        futures[i].waitForFinished();
+    }
+}
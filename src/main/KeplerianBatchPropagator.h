@@ -0,0 +1,118 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _KEPLERIAN_BATCH_PROPAGATOR_H_
+#define _KEPLERIAN_BATCH_PROPAGATOR_H_
+
+#include <vesta/OrbitalElements.h>
+#include <vector>
+
+
+/** KeplerianBatchPropagator computes positions for a large number of
+  * objects on Keplerian orbits (e.g. all known asteroids) at a single time.
+  * It is the CPU counterpart of the KeplerianSwarm shader and has no
+  * graphics dependencies.
+  *
+  * Objects are stored in a compact single precision form relative to a
+  * common epoch. Elliptical orbits are evaluated in blocks with a fixed
+  * number of Newton iterations, like the shader; the rare hyperbolic orbits
+  * are solved separately to full precision. The work is divided among
+  * threads from the global thread pool.
+  */
+class KeplerianBatchPropagator
+{
+public:
+    KeplerianBatchPropagator();
+    ~KeplerianBatchPropagator();
+
+    /** Compact representation of an object. The mean anomaly and discovery
+      * date are relative to the epoch, and the orbit orientation is stored
+      * as a quaternion.
+      */
+    struct KeplerianObject
+    {
+        float sma;
+        float ecc;
+        float meanAnomaly;
+        float meanMotion;
+        float qw;
+        float qx;
+        float qy;
+        float qz;
+        float discoveryDate;
+    };
+
+    static KeplerianObject makeObject(const vesta::OrbitalElements& elements, double discoveryTime, double epoch);
+
+    void addObject(const vesta::OrbitalElements& elements, double discoveryTime);
+    void addObjects(const KeplerianObject* objects, unsigned int count);
+    void clear();
+
+    /** Get the objects in the order that they were added.
+      */
+    const std::vector<KeplerianObject>& objects() const
+    {
+        return m_objects;
+    }
+
+    unsigned int objectCount() const
+    {
+        return m_objects.size();
+    }
+
+    /** Get the epoch (seconds since J2000 TDB) that mean anomalies and
+      * discovery dates are relative to.
+      */
+    double epoch() const
+    {
+        return m_epoch;
+    }
+
+    void setEpoch(double epoch)
+    {
+        m_epoch = epoch;
+    }
+
+    /** Get the largest apoapsis distance of all elliptical orbits.
+      */
+    float maxApoapsis() const
+    {
+        return m_maxApoapsis;
+    }
+
+    void propagate(double t, float* positions, unsigned int stride = 3) const;
+
+private:
+    // Output for one parallel position computation; stride is the distance
+    // (in floats) between consecutive positions.
+    struct PositionBatch
+    {
+        double t;
+        float* positions;
+        unsigned int stride;
+        unsigned int taskCount;
+    };
+
+    void propagateRange(double t, unsigned int begin, unsigned int end, float* positions, unsigned int stride) const;
+    static void propagateTask(const KeplerianBatchPropagator* propagator, const PositionBatch* batch, unsigned int task);
+
+private:
+    std::vector<KeplerianObject> m_objects;
+    double m_epoch;
+    float m_maxApoapsis;
+};
+
+#endif // _KEPLERIAN_BATCH_PROPAGATOR_H_
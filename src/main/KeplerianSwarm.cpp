@@ -15,6 +15,7 @@
 // limitations under the License.
 
 #include "KeplerianSwarm.h"
+#include "SwarmPointRenderer.h"
 #include <vesta/RenderContext.h>
 #include <vesta/Material.h>
 #include <vesta/Units.h>
@@ -30,6 +31,10 @@ using namespace Eigen;
 using namespace std;
 
 
+// Period over which newly discovered objects fade from white to the swarm color
+static const float DiscoveryFadeTime = 86400.0f * 50.0f;
+
+
 // Keplerian swarm shader GLSL source
 //
 // The vertex layout uses the the standard attributes but assignes them
@@ -70,10 +75,26 @@ static const char* SwarmVertexShaderSource =
 "    vec4 q = vec4(vesta_Normal.z, vesta_TexCoord0.x, vesta_TexCoord0.y, vesta_Normal.y);\n"
 "\n"
 "    float M = M0 + time * nu;                                                \n"
-"    float E = M;                                                             \n"
-"    for (int i = 0; i < 4; i += 1)                                           \n"
-"        E = M + ecc * sin(E);                                                \n"
-"    vec3 position = vec3(sma * (cos(E) - ecc), sma * (sin(E) * sqrt(1.0 - ecc * ecc)), 0.0);\n"
+"    vec3 position;                                                           \n"
+"    if (ecc <= 1.0)                                                          \n"
+"    {                                                                        \n"
+"        float E = M;                                                         \n"
+"        for (int i = 0; i < 4; i += 1)                                       \n"
+"            E = M + ecc * sin(E);                                            \n"
+"        position = vec3(sma * (cos(E) - ecc), sma * (sin(E) * sqrt(1.0 - ecc * ecc)), 0.0);\n"
+"    }                                                                        \n"
+"    else                                                                     \n"
+"    {                                                                        \n"
+"        // Hyperbolic orbit: solve ecc * sinh(H) - H = M by Newton's method  \n"
+"        float H = sign(M) * log(2.0 * abs(M) / ecc + 1.8);                   \n"
+"        for (int i = 0; i < 8; i += 1)                                       \n"
+"        {                                                                    \n"
+"            float expH = exp(H);                                             \n"
+"            H = H - (ecc * 0.5 * (expH - 1.0 / expH) - H - M) / (ecc * 0.5 * (expH + 1.0 / expH) - 1.0);\n"
+"        }                                                                    \n"
+"        float expH = exp(H);                                                 \n"
+"        position = vec3(sma * (0.5 * (expH + 1.0 / expH) - ecc), -sma * sqrt(ecc * ecc - 1.0) * 0.5 * (expH - 1.0 / expH), 0.0);\n"
+"    }                                                                        \n"
 "\n"
 "    // Rotate by quaternion q                                                \n"
 "    vec3 a = cross(q.xyz, position) + q.w * position;                        \n"
@@ -117,10 +138,26 @@ static const char* SwarmVertexShaderSource =
 "    vec4 q = vec4(gl_Normal.z, gl_MultiTexCoord0.x, gl_MultiTexCoord0.y, gl_Normal.y);\n"
 "\n"
 "    float M = M0 + time * nu;                                                \n"
-"    float E = M;                                                             \n"
-"    for (int i = 0; i < 4; i += 1)                                           \n"
-"        E = M + ecc * sin(E);                                                \n"
-"    vec3 position = vec3(sma * (cos(E) - ecc), sma * (sin(E) * sqrt(1.0 - ecc * ecc)), 0.0);\n"
+"    vec3 position;                                                           \n"
+"    if (ecc <= 1.0)                                                          \n"
+"    {                                                                        \n"
+"        float E = M;                                                         \n"
+"        for (int i = 0; i < 4; i += 1)                                       \n"
+"            E = M + ecc * sin(E);                                            \n"
+"        position = vec3(sma * (cos(E) - ecc), sma * (sin(E) * sqrt(1.0 - ecc * ecc)), 0.0);\n"
+"    }                                                                        \n"
+"    else                                                                     \n"
+"    {                                                                        \n"
+"        // Hyperbolic orbit: solve ecc * sinh(H) - H = M by Newton's method  \n"
+"        float H = sign(M) * log(2.0 * abs(M) / ecc + 1.8);                   \n"
+"        for (int i = 0; i < 8; i += 1)                                       \n"
+"        {                                                                    \n"
+"            float expH = exp(H);                                             \n"
+"            H = H - (ecc * 0.5 * (expH - 1.0 / expH) - H - M) / (ecc * 0.5 * (expH + 1.0 / expH) - 1.0);\n"
+"        }                                                                    \n"
+"        float expH = exp(H);                                                 \n"
+"        position = vec3(sma * (0.5 * (expH + 1.0 / expH) - ecc), -sma * sqrt(ecc * ecc - 1.0) * 0.5 * (expH - 1.0 / expH), 0.0);\n"
+"    }                                                                        \n"
 "\n"
 "    // Rotate by quaternion q                                                \n"
 "    vec3 a = cross(q.xyz, position) + q.w * position;                        \n"
@@ -152,8 +189,6 @@ static const char* SwarmFragmentShaderSource =
 
 KeplerianSwarm::KeplerianSwarm() :
     m_vertexSpec(NULL),
-    m_epoch(vesta::J2000),
-    m_boundingRadius(0.0f),
     m_color(Spectrum(1.0f, 1.0f, 1.0f)),
     m_opacity(1.0f),
     m_pointSize(1.0f),
@@ -182,7 +217,8 @@ KeplerianSwarm::~KeplerianSwarm()
 void
 KeplerianSwarm::render(RenderContext& rc, double clock) const
 {
-    if (m_objects.empty())
+    const std::vector<KeplerianObject>& objects = m_propagator.objects();
+    if (objects.empty())
     {
         return;
     }
@@ -193,27 +229,19 @@ KeplerianSwarm::render(RenderContext& rc, double clock) const
         return;
     }
 
-    float fadeFactor = 1.0f;
-    if (m_fadeSize > 0.0f)
-    {
-        const float sizeFadeStart = m_fadeSize * 4;
-        const float sizeFadeEnd = m_fadeSize;
-        float pixelSize = boundingSphereRadius() / (rc.modelview().translation().norm() * rc.pixelSize());
-        if (pixelSize < sizeFadeStart)
-        {
-            fadeFactor = std::max(0.0f, (pixelSize - sizeFadeEnd) / (sizeFadeStart - sizeFadeEnd));
-        }
-    }
-    
+    float fadeFactor = SwarmPointRenderer::fadeFactor(rc, boundingSphereRadius(), m_fadeSize);
+
     if (fadeFactor < 0.001f)
     {
         // Total fade out
         return;
     }
     
-    if (m_vertexBuffer.isNull())
+    float effectiveOpacity = fadeFactor * m_opacity;
+
+    if (rc.shaderCapability() != RenderContext::FixedFunction && m_vertexBuffer.isNull())
     {
-        m_vertexBuffer = VertexBuffer::Create(m_objects.size() * sizeof(KeplerianObject), VertexBuffer::StaticDraw, &m_objects[0]);
+        m_vertexBuffer = VertexBuffer::Create(objects.size() * sizeof(KeplerianObject), VertexBuffer::StaticDraw, &objects[0]);
     }
 
     if (rc.shaderCapability() != RenderContext::FixedFunction && m_vertexBuffer.isValid())
@@ -234,47 +262,88 @@ KeplerianSwarm::render(RenderContext& rc, double clock) const
             }
 #endif
         }
+    }
 
-        if (m_swarmShader.isValid())
-        {
-            float effectiveOpacity = fadeFactor * m_opacity;
-            
-            rc.bindVertexBuffer(*m_vertexSpec, m_vertexBuffer.ptr(), sizeof(KeplerianObject));
-
-            Material material;
-            material.setOpacity(std::min(0.99f, effectiveOpacity));
-            rc.bindMaterial(&material);
-
-            rc.enableCustomShader(m_swarmShader.ptr());
-            m_swarmShader->bind();
-            m_swarmShader->setConstant("time", float(clock - m_epoch));
-            m_swarmShader->setConstant("pointSize", m_pointSize);
-            m_swarmShader->setConstant("color", Vector4f(m_color.red(), m_color.green(), m_color.blue(), effectiveOpacity));
+    if (rc.shaderCapability() != RenderContext::FixedFunction && m_vertexBuffer.isValid() && m_swarmShader.isValid())
+    {
+        rc.bindVertexBuffer(*m_vertexSpec, m_vertexBuffer.ptr(), sizeof(KeplerianObject));
+
+        Material material;
+        material.setOpacity(std::min(0.99f, effectiveOpacity));
+        rc.bindMaterial(&material);
+
+        rc.enableCustomShader(m_swarmShader.ptr());
+        m_swarmShader->bind();
+        m_swarmShader->setConstant("time", float(clock - epoch()));
+        m_swarmShader->setConstant("pointSize", m_pointSize);
+        m_swarmShader->setConstant("color", Vector4f(m_color.red(), m_color.green(), m_color.blue(), effectiveOpacity));
 #ifdef VESTA_OGLES2
-            m_swarmShader->setConstant("vesta_ModelViewProjectionMatrix", (rc.projection() * rc.modelview()).matrix());                                                             
-            rc.drawPrimitives(PrimitiveBatch(PrimitiveBatch::Points, m_objects.size()));
+        m_swarmShader->setConstant("vesta_ModelViewProjectionMatrix", (rc.projection() * rc.modelview()).matrix());
+        rc.drawPrimitives(PrimitiveBatch(PrimitiveBatch::Points, objects.size()));
 #else
-            glEnable(GL_POINT_SPRITE);
-            rc.drawPrimitives(PrimitiveBatch(PrimitiveBatch::Points, m_objects.size()));
-            glDisable(GL_POINT_SPRITE);
+        glEnable(GL_POINT_SPRITE);
+        rc.drawPrimitives(PrimitiveBatch(PrimitiveBatch::Points, objects.size()));
+        glDisable(GL_POINT_SPRITE);
 #endif
-            rc.unbindVertexBuffer();
+        rc.unbindVertexBuffer();
 
-            rc.disableCustomShader();
-        }
+        rc.disableCustomShader();
     }
     else
     {
-        // TODO: implement non-GPU fallback path. This will be much slower, as the GPU version benefits
-        // greatly from fast transcendental functions.
+        // No shaders or the swarm shader failed to compile
+        renderFixedFunction(rc, clock, effectiveOpacity);
     }
 }
 
 
+// Draw the swarm as simple points with positions computed on the CPU.
+// The result matches the shader, except that points are square when
+// shaders aren't available.
+void
+KeplerianSwarm::renderFixedFunction(RenderContext& rc, double clock, float opacity) const
+{
+    const std::vector<KeplerianObject>& objects = m_propagator.objects();
+    unsigned int objectCount = objects.size();
+
+    float* vertexData = m_points.mapPoints(objectCount);
+    if (!vertexData)
+    {
+        return;
+    }
+
+    m_propagator.propagate(clock, vertexData, SwarmPointRenderer::VertexStride);
+
+    // Objects are invisible before they are discovered, then fade from white to
+    // the swarm color.
+    float time = float(clock - epoch());
+    for (unsigned int i = 0; i < objectCount; ++i)
+    {
+        float* vertex = vertexData + i * SwarmPointRenderer::VertexStride;
+        float age = time - objects[i].discoveryDate;
+        if (age >= 0.0f)
+        {
+            float f = std::min(age / DiscoveryFadeTime, 1.0f);
+            Spectrum color(1.0f + f * (m_color.red() - 1.0f),
+                           1.0f + f * (m_color.green() - 1.0f),
+                           1.0f + f * (m_color.blue() - 1.0f));
+            SwarmPointRenderer::setColor(vertex, color, opacity);
+        }
+        else
+        {
+            SwarmPointRenderer::setColor(vertex, Spectrum(0.0f, 0.0f, 0.0f), 0.0f);
+        }
+    }
+
+    m_points.unmapPoints();
+    m_points.draw(rc, objectCount, m_pointSize, opacity);
+}
+
+
 float
 KeplerianSwarm::boundingSphereRadius() const
 {
-    return m_boundingRadius;
+    return m_propagator.maxApoapsis();
 }
 
 
@@ -295,28 +364,23 @@ KeplerianSwarm::nearPlaneDistance(const Eigen::Vector3f& cameraPosition) const
 void
 KeplerianSwarm::addObject(const OrbitalElements& elements, double discoveryTime)
 {
-    Quaterniond orbitOrientation = OrbitalElements::orbitOrientation(elements.inclination,
-                                                                     elements.longitudeOfAscendingNode,
-                                                                     elements.argumentOfPeriapsis);
-    double semiMajorAxis = elements.periapsisDistance / (1.0 - elements.eccentricity);
-
-    // Change of epoch when computing mean anomaly
-    double meanAnomaly = elements.meanAnomalyAtEpoch + (m_epoch - elements.epoch) * elements.meanMotion;
-
-    KeplerianObject k;
-    k.sma = float(semiMajorAxis);
-    k.ecc = float(elements.eccentricity);
-    k.meanAnomaly = float(meanAnomaly);
-    k.meanMotion = float(elements.meanMotion);
-    k.qw = float(orbitOrientation.w());
-    k.qx = float(orbitOrientation.x());
-    k.qy = float(orbitOrientation.y());
-    k.qz = float(orbitOrientation.z());
-    k.discoveryDate = discoveryTime - m_epoch;
-
-    m_objects.push_back(k);
-
-    m_boundingRadius = max(m_boundingRadius, float(k.sma * (1.0 + elements.eccentricity)));
+    m_propagator.addObject(elements, discoveryTime);
+
+    // The vertex buffer must be rebuilt to include the new object
+    m_vertexBuffer = NULL;
+}
+
+
+/** Add objects that were created for a swarm with the same epoch as this one
+  * (see makeObject().)
+  */
+void
+KeplerianSwarm::addObjects(const KeplerianObject* objects, unsigned int count)
+{
+    m_propagator.addObjects(objects, count);
+
+    // The vertex buffer must be rebuilt to include the new objects
+    m_vertexBuffer = NULL;
 }
 
 
@@ -325,6 +389,21 @@ KeplerianSwarm::addObject(const OrbitalElements& elements, double discoveryTime)
 void
 KeplerianSwarm::clear()
 {
-    m_boundingRadius = 0.0;
-    m_objects.clear();
+    m_propagator.clear();
+    m_vertexBuffer = NULL;
+    m_points.clear();
+}
+
+
+/** Compute the positions of all objects at time t (seconds since J2000 TDB.)
+  * The positions array must have room for three values per object; positions
+  * are in the same units as the orbital elements (usually km), and stored in
+  * the order that objects were added.
+  *
+  * See KeplerianBatchPropagator::propagate().
+  */
+void
+KeplerianSwarm::computePositions(double t, float* positions) const
+{
+    m_propagator.propagate(t, positions);
 }
@@ -17,6 +17,8 @@
 #ifndef _VESTA_KEPLERIAN_SWARM_H_
 #define _VESTA_KEPLERIAN_SWARM_H_
 
+#include "KeplerianBatchPropagator.h"
+#include "SwarmPointRenderer.h"
 #include <vesta/Geometry.h>
 #include <vesta/Spectrum.h>
 #include <vesta/OrbitalElements.h>
@@ -66,12 +68,12 @@ public:
 
     double epoch() const
     {
-        return m_epoch;
+        return m_propagator.epoch();
     }
 
     void setEpoch(double epoch)
     {
-        m_epoch = epoch;
+        m_propagator.setEpoch(epoch);
     }
 
     float pointSize() const
@@ -106,28 +108,41 @@ public:
         m_fadeSize = fadeSize;
     }
     
+    /** Compact representation of an object in the swarm. The mean anomaly
+      * and discovery date are relative to the swarm epoch, and the orbit
+      * orientation is stored as a quaternion.
+      */
+    typedef KeplerianBatchPropagator::KeplerianObject KeplerianObject;
+
     void addObject(const OrbitalElements& elements, double discoveryTime);
+    void addObjects(const KeplerianObject* objects, unsigned int count);
     void clear();
 
-private:
-    struct KeplerianObject
+    /** Get the objects in the swarm.
+      */
+    const std::vector<KeplerianObject>& objects() const
     {
-        float sma;
-        float ecc;
-        float meanAnomaly;
-        float meanMotion;
-        float qw;
-        float qx;
-        float qy;
-        float qz;
-        float discoveryDate;
-    };
+        return m_propagator.objects();
+    }
+
+    static KeplerianObject makeObject(const OrbitalElements& elements, double discoveryTime, double epoch)
+    {
+        return KeplerianBatchPropagator::makeObject(elements, discoveryTime, epoch);
+    }
+
+    unsigned int objectCount() const
+    {
+        return m_propagator.objectCount();
+    }
+
+    void computePositions(double t, float* positions) const;
+
+private:
+    void renderFixedFunction(vesta::RenderContext& rc, double clock, float opacity) const;
 
     VertexSpec* m_vertexSpec;
-    std::vector<KeplerianObject> m_objects;
+    KeplerianBatchPropagator m_propagator;
 
-    double m_epoch;
-    float m_boundingRadius;
     Spectrum m_color;
     float m_opacity;
     float m_pointSize;
@@ -138,6 +153,9 @@ private:
     mutable counted_ptr<GLShaderProgram> m_swarmShader;
     mutable bool m_shaderCompiled;
     mutable counted_ptr<VertexBuffer> m_vertexBuffer;
+
+    // Positions and colors computed on the CPU when shaders aren't available
+    mutable SwarmPointRenderer m_points;
 };
 
 }
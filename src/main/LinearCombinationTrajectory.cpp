@@ -15,6 +15,8 @@
 // limitations under the License.
 
 #include "LinearCombinationTrajectory.h"
+#include <Eigen/StdVector>
+#include <vector>
 #include <cmath>
 
 using namespace vesta;
@@ -65,6 +67,44 @@ LinearCombinationTrajectory::state(double tdbSec) const
 }
 
 
+/** Compute states at n times, passing the whole batch on to each of the
+  * child trajectories.
+  */
+void
+LinearCombinationTrajectory::states(const double* t, size_t n, StateVector* out) const
+{
+    if (n == 0)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        out[i] = StateVector(Vector6d::Zero());
+    }
+
+    std::vector<StateVector, aligned_allocator<StateVector> > childStates(n);
+
+    if (m_trajectory0.isValid())
+    {
+        m_trajectory0->states(t, n, &childStates[0]);
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i] = StateVector(m_weight0 * childStates[i].state());
+        }
+    }
+
+    if (m_trajectory1.isValid())
+    {
+        m_trajectory1->states(t, n, &childStates[0]);
+        for (size_t i = 0; i < n; ++i)
+        {
+            out[i] = StateVector(out[i].state() + m_weight1 * childStates[i].state());
+        }
+    }
+}
+
+
 double
 LinearCombinationTrajectory::boundingSphereRadius() const
 {
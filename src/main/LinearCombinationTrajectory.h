@@ -41,11 +41,32 @@ public:
     ~LinearCombinationTrajectory();
 
     virtual vesta::StateVector state(double tdbSec) const;
+    virtual void states(const double* t, std::size_t n, vesta::StateVector* out) const;
     virtual double boundingSphereRadius() const;
     virtual bool isPeriodic() const;
     virtual double period() const;
     void setPeriod(double period);
 
+    vesta::Trajectory* trajectory0() const
+    {
+        return m_trajectory0.ptr();
+    }
+
+    vesta::Trajectory* trajectory1() const
+    {
+        return m_trajectory1.ptr();
+    }
+
+    double weight0() const
+    {
+        return m_weight0;
+    }
+
+    double weight1() const
+    {
+        return m_weight1;
+    }
+
 private:
     vesta::counted_ptr<vesta::Trajectory> m_trajectory0;
     vesta::counted_ptr<vesta::Trajectory> m_trajectory1;
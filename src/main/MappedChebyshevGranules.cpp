@@ -0,0 +1,130 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "MappedChebyshevGranules.h"
+#include <cstring>
+
+
+/** Create a new granule source for coefficients in a mapped file.
+  *
+  * \param file the mapped file containing the coefficients
+  * \param firstGranuleOffset offset in bytes of the first granule in the first record
+  * \param recordSize distance in bytes between the start of consecutive records
+  * \param granulesPerRecord the number of consecutive granules stored in each record
+  * \param degree the degree of the Chebyshev polynomials
+  * \param granuleCount the total number of granules
+  * \param swapBytes true if the coefficients are stored in the opposite of the host byte order
+  */
+MappedChebyshevGranules::MappedChebyshevGranules(MappedFile* file,
+                                                 qint64 firstGranuleOffset,
+                                                 unsigned int recordSize,
+                                                 unsigned int granulesPerRecord,
+                                                 unsigned int degree,
+                                                 unsigned int granuleCount,
+                                                 bool swapBytes) :
+    m_file(file),
+    m_firstGranuleOffset(firstGranuleOffset),
+    m_recordSize(recordSize),
+    m_granulesPerRecord(granulesPerRecord),
+    m_granuleSize((degree + 1) * 3),
+    m_granuleCount(granuleCount),
+    m_swapBytes(swapBytes),
+    m_decodedGranules(NULL)
+{
+    if (m_swapBytes)
+    {
+        // Only the table of pointers is allocated here; granules are decoded
+        // on demand.
+        m_decodedGranules = new QAtomicPointer<double>[granuleCount];
+    }
+}
+
+
+MappedChebyshevGranules::~MappedChebyshevGranules()
+{
+    if (m_decodedGranules)
+    {
+        for (unsigned int i = 0; i < m_granuleCount; ++i)
+        {
+            delete[] m_decodedGranules[i].load();
+        }
+        delete[] m_decodedGranules;
+    }
+}
+
+
+/** Return true if all granules lie within the bounds of the mapped file.
+  */
+bool
+MappedChebyshevGranules::isValid() const
+{
+    if (m_granuleCount == 0 || m_granulesPerRecord == 0)
+    {
+        return false;
+    }
+
+    qint64 lastGranuleOffset = granuleAddress(m_granuleCount - 1) - m_file->data();
+    return m_file->contains(m_firstGranuleOffset, 0) &&
+           m_file->contains(lastGranuleOffset, m_granuleSize * sizeof(double));
+}
+
+
+const double*
+MappedChebyshevGranules::granule(unsigned int index, double* /* buffer */) const
+{
+    if (!m_swapBytes)
+    {
+        return reinterpret_cast<const double*>(granuleAddress(index));
+    }
+
+    const double* coeffs = m_decodedGranules[index].loadAcquire();
+    if (coeffs)
+    {
+        return coeffs;
+    }
+    else
+    {
+        return decodeGranule(index);
+    }
+}
+
+
+// Byte swap a granule into a newly allocated buffer and publish it. No lock
+// is required: if two threads decode the same granule at the same time, the
+// loser discards its copy and uses the winner's.
+const double*
+MappedChebyshevGranules::decodeGranule(unsigned int index) const
+{
+    const uchar* src = granuleAddress(index);
+    double* coeffs = new double[m_granuleSize];
+    for (unsigned int i = 0; i < m_granuleSize; ++i)
+    {
+        quint64 bits;
+        memcpy(&bits, src + i * sizeof(double), sizeof(bits));
+        bits = SwapBytes64(bits);
+        memcpy(&coeffs[i], &bits, sizeof(bits));
+    }
+
+    if (m_decodedGranules[index].testAndSetOrdered(NULL, coeffs))
+    {
+        return coeffs;
+    }
+    else
+    {
+        delete[] coeffs;
+        return m_decodedGranules[index].loadAcquire();
+    }
+}
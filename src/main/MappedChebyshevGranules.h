@@ -0,0 +1,83 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _MAPPED_CHEBYSHEV_GRANULES_H_
+#define _MAPPED_CHEBYSHEV_GRANULES_H_
+
+#include "ChebyshevPolyTrajectory.h"
+#include "MappedFile.h"
+#include <QAtomicPointer>
+
+
+/** MappedChebyshevGranules provides Chebyshev polynomial coefficients
+  * stored in a memory mapped file. Granules are laid out in records of
+  * fixed size, possibly with several consecutive granules per record (as in
+  * the JPL DE ephemerides, where one record holds all bodies for a fixed span
+  * of time.)
+  *
+  * When the file byte order matches the host's, coefficients are used in
+  * place and never copied. Otherwise, each granule is byte swapped into a
+  * private buffer the first time that it's requested, so that the cost of
+  * loading is independent of the size of the file.
+  */
+class MappedChebyshevGranules : public ChebyshevGranuleSource
+{
+public:
+    MappedChebyshevGranules(MappedFile* file,
+                            qint64 firstGranuleOffset,
+                            unsigned int recordSize,
+                            unsigned int granulesPerRecord,
+                            unsigned int degree,
+                            unsigned int granuleCount,
+                            bool swapBytes);
+    ~MappedChebyshevGranules();
+
+    virtual const double* granule(unsigned int index, double* buffer) const;
+
+    /** Get the number of doubles in each granule.
+      */
+    unsigned int granuleSize() const
+    {
+        return m_granuleSize;
+    }
+
+    bool isValid() const;
+
+private:
+    const uchar* granuleAddress(unsigned int index) const
+    {
+        unsigned int record = index / m_granulesPerRecord;
+        unsigned int granuleInRecord = index % m_granulesPerRecord;
+        return m_file->data() + m_firstGranuleOffset + qint64(record) * m_recordSize + granuleInRecord * m_granuleSize * sizeof(double);
+    }
+
+    const double* decodeGranule(unsigned int index) const;
+
+private:
+    vesta::counted_ptr<MappedFile> m_file;
+    qint64 m_firstGranuleOffset;
+    unsigned int m_recordSize;
+    unsigned int m_granulesPerRecord;
+    unsigned int m_granuleSize;
+    unsigned int m_granuleCount;
+    bool m_swapBytes;
+
+    // Byte swapped copies of granules; only allocated when the byte order of
+    // the file differs from the host byte order.
+    mutable QAtomicPointer<double>* m_decodedGranules;
+};
+
+#endif // _MAPPED_CHEBYSHEV_GRANULES_H_
@@ -0,0 +1,72 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "MappedFile.h"
+#include <QFile>
+#include <QDebug>
+
+
+MappedFile::MappedFile(QFile* file, const uchar* data, qint64 size) :
+    m_file(file),
+    m_data(data),
+    m_size(size)
+{
+}
+
+
+MappedFile::~MappedFile()
+{
+    // Destroying the QFile releases the mapping
+    delete m_file;
+}
+
+
+QString
+MappedFile::fileName() const
+{
+    return m_file->fileName();
+}
+
+
+/** Map the complete contents of a file into memory. Returns null if the
+  * file couldn't be opened or mapped.
+  */
+MappedFile*
+MappedFile::Open(const QString& fileName)
+{
+    QFile* file = new QFile(fileName);
+    if (!file->open(QIODevice::ReadOnly))
+    {
+        delete file;
+        return NULL;
+    }
+
+    qint64 size = file->size();
+    uchar* data = NULL;
+    if (size > 0)
+    {
+        data = file->map(0, size);
+    }
+
+    if (!data)
+    {
+        qDebug() << "Unable to map file " << fileName;
+        delete file;
+        return NULL;
+    }
+
+    return new MappedFile(file, data, size);
+}
@@ -0,0 +1,88 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+
+#include <vesta/Object.h>
+#include <QString>
+
+class QFile;
+
+
+/** MappedFile is a reference counted, read-only memory mapping of an
+  * entire file. Objects that reference data stored in the file (e.g. the
+  * coefficients of a Chebyshev polynomial trajectory) keep a counted
+  * pointer to the MappedFile; the mapping is released when the last
+  * reference goes away.
+  */
+class MappedFile : public vesta::Object
+{
+private:
+    MappedFile(QFile* file, const uchar* data, qint64 size);
+
+public:
+    ~MappedFile();
+
+    /** Get a pointer to the first byte of the mapped file.
+      */
+    const uchar* data() const
+    {
+        return m_data;
+    }
+
+    /** Get the size of the mapped file in bytes.
+      */
+    qint64 size() const
+    {
+        return m_size;
+    }
+
+    /** Return true if the range [offset, offset + length) lies entirely within
+      * the mapped file.
+      */
+    bool contains(qint64 offset, qint64 length) const
+    {
+        return offset >= 0 && length >= 0 && offset + length <= m_size;
+    }
+
+    QString fileName() const;
+
+    static MappedFile* Open(const QString& fileName);
+
+private:
+    QFile* m_file;
+    const uchar* m_data;
+    qint64 m_size;
+};
+
+
+/** Reverse the byte order of a 32-bit value.
+  */
+inline quint32 SwapBytes32(quint32 x)
+{
+    return (x >> 24) | ((x >> 8) & 0x0000ff00u) | ((x << 8) & 0x00ff0000u) | (x << 24);
+}
+
+
+/** Reverse the byte order of a 64-bit value.
+  */
+inline quint64 SwapBytes64(quint64 x)
+{
+    return (quint64(SwapBytes32(quint32(x))) << 32) | quint64(SwapBytes32(quint32(x >> 32)));
+}
+
+#endif // _MAPPED_FILE_H_
@@ -0,0 +1,129 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "SampledTimeIndex.h"
+#include <QDebug>
+#include <algorithm>
+
+using namespace std;
+
+
+SampledTimeIndex::SampledTimeIndex() :
+    m_times(NULL),
+    m_count(0),
+    m_index(NULL),
+    m_indexStride(0),
+    m_indexCount(0)
+{
+}
+
+
+/** Set the record times to a copy of a list of times.
+  */
+void
+SampledTimeIndex::setTimes(const std::vector<double>& times)
+{
+    m_timeList = times;
+    m_times = m_timeList.empty() ? NULL : &m_timeList[0];
+    m_count = m_timeList.size();
+    m_index = NULL;
+    m_indexStride = 0;
+    m_indexCount = 0;
+}
+
+
+/** Set the record times to an external array, which must remain valid for
+  * the lifetime of the index. The coarse index may be null; it is ignored
+  * unless it covers the whole table and every entry is the time of the
+  * corresponding record.
+  */
+void
+SampledTimeIndex::setTimes(const double* times, unsigned int count,
+                           const double* index, unsigned int indexStride, unsigned int indexCount)
+{
+    m_timeList.clear();
+    m_times = times;
+    m_count = count;
+    m_index = index;
+    m_indexStride = indexStride;
+    m_indexCount = indexCount;
+
+    // The coarse index is only usable if it covers the whole table
+    if (m_indexStride == 0 || m_indexCount != (m_count + m_indexStride - 1) / m_indexStride)
+    {
+        m_index = NULL;
+    }
+
+    // The index is read from a file along with the times, so check it against
+    // them rather than trusting it: a stale or corrupt index would otherwise
+    // send the search to the wrong block of records.
+    if (m_index)
+    {
+        for (unsigned int k = 0; k < m_indexCount; ++k)
+        {
+            if (!(m_index[k] == m_times[k * m_indexStride]))
+            {
+                qDebug() << "Ignoring coarse time index that doesn't match the record times";
+                m_index = NULL;
+                break;
+            }
+        }
+    }
+}
+
+
+/** Find the index i of the interval such that time[i] <= t < time[i + 1]. The
+  * time must lie strictly between the first and last record times. The last
+  * interval found by the calling thread is tried first, followed by the one
+  * after it, so that lookups for sequences of increasing times are O(1).
+  */
+unsigned int
+SampledTimeIndex::findInterval(double t) const
+{
+    unsigned int& lastInterval = m_lastInterval.localData();
+
+    unsigned int i = lastInterval;
+    if (i + 1 < m_count && m_times[i] <= t)
+    {
+        if (t < m_times[i + 1])
+        {
+            return i;
+        }
+        else if (i + 2 < m_count && t < m_times[i + 2])
+        {
+            lastInterval = i + 1;
+            return i + 1;
+        }
+    }
+
+    const double* first = m_times;
+    const double* last = m_times + m_count;
+
+    // Use the coarse index (if there is one) to narrow the search down to a
+    // block of indexStride records.
+    if (m_index)
+    {
+        unsigned int block = upper_bound(m_index, m_index + m_indexCount, t) - m_index;
+        block = block > 0 ? min(block - 1, m_indexCount - 1) : 0;
+        first = m_times + block * m_indexStride;
+        last = min(last, first + m_indexStride + 1);
+    }
+
+    i = (upper_bound(first, last, t) - m_times) - 1;
+    lastInterval = i;
+
+    return i;
+}
@@ -0,0 +1,79 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _SAMPLED_TIME_INDEX_H_
+#define _SAMPLED_TIME_INDEX_H_
+
+#include <QThreadStorage>
+#include <vector>
+
+
+/** SampledTimeIndex finds the interval of a table of increasing record
+  * times that contains a given time. It is shared by the tables of time
+  * tagged records (InterpolatedStateTrajectory, InterpolatedRotation), which
+  * keep their records in lists or in separate arrays outside the table.
+  *
+  * The times are either copied into the index, or refer to an external
+  * array (e.g. in a memory mapped file) with an optional coarse index that
+  * gives the time of every indexStride-th record. The coarse index narrows
+  * the search for a time in very long tables.
+  *
+  * Each thread remembers the last interval in which it found a time, so that
+  * the usual sequence of increasing times can be evaluated without searching
+  * the table.
+  */
+class SampledTimeIndex
+{
+public:
+    SampledTimeIndex();
+
+    void setTimes(const std::vector<double>& times);
+    void setTimes(const double* times, unsigned int count,
+                  const double* index, unsigned int indexStride, unsigned int indexCount);
+
+    /** Get the number of records.
+      */
+    unsigned int count() const
+    {
+        return m_count;
+    }
+
+    /** Get the time of the record at the specified index, which must be
+      * less than count().
+      */
+    double operator[](unsigned int i) const
+    {
+        return m_times[i];
+    }
+
+    unsigned int findInterval(double t) const;
+
+private:
+    // Times copied from a record list; m_times points either here or to
+    // external storage.
+    std::vector<double> m_timeList;
+    const double* m_times;
+    unsigned int m_count;
+
+    const double* m_index;
+    unsigned int m_indexStride;
+    unsigned int m_indexCount;
+
+    // Index of the interval found by the last lookup in each thread
+    mutable QThreadStorage<unsigned int> m_lastInterval;
+};
+
+#endif // _SAMPLED_TIME_INDEX_H_
@@ -0,0 +1,389 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "SharedEphemerisCache.h"
+#include "MappedChebyshevGranules.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QDebug>
+#include <cstring>
+
+using namespace vesta;
+
+
+// Each cache entry begins with a header, stored in host byte order:
+//
+//  8 bytes - "EPHCACHE"
+//  4 bytes - uint32 - format version
+//  4 bytes - reserved
+//  8 bytes - int64 - size of the source file
+//  8 bytes - int64 - modification time of the source file (ms since 1970)
+//  8 bytes - int64 - payload size
+// 24 bytes - kind, padded with zeros
+//
+// The version of an entry written on a host with the other byte order won't
+// match, so such entries are ignored.
+static const char* CacheEntryMagic = "EPHCACHE";
+static const quint32 CacheEntryVersion = 1;
+static const unsigned int MaxKindLength = 23;
+
+// Header of a Chebyshev trajectory payload, stored in host byte order and
+// followed by the coefficients of each granule:
+//
+//  4 bytes - uint32 - degree
+//  4 bytes - uint32 - granule count
+//  8 bytes - double - start time of the first granule (seconds since J2000 TDB)
+//  8 bytes - double - granule length (seconds)
+//  8 bytes - double - bounding radius (km)
+//  8 bytes - double - period (seconds, or zero if not periodic)
+//  8 bytes - double - start of valid time range
+//  8 bytes - double - end of valid time range
+//  8 bytes - reserved
+static const unsigned int ChebyshevPayloadHeaderSize = 64;
+
+static QMutex CacheDirectoryMutex;
+static QString CacheDirectory;
+
+
+/** Set the directory in which cache entries are stored. The directory is
+  * created when the first entry is published. An empty path disables the
+  * cache.
+  */
+void
+SharedEphemerisCache::SetDirectory(const QString& path)
+{
+    QMutexLocker locker(&CacheDirectoryMutex);
+    CacheDirectory = path;
+}
+
+
+QString
+SharedEphemerisCache::Directory()
+{
+    QMutexLocker locker(&CacheDirectoryMutex);
+    return CacheDirectory;
+}
+
+
+bool
+SharedEphemerisCache::IsEnabled()
+{
+    return !Directory().isEmpty();
+}
+
+
+// Get the name of the cache entry for a source file, or an empty string if the
+// cache is disabled or the source file doesn't exist. The name includes a hash
+// of the canonical path of the source so that files with the same name in
+// different directories get different entries.
+QString
+SharedEphemerisCache::entryFileName(const QString& sourceFileName, const QString& kind)
+{
+    QString directory = Directory();
+    QString canonicalPath = QFileInfo(sourceFileName).canonicalFilePath();
+    if (directory.isEmpty() || canonicalPath.isEmpty() || kind.isEmpty() || kind.length() > int(MaxKindLength))
+    {
+        return QString();
+    }
+
+    QByteArray key = (canonicalPath + "\n" + kind).toUtf8();
+    QString hash = QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex().left(16));
+
+    return QString("%1/%2-%3.%4").arg(directory, QFileInfo(canonicalPath).fileName(), hash, kind);
+}
+
+
+/** Map the cache entry of the specified kind for a source file. Returns null
+  * if the cache is disabled, there's no entry, or the entry is out of date.
+  * The payload of the entry begins PayloadOffset bytes from the start of the
+  * mapped file.
+  */
+MappedFile*
+SharedEphemerisCache::Open(const QString& sourceFileName, const QString& kind)
+{
+    QString entryName = entryFileName(sourceFileName, kind);
+    if (entryName.isEmpty() || !QFileInfo(entryName).exists())
+    {
+        return NULL;
+    }
+
+    MappedFile* entry = MappedFile::Open(entryName);
+    if (!entry)
+    {
+        return NULL;
+    }
+    else if (!entry->contains(0, PayloadOffset))
+    {
+        delete entry;
+        return NULL;
+    }
+
+    const uchar* header = entry->data();
+    quint32 version = 0;
+    qint64 sourceSize = 0;
+    qint64 sourceTime = 0;
+    qint64 payloadSize = 0;
+    char entryKind[MaxKindLength + 1];
+    memcpy(&version,     header + 8,  sizeof(version));
+    memcpy(&sourceSize,  header + 16, sizeof(sourceSize));
+    memcpy(&sourceTime,  header + 24, sizeof(sourceTime));
+    memcpy(&payloadSize, header + 32, sizeof(payloadSize));
+    memcpy(entryKind,    header + 40, sizeof(entryKind));
+    entryKind[MaxKindLength] = '\0';
+
+    QFileInfo sourceInfo(sourceFileName);
+    if (memcmp(header, CacheEntryMagic, strlen(CacheEntryMagic)) != 0 ||
+        version != CacheEntryVersion ||
+        sourceSize != sourceInfo.size() ||
+        sourceTime != sourceInfo.lastModified().toMSecsSinceEpoch() ||
+        payloadSize != entry->size() - PayloadOffset ||
+        kind != QString::fromLatin1(entryKind))
+    {
+        delete entry;
+        return NULL;
+    }
+
+    return entry;
+}
+
+
+/** Create the cache entry of the specified kind for a source file, replacing
+  * any existing entry. The writer must write exactly payloadSize bytes.
+  * Returns the new entry, mapped as by Open(), or null if the cache is disabled
+  * or the entry couldn't be written.
+  */
+MappedFile*
+SharedEphemerisCache::Publish(const QString& sourceFileName, const QString& kind,
+                              qint64 payloadSize, const PayloadWriter& writer)
+{
+    QString entryName = entryFileName(sourceFileName, kind);
+    if (entryName.isEmpty())
+    {
+        return NULL;
+    }
+
+    QFileInfo sourceInfo(sourceFileName);
+    uchar header[PayloadOffset];
+    memset(header, 0, sizeof(header));
+    qint64 sourceSize = sourceInfo.size();
+    qint64 sourceTime = sourceInfo.lastModified().toMSecsSinceEpoch();
+    QByteArray kindName = kind.toLatin1();
+    memcpy(header,      CacheEntryMagic,    strlen(CacheEntryMagic));
+    memcpy(header + 8,  &CacheEntryVersion, sizeof(CacheEntryVersion));
+    memcpy(header + 16, &sourceSize,        sizeof(sourceSize));
+    memcpy(header + 24, &sourceTime,        sizeof(sourceTime));
+    memcpy(header + 32, &payloadSize,       sizeof(payloadSize));
+    memcpy(header + 40, kindName.constData(), kindName.size());
+
+    QDir().mkpath(Directory());
+
+    // QSaveFile writes to a temporary file and renames it when committed. Processes
+    // that have the old entry mapped keep using it, and if several processes publish
+    // the same entry at once, one of the complete entries wins.
+    QSaveFile file(entryName);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qDebug() << "Unable to create shared ephemeris cache entry " << entryName;
+        return NULL;
+    }
+
+    bool ok = file.write(reinterpret_cast<const char*>(header), PayloadOffset) == PayloadOffset &&
+              writer.write(&file) &&
+              file.pos() == PayloadOffset + payloadSize;
+    if (!ok)
+    {
+        file.cancelWriting();
+    }
+
+    if (!file.commit() || !ok)
+    {
+        qDebug() << "Error writing shared ephemeris cache entry " << entryName;
+        return NULL;
+    }
+
+    return Open(sourceFileName, kind);
+}
+
+
+namespace
+{
+
+class ByteArrayWriter : public SharedEphemerisCache::PayloadWriter
+{
+public:
+    ByteArrayWriter(const QByteArray& data) :
+        m_data(data)
+    {
+    }
+
+    bool write(QIODevice* device) const
+    {
+        return device->write(m_data) == m_data.size();
+    }
+
+private:
+    const QByteArray& m_data;
+};
+
+
+class ChebyshevTrajectoryWriter : public SharedEphemerisCache::PayloadWriter
+{
+public:
+    ChebyshevTrajectoryWriter(const ChebyshevPolyTrajectory* trajectory) :
+        m_trajectory(trajectory)
+    {
+    }
+
+    bool write(QIODevice* device) const
+    {
+        uchar header[ChebyshevPayloadHeaderSize];
+        memset(header, 0, sizeof(header));
+
+        quint32 degree = m_trajectory->degree();
+        quint32 granuleCount = m_trajectory->granuleCount();
+        double values[6] =
+        {
+            m_trajectory->firstGranuleStartTime(),
+            m_trajectory->granuleLength(),
+            m_trajectory->boundingSphereRadius(),
+            m_trajectory->isPeriodic() ? m_trajectory->period() : 0.0,
+            m_trajectory->startTime(),
+            m_trajectory->endTime()
+        };
+        memcpy(header,     &degree,       sizeof(degree));
+        memcpy(header + 4, &granuleCount, sizeof(granuleCount));
+        memcpy(header + 8, values,        sizeof(values));
+
+        if (device->write(reinterpret_cast<const char*>(header), sizeof(header)) != qint64(sizeof(header)))
+        {
+            return false;
+        }
+
+        qint64 granuleBytes = (degree + 1) * 3 * sizeof(double);
+        double buffer[ChebyshevGranuleSource::MaxGranuleSize];
+        for (unsigned int i = 0; i < granuleCount; ++i)
+        {
+            const double* coeffs = m_trajectory->granuleCoefficients(i, buffer);
+            if (device->write(reinterpret_cast<const char*>(coeffs), granuleBytes) != granuleBytes)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+private:
+    const ChebyshevPolyTrajectory* m_trajectory;
+};
+
+}
+
+
+/** Create a cache entry from a block of memory.
+  */
+MappedFile*
+SharedEphemerisCache::Publish(const QString& sourceFileName, const QString& kind, const QByteArray& payload)
+{
+    return Publish(sourceFileName, kind, payload.size(), ByteArrayWriter(payload));
+}
+
+
+// Create a trajectory that evaluates the coefficients in a Chebyshev
+// trajectory cache entry.
+static ChebyshevPolyTrajectory*
+chebyshevTrajectoryFromEntry(MappedFile* entry)
+{
+    counted_ptr<MappedFile> entryRef(entry);
+    const unsigned int payloadOffset = SharedEphemerisCache::PayloadOffset;
+    if (!entry->contains(payloadOffset, ChebyshevPayloadHeaderSize))
+    {
+        return NULL;
+    }
+
+    const uchar* header = entry->data() + payloadOffset;
+    quint32 degree = 0;
+    quint32 granuleCount = 0;
+    double values[6];
+    memcpy(&degree,       header,     sizeof(degree));
+    memcpy(&granuleCount, header + 4, sizeof(granuleCount));
+    memcpy(values,        header + 8, sizeof(values));
+
+    if (degree > ChebyshevPolyTrajectory::MaxChebyshevDegree || granuleCount == 0 || !(values[1] > 0.0))
+    {
+        return NULL;
+    }
+
+    unsigned int granuleBytes = (degree + 1) * 3 * sizeof(double);
+    qint64 coeffOffset = payloadOffset + ChebyshevPayloadHeaderSize;
+    if (entry->size() != coeffOffset + qint64(granuleCount) * granuleBytes)
+    {
+        return NULL;
+    }
+
+    counted_ptr<MappedChebyshevGranules> granules(new MappedChebyshevGranules(entry,
+                                                                              coeffOffset,
+                                                                              granuleBytes,
+                                                                              1,
+                                                                              degree,
+                                                                              granuleCount,
+                                                                              false));
+    if (!granules->isValid())
+    {
+        return NULL;
+    }
+
+    ChebyshevPolyTrajectory* trajectory = new ChebyshevPolyTrajectory(granules.ptr(), degree, granuleCount,
+                                                                      values[0], values[1], values[2]);
+    trajectory->setPeriod(values[3]);
+    trajectory->setValidTimeRange(values[4], values[5]);
+
+    return trajectory;
+}
+
+
+/** Create a Chebyshev polynomial trajectory from a cache entry written by
+  * PublishChebyshevTrajectory(). The trajectory evaluates the coefficients
+  * in the mapped entry. Returns null if there's no valid entry.
+  */
+ChebyshevPolyTrajectory*
+SharedEphemerisCache::OpenChebyshevTrajectory(const QString& sourceFileName, const QString& kind)
+{
+    MappedFile* entry = Open(sourceFileName, kind);
+    return entry ? chebyshevTrajectoryFromEntry(entry) : NULL;
+}
+
+
+/** Publish the coefficients of a Chebyshev polynomial trajectory, along with
+  * its period and valid time range. This is used to share tables that are
+  * expensive to compute, such as ephemerides baked into a different center.
+  * Returns a trajectory that uses the new entry, or null if the entry couldn't
+  * be written.
+  */
+ChebyshevPolyTrajectory*
+SharedEphemerisCache::PublishChebyshevTrajectory(const QString& sourceFileName, const QString& kind,
+                                                 const ChebyshevPolyTrajectory* trajectory)
+{
+    qint64 payloadSize = ChebyshevPayloadHeaderSize +
+                         qint64(trajectory->granuleCount()) * (trajectory->degree() + 1) * 3 * sizeof(double);
+    MappedFile* entry = Publish(sourceFileName, kind, payloadSize, ChebyshevTrajectoryWriter(trajectory));
+    return entry ? chebyshevTrajectoryFromEntry(entry) : NULL;
+}
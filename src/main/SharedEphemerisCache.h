@@ -0,0 +1,80 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _SHARED_EPHEMERIS_CACHE_H_
+#define _SHARED_EPHEMERIS_CACHE_H_
+
+#include "MappedFile.h"
+#include <QByteArray>
+#include <QString>
+
+class QIODevice;
+class ChebyshevPolyTrajectory;
+
+
+/** SharedEphemerisCache lets Cosmographia processes running on the same
+  * machine share decoded ephemeris and trajectory data. The first process
+  * to decode a file publishes the result, laid out so that it can be used in
+  * place, as an entry in the cache directory. Other processes map the entry
+  * read-only instead of decoding the source again. Mapped pages are shared
+  * through the system page cache, so every additional process starts faster
+  * and adds little to the total resident memory.
+  *
+  * Entries are keyed by the path of the source file and a kind that says
+  * what was decoded, since several entries may be derived from one source
+  * (e.g. an ephemeris and tables computed from it.) Each entry records the
+  * size and modification time of its source and is ignored when those
+  * change; the next process to load the source replaces it. Entries are
+  * written to a temporary file that is then renamed, so an entry is never
+  * modified while another process has it mapped.
+  *
+  * Payloads are stored in host byte order. The cache is disabled until a
+  * directory is set.
+  */
+class SharedEphemerisCache
+{
+public:
+    /** A PayloadWriter writes the payload of a new cache entry.
+      */
+    class PayloadWriter
+    {
+    public:
+        virtual ~PayloadWriter() {}
+        virtual bool write(QIODevice* device) const = 0;
+    };
+
+    static void SetDirectory(const QString& path);
+    static QString Directory();
+    static bool IsEnabled();
+
+    static MappedFile* Open(const QString& sourceFileName, const QString& kind);
+    static MappedFile* Publish(const QString& sourceFileName, const QString& kind,
+                               qint64 payloadSize, const PayloadWriter& writer);
+    static MappedFile* Publish(const QString& sourceFileName, const QString& kind, const QByteArray& payload);
+
+    static ChebyshevPolyTrajectory* OpenChebyshevTrajectory(const QString& sourceFileName, const QString& kind);
+    static ChebyshevPolyTrajectory* PublishChebyshevTrajectory(const QString& sourceFileName, const QString& kind,
+                                                               const ChebyshevPolyTrajectory* trajectory);
+
+    // Offset of the payload from the start of an entry. Payloads are aligned
+    // so that they may be used directly as arrays of doubles.
+    static const unsigned int PayloadOffset = 64;
+
+private:
+    static QString entryFileName(const QString& sourceFileName, const QString& kind);
+};
+
+#endif // _SHARED_EPHEMERIS_CACHE_H_
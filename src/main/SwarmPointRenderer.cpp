@@ -0,0 +1,247 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "SwarmPointRenderer.h"
+#include <vesta/RenderContext.h>
+#include <vesta/Material.h>
+#include <vesta/VertexBuffer.h>
+#include <vesta/VertexSpec.h>
+#include <vesta/ShaderBuilder.h>
+#include <vesta/glhelp/GLShaderProgram.h>
+#include <algorithm>
+#include <cstring>
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+// Size of a vertex in bytes
+static const unsigned int VertexSize = SwarmPointRenderer::VertexStride * sizeof(float);
+
+
+#ifdef VESTA_OGLES2
+
+static const char* PointVertexShaderSource =
+"attribute vec3 vesta_Position;   \n"
+"attribute vec4 vesta_Color;      \n"
+"uniform mat4 vesta_ModelViewProjectionMatrix;\n"
+"uniform float pointSize;         \n"
+"varying lowp vec4 pointColor;    \n"
+"\n"
+"void main()                      \n"
+"{                                \n"
+"    pointColor = vesta_Color;    \n"
+"    gl_PointSize = pointSize;    \n"
+"    gl_Position = vesta_ModelViewProjectionMatrix * vec4(vesta_Position, 1.0);\n"
+"}                                \n"
+;
+
+static const char* PointFragmentShaderSource =
+"varying lowp vec4 pointColor;                   \n"
+"void main()                                     \n"
+"{                                               \n"
+"    mediump vec2 v = gl_PointCoord - vec2(0.5, 0.5); \n"
+"    mediump float opacity = 1.0 - dot(v, v) * 4.0; \n"
+"    gl_FragColor = vec4(pointColor.rgb, opacity * pointColor.a);\n"
+"}                                               \n"
+;
+
+#else
+
+static const char* PointVertexShaderSource =
+"#version 120                     \n"
+"uniform float pointSize;         \n"
+"varying vec4 pointColor;         \n"
+"\n"
+"void main()                      \n"
+"{                                \n"
+"    pointColor = gl_Color;       \n"
+"    gl_PointSize = pointSize;    \n"
+"    gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;\n"
+"}                                \n"
+;
+
+static const char* PointFragmentShaderSource =
+"#version 120                                    \n"
+"varying vec4 pointColor;                        \n"
+"void main()                                     \n"
+"{                                               \n"
+"    vec2 v = gl_PointCoord - vec2(0.5, 0.5);    \n"
+"    float opacity = 1.0 - dot(v, v) * 4.0;      \n"
+"    gl_FragColor = vec4(pointColor.rgb, opacity * pointColor.a);\n"
+"}                                               \n"
+;
+
+#endif
+
+
+SwarmPointRenderer::SwarmPointRenderer() :
+    m_shaderCompiled(false)
+{
+}
+
+
+SwarmPointRenderer::~SwarmPointRenderer()
+{
+}
+
+
+/** Map the vertex buffer for writing the vertices of pointCount points;
+  * consecutive vertices are VertexStride floats apart. unmapPoints() must
+  * be called before the points are drawn. Returns NULL if the buffer
+  * couldn't be created or mapped.
+  */
+float*
+SwarmPointRenderer::mapPoints(unsigned int pointCount)
+{
+    if (m_vertexBuffer.isValid() && m_vertexBuffer->size() < pointCount * VertexSize)
+    {
+        m_vertexBuffer = NULL;
+    }
+
+    if (m_vertexBuffer.isNull())
+    {
+        m_vertexBuffer = VertexBuffer::Create(pointCount * VertexSize, VertexBuffer::StreamDraw);
+        if (m_vertexBuffer.isNull())
+        {
+            return NULL;
+        }
+    }
+
+    return reinterpret_cast<float*>(m_vertexBuffer->mapWriteOnly());
+}
+
+
+void
+SwarmPointRenderer::unmapPoints()
+{
+    if (m_vertexBuffer.isValid())
+    {
+        m_vertexBuffer->unmap();
+    }
+}
+
+
+/** Draw the first pointCount points written to the vertex buffer. The
+  * opacity of each point is the alpha of its color; opacity is the overall
+  * opacity of the swarm, which determines how the points are blended.
+  */
+void
+SwarmPointRenderer::draw(RenderContext& rc, unsigned int pointCount, float pointSize, float opacity)
+{
+    if (m_vertexBuffer.isNull())
+    {
+        return;
+    }
+
+    if (rc.shaderCapability() != RenderContext::FixedFunction && !m_shaderCompiled)
+    {
+        m_shader = GLShaderProgram::CreateShaderProgram(PointVertexShaderSource, PointFragmentShaderSource);
+        m_shaderCompiled = true;
+#ifdef VESTA_OGLES2
+        // Custom shaders have to bind the standard attributes themselves
+        if (m_shader.isValid())
+        {
+            m_shader->bindAttribute(ShaderBuilder::PositionAttribute, ShaderBuilder::PositionAttributeLocation);
+            m_shader->bindAttribute(ShaderBuilder::ColorAttribute, ShaderBuilder::ColorAttributeLocation);
+            m_shader->link();
+        }
+#endif
+    }
+
+    rc.bindVertexBuffer(VertexSpec::PositionColor, m_vertexBuffer.ptr(), VertexSize);
+
+    Material material;
+    material.setOpacity(std::min(0.99f, opacity));
+    rc.bindMaterial(&material);
+
+    if (rc.shaderCapability() != RenderContext::FixedFunction && m_shader.isValid())
+    {
+        rc.enableCustomShader(m_shader.ptr());
+        m_shader->bind();
+        m_shader->setConstant("pointSize", pointSize);
+#ifdef VESTA_OGLES2
+        m_shader->setConstant("vesta_ModelViewProjectionMatrix", (rc.projection() * rc.modelview()).matrix());
+        rc.drawPrimitives(PrimitiveBatch(PrimitiveBatch::Points, pointCount));
+#else
+        glEnable(GL_VERTEX_PROGRAM_POINT_SIZE_ARB);
+        glEnable(GL_POINT_SPRITE);
+        rc.drawPrimitives(PrimitiveBatch(PrimitiveBatch::Points, pointCount));
+        glDisable(GL_POINT_SPRITE);
+        glDisable(GL_VERTEX_PROGRAM_POINT_SIZE_ARB);
+#endif
+        rc.disableCustomShader();
+    }
+    else
+    {
+        // Fixed function fallback: square, unsmoothed points
+#ifndef VESTA_OGLES2
+        glPointSize(pointSize);
+        rc.drawPrimitives(PrimitiveBatch(PrimitiveBatch::Points, pointCount));
+        glPointSize(1.0f);
+#endif
+    }
+
+    rc.unbindVertexBuffer();
+}
+
+
+/** Release the vertex buffer.
+  */
+void
+SwarmPointRenderer::clear()
+{
+    m_vertexBuffer = NULL;
+}
+
+
+/** Store a color in a vertex.
+  */
+void
+SwarmPointRenderer::setColor(float* vertex, const Spectrum& color, float alpha)
+{
+    unsigned char rgba[4] = {
+        (unsigned char) (color.red() * 255.99f),
+        (unsigned char) (color.green() * 255.99f),
+        (unsigned char) (color.blue() * 255.99f),
+        (unsigned char) (alpha * 255.99f)
+    };
+    memcpy(vertex + 3, rgba, 4);
+}
+
+
+/** Compute how much a swarm should be faded based on its projected size in
+  * pixels: 1 when the size is at least four times fadeSize, falling to 0 at
+  * fadeSize. Fading is disabled when fadeSize is zero.
+  */
+float
+SwarmPointRenderer::fadeFactor(const RenderContext& rc, float boundingRadius, float fadeSize)
+{
+    float fade = 1.0f;
+    if (fadeSize > 0.0f)
+    {
+        const float sizeFadeStart = fadeSize * 4;
+        const float sizeFadeEnd = fadeSize;
+        float pixelSize = boundingRadius / (rc.modelview().translation().norm() * rc.pixelSize());
+        if (pixelSize < sizeFadeStart)
+        {
+            fade = std::max(0.0f, (pixelSize - sizeFadeEnd) / (sizeFadeStart - sizeFadeEnd));
+        }
+    }
+
+    return fade;
+}
@@ -0,0 +1,61 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _SWARM_POINT_RENDERER_H_
+#define _SWARM_POINT_RENDERER_H_
+
+#include <vesta/Object.h>
+#include <vesta/Spectrum.h>
+
+namespace vesta
+{
+class RenderContext;
+class VertexBuffer;
+class GLShaderProgram;
+}
+
+
+/** SwarmPointRenderer draws a large number of points whose positions and
+  * colors are computed on the CPU. It is shared by the swarm geometries
+  * (KeplerianSwarm and TleSwarm.) Points are written into a streaming vertex
+  * buffer, and drawn as round point sprites when shaders are available or as
+  * square points otherwise.
+  */
+class SwarmPointRenderer
+{
+public:
+    SwarmPointRenderer();
+    ~SwarmPointRenderer();
+
+    // Number of floats in each vertex: the position followed by a packed
+    // RGBA color (see setColor.)
+    static const unsigned int VertexStride = 4;
+
+    float* mapPoints(unsigned int pointCount);
+    void unmapPoints();
+    void draw(vesta::RenderContext& rc, unsigned int pointCount, float pointSize, float opacity);
+    void clear();
+
+    static void setColor(float* vertex, const vesta::Spectrum& color, float alpha);
+    static float fadeFactor(const vesta::RenderContext& rc, float boundingRadius, float fadeSize);
+
+private:
+    vesta::counted_ptr<vesta::VertexBuffer> m_vertexBuffer;
+    vesta::counted_ptr<vesta::GLShaderProgram> m_shader;
+    bool m_shaderCompiled;
+};
+
+#endif // _SWARM_POINT_RENDERER_H_
@@ -0,0 +1,492 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "TleBatchPropagator.h"
+#include <vesta/GregorianDate.h>
+#include <vesta/Units.h>
+#include <QThread>
+#include <QtConcurrentRun>
+#include <QFuture>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace vesta;
+using namespace std;
+
+
+// Model constants; these must match the ones in the noradtle library
+static const double TwoPi = 6.283185307179586476925286766559;
+static const double EarthRadius = 6.378135e3;  // km (xkmper)
+static const double Ck2 = 5.413079e-4;
+static const double KeplerTolerance = 1.0e-6;
+static const int MaxKeplerIterations = 10;
+
+// Offsets of values in the parameter block filled in by SGP4_init()
+enum Sgp4Param
+{
+    P_X3thm1 = 0, P_X1mth2 = 1, P_C1 = 2, P_C4 = 3, P_Xnodcf = 4, P_T2cof = 5,
+    P_Xlcof = 6, P_Aycof = 7, P_X7thm1 = 8, P_Aodp = 9, P_Cosio = 10, P_Sinio = 11,
+    P_Omgdot = 12, P_Xmdot = 13, P_Xnodot = 14, P_Xnodp = 15, P_C5 = 16,
+    P_D2 = 17, P_D3 = 18, P_D4 = 19, P_Delmo = 20, P_Eta = 21, P_Omgcof = 22,
+    P_Sinmo = 23, P_T3cof = 24, P_T4cof = 25, P_T5cof = 26, P_Xmcof = 27,
+    P_SimpleFlag = 28
+};
+
+// Don't split the work into tasks smaller than this
+static const unsigned int MinObjectsPerTask = 1024;
+
+
+static inline double fmod2p(double x)
+{
+    double r = fmod(x, TwoPi);
+    if (r < 0.0)
+    {
+        r += TwoPi;
+    }
+    return r;
+}
+
+
+// The TLE epoch is a UTC Julian date; get the calendar date without any
+// leap second correction (see the TleTrajectory constructor.)
+static GregorianDate tleEpochDate(const tle_t& tle)
+{
+    GregorianDate calendarDate = GregorianDate::TDBDateFromTDBJD(tle.epoch);
+    calendarDate.setTimeScale(TimeScale_UTC);
+    return calendarDate;
+}
+
+
+TleBatchPropagator::TleBatchPropagator() :
+    m_objectCount(0),
+    m_maxApoapsis(0.0)
+{
+}
+
+
+TleBatchPropagator::~TleBatchPropagator()
+{
+}
+
+
+/** Add an object to the propagator. Returns false if the element set
+  * couldn't be parsed.
+  */
+bool
+TleBatchPropagator::addObject(const std::string& line1, const std::string& line2)
+{
+    return addObjects(&line1, &line2, 1) == 1;
+}
+
+
+/** Add count objects with the element sets given by the arrays of first
+  * and second lines. Element sets that can't be parsed are skipped. Returns
+  * the number of objects added.
+  *
+  * The epochs of all element sets are converted to TDB together, which is
+  * faster than converting them one at a time when loading a large catalog.
+  */
+unsigned int
+TleBatchPropagator::addObjects(const std::string* line1, const std::string* line2, unsigned int count)
+{
+    std::vector<tle_t> tles;
+    std::vector<GregorianDate> epochDates;
+    tles.reserve(count);
+    epochDates.reserve(count);
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        tle_t tle;
+        if (parse_elements(line1[i].c_str(), line2[i].c_str(), &tle) == 0)
+        {
+            tles.push_back(tle);
+            epochDates.push_back(tleEpochDate(tle));
+        }
+    }
+
+    if (tles.empty())
+    {
+        return 0;
+    }
+
+    std::vector<double> epochs(tles.size());
+    GregorianDate::toTDBSec(tles.size(), &epochDates[0], &epochs[0]);
+
+    for (unsigned int i = 0; i < tles.size(); ++i)
+    {
+        addElements(tles[i], epochs[i]);
+    }
+
+    return tles.size();
+}
+
+
+// Initialize the model for an element set and append it to the model
+// constants. The epoch is in seconds since J2000 TDB.
+void
+TleBatchPropagator::addElements(const tle_t& tle, double epoch)
+{
+    double params[N_SAT_PARAMS];
+    memset(params, 0, sizeof(params));
+
+    if (select_ephemeris(&tle) != 0)
+    {
+        DeepSpaceObject obj;
+        obj.epoch = epoch;
+        obj.slot = m_objectCount;
+        obj.tle = tle;
+        SDP4_init(params, &tle);
+        memcpy(obj.params, params, sizeof(params));
+        m_deepSpaceObjects.push_back(obj);
+    }
+    else
+    {
+        SGP4_init(params, &tle);
+
+        double values[NearEarthFieldCount];
+        values[Epoch]  = epoch;
+        values[Xmo]    = tle.xmo;
+        values[Omegao] = tle.omegao;
+        values[Xnodeo] = tle.xnodeo;
+        values[Bstar]  = tle.bstar;
+        values[Eo]     = tle.eo;
+        values[Xincl]  = tle.xincl;
+        values[Aodp]   = params[P_Aodp];
+        values[Xnodp]  = params[P_Xnodp];
+        values[Cosio]  = params[P_Cosio];
+        values[Sinio]  = params[P_Sinio];
+        values[Xmdot]  = params[P_Xmdot];
+        values[Omgdot] = params[P_Omgdot];
+        values[Xnodot] = params[P_Xnodot];
+        values[Xnodcf] = params[P_Xnodcf];
+        values[C1]     = params[P_C1];
+        values[C4]     = params[P_C4];
+        values[C5]     = params[P_C5];
+        values[T2cof]  = params[P_T2cof];
+        values[Xlcof]  = params[P_Xlcof];
+        values[Aycof]  = params[P_Aycof];
+        values[X3thm1] = params[P_X3thm1];
+        values[X1mth2] = params[P_X1mth2];
+        values[X7thm1] = params[P_X7thm1];
+        values[Omgcof] = params[P_Omgcof];
+        values[Eta]    = params[P_Eta];
+        values[Xmcof]  = params[P_Xmcof];
+        values[Delmo]  = params[P_Delmo];
+        values[Sinmo]  = params[P_Sinmo];
+        values[D2]     = params[P_D2];
+        values[D3]     = params[P_D3];
+        values[D4]     = params[P_D4];
+        values[T3cof]  = params[P_T3cof];
+        values[T4cof]  = params[P_T4cof];
+        values[T5cof]  = params[P_T5cof];
+
+        for (unsigned int i = 0; i < NearEarthFieldCount; ++i)
+        {
+            m_nearEarth[i].push_back(values[i]);
+        }
+
+        int simpleFlag = 0;
+        memcpy(&simpleFlag, params + P_SimpleFlag, sizeof(int));
+        m_simpleModel.push_back(simpleFlag != 0 ? 1 : 0);
+        m_nearEarthSlots.push_back(m_objectCount);
+    }
+
+    // Both models store the semimajor axis (in Earth radii) at the same offset
+    m_maxApoapsis = max(m_maxApoapsis, params[P_Aodp] * (1.0 + tle.eo) * EarthRadius);
+
+    ++m_objectCount;
+}
+
+
+/** Remove all objects.
+  */
+void
+TleBatchPropagator::clear()
+{
+    for (unsigned int i = 0; i < NearEarthFieldCount; ++i)
+    {
+        m_nearEarth[i].clear();
+    }
+    m_simpleModel.clear();
+    m_nearEarthSlots.clear();
+    m_deepSpaceObjects.clear();
+    m_objectCount = 0;
+    m_maxApoapsis = 0.0;
+}
+
+
+// Propagate near-Earth objects in the range [begin, end). This follows the
+// SGP4() and sxpx_posn_vel() functions in noradtle exactly (so that results
+// are identical), omitting the velocity calculation.
+template<typename T> void
+TleBatchPropagator::propagateRange(double tdbSec, unsigned int begin, unsigned int end, T* positions) const
+{
+    const double* epoch  = &m_nearEarth[Epoch][0];
+    const double* xmo    = &m_nearEarth[Xmo][0];
+    const double* omegao = &m_nearEarth[Omegao][0];
+    const double* xnodeo = &m_nearEarth[Xnodeo][0];
+    const double* bstar  = &m_nearEarth[Bstar][0];
+    const double* eo     = &m_nearEarth[Eo][0];
+    const double* xincl  = &m_nearEarth[Xincl][0];
+    const double* aodp   = &m_nearEarth[Aodp][0];
+    const double* xnodp  = &m_nearEarth[Xnodp][0];
+    const double* cosio  = &m_nearEarth[Cosio][0];
+    const double* sinio  = &m_nearEarth[Sinio][0];
+    const double* xmdot  = &m_nearEarth[Xmdot][0];
+    const double* omgdot = &m_nearEarth[Omgdot][0];
+    const double* xnodot = &m_nearEarth[Xnodot][0];
+    const double* xnodcf = &m_nearEarth[Xnodcf][0];
+    const double* c1     = &m_nearEarth[C1][0];
+    const double* c4     = &m_nearEarth[C4][0];
+    const double* c5     = &m_nearEarth[C5][0];
+    const double* t2cof  = &m_nearEarth[T2cof][0];
+    const double* xlcof  = &m_nearEarth[Xlcof][0];
+    const double* aycof  = &m_nearEarth[Aycof][0];
+    const double* x3thm1 = &m_nearEarth[X3thm1][0];
+    const double* x1mth2 = &m_nearEarth[X1mth2][0];
+    const double* x7thm1 = &m_nearEarth[X7thm1][0];
+    const double* omgcof = &m_nearEarth[Omgcof][0];
+    const double* eta    = &m_nearEarth[Eta][0];
+    const double* xmcof  = &m_nearEarth[Xmcof][0];
+    const double* delmo  = &m_nearEarth[Delmo][0];
+    const double* sinmo  = &m_nearEarth[Sinmo][0];
+    const double* d2     = &m_nearEarth[D2][0];
+    const double* d3     = &m_nearEarth[D3][0];
+    const double* d4     = &m_nearEarth[D4][0];
+    const double* t3cof  = &m_nearEarth[T3cof][0];
+    const double* t4cof  = &m_nearEarth[T4cof][0];
+    const double* t5cof  = &m_nearEarth[T5cof][0];
+
+    for (unsigned int i = begin; i < end; ++i)
+    {
+        T* pos = positions + 3 * m_nearEarthSlots[i];
+
+        // Minutes since epoch
+        double tsince = (tdbSec - epoch[i]) / 60.0;
+
+        // Update for secular gravity and atmospheric drag
+        double xmdf = xmo[i] + xmdot[i] * tsince;
+        double omgadf = omegao[i] + omgdot[i] * tsince;
+        double xnoddf = xnodeo[i] + xnodot[i] * tsince;
+        double omega = omgadf;
+        double xmp = xmdf;
+        double tsq = tsince * tsince;
+        double xnode = xnoddf + xnodcf[i] * tsq;
+        double tempa = 1 - c1[i] * tsince;
+        double tempe = bstar[i] * c4[i] * tsince;
+        double templ = t2cof[i] * tsq;
+        if (!m_simpleModel[i])
+        {
+            double delomg = omgcof[i] * tsince;
+            double delm = 1.0 + eta[i] * cos(xmdf);
+            delm = xmcof[i] * (delm * delm * delm - delmo[i]);
+            double temp = delomg + delm;
+            xmp = xmdf + temp;
+            omega = omgadf - temp;
+            double tcube = tsq * tsince;
+            double tfour = tsince * tcube;
+            tempa = tempa - d2[i] * tsq - d3[i] * tcube - d4[i] * tfour;
+            tempe = tempe + bstar[i] * c5[i] * (sin(xmp) - sinmo[i]);
+            templ = templ + t3cof[i] * tcube + tfour * (t4cof[i] + tsince * t5cof[i]);
+        }
+
+        double a = aodp[i] * tempa * tempa;
+        double e = eo[i] - tempe;
+        double xl = xmp + omega + xnode + xnodp[i] * templ;
+
+        // Long period periodics
+        double axn = e * cos(omega);
+        double temp = 1 / (a * (1.0 - e * e));
+        double xll = temp * xlcof[i] * axn;
+        double aynl = temp * aycof[i];
+        double xlt = xl + xll;
+        double ayn = e * sin(omega) + aynl;
+        double elsq = axn * axn + ayn * ayn;
+        double capu = fmod2p(xlt - xnode);
+
+        // The model isn't valid for decayed objects
+        if (a <= 0.0 || a * (1.0 - e) <= 0.0 || elsq >= 1.0)
+        {
+            pos[0] = pos[1] = pos[2] = T(0);
+            continue;
+        }
+
+        // Solve Kepler's equation
+        double temp2 = capu;
+        double temp3 = 0.0;
+        double temp4 = 0.0;
+        double temp5 = 0.0;
+        double temp6 = 0.0;
+        double sinepw = 0.0;
+        double cosepw = 0.0;
+        int iter = 0;
+        do
+        {
+            sinepw = sin(temp2);
+            cosepw = cos(temp2);
+            temp3 = axn * sinepw;
+            temp4 = ayn * cosepw;
+            temp5 = axn * cosepw;
+            temp6 = ayn * sinepw;
+            double epw = (capu - temp4 + temp3 - temp2) / (1 - temp5 - temp6) + temp2;
+            if (fabs(epw - temp2) <= KeplerTolerance)
+            {
+                break;
+            }
+            temp2 = epw;
+        }
+        while (iter++ < MaxKeplerIterations);
+
+        // Short period preliminary quantities
+        double ecose = temp5 + temp6;
+        double esine = temp3 - temp4;
+        temp = 1 - elsq;
+        double pl = a * temp;
+        double r = a * (1 - ecose);
+        double temp1 = 1 / r;
+        temp2 = a * temp1;
+        double betal = sqrt(temp);
+        temp3 = 1 / (1 + betal);
+        double cosu = temp2 * (cosepw - axn + ayn * esine * temp3);
+        double sinu = temp2 * (sinepw - ayn - axn * esine * temp3);
+        double u = atan2(sinu, cosu);
+        double sin2u = 2 * sinu * cosu;
+        double cos2u = 2 * cosu * cosu - 1;
+        temp = 1 / pl;
+        temp1 = Ck2 * temp;
+        temp2 = temp1 * temp;
+
+        // Update for short periodics
+        double rk = r * (1 - 1.5 * temp2 * betal * x3thm1[i]) + 0.5 * temp1 * x1mth2[i] * cos2u;
+        double uk = u - 0.25 * temp2 * x7thm1[i] * sin2u;
+        double xnodek = xnode + 1.5 * temp2 * cosio[i] * sin2u;
+        double xinck = xincl[i] + 1.5 * temp2 * cosio[i] * sinio[i] * cos2u;
+
+        // Orientation vectors
+        double sinuk = sin(uk);
+        double cosuk = cos(uk);
+        double sinik = sin(xinck);
+        double cosik = cos(xinck);
+        double sinnok = sin(xnodek);
+        double cosnok = cos(xnodek);
+        double xmx = -sinnok * cosik;
+        double xmy = cosnok * cosik;
+        double ux = xmx * sinuk + cosnok * cosuk;
+        double uy = xmy * sinuk + sinnok * cosuk;
+        double uz = sinik * sinuk;
+
+        pos[0] = T(rk * ux * EarthRadius);
+        pos[1] = T(rk * uy * EarthRadius);
+        pos[2] = T(rk * uz * EarthRadius);
+    }
+}
+
+
+template<typename T> void
+TleBatchPropagator::propagateDeepSpaceRange(double tdbSec, unsigned int begin, unsigned int end, T* positions) const
+{
+    for (unsigned int i = begin; i < end; ++i)
+    {
+        const DeepSpaceObject& obj = m_deepSpaceObjects[i];
+        double tsince = (tdbSec - obj.epoch) / 60.0;
+
+        // SDP4 keeps the state of the resonance integrator and lunar-solar
+        // periodics in the params array, so it's evaluated on a private copy
+        // (as in TleTrajectory.) The position then depends only on the time,
+        // and tasks don't race on shared state.
+        double params[N_SAT_PARAMS];
+        memcpy(params, obj.params, sizeof(params));
+
+        double pos[3];
+        SDP4(tsince, &obj.tle, params, pos, NULL);
+
+        T* out = positions + 3 * obj.slot;
+        out[0] = T(pos[0]);
+        out[1] = T(pos[1]);
+        out[2] = T(pos[2]);
+    }
+}
+
+
+// Propagate one task's share of the near-Earth and deep space objects.
+template<typename T> void
+TleBatchPropagator::propagateTask(const TleBatchPropagator* propagator, double tdbSec, unsigned int task, unsigned int taskCount, T* positions)
+{
+    unsigned int nearCount = propagator->m_nearEarthSlots.size();
+    unsigned int deepCount = propagator->m_deepSpaceObjects.size();
+    propagator->propagateRange(tdbSec,
+                               unsigned(quint64(nearCount) * task / taskCount),
+                               unsigned(quint64(nearCount) * (task + 1) / taskCount),
+                               positions);
+    propagator->propagateDeepSpaceRange(tdbSec,
+                                        unsigned(quint64(deepCount) * task / taskCount),
+                                        unsigned(quint64(deepCount) * (task + 1) / taskCount),
+                                        positions);
+}
+
+
+template<typename T> void
+TleBatchPropagator::propagateAll(double tdbSec, T* positions) const
+{
+    if (m_objectCount == 0)
+    {
+        return;
+    }
+
+    unsigned int taskCount = max(1u, min(unsigned(max(1, QThread::idealThreadCount())), m_objectCount / MinObjectsPerTask));
+    if (taskCount == 1)
+    {
+        propagateTask(this, tdbSec, 0, 1, positions);
+    }
+    else
+    {
+        // Run the first task on this thread and the rest in the thread pool
+        void (*taskFunction)(const TleBatchPropagator*, double, unsigned int, unsigned int, T*) = &TleBatchPropagator::propagateTask<T>;
+        std::vector<QFuture<void> > futures;
+        for (unsigned int task = 1; task < taskCount; ++task)
+        {
+            futures.push_back(QtConcurrent::run(taskFunction, this, tdbSec, task, taskCount, positions));
+        }
+        propagateTask(this, tdbSec, 0, taskCount, positions);
+        for (unsigned int i = 0; i < futures.size(); ++i)
+        {
+            futures[i].waitForFinished();
+        }
+    }
+}
+
+
+/** Compute the positions of all objects at the specified time (seconds
+  * since J2000 TDB.) The positions array must have room for three values
+  * (x, y, z in km) per object. Positions are stored in the order that objects
+  * were added.
+  */
+void
+TleBatchPropagator::propagate(double tdbSec, float* positions) const
+{
+    propagateAll(tdbSec, positions);
+}
+
+
+/** Compute the positions of all objects at the specified time in double
+  * precision.
+  */
+void
+TleBatchPropagator::propagate(double tdbSec, double* positions) const
+{
+    propagateAll(tdbSec, positions);
+}
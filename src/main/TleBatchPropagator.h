@@ -0,0 +1,124 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef _TLE_BATCH_PROPAGATOR_H_
+#define _TLE_BATCH_PROPAGATOR_H_
+
+#include <noradtle/norad.h>
+#include <string>
+#include <vector>
+
+
+/** TleBatchPropagator computes positions for a large number of objects with
+  * two-line element sets (e.g. an entire catalog of Earth satellites and
+  * debris) at a single time.
+  *
+  * Near-Earth objects (period less than 225 minutes) are propagated with
+  * SGP4. Their initialized model constants are stored as separate arrays
+  * (one per quantity) rather than one structure per object, so the
+  * propagation loop streams through memory and has no per-object calls.
+  * Deep space objects use the SDP4 implementation from the noradtle library.
+  * The work is divided among threads from the global thread pool.
+  *
+  * Results match TleTrajectory within the TLE's range of validity. Unlike
+  * TleTrajectory, there is no switch to a Keplerian approximation far from
+  * the epoch. Objects for which the model breaks down (e.g. decayed
+  * satellites) are placed at the center of the Earth.
+  *
+  * SDP4 is evaluated on a private copy of each object's model parameters,
+  * since it keeps integrator state in them. Positions thus depend only on
+  * the time, and propagate() may be called from multiple threads at once.
+  */
+class TleBatchPropagator
+{
+public:
+    TleBatchPropagator();
+    ~TleBatchPropagator();
+
+    bool addObject(const std::string& line1, const std::string& line2);
+    unsigned int addObjects(const std::string* line1, const std::string* line2, unsigned int count);
+    void clear();
+
+    /** Get the total number of objects.
+      */
+    unsigned int objectCount() const
+    {
+        return m_objectCount;
+    }
+
+    /** Get the number of objects propagated with the deep space model.
+      */
+    unsigned int deepSpaceObjectCount() const
+    {
+        return m_deepSpaceObjects.size();
+    }
+
+    /** Get the largest apoapsis distance (in km) of all objects. This is
+      * computed from the mean elements, so a bounding radius should allow
+      * some margin.
+      */
+    double maxApoapsis() const
+    {
+        return m_maxApoapsis;
+    }
+
+    void propagate(double tdbSec, float* positions) const;
+    void propagate(double tdbSec, double* positions) const;
+
+private:
+    // Model constants for near-Earth objects; each has one array with an
+    // element per object.
+    enum NearEarthField
+    {
+        Epoch,
+        Xmo, Omegao, Xnodeo, Bstar, Eo, Xincl,
+        Aodp, Xnodp, Cosio, Sinio,
+        Xmdot, Omgdot, Xnodot, Xnodcf,
+        C1, C4, C5, T2cof,
+        Xlcof, Aycof, X3thm1, X1mth2, X7thm1,
+        Omgcof, Eta, Xmcof, Delmo, Sinmo,
+        D2, D3, D4, T3cof, T4cof, T5cof,
+        NearEarthFieldCount
+    };
+
+    struct DeepSpaceObject
+    {
+        double epoch;
+        unsigned int slot;
+        tle_t tle;
+        double params[N_SAT_PARAMS];
+    };
+
+private:
+    void addElements(const tle_t& tle, double epoch);
+    template<typename T> void propagateRange(double tdbSec, unsigned int begin, unsigned int end, T* positions) const;
+    template<typename T> void propagateDeepSpaceRange(double tdbSec, unsigned int begin, unsigned int end, T* positions) const;
+    template<typename T> void propagateAll(double tdbSec, T* positions) const;
+    template<typename T> static void propagateTask(const TleBatchPropagator* propagator, double tdbSec, unsigned int task, unsigned int taskCount, T* positions);
+
+private:
+    unsigned int m_objectCount;
+    double m_maxApoapsis;
+
+    std::vector<double> m_nearEarth[NearEarthFieldCount];
+    std::vector<unsigned char> m_simpleModel;
+    std::vector<unsigned int> m_nearEarthSlots;
+
+    std::vector<DeepSpaceObject> m_deepSpaceObjects;
+};
+
+#endif // _TLE_BATCH_PROPAGATOR_H_
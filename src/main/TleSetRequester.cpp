@@ -0,0 +1,148 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "TleSetRequester.h"
+#include "TleTrajectory.h"
+#include <QNetworkDiskCache>
+#include <QNetworkRequest>
+#include <QCryptographicHash>
+#include <QDebug>
+
+using namespace vesta;
+
+
+/** Create a new TLE set requester. Downloaded sets are stored in a disk cache
+  * in the specified directory.
+  */
+TleSetRequester::TleSetRequester(const QString& cacheDirectory, QObject* parent) :
+    QObject(parent),
+    m_networkManager(NULL)
+{
+    qRegisterMetaType<QList<TleRecord> >("QList<TleRecord>");
+
+    m_networkManager = new QNetworkAccessManager(this);
+    QNetworkDiskCache* cache = new QNetworkDiskCache(this);
+    cache->setCacheDirectory(cacheDirectory);
+    m_networkManager->setCache(cache);
+    connect(m_networkManager, SIGNAL(finished(QNetworkReply*)), this, SLOT(processReply(QNetworkReply*)));
+}
+
+
+TleSetRequester::~TleSetRequester()
+{
+}
+
+
+/** Request a TLE set from the specified URL. When the set is cached, the
+  * network manager revalidates it with a conditional GET, and an unmodified
+  * set is read from the disk cache rather than downloaded again.
+  */
+void
+TleSetRequester::requestTleSet(const QString& source)
+{
+    QNetworkRequest request(source);
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferNetwork);
+    m_networkManager->get(request);
+}
+
+
+void
+TleSetRequester::processReply(QNetworkReply* reply)
+{
+    if (reply->error() == QNetworkReply::NoError)
+    {
+        processTleSet(reply->url().toString(), reply->readAll());
+    }
+    else
+    {
+        qDebug() << "Error retrieving TLE set " << reply->url().toString() << ": " << reply->errorString();
+    }
+
+    reply->deleteLater();
+}
+
+
+/** Parse a TLE set in the three line format (name followed by the two lines
+  * of the element set.) Records that are new or have changed since the
+  * last time that the source was processed are sent with the
+  * tleRecordsChanged signal.
+  */
+void
+TleSetRequester::processTleSet(const QString& source, const QByteArray& data)
+{
+    QByteArray sourceHash = QCryptographicHash::hash(data, QCryptographicHash::Md5);
+    if (m_sourceHashes.value(source) == sourceHash)
+    {
+        return;
+    }
+    m_sourceHashes.insert(source, sourceHash);
+
+    QList<TleRecord> changedRecords;
+    unsigned int recordCount = 0;
+
+    int pos = 0;
+    while (pos < data.size())
+    {
+        QByteArray lines[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            int end = data.indexOf('\n', pos);
+            if (end < 0)
+            {
+                end = data.size();
+            }
+            lines[i] = data.mid(pos, end - pos).trimmed();
+            pos = end + 1;
+        }
+
+        if (lines[0].isEmpty())
+        {
+            break;
+        }
+        recordCount++;
+
+        QString name = QString::fromLatin1(lines[0]);
+        QString key = source + "!" + name;
+        QByteArray recordHash = QCryptographicHash::hash(lines[1] + '\n' + lines[2], QCryptographicHash::Md5);
+        if (m_recordHashes.value(key) == recordHash)
+        {
+            continue;
+        }
+        m_recordHashes.insert(key, recordHash);
+
+        // Validate here rather than on the GUI thread
+        counted_ptr<TleTrajectory> tle(TleTrajectory::Create(lines[1].constData(), lines[2].constData()));
+        if (tle.isNull())
+        {
+            qDebug() << "Bad TLE received: " << name << " from " << source;
+            continue;
+        }
+
+        TleRecord record;
+        record.source = source;
+        record.name = name;
+        record.line1 = QString::fromLatin1(lines[1]);
+        record.line2 = QString::fromLatin1(lines[2]);
+        changedRecords << record;
+    }
+
+    qDebug() << "TLE set " << source << ": " << changedRecords.size() << " of " << recordCount << " records changed";
+
+    if (!changedRecords.isEmpty())
+    {
+        emit tleRecordsChanged(changedRecords);
+    }
+}
@@ -0,0 +1,79 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _TLE_SET_REQUESTER_H_
+#define _TLE_SET_REQUESTER_H_
+
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QHash>
+#include <QList>
+#include <QMetaType>
+#include <QString>
+
+
+/** A single element set from a TLE set, e.g. one of the Celestrak groups.
+  */
+struct TleRecord
+{
+    QString source;
+    QString name;
+    QString line1;
+    QString line2;
+};
+
+Q_DECLARE_METATYPE(QList<TleRecord>)
+
+
+/** TleSetRequester fetches and parses TLE sets. It is intended to be moved
+  * to a worker thread so that neither reading the sets nor validating the
+  * element sets stalls the GUI thread.
+  *
+  * The requester remembers a hash of the lines of every element set that it
+  * has delivered, and the tleRecordsChanged signal carries only those records
+  * that are new or differ from the last delivered version.
+  */
+class TleSetRequester : public QObject
+{
+    Q_OBJECT
+
+public:
+    TleSetRequester(const QString& cacheDirectory, QObject* parent = NULL);
+    ~TleSetRequester();
+
+    void processTleSet(const QString& source, const QByteArray& data);
+
+public slots:
+    void requestTleSet(const QString& source);
+
+private slots:
+    void processReply(QNetworkReply* reply);
+
+signals:
+    void tleRecordsChanged(const QList<TleRecord>& records);
+
+private:
+    QNetworkAccessManager* m_networkManager;
+
+    // Hash of the complete contents of each source, used to skip parsing
+    // entirely when a set hasn't changed at all.
+    QHash<QString, QByteArray> m_sourceHashes;
+
+    // Hash of the line pair of each element set, keyed by source and name
+    QHash<QString, QByteArray> m_recordHashes;
+};
+
+#endif // _TLE_SET_REQUESTER_H_
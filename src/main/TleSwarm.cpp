@@ -0,0 +1,151 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "TleSwarm.h"
+#include <vesta/RenderContext.h>
+#include <algorithm>
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+// Margin added to the apoapsis of the largest orbit when computing the
+// bounding radius; perturbations can carry objects a bit beyond the
+// mean apoapsis.
+static const double BoundingRadiusMargin = 1.1;
+
+
+TleSwarm::TleSwarm() :
+    m_color(Spectrum(1.0f, 1.0f, 1.0f)),
+    m_opacity(1.0f),
+    m_pointSize(1.0f),
+    m_fadeSize(50.0f),
+    m_positionsTime(0.0),
+    m_positionsValid(false)
+{
+#ifndef VESTA_OGLES2
+    setClippingPolicy(PreventClipping);
+#endif
+}
+
+
+TleSwarm::~TleSwarm()
+{
+}
+
+
+void
+TleSwarm::render(RenderContext& rc, double clock) const
+{
+    unsigned int objectCount = m_propagator.objectCount();
+    if (objectCount == 0)
+    {
+        return;
+    }
+
+    // Contents are never treated as opaque; always draw during the translucent pass
+    if (rc.pass() != RenderContext::TranslucentPass)
+    {
+        return;
+    }
+
+    float fadeFactor = SwarmPointRenderer::fadeFactor(rc, boundingSphereRadius(), m_fadeSize);
+    if (fadeFactor < 0.001f)
+    {
+        // Total fade out
+        return;
+    }
+
+    // Propagate only when the time has changed; the swarm may be drawn
+    // more than once per frame (e.g. in multiple depth buffer spans.)
+    if (!m_positionsValid || clock != m_positionsTime)
+    {
+        m_positions.resize(objectCount * 3);
+        m_propagator.propagate(clock, &m_positions[0]);
+        m_positionsTime = clock;
+        m_positionsValid = true;
+    }
+
+    float effectiveOpacity = fadeFactor * m_opacity;
+
+    float* vertexData = m_points.mapPoints(objectCount);
+    if (!vertexData)
+    {
+        return;
+    }
+
+    for (unsigned int i = 0; i < objectCount; ++i)
+    {
+        float* vertex = vertexData + i * SwarmPointRenderer::VertexStride;
+        vertex[0] = m_positions[i * 3];
+        vertex[1] = m_positions[i * 3 + 1];
+        vertex[2] = m_positions[i * 3 + 2];
+        SwarmPointRenderer::setColor(vertex, m_color, effectiveOpacity);
+    }
+
+    m_points.unmapPoints();
+    m_points.draw(rc, objectCount, m_pointSize, effectiveOpacity);
+}
+
+
+float
+TleSwarm::boundingSphereRadius() const
+{
+    return float(m_propagator.maxApoapsis() * BoundingRadiusMargin);
+}
+
+
+bool
+TleSwarm::isOpaque() const
+{
+    return false;
+}
+
+
+/** Add an object to the swarm. Returns false if the two-line element set
+  * couldn't be parsed.
+  */
+bool
+TleSwarm::addObject(const std::string& line1, const std::string& line2)
+{
+    m_positionsValid = false;
+    return m_propagator.addObject(line1, line2);
+}
+
+
+/** Add count objects with the element sets given by the arrays of first
+  * and second lines. Returns the number of element sets that could be
+  * parsed and were added.
+  */
+unsigned int
+TleSwarm::addObjects(const std::string* line1, const std::string* line2, unsigned int count)
+{
+    m_positionsValid = false;
+    return m_propagator.addObjects(line1, line2, count);
+}
+
+
+/** Remove all objects.
+  */
+void
+TleSwarm::clear()
+{
+    m_positionsValid = false;
+    m_propagator.clear();
+    m_positions.clear();
+    m_points.clear();
+}
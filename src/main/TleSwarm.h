@@ -0,0 +1,119 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _TLE_SWARM_H_
+#define _TLE_SWARM_H_
+
+#include "TleBatchPropagator.h"
+#include "SwarmPointRenderer.h"
+#include <vesta/Geometry.h>
+#include <vesta/Spectrum.h>
+#include <vector>
+
+
+/** TleSwarm draws every object in a catalog of two-line element sets as a
+  * point. Positions are computed on the CPU with a TleBatchPropagator once
+  * per frame, so the memory cost is fixed per object: the model constants,
+  * three floats for the position, and a vertex in the buffer drawn by a
+  * SwarmPointRenderer.
+  *
+  * Positions are relative to the center of the Earth and in the frame used
+  * by TleTrajectory, so the geometry should be attached to a body at the
+  * center of the Earth with an EME J2000 body frame.
+  */
+class TleSwarm : public vesta::Geometry
+{
+public:
+    TleSwarm();
+    ~TleSwarm();
+
+    virtual void render(vesta::RenderContext& rc, double clock) const;
+    virtual float boundingSphereRadius() const;
+    virtual bool isOpaque() const;
+
+    vesta::Spectrum color() const
+    {
+        return m_color;
+    }
+
+    void setColor(const vesta::Spectrum& color)
+    {
+        m_color = color;
+    }
+
+    float opacity() const
+    {
+        return m_opacity;
+    }
+
+    void setOpacity(float opacity)
+    {
+        m_opacity = opacity;
+    }
+
+    float pointSize() const
+    {
+        return m_pointSize;
+    }
+
+    void setPointSize(float pointSize)
+    {
+        m_pointSize = pointSize;
+    }
+
+    /** Get projected size (in pixels) of the swarm where it becomes
+     *  completely invisible. Fading is disabled when fadeSize is zero.
+     */
+    float fadeSize() const
+    {
+        return m_fadeSize;
+    }
+
+    /** Set projected size (in pixels) of the swarm where it becomes
+     *  completely invisible. Setting the fade size to zero disables fading.
+     */
+    void setFadeSize(float fadeSize)
+    {
+        m_fadeSize = fadeSize;
+    }
+
+    bool addObject(const std::string& line1, const std::string& line2);
+    unsigned int addObjects(const std::string* line1, const std::string* line2, unsigned int count);
+    void clear();
+
+    unsigned int objectCount() const
+    {
+        return m_propagator.objectCount();
+    }
+
+private:
+    TleBatchPropagator m_propagator;
+
+    vesta::Spectrum m_color;
+    float m_opacity;
+    float m_pointSize;
+    float m_fadeSize;
+
+    // Positions are cached for the most recently rendered time; they're only
+    // mutable because render() is const.
+    mutable std::vector<float> m_positions;
+    mutable double m_positionsTime;
+    mutable bool m_positionsValid;
+
+    mutable SwarmPointRenderer m_points;
+};
+
+#endif // _TLE_SWARM_H_
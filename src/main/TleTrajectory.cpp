@@ -19,6 +19,7 @@
 #include <vesta/Units.h>
 #include <vesta/GregorianDate.h>
 #include <vesta/Debug.h>
+#include <algorithm>
 
 using namespace vesta;
 using namespace Eigen;
@@ -109,6 +110,13 @@ TleTrajectory::tleState(double tsec) const
 
     Vector3d position;
     Vector3d velocity;
+
+    // The deep space models (SDP4 and SDP8) use the end of the params array
+    // as scratch space, and they keep the state of the resonance integrator
+    // and the lunar-solar periodics there between calls. Evaluating them on
+    // a private copy of the params keeps the trajectory safe to use from
+    // multiple threads, and makes the result depend only on the time rather
+    // than on whatever time was evaluated previously.
     switch (m_ephemerisType)
     {
     case TLE_EPHEMERIS_TYPE_SGP:
@@ -118,13 +126,21 @@ TleTrajectory::tleState(double tsec) const
        SGP4(tmin, m_tle, m_satParams, position.data(), velocity.data());
        break;
     case TLE_EPHEMERIS_TYPE_SDP4:
-       SDP4(tmin, m_tle, m_satParams, position.data(), velocity.data());
+       {
+           double params[N_SAT_PARAMS];
+           std::copy(m_satParams, m_satParams + N_SAT_PARAMS, params);
+           SDP4(tmin, m_tle, params, position.data(), velocity.data());
+       }
        break;
     case TLE_EPHEMERIS_TYPE_SGP8:
        SGP8(tmin, m_tle, m_satParams, position.data(), velocity.data());
        break;
     case TLE_EPHEMERIS_TYPE_SDP8:
-       SDP8(tmin, m_tle, m_satParams, position.data(), velocity.data());
+       {
+           double params[N_SAT_PARAMS];
+           std::copy(m_satParams, m_satParams + N_SAT_PARAMS, params);
+           SDP8(tmin, m_tle, params, position.data(), velocity.data());
+       }
        break;
     }
 
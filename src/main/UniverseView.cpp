@@ -52,6 +52,7 @@
 #include <vesta/Units.h>
 #include <vesta/Universe.h>
 #include <vesta/UniverseRenderer.h>
+#include <vesta/EvaluationContext.h>
 #include <vesta/WorldGeometry.h>
 #include <vesta/TextureMapLoader.h>
 #include <vesta/InertialFrame.h>
@@ -1253,10 +1254,15 @@ UniverseView::drawInfoOverlay()
             /*
             QString frameCountString = QString("%1 fps").arg(m_framesPerSecond);
             QString texMemString = QString("%1 MB textures").arg(double(m_textureLoader->textureMemoryUsed()) / (1024 * 1024));
-            m_textFont->render(frameCountString.toLatin1().data(), Vector2f(viewportWidth - 200.0f, 30.0f));
-            m_textFont->render(texMemString.toLatin1().data(), Vector2f(viewportWidth - 200.0f, 10.0f));
+            QString evalString = QString("%1 evaluated, %2 cached").arg(m_renderer->evaluationContext()->missCount()).arg(m_renderer->evaluationContext()->hitCount());
+            m_textFont->render(frameCountString.toLatin1().data(), Vector2f(viewportWidth - 200.0f, 50.0f));
+            m_textFont->render(texMemString.toLatin1().data(), Vector2f(viewportWidth - 200.0f, 30.0f));
+            m_textFont->render(evalString.toLatin1().data(), Vector2f(viewportWidth - 200.0f, 10.0f));
             */
 
+            // Positions computed while rendering the frame are reused here
+            EvaluationContext* evaluationContext = m_renderer->evaluationContext();
+
             // Display information about the selection
             if (m_selectedBody.isValid())
             {
@@ -1266,7 +1272,7 @@ UniverseView::drawInfoOverlay()
                 glColor4fv(textColor.data());
                 m_textFont->bind();
 
-                Vector3d r = m_observer->absolutePosition(m_simulationTime) - m_selectedBody->position(m_simulationTime);
+                Vector3d r = evaluationContext->observerPosition(m_observer.ptr()) - evaluationContext->position(m_selectedBody.ptr());
                 double distance = r.norm();
 
                 bool isEllipsoidal = m_selectedBody->geometry() && m_selectedBody->geometry()->isEllipsoidal();
@@ -1285,7 +1291,7 @@ UniverseView::drawInfoOverlay()
                 if (isEllipsoidal && distance < m_selectedBody->geometry()->ellipsoid().semiMajorAxisLength() * 5)
                 {
                     float dx = m_textFont->textWidth(distanceStdString);
-                    Vector3d q = m_selectedBody->orientation(m_simulationTime).conjugate() * r;
+                    Vector3d q = evaluationContext->orientation(m_selectedBody.ptr()).conjugate() * r;
 
                     PlanetographicCoordHemi coord = getPlanetographicCoordinate(q, m_selectedBody.ptr());
                     QString coordString = QString(" (%1\260%2, %3\260%4)").
@@ -58,6 +58,7 @@ My implementation of GUST86 has the following modifications:
 
 #include "Gust86.h"
 #include "Constants.h"
+#include "SatelliteTheoryCache.h"
 #include <vesta/Units.h>
 #include <cmath>
 
@@ -108,17 +109,40 @@ const double phi[5] = {5.702313,
                        4.206896};
 
 
-void
-CalcGust86Elem(double t, Gust86Orbit::Satellite body, double elements[6])
+// Terms shared by all satellites at one epoch: the time and the
+// fundamental arguments
+struct Gust86Terms
 {
-    double an[5],ae[5],ai[5];
+    double t;
+    double an[5];
+    double ae[5];
+    double ai[5];
+};
+
 
+static void
+CalcGust86Terms(double tdbSec, Gust86Terms* terms)
+{
+    const double GUST86_T0 = 2444239.5;
+
+    double t = secondsToDays(tdbSec) + (J2000 - GUST86_T0);
+    terms->t = t;
     for (int i = 0; i < 5; i++)
     {
-        an[i] = fmod(fqn[i] * t + phn[i], 2*M_PI);
-        ae[i] = fmod(fqe[i] * t + phe[i], 2*M_PI);
-        ai[i] = fmod(fqi[i] * t + phi[i], 2*M_PI);
+        terms->an[i] = fmod(fqn[i] * t + phn[i], 2*M_PI);
+        terms->ae[i] = fmod(fqe[i] * t + phe[i], 2*M_PI);
+        terms->ai[i] = fmod(fqi[i] * t + phi[i], 2*M_PI);
     }
+}
+
+
+static void
+CalcGust86Elem(const Gust86Terms& terms, Gust86Orbit::Satellite body, double elements[6])
+{
+    const double t = terms.t;
+    const double* an = terms.an;
+    const double* ae = terms.ae;
+    const double* ai = terms.ai;
 
     switch (body)
     {
@@ -564,19 +588,15 @@ EllipticToRectangularN(double mu,const double elem[6],double dt,
 
 
 
-/** Compute the areocentric state of the satellite in the frame of the Earth mean
-  * equator and equinox of J2000.
-  */
-StateVector
-Gust86Orbit::state(double tdbSec) const
-{
-    const double GUST86_T0 = 2444239.5;
+typedef SatelliteTheoryCache<Gust86Terms, Gust86Ephemeris::SatelliteCount> Gust86TermsCache;
+static Gust86TermsCache Gust86Cache;
 
-    double t = secondsToDays(tdbSec) + (J2000 - GUST86_T0);
-    int satIndex = (int) m_satellite;
 
+static StateVector
+CalcGust86State(const Gust86Terms& terms, unsigned int satIndex)
+{
     double elements[6];
-    CalcGust86Elem(t, m_satellite, elements);
+    CalcGust86Elem(terms, Gust86Orbit::Satellite(satIndex), elements);
 
     double x[6];
     EllipticToRectangularN(gust86_rmu[satIndex], elements, 0.0, x);
@@ -593,6 +613,23 @@ Gust86Orbit::state(double tdbSec) const
 }
 
 
+/** Compute the Uranocentric state of a satellite in the frame of the Earth mean
+  * equator and equinox of J2000.
+  */
+StateVector
+Gust86Ephemeris::state(double tdbSec, Gust86Orbit::Satellite satellite)
+{
+    return Gust86Cache.evaluate(tdbSec, (unsigned int) satellite, CalcGust86Terms, CalcGust86State);
+}
+
+
+StateVector
+Gust86Orbit::state(double tdbSec) const
+{
+    return Gust86Ephemeris::state(tdbSec, m_satellite);
+}
+
+
 Gust86Orbit::Gust86Orbit(Satellite satellite) :
     m_satellite(satellite),
     m_boundingRadius(0.0),
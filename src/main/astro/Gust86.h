@@ -63,4 +63,19 @@ private:
     double m_period;
 };
 
+
+/** Gust86Ephemeris evaluates the GUST86 theory for the five major Uranian
+  * satellites. The fundamental arguments common to all satellites are
+  * computed once per epoch, and results for recent epochs are cached so that
+  * the trajectories of all five satellites share them. Gust86Orbit
+  * trajectories are views onto this class.
+  */
+class Gust86Ephemeris
+{
+public:
+    static const unsigned int SatelliteCount = 5;
+
+    static vesta::StateVector state(double tdbSec, Gust86Orbit::Satellite satellite);
+};
+
 #endif // _ASTRO_GUST86_H_
@@ -40,6 +40,7 @@
 
 #include "L1.h"
 #include "Constants.h"
+#include "SatelliteTheoryCache.h"
 #include <vesta/Units.h>
 #include <vesta/OrbitalElements.h>
 #include <cmath>
@@ -918,29 +919,47 @@ static StateVector EllipticalToCartesian(double elements[6], double mu)
 
 
 
+// Terms shared by all satellites at one epoch: the time and the Chebyshev
+// polynomials used for the corrections to the elements.
+struct L1Terms
+{
+    double t;
+    double tn[9];
+};
+
+
+static void ComputeL1Terms(double tdbSec, L1Terms* terms)
+{
+    double jd = secondsToDays(tdbSec) + J2000;
+    double t = jd - L1_T0;
+
+    double a = -819.727638594856;
+    double b =  812.721806990360;
+    double x = (t / 365.25 - 0.5 * (b + a)) / (0.5 * (b - a));
+
+    terms->t = t;
+    terms->tn[0] = 1.0;
+    terms->tn[1] = x;
+    for (unsigned int i = 2; i < 9; ++i)
+    {
+        terms->tn[i] = 2.0 * x * terms->tn[i - 1] - terms->tn[i - 2];
+    }
+}
+
+
 static void ComputeL1Elements(unsigned int satIndex,
-                              double t,
+                              const L1Terms& terms,
                               double elements[6])
 {
     const L1Body* body = &L1Bodies[satIndex];
+    const double t = terms.t;
+    const double* tn = terms.tn;
 
     // Calculate corrections with Chebyshev polynomials.
     // TODO: This should only be done in the allowed date range
     double corrections[5] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
     if (true)
     {
-        double a = -819.727638594856;
-        double b =  812.721806990360;
-        double x = (t / 365.25 - 0.5 * (b + a)) / (0.5 * (b - a));
-
-        double tn[9];
-        tn[0] = 1.0;
-        tn[1] = x;
-        for (unsigned int i = 2; i < 9; ++i)
-        {
-            tn[i] = 2.0 * x * tn[i - 1] - tn[i - 2];
-        }
-
         for (unsigned int element = 0; element < 5; ++element)
         {
             for (unsigned int i = 0; i < 9; ++i)
@@ -1020,10 +1039,8 @@ Vector3d TransformL1ToEMEJ2000(Vector3d v)
 
 
 static StateVector
-ComputeL1State(unsigned int satIndex, double jd)
+ComputeL1State(const L1Terms& terms, unsigned int satIndex)
 {
-    double t = jd - L1_T0;
-
     // Fundamental arguments not required
     /*
     double args[17];
@@ -1045,7 +1062,7 @@ ComputeL1State(unsigned int satIndex, double jd)
      *         longitude of ascending node
      */
     double elements[6];
-    ComputeL1Elements(satIndex, t, elements);
+    ComputeL1Elements(satIndex, terms, elements);
 
     double mu = L1Bodies[satIndex].mu * (pow(astro::AU, 3.0) / pow(86400.0, 2.0));
 
@@ -1079,10 +1096,24 @@ static double L1TestStates[4][6] =
 #endif // TEST_L1
 
 
+typedef SatelliteTheoryCache<L1Terms, L1Ephemeris::SatelliteCount> L1TermsCache;
+static L1TermsCache L1Cache;
+
+
+/** Compute the Jovicentric state of a satellite in the frame of the Earth mean
+  * equator and equinox of J2000.
+  */
+StateVector
+L1Ephemeris::state(double tdbSec, L1Orbit::Satellite satellite)
+{
+    return L1Cache.evaluate(tdbSec, (unsigned int) satellite, ComputeL1Terms, ComputeL1State);
+}
+
+
 StateVector
 L1Orbit::state(double tdbSec) const
 {
-    return ComputeL1State((int) m_satellite, secondsToDays(tdbSec) + J2000);
+    return L1Ephemeris::state(tdbSec, m_satellite);
 #if 0
     // Compute the time as Julian days since midnight 1/1/1950 (TT)
     const double JD1950 = 2433282.5;
@@ -62,4 +62,18 @@ private:
     double m_period;
 };
 
+
+/** L1Ephemeris evaluates the L1 theory for the four Galilean satellites.
+  * The terms common to all satellites are computed once per epoch, and
+  * results for recent epochs are cached so that the trajectories of all four
+  * satellites share them. L1Orbit trajectories are views onto this class.
+  */
+class L1Ephemeris
+{
+public:
+    static const unsigned int SatelliteCount = 4;
+
+    static vesta::StateVector state(double tdbSec, L1Orbit::Satellite satellite);
+};
+
 #endif // _ASTRO_L1_H_
@@ -60,6 +60,7 @@ in MarsSatV1-0.f are
 
 #include "MarsSat.h"
 #include "Constants.h"
+#include "SatelliteTheoryCache.h"
 #include <vesta/Units.h>
 #include <cmath>
 
@@ -504,24 +505,38 @@ void EllipticToRectangularA(double mu,const double elem[6],double dt,
 }
 
 
-/** Compute the areocentric state of the satellite in the frame of the Earth mean
-  * equator and equinox of J2000.
-  */
-StateVector
-MarsSatOrbit::state(double tdbSec) const
+// Terms shared by all satellites at one epoch: the time and the orientation
+// of the Mars equator
+struct MarsSatTerms
+{
+    double t;
+    Matrix3d toJ2000;
+};
+
+typedef SatelliteTheoryCache<MarsSatTerms, MarsSatEphemeris::SatelliteCount> MarsSatTermsCache;
+static MarsSatTermsCache MarsSatCache;
+
+
+static void
+CalcMarsSatTerms(double tdbSec, MarsSatTerms* terms)
 {
     const double MARSSAT_T0 = 2451545.0 - 6491.5;
 
-    double t = secondsToDays(tdbSec) + (J2000 - MARSSAT_T0);
-    int satIndex = (int) m_satellite;
+    terms->t = secondsToDays(tdbSec) + (J2000 - MARSSAT_T0);
+    terms->toJ2000 = MarsSatToJ2000(terms->t);
+}
+
 
+static StateVector
+CalcMarsSatState(const MarsSatTerms& terms, unsigned int satIndex)
+{
     double elements[6];
-    CalcMarsSatElem(t, satIndex, elements);
+    CalcMarsSatElem(terms.t, satIndex, elements);
 
     double x[6];
     EllipticToRectangularA(mars_sat_bodies[satIndex].mu, elements, 0.0, x);
 
-    const Matrix3d r = MarsSatToJ2000(t);
+    const Matrix3d& r = terms.toJ2000;
     // Transform the state vector from the Saturn equatorial coordinate system
     // to EMEJ2000 and convert units (position from AU to km, velocity from
     // AU/year to km/sec)
@@ -532,6 +547,23 @@ MarsSatOrbit::state(double tdbSec) const
 }
 
 
+/** Compute the areocentric state of a satellite in the frame of the Earth mean
+  * equator and equinox of J2000.
+  */
+StateVector
+MarsSatEphemeris::state(double tdbSec, MarsSatOrbit::Satellite satellite)
+{
+    return MarsSatCache.evaluate(tdbSec, (unsigned int) satellite, CalcMarsSatTerms, CalcMarsSatState);
+}
+
+
+StateVector
+MarsSatOrbit::state(double tdbSec) const
+{
+    return MarsSatEphemeris::state(tdbSec, m_satellite);
+}
+
+
 MarsSatOrbit::MarsSatOrbit(Satellite satellite) :
     m_satellite(satellite),
     m_boundingRadius(0.0),
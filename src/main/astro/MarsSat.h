@@ -60,4 +60,19 @@ private:
     double m_period;
 };
 
+
+/** MarsSatEphemeris evaluates the MarsSat V1.0 theory of Phobos and Deimos.
+  * The orientation of the Mars equator is computed once per epoch, and
+  * results for recent epochs are cached so that the trajectories of both
+  * satellites share them. MarsSatOrbit trajectories are views onto this
+  * class.
+  */
+class MarsSatEphemeris
+{
+public:
+    static const unsigned int SatelliteCount = 2;
+
+    static vesta::StateVector state(double tdbSec, MarsSatOrbit::Satellite satellite);
+};
+
 #endif // _ASTRO_MARSSAT_H_
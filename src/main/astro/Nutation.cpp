@@ -1,3 +1,4 @@
+#include "Nutation.h"
 #include <vesta/Units.h>
 #include <cmath>
 
@@ -11,83 +12,12 @@ static const double ASEC360 = 1296000.0;
 
 /******** Code from USNO's NOVAS package. ******/
 
-/********iau2000b */
-
-void iau2000b (double jd_high, double jd_low,
-
-               double *dpsi, double *deps)
-/*
-------------------------------------------------------------------------
-
-   PURPOSE:
-      To compute the forced nutation of the non-rigid Earth based on
-      the IAU 2000B precession/nutation model.
-
-   REFERENCES:
-      McCarthy, D. and Luzum, B. (2003). "An Abridged Model of the
-         Precession & Nutation of the Celestial Pole," Celestial
-         Mechanics and Dynamical Astronomy, Volume 85, Issue 1,
-         Jan. 2003, p. 37. (IAU 2000B)
-      IERS Conventions (2003), Chapter 5.
-
-   INPUT
-   ARGUMENTS:
-      jd_high (double)
-         High-order part of TT Julian date.
-      jd_low (double)
-         Low-order part of TT Julian date.
-
-   OUTPUT
-   ARGUMENTS:
-      *dpsi (double)
-         Nutation (luni-solar + planetary) in longitude, in radians.
-      *deps (double)
-         Nutation (luni-solar + planetary) in obliquity, in radians.
-
-   RETURNED
-   VALUE:
-      None.
-
-   GLOBALS
-   USED:
-      T0, ASEC2RAD, TWOPI
-
-   FUNCTIONS
-   CALLED:
-      fmod      math.h
-      sin       math.h
-      cos       math.h
-
-   VER./DATE/
-   PROGRAMMER:
-      V1.0/09-03/JAB (USNO/AA)
-
-   NOTES:
-      1. IAU 2000B reproduces the IAU 2000A model to a precision of
-      1 milliarcsecond in the interval 1995-2020.
-
-------------------------------------------------------------------------
-*/
-{
-   short int i;
-
-/*
-   Planetary nutation (arcsec).  These fixed terms account for the
-   omission of the long-period planetary terms in the truncated model.
-*/
-
-   double dpplan = -0.000135;
-   double deplan =  0.000388;
-
-   double t, el, elp, f, d, om, arg, dp, de, sarg, carg, factor, dpsils,
-      depsls, dpsipl, depspl;
-
 /*
    Luni-Solar argument multipliers:
        L     L'    F     D     Om
 */
 
-   const short int nals_t[77][5] =
+static const short int nals_t[77][5] =
    {
        {  0,    0,    0,    0,    1, },
        {  0,    0,    2,   -2,    2, },
@@ -176,7 +106,7 @@ void iau2000b (double jd_high, double jd_low,
    row of fundamental-argument multipliers in 'nals_t'.
 */
 
-   const double cls_t[77][6] =
+static const double cls_t[77][6] =
       {
           { -172064161.0, -174666.0,  33386.0, 92052331.0,  9086.0, 15377.0 },
           { -13170906.0,   -1675.0, -13696.0,  5730336.0, -3015.0, -4587.0 },
@@ -257,6 +187,79 @@ void iau2000b (double jd_high, double jd_low,
           {      1290.0,       0.0,      0.0,     -556.0,     0.0,     0.0 }
  };
 
+
+/********iau2000b */
+
+void iau2000b (double jd_high, double jd_low,
+
+               double *dpsi, double *deps)
+/*
+------------------------------------------------------------------------
+
+   PURPOSE:
+      To compute the forced nutation of the non-rigid Earth based on
+      the IAU 2000B precession/nutation model.
+
+   REFERENCES:
+      McCarthy, D. and Luzum, B. (2003). "An Abridged Model of the
+         Precession & Nutation of the Celestial Pole," Celestial
+         Mechanics and Dynamical Astronomy, Volume 85, Issue 1,
+         Jan. 2003, p. 37. (IAU 2000B)
+      IERS Conventions (2003), Chapter 5.
+
+   INPUT
+   ARGUMENTS:
+      jd_high (double)
+         High-order part of TT Julian date.
+      jd_low (double)
+         Low-order part of TT Julian date.
+
+   OUTPUT
+   ARGUMENTS:
+      *dpsi (double)
+         Nutation (luni-solar + planetary) in longitude, in radians.
+      *deps (double)
+         Nutation (luni-solar + planetary) in obliquity, in radians.
+
+   RETURNED
+   VALUE:
+      None.
+
+   GLOBALS
+   USED:
+      T0, ASEC2RAD, TWOPI
+
+   FUNCTIONS
+   CALLED:
+      fmod      math.h
+      sin       math.h
+      cos       math.h
+
+   VER./DATE/
+   PROGRAMMER:
+      V1.0/09-03/JAB (USNO/AA)
+
+   NOTES:
+      1. IAU 2000B reproduces the IAU 2000A model to a precision of
+      1 milliarcsecond in the interval 1995-2020.
+
+------------------------------------------------------------------------
+*/
+{
+   short int i;
+
+/*
+   Planetary nutation (arcsec).  These fixed terms account for the
+   omission of the long-period planetary terms in the truncated model.
+*/
+
+   double dpplan = -0.000135;
+   double deplan =  0.000388;
+
+   double t, el, elp, f, d, om, arg, dp, de, sarg, carg, factor, dpsils,
+      depsls, dpsipl, depspl;
+
+
 /*
    Interval between fundamental epoch J2000.0 and given date.
 */
@@ -368,3 +371,62 @@ void iau2000b (double jd_high, double jd_low,
 
    return;
 }
+
+
+/** Compute upper bounds on the magnitude of the nth time derivative of the
+  * IAU 2000B nutation in longitude and obliquity. The bounds are the sums of
+  * the bounds for the individual terms of the series, and so hold for all
+  * dates within maxCenturies Julian centuries of J2000.
+  *
+  * \param order order of the derivative
+  * \param maxCenturies the largest interval from J2000 to consider
+  * \param dpsiBound receives the bound for the nutation in longitude (radians / sec^order)
+  * \param depsBound receives the bound for the nutation in obliquity (radians / sec^order)
+  */
+void iau2000bDerivativeBound(unsigned int order, double maxCenturies,
+                             double *dpsiBound, double *depsBound)
+{
+    // Rates of the Delaunay arguments (L, L', F, D, Om) in arcsec per
+    // Julian century; these are the linear terms of the fundamental
+    // arguments used in iau2000b.
+    static const double argRates[5] =
+    {
+        1717915923.2178, 129596581.0481, 1739527262.8478, 1602961601.2090, -6962890.5431
+    };
+
+    const double secondsPerCentury = 36525.0 * 86400.0;
+    const double factor = 1.0e-7 * ASEC2RAD;
+
+    double dpsiSum = 0.0;
+    double depsSum = 0.0;
+    for (unsigned int i = 0; i < 77; ++i)
+    {
+        double rate = 0.0;
+        for (unsigned int j = 0; j < 5; ++j)
+        {
+            rate += nals_t[i][j] * argRates[j];
+        }
+        double omega = fabs(rate) * ASEC2RAD / secondsPerCentury;
+
+        // By the Leibniz rule, the nth derivative of (a + b*t) sin(omega*t + phi)
+        // is bounded by |a + b*t| omega^n + n |b| omega^(n - 1)
+        double omegaN = pow(omega, double(order));
+        double omegaN1 = order > 0 ? pow(omega, double(order - 1)) : 0.0;
+
+        double dpsiAmp = fabs(cls_t[i][0]) + fabs(cls_t[i][1]) * maxCenturies + fabs(cls_t[i][2]);
+        double depsAmp = fabs(cls_t[i][3]) + fabs(cls_t[i][4]) * maxCenturies + fabs(cls_t[i][5]);
+        dpsiSum += dpsiAmp * omegaN + order * fabs(cls_t[i][1]) / secondsPerCentury * omegaN1;
+        depsSum += depsAmp * omegaN + order * fabs(cls_t[i][4]) / secondsPerCentury * omegaN1;
+    }
+
+    *dpsiBound = dpsiSum * factor;
+    *depsBound = depsSum * factor;
+
+    // The planetary terms are constant and only contribute to the value
+    // itself.
+    if (order == 0)
+    {
+        *dpsiBound += 0.000135 * ASEC2RAD;
+        *depsBound += 0.000388 * ASEC2RAD;
+    }
+}
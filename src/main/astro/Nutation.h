@@ -0,0 +1,26 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ASTRO_NUTATION_H_
+#define _ASTRO_NUTATION_H_
+
+void iau2000b(double jd_high, double jd_low,
+              double *dpsi, double *deps);
+
+void iau2000bDerivativeBound(unsigned int order, double maxCenturies,
+                             double *dpsiBound, double *depsBound);
+
+#endif // _ASTRO_NUTATION_H_
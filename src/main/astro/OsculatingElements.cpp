@@ -94,11 +94,59 @@ CalculateOsculatingElements(const StateVector& state, double gm, double epoch)
 }
 
 
+/** Solve Kepler's equation for a hyperbolic orbit, e sinh H - H = M, for
+  * the hyperbolic anomaly H. The eccentricity must be greater than one.
+  */
+double
+HyperbolicAnomaly(double ecc, double M)
+{
+    const unsigned int MaxIterations = 50;
+
+    // Starting guess from Danby. Since e sinh H - H is convex for H > 0 (and
+    // concave for H < 0), Newton's method converges from it for any M.
+    double H = M < 0.0 ? -log(-2.0 * M / ecc + 1.8) : log(2.0 * M / ecc + 1.8);
+    for (unsigned int i = 0; i < MaxIterations; ++i)
+    {
+        double dH = (ecc * sinh(H) - H - M) / (ecc * cosh(H) - 1.0);
+        H -= dH;
+        if (abs(dH) <= 1.0e-14 * (1.0 + abs(H)))
+        {
+            break;
+        }
+    }
+
+    return H;
+}
+
+
+/** Compute the state at time t of an object with the specified orbital
+  * elements. Elliptical and hyperbolic orbits are supported, but not
+  * parabolic ones.
+  */
 StateVector
 ElementsToStateVector(const OrbitalElements& el, double t)
 {
     double e = el.eccentricity;
     double M = el.meanAnomalyAtEpoch + el.meanMotion * (t - el.epoch);
+    Quaterniond q(OrbitalElements::orbitOrientation(el.inclination, el.longitudeOfAscendingNode, el.argumentOfPeriapsis));
+
+    if (e > 1.0)
+    {
+        // The semimajor axis is negative for hyperbolic orbits
+        double H = HyperbolicAnomaly(e, M);
+        double sinhH = sinh(H);
+        double coshH = cosh(H);
+        double w = sqrt(e * e - 1.0);
+
+        double semiMajorAxis = el.periapsisDistance / (1.0 - e);
+        Vector3d r(semiMajorAxis * (coshH - e), -semiMajorAxis * w * sinhH, 0.0);
+
+        double hdot = el.meanMotion / (e * coshH - 1.0);
+        Vector3d v(semiMajorAxis * sinhH * hdot, -semiMajorAxis * w * coshH * hdot, 0.0);
+
+        return StateVector(q * r, q * v);
+    }
+
     double E = OrbitalElements::eccentricAnomaly(e, M);
     double sinE = sin(E);
     double cosE = cos(E);
@@ -110,7 +158,6 @@ ElementsToStateVector(const OrbitalElements& el, double t)
     double edot = el.meanMotion / (1 - e * cosE);
     Vector3d v(-semiMajorAxis * sinE * edot, semiMajorAxis * w * cosE * edot, 0.0);
 
-    Quaterniond q(OrbitalElements::orbitOrientation(el.inclination, el.longitudeOfAscendingNode, el.argumentOfPeriapsis));
     return StateVector(q * r, q * v);
 }
 
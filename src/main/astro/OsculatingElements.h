@@ -26,4 +26,7 @@ CalculateOsculatingElements(const vesta::StateVector& state, double gm, double e
 vesta::StateVector
 ElementsToStateVector(const vesta::OrbitalElements& el, double t);
 
+double
+HyperbolicAnomaly(double ecc, double M);
+
 #endif // _ASTRO_OSCULATING_ELEMENTS_H_
@@ -0,0 +1,245 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "PrecessionNutation.h"
+#include "Precession.h"
+#include "Nutation.h"
+#include <vesta/Units.h>
+#include <QMutexLocker>
+#include <cmath>
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+const double PrecessionNutation::DefaultStep = 43200.0;
+
+// Table entries are computed in blocks of this many entries
+static const int BlockSize = 64;
+
+// Maximum number of blocks kept; 256 blocks cover 22 years at the default
+// step. The whole table is discarded when it grows larger than this.
+static const unsigned int MaxBlockCount = 256;
+
+// Range of dates (in Julian centuries from J2000) over which the nutation
+// error bound is computed
+static const double NutationBoundCenturies = 10.0;
+
+struct PrecessionNutation::Block
+{
+    PrecessionNutationAngles entries[BlockSize];
+};
+
+
+/** Create a new precession and nutation table.
+  *
+  * \param step the interval between table entries in seconds
+  */
+PrecessionNutation::PrecessionNutation(double step) :
+    m_step(step)
+{
+}
+
+
+PrecessionNutation::~PrecessionNutation()
+{
+    for (map<int, Block*>::const_iterator iter = m_blocks.begin(); iter != m_blocks.end(); ++iter)
+    {
+        delete iter->second;
+    }
+}
+
+
+/** Get the precession and nutation angles at the specified time.
+  *
+  * \param tdbSec time in seconds since J2000 TDB
+  */
+PrecessionNutationAngles
+PrecessionNutation::angles(double tdbSec) const
+{
+    QMutexLocker locker(&m_mutex);
+    return interpolate(tdbSec);
+}
+
+
+/** Get the precession and nutation angles at many times. This is more
+  * efficient than calling angles() for each time.
+  *
+  * \param count the number of times
+  * \param tdbSec array of times in seconds since J2000 TDB
+  * \param result array that receives the angles at each time
+  */
+void
+PrecessionNutation::angles(unsigned int count, const double* tdbSec, PrecessionNutationAngles* result) const
+{
+    QMutexLocker locker(&m_mutex);
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        result[i] = interpolate(tdbSec[i]);
+    }
+}
+
+
+/** Get an upper bound on the error in the interpolated nutation angles
+  * (in radians) for dates within 1000 years of J2000.
+  *
+  * For cubic interpolation between the middle two of four evenly spaced
+  * points, the error is at most 3/128 * h^4 * max|f''''|, where h is the
+  * step. The bound on the fourth derivative is computed term by term from
+  * the nutation series.
+  */
+double
+PrecessionNutation::maxNutationError() const
+{
+    double dpsiBound = 0.0;
+    double depsBound = 0.0;
+    iau2000bDerivativeBound(4, NutationBoundCenturies, &dpsiBound, &depsBound);
+
+    double h4 = m_step * m_step * m_step * m_step;
+    return 3.0 / 128.0 * h4 * max(dpsiBound, depsBound);
+}
+
+
+/** Compute the precession and nutation angles at the specified time
+  * without using the table.
+  *
+  * \param tdbSec time in seconds since J2000 TDB
+  */
+PrecessionNutationAngles
+PrecessionNutation::computeAngles(double tdbSec)
+{
+    PrecessionNutationAngles angles;
+
+    double jd = J2000 + secondsToDays(tdbSec);
+    double dzeta = 0.0;
+    double dz = 0.0;
+    double dtheta = 0.0;
+    PrecessionAngles_IAU1976(J2000, jd, &angles.zeta, &angles.z, &angles.theta, &dzeta, &dz, &dtheta);
+
+    // IAU 1976 mean obliquity
+    double T = secondsToDays(tdbSec) / 36525.0;
+    angles.meanObliquity = arcsecToRadians(84381.448 + T * (-46.8150 + T * (-0.00059 + T * 0.001813)));
+
+    // The nutation series expects TT; the difference from TDB is
+    // negligible here.
+    iau2000b(J2000, secondsToDays(tdbSec), &angles.dpsi, &angles.deps);
+
+    return angles;
+}
+
+
+/** Get the orientation of the mean equator and equinox of date with
+  * respect to the J2000 equator.
+  */
+Quaterniond
+PrecessionNutation::meanEquatorOrientation(const PrecessionNutationAngles& angles)
+{
+    return Quaterniond(AngleAxisd(-angles.zeta, Vector3d::UnitZ())) *
+           Quaterniond(AngleAxisd( angles.theta, Vector3d::UnitY())) *
+           Quaterniond(AngleAxisd(-angles.z, Vector3d::UnitZ()));
+}
+
+
+/** Get the orientation of the true equator and equinox of date with
+  * respect to the J2000 equator.
+  */
+Quaterniond
+PrecessionNutation::trueEquatorOrientation(const PrecessionNutationAngles& angles)
+{
+    double trueObliquity = angles.meanObliquity + angles.deps;
+    return meanEquatorOrientation(angles) *
+           Quaterniond(AngleAxisd( angles.meanObliquity, Vector3d::UnitX())) *
+           Quaterniond(AngleAxisd(-angles.dpsi, Vector3d::UnitZ())) *
+           Quaterniond(AngleAxisd(-trueObliquity, Vector3d::UnitX()));
+}
+
+
+/** Get the table shared by all users of precession and nutation.
+  */
+PrecessionNutation*
+PrecessionNutation::shared()
+{
+    static PrecessionNutation s_shared;
+    return &s_shared;
+}
+
+
+// Interpolate the angles from the four table entries surrounding the time.
+// Must be called with the mutex locked.
+PrecessionNutationAngles
+PrecessionNutation::interpolate(double tdbSec) const
+{
+    double x = tdbSec / m_step;
+    double k = floor(x);
+    double s = x - k;
+    int index = int(k);
+
+    // Lagrange weights for the entries at index - 1, index, index + 1, index + 2
+    double w[4];
+    w[0] = -s * (s - 1.0) * (s - 2.0) / 6.0;
+    w[1] = (s + 1.0) * (s - 1.0) * (s - 2.0) / 2.0;
+    w[2] = -(s + 1.0) * s * (s - 2.0) / 2.0;
+    w[3] = (s + 1.0) * s * (s - 1.0) / 6.0;
+
+    PrecessionNutationAngles result = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+    for (int i = 0; i < 4; ++i)
+    {
+        const PrecessionNutationAngles& e = entry(index - 1 + i);
+        result.zeta          += w[i] * e.zeta;
+        result.z             += w[i] * e.z;
+        result.theta         += w[i] * e.theta;
+        result.meanObliquity += w[i] * e.meanObliquity;
+        result.dpsi          += w[i] * e.dpsi;
+        result.deps          += w[i] * e.deps;
+    }
+
+    return result;
+}
+
+
+// Get a table entry, computing the block that contains it if necessary.
+// Must be called with the mutex locked.
+const PrecessionNutationAngles&
+PrecessionNutation::entry(int index) const
+{
+    // Round toward negative infinity so that negative indices work
+    int blockIndex = index >= 0 ? index / BlockSize : -((-index - 1) / BlockSize) - 1;
+
+    map<int, Block*>::const_iterator iter = m_blocks.find(blockIndex);
+    if (iter != m_blocks.end())
+    {
+        return iter->second->entries[index - blockIndex * BlockSize];
+    }
+
+    if (m_blocks.size() >= MaxBlockCount)
+    {
+        for (iter = m_blocks.begin(); iter != m_blocks.end(); ++iter)
+        {
+            delete iter->second;
+        }
+        m_blocks.clear();
+    }
+
+    Block* block = new Block;
+    for (int i = 0; i < BlockSize; ++i)
+    {
+        block->entries[i] = computeAngles((blockIndex * BlockSize + i) * m_step);
+    }
+    m_blocks[blockIndex] = block;
+
+    return block->entries[index - blockIndex * BlockSize];
+}
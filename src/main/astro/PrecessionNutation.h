@@ -0,0 +1,97 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ASTRO_PRECESSION_NUTATION_H_
+#define _ASTRO_PRECESSION_NUTATION_H_
+
+#include <Eigen/Geometry>
+#include <QMutex>
+#include <map>
+
+
+/** Precession and nutation angles of the Earth at some date. All angles
+  * are in radians.
+  */
+struct PrecessionNutationAngles
+{
+    // IAU 1976 precession angles from J2000 to the date
+    double zeta;
+    double z;
+    double theta;
+
+    // IAU 1976 mean obliquity of the ecliptic at the date
+    double meanObliquity;
+
+    // IAU 2000B nutation in longitude and obliquity
+    double dpsi;
+    double deps;
+};
+
+
+/** PrecessionNutation provides the precession and nutation of the Earth by
+  * interpolating in a table of angles. Entries are computed as needed at
+  * a fixed step (half a day by default) and the angles are interpolated
+  * with cubic polynomials through the four nearest entries.
+  *
+  * The precession angles and the mean obliquity are cubic polynomials in
+  * time, so interpolating them is exact apart from roundoff. The error in
+  * the interpolated nutation angles is bounded by maxNutationError(); for
+  * the default step, the bound is a few hundredths of a milliarcsecond,
+  * much smaller than the 1 mas accuracy of the IAU 2000B model itself.
+  *
+  * The table is shared by all frames that need precession or nutation (see
+  * shared()), and may be used from multiple threads.
+  */
+class PrecessionNutation
+{
+public:
+    explicit PrecessionNutation(double step = DefaultStep);
+    ~PrecessionNutation();
+
+    /** Get the interval between table entries in seconds.
+      */
+    double step() const
+    {
+        return m_step;
+    }
+
+    PrecessionNutationAngles angles(double tdbSec) const;
+    void angles(unsigned int count, const double* tdbSec, PrecessionNutationAngles* result) const;
+
+    double maxNutationError() const;
+
+    static PrecessionNutationAngles computeAngles(double tdbSec);
+    static Eigen::Quaterniond meanEquatorOrientation(const PrecessionNutationAngles& angles);
+    static Eigen::Quaterniond trueEquatorOrientation(const PrecessionNutationAngles& angles);
+
+    static PrecessionNutation* shared();
+
+    // Default table step in seconds
+    static const double DefaultStep;
+
+private:
+    struct Block;
+
+    PrecessionNutationAngles interpolate(double tdbSec) const;
+    const PrecessionNutationAngles& entry(int index) const;
+
+private:
+    double m_step;
+    mutable QMutex m_mutex;
+    mutable std::map<int, Block*> m_blocks;
+};
+
+#endif // _ASTRO_PRECESSION_NUTATION_H_
@@ -0,0 +1,161 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _ASTRO_SATELLITE_THEORY_CACHE_H_
+#define _ASTRO_SATELLITE_THEORY_CACHE_H_
+
+#include <vesta/StateVector.h>
+#include <QMutex>
+#include <QMutexLocker>
+
+
+/** SatelliteTheoryCache holds the results of an analytical satellite theory
+  * for the few most recently evaluated epochs. Each entry stores the terms
+  * shared by all satellites of the system (e.g. the long-period series in
+  * TASS17) and the states of whichever satellites have been computed at
+  * that epoch.
+  *
+  * The theories supply a function that computes the shared terms and one
+  * that derives the state of a satellite from them; evaluate() calls these
+  * only for what isn't already cached.
+  *
+  * The cache may be used from multiple threads. Evaluation of the theory
+  * happens outside the lock; the lock is only held while copying to or
+  * from the cache. A state that is already cached costs a single lock.
+  */
+template<typename Terms, unsigned int SatelliteCount>
+class SatelliteTheoryCache
+{
+public:
+    /** Function that computes the shared terms at a time (seconds since
+      * J2000 TDB.)
+      */
+    typedef void (*ComputeTerms)(double tdbSec, Terms* terms);
+
+    /** Function that computes the state of one satellite from the shared
+      * terms.
+      */
+    typedef vesta::StateVector (*ComputeState)(const Terms& terms, unsigned int satellite);
+
+    SatelliteTheoryCache() :
+        m_nextEntry(0)
+    {
+        for (unsigned int i = 0; i < EntryCount; ++i)
+        {
+            m_entries[i].valid = false;
+        }
+    }
+
+    /** Get the state of a satellite at the specified time, computing the
+      * shared terms and the state only if they aren't already cached.
+      */
+    vesta::StateVector evaluate(double tdbSec, unsigned int satellite,
+                                ComputeTerms computeTerms, ComputeState computeState)
+    {
+        // Look up the state, and copy the shared terms if only they are cached
+        Terms terms;
+        bool haveTerms = false;
+        {
+            QMutexLocker locker(&m_mutex);
+            const Entry* entry = findEntry(tdbSec);
+            if (entry)
+            {
+                if (entry->stateValid[satellite])
+                {
+                    return entry->states[satellite];
+                }
+
+                terms = entry->terms;
+                haveTerms = true;
+            }
+        }
+
+        if (!haveTerms)
+        {
+            computeTerms(tdbSec, &terms);
+        }
+
+        vesta::StateVector state = computeState(terms, satellite);
+
+        // Another thread may have added the same epoch in the meantime, or
+        // replaced the entry that the terms came from.
+        QMutexLocker locker(&m_mutex);
+        Entry* entry = findEntry(tdbSec);
+        if (!entry)
+        {
+            entry = addEntry(tdbSec, terms);
+        }
+        entry->states[satellite] = state;
+        entry->stateValid[satellite] = true;
+
+        return state;
+    }
+
+private:
+    static const unsigned int EntryCount = 4;
+
+    struct Entry
+    {
+        bool valid;
+        double tdbSec;
+        Terms terms;
+        bool stateValid[SatelliteCount];
+        vesta::StateVector states[SatelliteCount];
+    };
+
+    const Entry* findEntry(double tdbSec) const
+    {
+        for (unsigned int i = 0; i < EntryCount; ++i)
+        {
+            if (m_entries[i].valid && m_entries[i].tdbSec == tdbSec)
+            {
+                return &m_entries[i];
+            }
+        }
+
+        return NULL;
+    }
+
+    Entry* findEntry(double tdbSec)
+    {
+        return const_cast<Entry*>(static_cast<const SatelliteTheoryCache*>(this)->findEntry(tdbSec));
+    }
+
+    // Add the shared terms for a new epoch, replacing the oldest entry. The
+    // caller must hold the lock.
+    Entry* addEntry(double tdbSec, const Terms& terms)
+    {
+        Entry& entry = m_entries[m_nextEntry];
+        m_nextEntry = (m_nextEntry + 1) % EntryCount;
+
+        entry.valid = true;
+        entry.tdbSec = tdbSec;
+        entry.terms = terms;
+        for (unsigned int i = 0; i < SatelliteCount; ++i)
+        {
+            entry.stateValid[i] = false;
+        }
+
+        return &entry;
+    }
+
+private:
+    mutable QMutex m_mutex;
+    Entry m_entries[EntryCount];
+    unsigned int m_nextEntry;
+};
+
+#endif // _ASTRO_SATELLITE_THEORY_CACHE_H_
@@ -62,6 +62,7 @@ My modifications are:
 
 #include "TASS17.h"
 #include "Constants.h"
+#include "SatelliteTheoryCache.h"
 #include <vesta/Units.h>
 #include <vesta/InertialFrame.h>
 #include <cmath>
@@ -3242,21 +3243,32 @@ void EllipticToRectangularN(double mu,const double elem[6],double dt,
 }
 
 
-/** Compute the Saturnocentric state of the satellite in the frame of the Earth mean
-  * equator and equinox of J2000.
-  */
-StateVector
-TASS17Orbit::state(double tdbSec) const
+// Terms shared by all satellites at one epoch
+struct TASS17Terms
+{
+    double t;
+    double longitudes[7];
+};
+
+typedef SatelliteTheoryCache<TASS17Terms, TASS17Ephemeris::SatelliteCount> TASS17TermsCache;
+static TASS17TermsCache TASS17Cache;
+
+
+static void
+CalcTass17Terms(double tdbSec, TASS17Terms* terms)
 {
     const double TASS17_T0 = 2444240.0;
 
-    double t = secondsToDays(tdbSec) + (J2000 - TASS17_T0);
-    int satIndex = (int) m_satellite;
+    terms->t = secondsToDays(tdbSec) + (J2000 - TASS17_T0);
+    CalcLon(terms->t, terms->longitudes);
+}
 
-    double longitudes[7];
+
+static StateVector
+CalcTass17State(const TASS17Terms& terms, unsigned int satIndex)
+{
     double elements[6];
-    CalcLon(t, longitudes);
-    CalcTass17Elem(t, longitudes, satIndex, elements);
+    CalcTass17Elem(terms.t, terms.longitudes, satIndex, elements);
 
     double x[6];
     EllipticToRectangularN(tass17bodies[satIndex].mu, elements, 0.0, x);
@@ -3274,6 +3286,23 @@ TASS17Orbit::state(double tdbSec) const
 }
 
 
+/** Compute the Saturnocentric state of a satellite in the frame of the Earth mean
+  * equator and equinox of J2000.
+  */
+StateVector
+TASS17Ephemeris::state(double tdbSec, TASS17Orbit::Satellite satellite)
+{
+    return TASS17Cache.evaluate(tdbSec, (unsigned int) satellite, CalcTass17Terms, CalcTass17State);
+}
+
+
+StateVector
+TASS17Orbit::state(double tdbSec) const
+{
+    return TASS17Ephemeris::state(tdbSec, m_satellite);
+}
+
+
 TASS17Orbit::TASS17Orbit(Satellite satellite) :
     m_satellite(satellite),
     m_boundingRadius(0.0),
@@ -66,4 +66,19 @@ private:
     double m_period;
 };
 
+
+/** TASS17Ephemeris evaluates the TASS 1.7 theory for the whole Saturnian
+  * system. The long-period longitude series that every satellite depends on
+  * is summed only once per epoch, and results for recent epochs are cached
+  * so that the trajectories of all eight satellites share them.
+  * TASS17Orbit trajectories are views onto this class.
+  */
+class TASS17Ephemeris
+{
+public:
+    static const unsigned int SatelliteCount = 8;
+
+    static vesta::StateVector state(double tdbSec, TASS17Orbit::Satellite satellite);
+};
+
 #endif // _ASTRO_TASS17_H_
@@ -15,15 +15,334 @@
 // limitations under the License.
 
 #include "AstorbLoader.h"
+#include "NumericTableReader.h"
 #include "../astro/Constants.h"
 #include <vesta/Units.h>
 #include <vesta/GregorianDate.h>
 #include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QDateTime>
 #include <QDebug>
-#include <QRegExp>
 #include <QDataStream>
+#include <QThread>
+#include <QtConcurrentRun>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
 
 using namespace vesta;
+using namespace std;
+
+
+// Zero-based column ranges of the fields used from astorb.dat records. The last
+// field ends at column 181; shorter lines are ignored.
+static const int NameStart          = 7;
+static const int NameEnd            = 26;
+static const int EpochYearStart     = 106;
+static const int EpochMonthStart    = 110;
+static const int EpochDayStart      = 112;
+static const int MeanAnomalyStart   = 115;
+static const int ArgOfPeriStart     = 126;
+static const int AscendingNodeStart = 137;
+static const int InclinationStart   = 148;
+static const int EccentricityStart  = 158;
+static const int SmaStart           = 169;
+static const int MinRecordLength    = 181;
+
+// Files smaller than this are parsed in a single chunk
+static const qint64 MinAstorbChunkSize = 256 * 1024;
+
+// The cache file has a 40 byte header followed by the swarm objects:
+//   magic               (8 bytes)
+//   source file size    (64-bit integer)
+//   source file mtime   (64-bit integer, milliseconds since 1970)
+//   object count        (32-bit integer)
+//   object size         (32-bit integer)
+//   swarm epoch         (64-bit double, seconds since J2000 TDB)
+// All values are little endian.
+static const char AstorbCacheMagic[8] = { 'A', 'S', 'T', 'C', 'A', 'C', 'H', '1' };
+static const int AstorbCacheHeaderSize = 40;
+
+
+struct AstorbChunk
+{
+    AstorbChunk() : begin(NULL), end(NULL), epoch(0.0), badRecordCount(0) {}
+
+    const char* begin;
+    const char* end;
+    double epoch;
+    std::vector<KeplerianSwarm::KeplerianObject> objects;
+    unsigned int badRecordCount;
+};
+
+
+// Parse a fixed width field as a double. Leading and trailing spaces are ignored.
+static bool
+parseField(const char* record, int start, int end, double* value)
+{
+    const char* p = record + start;
+    const char* fieldEnd = record + end;
+    while (p < fieldEnd && *p == ' ')
+    {
+        ++p;
+    }
+    while (fieldEnd > p && fieldEnd[-1] == ' ')
+    {
+        --fieldEnd;
+    }
+
+    return NumericTableReader::parseDouble(p, fieldEnd, value);
+}
+
+
+// Parse a fixed width field of digits
+static int
+parseDigits(const char* record, int start, int length)
+{
+    int value = 0;
+    for (int i = start; i < start + length; ++i)
+    {
+        value = value * 10 + (record[i] - '0');
+    }
+
+    return value;
+}
+
+
+static bool
+isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+
+// Parse a single astorb record. The epoch conversion is only done when the
+// epoch date differs from that of the previous record, as most records in
+// the file share the same epoch.
+static bool
+parseAstorbRecord(const char* record, OrbitalElements* el, double* discoveryTime, int* lastEpochDate, double* lastEpoch)
+{
+    for (int i = EpochYearStart; i < MeanAnomalyStart - 1; ++i)
+    {
+        if (!isDigit(record[i]))
+        {
+            return false;
+        }
+    }
+
+    double meanAnomaly = 0.0;
+    double argOfPeri = 0.0;
+    double ascendingNode = 0.0;
+    double inclination = 0.0;
+    double eccentricity = 0.0;
+    double smaAU = 0.0;
+    if (!parseField(record, MeanAnomalyStart, MeanAnomalyStart + 10, &meanAnomaly) ||
+        !parseField(record, ArgOfPeriStart, ArgOfPeriStart + 10, &argOfPeri) ||
+        !parseField(record, AscendingNodeStart, AscendingNodeStart + 10, &ascendingNode) ||
+        !parseField(record, InclinationStart, InclinationStart + 9, &inclination) ||
+        !parseField(record, EccentricityStart, EccentricityStart + 10, &eccentricity) ||
+        !parseField(record, SmaStart, SmaStart + 12, &smaAU))
+    {
+        return false;
+    }
+
+    // Epoch is Terrestrial Time
+    int epochDate = parseDigits(record, EpochYearStart, 8);
+    if (epochDate != *lastEpochDate)
+    {
+        GregorianDate epoch(parseDigits(record, EpochYearStart, 4),
+                            parseDigits(record, EpochMonthStart, 2),
+                            parseDigits(record, EpochDayStart, 2),
+                            12, 0, 0);
+        epoch.setTimeScale(TimeScale_TT);
+        *lastEpochDate = epochDate;
+        *lastEpoch = epoch.toTDBSec();
+    }
+
+    // Objects with a provisional designation (e.g. 2004 MN4) have an
+    // approximate discovery date; assume that all others were discovered long ago.
+    *discoveryTime = -daysToSeconds(365.25 * 100);
+    const char* name = record + NameStart;
+    const char* nameEnd = record + NameEnd;
+    while (name < nameEnd && *name == ' ')
+    {
+        ++name;
+    }
+    if (nameEnd - name >= 7 &&
+        isDigit(name[0]) && isDigit(name[1]) && isDigit(name[2]) && isDigit(name[3]) &&
+        name[4] == ' ' &&
+        name[5] >= 'A' && name[5] <= 'Z' && name[6] >= 'A' && name[6] <= 'Z')
+    {
+        double year = parseDigits(name, 0, 4);
+        double halfMonth = name[5] - 'A';
+        *discoveryTime = daysToSeconds((year - 2000.0) * 365.25 + halfMonth * (365.25 / 24.0));
+    }
+
+    double periodYears = pow(smaAU, 1.5);
+
+    el->eccentricity = eccentricity;
+    el->periapsisDistance = (1.0 - eccentricity) * smaAU * astro::AU;
+    el->inclination = toRadians(inclination);
+    el->longitudeOfAscendingNode = toRadians(ascendingNode);
+    el->argumentOfPeriapsis = toRadians(argOfPeri);
+    el->meanAnomalyAtEpoch = toRadians(meanAnomaly);
+    el->meanMotion = 2.0 * PI / daysToSeconds(365.25 * periodYears);
+    el->epoch = *lastEpoch;
+
+    return true;
+}
+
+
+static void
+parseAstorbChunk(AstorbChunk* chunk)
+{
+    int lastEpochDate = -1;
+    double lastEpoch = 0.0;
+
+    const char* p = chunk->begin;
+    while (p < chunk->end)
+    {
+        const char* lineEnd = static_cast<const char*>(memchr(p, '\n', chunk->end - p));
+        if (!lineEnd)
+        {
+            lineEnd = chunk->end;
+        }
+
+        if (lineEnd - p >= MinRecordLength)
+        {
+            OrbitalElements el;
+            double discoveryTime = 0.0;
+            if (parseAstorbRecord(p, &el, &discoveryTime, &lastEpochDate, &lastEpoch))
+            {
+                chunk->objects.push_back(KeplerianSwarm::makeObject(el, discoveryTime, chunk->epoch));
+            }
+            else
+            {
+                chunk->badRecordCount++;
+            }
+        }
+
+        p = lineEnd + 1;
+    }
+}
+
+
+// Load a swarm from the cache for an astorb file. Returns NULL if there's no
+// cache or it doesn't match the current source file.
+static KeplerianSwarm*
+LoadAstorbCache(const QString& cacheFileName, const QFileInfo& sourceInfo)
+{
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    // Cached objects are stored in host byte order, and the cache header is
+    // little endian; big endian hosts always parse the source file.
+    return NULL;
+#else
+    QFile file(cacheFileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return NULL;
+    }
+
+    QByteArray header = file.read(AstorbCacheHeaderSize);
+    if (header.size() != AstorbCacheHeaderSize || memcmp(header.constData(), AstorbCacheMagic, 8) != 0)
+    {
+        return NULL;
+    }
+
+    const uchar* h = reinterpret_cast<const uchar*>(header.constData());
+    quint64 sourceSize = qFromLittleEndian<quint64>(h + 8);
+    qint64 sourceTime = qFromLittleEndian<qint64>(h + 16);
+    quint32 objectCount = qFromLittleEndian<quint32>(h + 24);
+    quint32 objectSize = qFromLittleEndian<quint32>(h + 28);
+    double epoch = 0.0;
+    memcpy(&epoch, h + 32, sizeof(epoch));
+
+    if (sourceSize != quint64(sourceInfo.size()) ||
+        sourceTime != sourceInfo.lastModified().toMSecsSinceEpoch() ||
+        objectSize != sizeof(KeplerianSwarm::KeplerianObject) ||
+        objectCount == 0 ||
+        file.size() != AstorbCacheHeaderSize + qint64(objectCount) * objectSize)
+    {
+        return NULL;
+    }
+
+    std::vector<KeplerianSwarm::KeplerianObject> objects(objectCount);
+    qint64 dataSize = qint64(objectCount) * objectSize;
+    if (file.read(reinterpret_cast<char*>(&objects[0]), dataSize) != dataSize)
+    {
+        return NULL;
+    }
+
+    KeplerianSwarm* swarm = new KeplerianSwarm();
+    swarm->setEpoch(epoch);
+    swarm->addObjects(&objects[0], objectCount);
+
+    return swarm;
+#endif
+}
+
+
+// Write the cache for an astorb file. QSaveFile writes the cache to a
+// temporary file and renames it when committed, so a partially written
+// cache is never used.
+static void
+WriteAstorbCache(const QString& cacheFileName, const QFileInfo& sourceInfo, const KeplerianSwarm* swarm)
+{
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    // Caches aren't used on big endian hosts (see LoadAstorbCache)
+#else
+    const std::vector<KeplerianSwarm::KeplerianObject>& objects = swarm->objects();
+
+    uchar header[AstorbCacheHeaderSize];
+    memcpy(header, AstorbCacheMagic, 8);
+    qToLittleEndian<quint64>(quint64(sourceInfo.size()), header + 8);
+    qToLittleEndian<qint64>(sourceInfo.lastModified().toMSecsSinceEpoch(), header + 16);
+    qToLittleEndian<quint32>(quint32(objects.size()), header + 24);
+    qToLittleEndian<quint32>(quint32(sizeof(KeplerianSwarm::KeplerianObject)), header + 28);
+    double epoch = swarm->epoch();
+    memcpy(header + 32, &epoch, sizeof(epoch));
+
+    QDir().mkpath(QFileInfo(cacheFileName).absolutePath());
+
+    QSaveFile file(cacheFileName);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qDebug() << "Unable to create astorb cache file " << cacheFileName;
+        return;
+    }
+
+    qint64 dataSize = qint64(objects.size()) * sizeof(KeplerianSwarm::KeplerianObject);
+    bool ok = file.write(reinterpret_cast<const char*>(header), AstorbCacheHeaderSize) == AstorbCacheHeaderSize &&
+              file.write(reinterpret_cast<const char*>(&objects[0]), dataSize) == dataSize;
+    if (!ok)
+    {
+        file.cancelWriting();
+    }
+
+    if (!file.commit() || !ok)
+    {
+        qDebug() << "Error writing astorb cache file " << cacheFileName;
+    }
+#endif
+}
+
+
+// Get the name of the cache file for an astorb file. Cache files are kept in
+// the user's cache directory rather than next to the data; the name includes
+// a hash of the path so that files with the same name in different
+// directories get different caches.
+static QString
+AstorbCacheFileName(const QFileInfo& sourceInfo)
+{
+    QByteArray pathHash = QCryptographicHash::hash(sourceInfo.absoluteFilePath().toUtf8(), QCryptographicHash::Md5).toHex();
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/astorb";
+
+    return cacheDir + "/" + sourceInfo.fileName() + "-" + QString::fromLatin1(pathHash) + ".cache";
+}
 
 
 /** Load a text file containing minor planet data in the ASTORB format used in
@@ -31,10 +350,24 @@ using namespace vesta;
   * to the must current data is here:
   *
   *   ftp://ftp.lowell.edu/pub/elgb/astorb.html
+  *
+  * The file is memory mapped and parsed in parallel chunks. A binary cache of the
+  * parsed swarm is kept in the user's cache directory and used instead of the
+  * text file when the text file's size and modification time haven't changed.
   */
 KeplerianSwarm*
 LoadAstorbFile(const QString& fileName)
 {
+    QFileInfo info(fileName);
+    QString cacheFileName = AstorbCacheFileName(info);
+
+    KeplerianSwarm* swarm = LoadAstorbCache(cacheFileName, info);
+    if (swarm)
+    {
+        qDebug() << "Loaded " << swarm->objectCount() << " objects from astorb cache " << cacheFileName;
+        return swarm;
+    }
+
     QFile file(fileName);
     if (!file.open(QIODevice::ReadOnly))
     {
@@ -42,81 +375,100 @@ LoadAstorbFile(const QString& fileName)
         return NULL;
     }
 
-    KeplerianSwarm* swarm = new KeplerianSwarm();
+    const qint64 size = file.size();
 
-    unsigned int objectCount = 0;
+    // Map the file if possible; otherwise, read it into memory.
+    QByteArray contents;
+    const char* data = size > 0 ? reinterpret_cast<const char*>(file.map(0, size)) : NULL;
+    if (!data)
+    {
+        contents = file.readAll();
+        data = contents.constData();
+    }
+    const char* fileEnd = data + size;
+
+    // The epoch of the swarm is that of the first record in the file
+    double swarmEpoch = 0.0;
+    bool foundRecord = false;
+    for (const char* p = data; p < fileEnd && !foundRecord; )
+    {
+        const char* lineEnd = static_cast<const char*>(memchr(p, '\n', fileEnd - p));
+        if (!lineEnd)
+        {
+            lineEnd = fileEnd;
+        }
+
+        OrbitalElements el;
+        double discoveryTime = 0.0;
+        int epochDate = -1;
+        if (lineEnd - p >= MinRecordLength && parseAstorbRecord(p, &el, &discoveryTime, &epochDate, &swarmEpoch))
+        {
+            foundRecord = true;
+        }
+        p = lineEnd + 1;
+    }
 
-    QRegExp provisionalDesignation("\\d\\d\\d\\d [A-Z][A-Z]\\d*");
+    if (!foundRecord)
+    {
+        qDebug() << "astorb file " << fileName << " contains no records";
+        return NULL;
+    }
 
-    QTextStream in(&file);
-    while (!in.atEnd() && in.status() == QTextStream::Ok)
+    // Divide the file into line-aligned chunks of roughly equal size
+    int chunkCount = int(min(qint64(max(1, QThread::idealThreadCount())), max(qint64(1), size / MinAstorbChunkSize)));
+    std::vector<AstorbChunk> chunks(chunkCount);
+    const char* chunkStart = data;
+    for (int i = 0; i < chunkCount; ++i)
     {
-        QString record = in.readLine();
-        if (in.status() == QTextStream::Ok)
+        const char* chunkEnd = fileEnd;
+        if (i < chunkCount - 1)
         {
-            QString epochYear = record.mid(106, 4);
-            QString epochMonth = record.mid(110, 2);
-            QString epochDay = record.mid(112, 2);
-            QString meanAnomaly = record.mid(115, 10);
-            QString argOfPeri = record.mid(126, 10);
-            QString ascendingNode = record.mid(137, 10);
-            QString inclination = record.mid(148, 9);
-            QString eccentricity = record.mid(158, 10);
-            QString sma = record.mid(169, 12);
-
-            QString name = record.mid(7, 19).trimmed();
-
-            //bool isNEO = el.periapsisDistance / AU < 1.3;
-            //bool isHilda = el.inclination < toRadians(20.0) && el.eccentricity < 0.3 && smaAU > 3.7 && smaAU < 4.1;
-            //bool isJupiterTrojan = smaAU > 5.1 && smaAU < 5.35 && el.eccentricity < 0.25;
-            //bool isKBO = smaAU >= 30.0;
-
-
-            double discoveryTime = -daysToSeconds(365.25 * 100);
-            if (provisionalDesignation.indexIn(name) == 0)
+            chunkEnd = max(chunkStart, data + size * (i + 1) / chunkCount);
+            while (chunkEnd < fileEnd && *chunkEnd != '\n')
             {
-                double year = name.mid(0, 4).toDouble();
-                double halfMonth = name.at(5).toLatin1() - 'A';
-                discoveryTime = (year - 2000.0) * 365.25 + halfMonth * (365.25 / 24.0);
-                discoveryTime *= 86400.0;
+                ++chunkEnd;
             }
+        }
 
-            // float absMag = record.mid(43, 5).toFloat();
-
-            // Epoch is Terrestrial Time
-            GregorianDate epoch(epochYear.toInt(), epochMonth.toInt(), epochDay.toInt(), 12, 0, 0);
-            epoch.setTimeScale(TimeScale_TT);
-            double smaAU = sma.toDouble();
-            double periodYears = pow(smaAU, 1.5);
+        chunks[i].begin = chunkStart;
+        chunks[i].end = chunkEnd;
+        chunks[i].epoch = swarmEpoch;
+        chunks[i].objects.reserve((chunkEnd - chunkStart) / MinRecordLength + 1);
+        chunkStart = chunkEnd;
+    }
 
-            OrbitalElements el;
-            el.eccentricity = eccentricity.toDouble();
-            el.periapsisDistance = (1.0 - el.eccentricity) * smaAU * astro::AU;
-            el.inclination = toRadians(inclination.toDouble());
-            el.longitudeOfAscendingNode = toRadians(ascendingNode.toDouble());
-            el.argumentOfPeriapsis = toRadians(argOfPeri.toDouble());
-            el.meanAnomalyAtEpoch = toRadians(meanAnomaly.toDouble());
-            el.meanMotion = 2.0 * PI / daysToSeconds(365.25 * periodYears);
-            el.epoch = epoch.toTDBSec();
+    // Parse the first chunk on this thread and the rest in the thread pool
+    std::vector<QFuture<void> > futures;
+    for (int i = 1; i < chunkCount; ++i)
+    {
+        futures.push_back(QtConcurrent::run(parseAstorbChunk, &chunks[i]));
+    }
+    parseAstorbChunk(&chunks[0]);
+    for (unsigned int i = 0; i < futures.size(); ++i)
+    {
+        futures[i].waitForFinished();
+    }
 
-            // Automatically set epoch for the swarm geometry to that of the first record in the file
-            if (objectCount == 0)
-            {
-                swarm->setEpoch(el.epoch);
-            }
+    swarm = new KeplerianSwarm();
+    swarm->setEpoch(swarmEpoch);
 
-            swarm->addObject(el, discoveryTime);
-            objectCount++;
+    unsigned int badRecordCount = 0;
+    for (int i = 0; i < chunkCount; ++i)
+    {
+        if (!chunks[i].objects.empty())
+        {
+            swarm->addObjects(&chunks[i].objects[0], chunks[i].objects.size());
         }
+        badRecordCount += chunks[i].badRecordCount;
     }
 
-    if (objectCount == 0)
+    if (badRecordCount > 0)
     {
-        qDebug() << "astorb file " << fileName << " contains no records";
-        delete swarm;
-        swarm = NULL;
+        qDebug() << "Skipped " << badRecordCount << " bad records in astorb file " << fileName;
     }
 
+    WriteAstorbCache(cacheFileName, info, swarm);
+
     return swarm;
 }
 
@@ -15,13 +15,113 @@
 // limitations under the License.
 
 #include "ChebyshevPolyFileLoader.h"
+#include "../MappedChebyshevGranules.h"
+#include "../CompactChebyshevGranules.h"
 #include <QFile>
-#include <QDataStream>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QtEndian>
 #include <QDebug>
+#include <cstring>
 
 using namespace vesta;
 
 static const char* ChebyshevPolyFileHeader = "CHEBPOLY";
+static const unsigned int ChebyshevPolyHeaderSize = 32;
+static const char* CompactChebyshevFileHeader = "CHEBCOMP";
+static const unsigned int CompactChebyshevHeaderSize = 40;
+
+
+// Bounding radius cache files
+//
+// Computing the bounding radius of a Chebyshev trajectory requires visiting
+// every granule, which would defeat the purpose of mapping the file. The
+// radius is instead stored in a small text file in the cache directory,
+// named after the trajectory file plus a hash of its path, e.g.
+// saturn.cheb-<hash>.radius. It contains three numbers: the size in bytes
+// and modification time (milliseconds since 1970) of the trajectory file,
+// which are used to detect a stale file, and the bounding radius in
+// kilometers. When no valid file is found, the radius is computed and the
+// file is written. Nothing is ever written to the directory of the data.
+
+static QString
+radiusCacheFileName(const QString& fileName)
+{
+    QFileInfo info(fileName);
+    QByteArray pathHash = QCryptographicHash::hash(info.absoluteFilePath().toUtf8(), QCryptographicHash::Md5).toHex();
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/chebpoly";
+
+    return cacheDir + "/" + info.fileName() + "-" + QString::fromLatin1(pathHash) + ".radius";
+}
+
+
+static bool
+readBoundingRadius(const QString& cacheName, const QFileInfo& sourceInfo, double* boundingRadius)
+{
+    QFile cacheFile(cacheName);
+    if (!cacheFile.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        return false;
+    }
+
+    QTextStream in(&cacheFile);
+    qint64 recordedSize = 0;
+    qint64 recordedTime = 0;
+    double radius = 0.0;
+    in >> recordedSize >> recordedTime >> radius;
+    if (in.status() != QTextStream::Ok ||
+        recordedSize != sourceInfo.size() ||
+        recordedTime != sourceInfo.lastModified().toMSecsSinceEpoch() ||
+        !(radius > 0.0))
+    {
+        return false;
+    }
+
+    *boundingRadius = radius;
+    return true;
+}
+
+
+static void
+writeBoundingRadius(const QString& cacheName, const QFileInfo& sourceInfo, double boundingRadius)
+{
+    QDir().mkpath(QFileInfo(cacheName).absolutePath());
+
+    // QSaveFile replaces the file atomically, so a partially written file is
+    // never read.
+    QSaveFile cacheFile(cacheName);
+    if (cacheFile.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        QTextStream out(&cacheFile);
+        out.setRealNumberPrecision(17);
+        out << sourceInfo.size() << " " << sourceInfo.lastModified().toMSecsSinceEpoch() << " " << boundingRadius << "\n";
+        out.flush();
+        if (out.status() != QTextStream::Ok)
+        {
+            cacheFile.cancelWriting();
+        }
+    }
+
+    if (!cacheFile.commit())
+    {
+        qDebug() << "Unable to write bounding radius cache file " << cacheName;
+    }
+}
+
+
+static double
+readLittleEndianDouble(const uchar* p)
+{
+    quint64 bits = qFromLittleEndian<quint64>(p);
+    double x = 0.0;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
 
 
 /** Load a binary file containing an orbit represented as an array of Chebyshev
@@ -40,43 +140,49 @@ static const char* ChebyshevPolyFileHeader = "CHEBPOLY";
   *   x0 x1 x2 ... xn y0 y1 y2 ... yn z0 z1 z2 ... zn
   *
   * Byte order is little endian (Intel x86)
+  *
+  * The file is memory mapped and the trajectory refers to the coefficients
+  * in place, so loading doesn't read the coefficients; only pages holding
+  * granules that are actually evaluated are ever touched. The bounding radius
+  * is read from a cache file (see above.)
+  *
+  * Compact Chebyshev files (created by tools/chebpoly/chebcompact.py) are
+  * also accepted. They store the high order coefficients in 32 bits; see
+  * CompactChebyshevGranules for the record layout. The header is:
+  *
+  * 8 bytes - header "CHEBCOMP"
+  * 4 bytes - int32 - record count
+  * 4 bytes - int32 - polynomial degree
+  * 8 bytes - double - start time (seconds since J2000.0 TDB)
+  * 8 bytes - double - interval covered by each polynomial (in seconds)
+  * 4 bytes - int32 - number of coefficients per component stored as doubles
+  * 4 bytes - int32 - encoding of the other coefficients (0 = float, 1 = scaled int32)
   */
 ChebyshevPolyTrajectory*
 LoadChebyshevPolyFile(const QString& fileName)
 {
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly))
+    counted_ptr<MappedFile> file(MappedFile::Open(fileName));
+    if (file.isNull())
     {
         qDebug() << "Unable to open Chebyshev polynomial trajectory file " << fileName;
         return NULL;
     }
 
-    QDataStream in(&file);
-
-    // All floating point values in the file are double precision
-    in.setVersion(QDataStream::Qt_4_7);
-    in.setFloatingPointPrecision(QDataStream::DoublePrecision);
-    in.setByteOrder(QDataStream::LittleEndian);
-
-    char header[8];
-    in.readRawData(header, sizeof(header));
-    if (QString::fromLatin1(header, sizeof(header)) != ChebyshevPolyFileHeader)
+    bool compact = file->contains(0, CompactChebyshevHeaderSize) &&
+                   memcmp(file->data(), CompactChebyshevFileHeader, strlen(CompactChebyshevFileHeader)) == 0;
+    if (!compact &&
+        (!file->contains(0, ChebyshevPolyHeaderSize) ||
+         memcmp(file->data(), ChebyshevPolyFileHeader, strlen(ChebyshevPolyFileHeader)) != 0))
     {
         qDebug() << "File " << fileName << " is not a Chebyshev polynomial trajectory file.";
         return NULL;
     }
 
-    quint32 recordCount   = 0;
-    quint32 degree        = 0;
-    double startTime      = 0.0;
-    double intervalLength = 0.0;
-
-    in >> recordCount >> degree >> startTime >> intervalLength;
-    if (in.status() != QDataStream::Ok)
-    {
-        qDebug() << "Error reading header from Chebyshev polynomial file " << fileName;
-        return NULL;
-    }
+    const uchar* header = file->data();
+    quint32 recordCount   = qFromLittleEndian<quint32>(header + 8);
+    quint32 degree        = qFromLittleEndian<quint32>(header + 12);
+    double startTime      = readLittleEndianDouble(header + 16);
+    double intervalLength = readLittleEndianDouble(header + 24);
 
 #if 0
     qDebug() << "Chebyshev file " << fileName << ": "
@@ -85,42 +191,66 @@ LoadChebyshevPolyFile(const QString& fileName)
              << ", interval " << intervalLength / 86400.0 << " days";
 #endif
 
-    unsigned int recordSize = 3 * (degree + 1);
-    unsigned int coeffCount = recordSize * recordCount;
-
-    double* coeffs = new double[coeffCount];
-    if (!coeffs)
+    if (recordCount == 0 || degree > ChebyshevPolyTrajectory::MaxChebyshevDegree || !(intervalLength > 0.0))
     {
-        qDebug() << "Not enough memory to load Chebyshev polynomial trajectory " << fileName;
+        qDebug() << "Error reading header from Chebyshev polynomial file " << fileName;
         return NULL;
     }
 
-    if (in.readRawData(reinterpret_cast<char*>(coeffs), coeffCount * sizeof(double)) < 0)
+    counted_ptr<ChebyshevGranuleSource> granules;
+    if (compact)
     {
-        qDebug() << "Error reading coefficients from Chebyshev polynomial file " << fileName;
-        delete[] coeffs;
-        return NULL;
-    }
+        quint32 doubleTermCount = qFromLittleEndian<quint32>(header + 32);
+        quint32 encoding        = qFromLittleEndian<quint32>(header + 36);
 
-    // Change layout from structure of arrays to array of structures
-    /* Not currently required
-    double* swapBuffer = new double[recordSize];
-    for (unsigned int rec = 0; rec < recordCount; ++rec)
+        counted_ptr<CompactChebyshevGranules> compactGranules(new CompactChebyshevGranules(file.ptr(),
+                                                                                           CompactChebyshevHeaderSize,
+                                                                                           degree,
+                                                                                           recordCount,
+                                                                                           doubleTermCount,
+                                                                                           CompactChebyshevGranules::Encoding(encoding)));
+        if (!compactGranules->isValid())
+        {
+            qDebug() << "Error reading coefficients from compact Chebyshev polynomial file " << fileName;
+            return NULL;
+        }
+        granules = compactGranules.ptr();
+    }
+    else
     {
-        for (unsigned int i = 0; i <= degree; ++i)
+        unsigned int recordSize = 3 * (degree + 1) * sizeof(double);
+
+        // Coefficients are used in place on little endian hosts; big endian hosts
+        // byte swap each granule when it's first needed.
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+        bool swapBytes = true;
+#else
+        bool swapBytes = false;
+#endif
+
+        counted_ptr<MappedChebyshevGranules> mappedGranules(new MappedChebyshevGranules(file.ptr(),
+                                                                                        ChebyshevPolyHeaderSize,
+                                                                                        recordSize,
+                                                                                        1,
+                                                                                        degree,
+                                                                                        recordCount,
+                                                                                        swapBytes));
+        if (!mappedGranules->isValid())
         {
-            for (unsigned int j = 0; j < 3; ++j)
-            {
-                swapBuffer[i * 3 + j] = coeffs[rec * recordSize + j * (degree + 1) + i];//coeffs[rec * recordSize + i * (degree + 1) + j];
-            }
+            qDebug() << "Error reading coefficients from Chebyshev polynomial file " << fileName;
+            return NULL;
         }
-        qCopy(swapBuffer, swapBuffer + recordSize, coeffs + rec * recordSize);
+        granules = mappedGranules.ptr();
     }
-    delete[] swapBuffer;
-    */
 
-    ChebyshevPolyTrajectory* trajectory = new ChebyshevPolyTrajectory(coeffs, degree, recordCount, startTime, intervalLength);
-    delete[] coeffs;
+    double boundingRadius = 0.0;
+    QFileInfo sourceInfo(fileName);
+    QString radiusCacheName = radiusCacheFileName(fileName);
+    if (!readBoundingRadius(radiusCacheName, sourceInfo, &boundingRadius))
+    {
+        boundingRadius = ChebyshevPolyTrajectory::computeBoundingRadius(granules.ptr(), degree, recordCount);
+        writeBoundingRadius(radiusCacheName, sourceInfo, boundingRadius);
+    }
 
-    return trajectory;
+    return new ChebyshevPolyTrajectory(granules.ptr(), degree, recordCount, startTime, intervalLength, boundingRadius);
 }
@@ -0,0 +1,392 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "NumericTableReader.h"
+#include <QFile>
+#include <QByteArray>
+#include <QThread>
+#include <QtConcurrentRun>
+#include <QFuture>
+#include <algorithm>
+
+using namespace std;
+
+
+// Files smaller than this are parsed in a single chunk; the cost of starting
+// extra threads isn't worth it.
+static const qint64 MinChunkSize = 64 * 1024;
+
+// More significant digits than this won't fit in a 64-bit mantissa
+static const int MaxMantissaDigits = 19;
+
+// Largest integer that can be exactly represented by a double
+static const quint64 MaxExactMantissa = quint64(1) << 53;
+
+// Powers of ten that are exactly representable as doubles
+static const double ExactPowersOfTen[] =
+{
+    1.0e0,  1.0e1,  1.0e2,  1.0e3,  1.0e4,  1.0e5,  1.0e6,  1.0e7,
+    1.0e8,  1.0e9,  1.0e10, 1.0e11, 1.0e12, 1.0e13, 1.0e14, 1.0e15,
+    1.0e16, 1.0e17, 1.0e18, 1.0e19, 1.0e20, 1.0e21, 1.0e22
+};
+static const int MaxExactPowerOfTen = 22;
+
+
+namespace
+{
+
+struct ChunkResult
+{
+    ChunkResult() : ok(true) {}
+
+    std::vector<double> values;
+    bool ok;
+};
+
+}
+
+
+static inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+
+// Locale independent test for whitespace
+static inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+
+static inline bool isLineEnd(char c)
+{
+    return c == '\n' || c == '\r';
+}
+
+
+/** Parse all values in the range [begin, end). On error, the result contains
+  * all values read before the invalid token and the ok flag is cleared.
+  */
+static void
+parseChunk(const char* begin, const char* end, ChunkResult* result)
+{
+    // Guess at the number of values based on typical formatting
+    result->values.reserve((end - begin) / 10);
+
+    const char* p = begin;
+    while (p < end)
+    {
+        char c = *p;
+        if (isSpace(c))
+        {
+            ++p;
+        }
+        else if (c == '#')
+        {
+            while (p < end && !isLineEnd(*p))
+            {
+                ++p;
+            }
+        }
+        else
+        {
+            const char* tokenEnd = p;
+            while (tokenEnd < end && !isSpace(*tokenEnd) && *tokenEnd != '#')
+            {
+                ++tokenEnd;
+            }
+
+            double value = 0.0;
+            if (!NumericTableReader::parseDouble(p, tokenEnd, &value))
+            {
+                result->ok = false;
+                return;
+            }
+
+            result->values.push_back(value);
+            p = tokenEnd;
+        }
+    }
+}
+
+
+NumericTableReader::NumericTableReader(unsigned int fieldCount) :
+    m_fieldCount(max(1u, fieldCount)),
+    m_recordCount(0),
+    m_errorRecord(0)
+{
+}
+
+
+/** Read the contents of a file. Returns Ok if the file contained only valid
+  * values and the number of values was a multiple of the field count.
+  * If there was an error, errorRecord() gives the index of the record
+  * where it occurred. Any records before the error are still available.
+  */
+NumericTableReader::Status
+NumericTableReader::read(const QString& fileName)
+{
+    m_values.clear();
+    m_recordCount = 0;
+    m_errorRecord = 0;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return OpenError;
+    }
+
+    const qint64 size = file.size();
+    if (size == 0)
+    {
+        return Ok;
+    }
+
+    // Map the file if possible; otherwise, read it into memory.
+    QByteArray contents;
+    const char* data = reinterpret_cast<const char*>(file.map(0, size));
+    if (!data)
+    {
+        contents = file.readAll();
+        data = contents.constData();
+    }
+
+    const char* fileEnd = data + size;
+
+    // Divide the file into roughly equal chunks. Chunk boundaries are moved
+    // forward to the next line end so that no number or comment is split.
+    int chunkCount = int(min(qint64(max(1, QThread::idealThreadCount())), max(qint64(1), size / MinChunkSize)));
+    std::vector<const char*> boundaries;
+    boundaries.push_back(data);
+    for (int i = 1; i < chunkCount; ++i)
+    {
+        const char* p = max(boundaries.back(), data + size * i / chunkCount);
+        while (p < fileEnd && !isLineEnd(*p))
+        {
+            ++p;
+        }
+        boundaries.push_back(p);
+    }
+    boundaries.push_back(fileEnd);
+
+    std::vector<ChunkResult> results(chunkCount);
+    if (chunkCount == 1)
+    {
+        parseChunk(data, fileEnd, &results[0]);
+    }
+    else
+    {
+        // Parse the first chunk on this thread while the others are handled by
+        // the thread pool.
+        std::vector<QFuture<void> > futures;
+        for (int i = 1; i < chunkCount; ++i)
+        {
+            futures.push_back(QtConcurrent::run(parseChunk, boundaries[i], boundaries[i + 1], &results[i]));
+        }
+        parseChunk(boundaries[0], boundaries[1], &results[0]);
+        for (unsigned int i = 0; i < futures.size(); ++i)
+        {
+            futures[i].waitForFinished();
+        }
+    }
+
+    // Concatenate the results, stopping at the first chunk with an error
+    bool ok = true;
+    if (chunkCount == 1)
+    {
+        m_values.swap(results[0].values);
+        ok = results[0].ok;
+    }
+    else
+    {
+        std::size_t valueCount = 0;
+        int lastChunk = 0;
+        for (lastChunk = 0; lastChunk < chunkCount; ++lastChunk)
+        {
+            valueCount += results[lastChunk].values.size();
+            if (!results[lastChunk].ok)
+            {
+                ok = false;
+                break;
+            }
+        }
+
+        m_values.reserve(valueCount);
+        for (int i = 0; i < chunkCount && i <= lastChunk; ++i)
+        {
+            m_values.insert(m_values.end(), results[i].values.begin(), results[i].values.end());
+        }
+    }
+
+    // An incomplete record at the end of the file is also an error
+    m_recordCount = m_values.size() / m_fieldCount;
+    if (m_values.size() % m_fieldCount != 0)
+    {
+        ok = false;
+        m_values.resize(m_recordCount * m_fieldCount);
+    }
+
+    if (!ok)
+    {
+        m_errorRecord = m_recordCount;
+        return ParseError;
+    }
+
+    return Ok;
+}
+
+
+/** Convert the text in [begin, end) to a double. The text must be a
+  * decimal number with optional sign, fraction, and exponent; anything
+  * else is rejected. Parsing is independent of the current locale.
+  *
+  * Numbers whose significant digits fit in 53 bits and with a small decimal
+  * exponent (this covers nearly everything in trajectory files) are
+  * converted with a single floating point multiply or divide, which is
+  * correctly rounded because both operands are exact. Other numbers are
+  * handed to Qt's correctly rounded converter.
+  */
+bool
+NumericTableReader::parseDouble(const char* begin, const char* end, double* value)
+{
+    const char* p = begin;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        ++p;
+    }
+
+    quint64 mantissa = 0;
+    int digitCount = 0;
+    int exponent = 0;
+    bool hasDigits = false;
+    bool truncated = false;
+
+    // Integer part; leading zeros don't count toward the significant digits
+    while (p < end && isDigit(*p))
+    {
+        int d = *p - '0';
+        hasDigits = true;
+        if (digitCount < MaxMantissaDigits)
+        {
+            mantissa = mantissa * 10 + d;
+            if (mantissa != 0)
+            {
+                ++digitCount;
+            }
+        }
+        else
+        {
+            ++exponent;
+            truncated = truncated || d != 0;
+        }
+        ++p;
+    }
+
+    // Fractional part
+    if (p < end && *p == '.')
+    {
+        ++p;
+        while (p < end && isDigit(*p))
+        {
+            int d = *p - '0';
+            hasDigits = true;
+            if (digitCount < MaxMantissaDigits)
+            {
+                mantissa = mantissa * 10 + d;
+                if (mantissa != 0)
+                {
+                    ++digitCount;
+                }
+                --exponent;
+            }
+            else
+            {
+                truncated = truncated || d != 0;
+            }
+            ++p;
+        }
+    }
+
+    if (!hasDigits)
+    {
+        return false;
+    }
+
+    // Exponent
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        ++p;
+        bool negativeExponent = false;
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            negativeExponent = *p == '-';
+            ++p;
+        }
+
+        if (p == end || !isDigit(*p))
+        {
+            return false;
+        }
+
+        int e = 0;
+        while (p < end && isDigit(*p))
+        {
+            // Clamp absurdly large exponents; the result is zero or infinity anyway
+            if (e < 100000)
+            {
+                e = e * 10 + (*p - '0');
+            }
+            ++p;
+        }
+        exponent += negativeExponent ? -e : e;
+    }
+
+    if (p != end)
+    {
+        return false;
+    }
+
+    if (mantissa == 0)
+    {
+        *value = negative ? -0.0 : 0.0;
+        return true;
+    }
+
+    if (!truncated && mantissa <= MaxExactMantissa && exponent >= -MaxExactPowerOfTen && exponent <= MaxExactPowerOfTen)
+    {
+        double x = double(mantissa);
+        if (exponent >= 0)
+        {
+            x *= ExactPowersOfTen[exponent];
+        }
+        else
+        {
+            x /= ExactPowersOfTen[-exponent];
+        }
+        *value = negative ? -x : x;
+        return true;
+    }
+
+    // Slow path for long mantissas and large exponents. The syntax has already
+    // been validated above.
+    bool ok = false;
+    *value = QByteArray(begin, int(end - begin)).toDouble(&ok);
+    return ok;
+}
@@ -0,0 +1,88 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef _NUMERIC_TABLE_READER_H_
+#define _NUMERIC_TABLE_READER_H_
+
+#include <QString>
+#include <vector>
+
+
+/** NumericTableReader reads a text file containing a table of floating
+  * point values with a fixed number of fields per record, e.g. the xyzv,
+  * xyz, and q files used for sampled trajectories and rotations. Values
+  * are separated by whitespace and newline terminated hash comments are
+  * allowed. Records aren't required to occupy a single line: the file
+  * is treated as a stream of numbers that is divided into records of
+  * fieldCount values each.
+  *
+  * The file is memory mapped and large files are split into line-aligned
+  * chunks that are parsed in parallel.
+  */
+class NumericTableReader
+{
+public:
+    enum Status
+    {
+        Ok,
+        OpenError,
+        ParseError,
+    };
+
+    explicit NumericTableReader(unsigned int fieldCount);
+
+    Status read(const QString& fileName);
+
+    /** Get the number of fields in each record.
+      */
+    unsigned int fieldCount() const
+    {
+        return m_fieldCount;
+    }
+
+    /** Get the number of complete records read.
+      */
+    unsigned int recordCount() const
+    {
+        return m_recordCount;
+    }
+
+    /** Get a pointer to the fields of the specified record.
+      */
+    const double* record(unsigned int index) const
+    {
+        return &m_values[index * m_fieldCount];
+    }
+
+    /** Get the index of the record that contained the first invalid value. This
+      * is only meaningful after read() has returned ParseError.
+      */
+    unsigned int errorRecord() const
+    {
+        return m_errorRecord;
+    }
+
+    static bool parseDouble(const char* begin, const char* end, double* value);
+
+private:
+    unsigned int m_fieldCount;
+    unsigned int m_recordCount;
+    unsigned int m_errorRecord;
+    std::vector<double> m_values;
+};
+
+#endif // _NUMERIC_TABLE_READER_H_
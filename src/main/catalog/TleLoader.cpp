@@ -0,0 +1,83 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "TleLoader.h"
+#include <QFile>
+#include <QDebug>
+#include <string>
+#include <vector>
+
+
+/** Load a file of two-line element sets, such as the catalogs distributed
+  * by CelesTrak. Element sets may optionally be preceded by a line with the
+  * name of the object (the 'three-line' format); any line that isn't part of
+  * an element set is ignored.
+  */
+TleSwarm*
+LoadTleFile(const QString& fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qDebug() << "Unable to open TLE file " << fileName;
+        return NULL;
+    }
+
+    // Collect all of the element sets first so that the swarm can initialize
+    // them together.
+    std::vector<std::string> lines1;
+    std::vector<std::string> lines2;
+    QByteArray line1;
+    while (!file.atEnd())
+    {
+        QByteArray line = file.readLine().trimmed();
+        if (line.startsWith("1 "))
+        {
+            line1 = line;
+        }
+        else if (line.startsWith("2 ") && !line1.isEmpty())
+        {
+            lines1.push_back(std::string(line1.constData()));
+            lines2.push_back(std::string(line.constData()));
+            line1.clear();
+        }
+        else
+        {
+            line1.clear();
+        }
+    }
+
+    TleSwarm* swarm = new TleSwarm();
+    unsigned int badRecordCount = 0;
+    if (!lines1.empty())
+    {
+        badRecordCount = lines1.size() - swarm->addObjects(&lines1[0], &lines2[0], lines1.size());
+    }
+
+    if (badRecordCount > 0)
+    {
+        qDebug() << "Skipped" << badRecordCount << "bad element sets in TLE file" << fileName;
+    }
+
+    if (swarm->objectCount() == 0)
+    {
+        qDebug() << "TLE file " << fileName << " contains no element sets";
+        delete swarm;
+        swarm = NULL;
+    }
+
+    return swarm;
+}
@@ -17,18 +17,25 @@
 #include "UniverseLoader.h"
 #include "AstorbLoader.h"
 #include "ChebyshevPolyFileLoader.h"
+#include "NumericTableReader.h"
+#include "TleLoader.h"
 #include "../TleTrajectory.h"
 #include "../InterpolatedStateTrajectory.h"
+#include "../MappedFile.h"
+#include "../SharedEphemerisCache.h"
 #include "../InterpolatedRotation.h"
 #include "../LinearCombinationTrajectory.h"
+#include "../ChebyshevCombinationTrajectory.h"
+#include "../AdaptiveChebyshevTrajectory.h"
+#include "../CachingChebyshevTrajectory.h"
 #include "../TwoVectorFrame.h"
+#include "../EquatorOfDateFrame.h"
 #include "../WMSTiledMap.h"
 #include "../MultiWMSTiledMap.h"
 #include "../UnitConversion.h"
 #include "../geometry/MeshInstanceGeometry.h"
 #include "../geometry/TimeSwitchedGeometry.h"
 #include "../geometry/FeatureLabelSetGeometry.h"
-#include "../compatibility/Scanner.h"
 #include "../compatibility/CmodLoader.h"
 #include "../compatibility/CatalogParser.h"
 #include "../compatibility/TransformCatalog.h"
@@ -40,6 +47,10 @@
 #include "../vext/NameTemplateTiledMap.h"
 #include "../vext/CompositeTrajectory.h"
 #include "../astro/Rotation.h"
+#include "../astro/TASS17.h"
+#include "../astro/L1.h"
+#include "../astro/Gust86.h"
+#include "../astro/MarsSat.h"
 #include "../Viewpoint.h"
 #include <vesta/Units.h>
 #include <vesta/Body.h>
@@ -71,6 +82,7 @@
 #ifdef SPICE_ENABLED
 #include "../spice/SpiceTrajectory.h"
 #include "../spice/SpiceRotationModel.h"
+#include "../spice/SpiceGateway.h"
 #endif
 
 #include <vesta/particlesys/ParticleEmitter.h>
@@ -87,6 +99,8 @@
 #include <QRegExp>
 #include <QBuffer>
 #include <QDebug>
+#include <QtEndian>
+#include <cstring>
 
 using namespace vesta;
 using namespace Eigen;
@@ -95,6 +109,9 @@ using namespace Eigen;
 static const double DefaultStartTime = daysToSeconds(-36525.0 * 2);  // 12:00:00 1 Jan 1800
 static const double DefaultEndTime   = daysToSeconds( 36525.0);      // 12:00:00 1 Jan 2100
 
+// Default polynomial degree for Lagrange and Hermite interpolation of sampled trajectories
+static const unsigned int DefaultInterpolationOrder = 8;
+
 QString ValueUnitsRegexpString("^\\s*([-+]?[0-9]*\\.?[0-9]+(?:[eE][-+]?[0-9]+)?)\\s*([A-Za-z]+)?\\s*$");
 
 
@@ -137,182 +154,372 @@ static ColorPaletteEntry StandardColorPalette[] =
 
 
 
-static bool readNextDouble(Scanner* scanner, double* value)
+static InterpolatedStateTrajectory* PublishSampledTrajectory(const QString& fileName,
+                                                             const QString& kind,
+                                                             const NumericTableReader& table);
+static InterpolatedStateTrajectory* XYZVBinaryTrajectory(MappedFile* file, qint64 offset, const QString& fileName);
+
+
+/** Load a list of time/state vector records from a file. The values
+  * are stored in ASCII format with newline terminated hash comments
+  * allowed. Dates are given as TDB Julian dates, positions are
+  * in units of kilometers, and velocities are km/sec.
+  *
+  * When the shared ephemeris cache is enabled, the parsed records are
+  * published to it, and other processes map them instead of parsing the file.
+  */
+InterpolatedStateTrajectory*
+LoadXYZVTrajectory(const QString& fileName)
 {
-    if (scanner->readNext() == Scanner::Double || scanner->currentToken() == Scanner::Integer)
-    {
-        *value = scanner->doubleValue();
-        return true;
-    }
-    else
+    counted_ptr<MappedFile> shared(SharedEphemerisCache::Open(fileName, "xyzv"));
+    if (shared.isValid())
     {
-        return false;
+        return XYZVBinaryTrajectory(shared.ptr(), SharedEphemerisCache::PayloadOffset, fileName);
     }
-}
-
 
-static bool readNextVector3(Scanner* scanner, Vector3d* value)
-{
-    double x = 0.0;
-    double y = 0.0;
-    double z = 0.0;
-    if (readNextDouble(scanner, &x) && readNextDouble(scanner, &y) && readNextDouble(scanner, &z))
+    NumericTableReader table(7);
+    NumericTableReader::Status status = table.read(fileName);
+    if (status == NumericTableReader::OpenError)
     {
-        *value = Vector3d(x, y, z);
-        return true;
+        qDebug() << "Unable to open trajectory file " << fileName;
+        return NULL;
     }
-    else
+    else if (status == NumericTableReader::ParseError)
     {
-        return false;
+        qDebug() << "Error in xyzv trajectory file, record " << table.errorRecord();
+        return NULL;
     }
-}
-
 
-static bool readNextQuaternion(Scanner* scanner, Quaterniond* value)
-{
-    double w = 0.0;
-    double x = 0.0;
-    double y = 0.0;
-    double z = 0.0;
-    if (readNextDouble(scanner, &w) &&
-        readNextDouble(scanner, &x) &&
-        readNextDouble(scanner, &y) &&
-        readNextDouble(scanner, &z))
-    {
-        *value = Quaterniond(w, x, y, z);
-        return true;
+    InterpolatedStateTrajectory* published = PublishSampledTrajectory(fileName, "xyzv", table);
+    if (published)
+    {
+        return published;
     }
-    else
+
+    InterpolatedStateTrajectory::TimeStateList states(table.recordCount());
+    for (unsigned int i = 0; i < table.recordCount(); ++i)
     {
-        return false;
+        const double* r = table.record(i);
+        states[i].tsec = daysToSeconds(r[0] - vesta::J2000);
+        states[i].state = StateVector(Vector3d(r[1], r[2], r[3]), Vector3d(r[4], r[5], r[6]));
     }
+
+    return new InterpolatedStateTrajectory(states);
 }
 
 
-/** Load a list of time/state vector records from a file. The values
+/** Load a list of time/position records from a file. The values
   * are stored in ASCII format with newline terminated hash comments
-  * allowed. Dates are given as TDB Julian dates, positions are
-  * in units of kilometers, and velocities are km/sec.
+  * allowed. Dates are given as TDB Julian dates and positions are
+  * in units of kilometers. Like xyzv files, xyz files are shared through
+  * the ephemeris cache when it's enabled.
   */
 InterpolatedStateTrajectory*
-LoadXYZVTrajectory(const QString& fileName)
+LoadXYZTrajectory(const QString& fileName)
 {
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly))
+    counted_ptr<MappedFile> shared(SharedEphemerisCache::Open(fileName, "xyz"));
+    if (shared.isValid())
+    {
+        return XYZVBinaryTrajectory(shared.ptr(), SharedEphemerisCache::PayloadOffset, fileName);
+    }
+
+    NumericTableReader table(4);
+    NumericTableReader::Status status = table.read(fileName);
+    if (status == NumericTableReader::OpenError)
     {
         qDebug() << "Unable to open trajectory file " << fileName;
         return NULL;
     }
+    else if (status == NumericTableReader::ParseError)
+    {
+        qDebug() << "Error in xyz trajectory file, record " << table.errorRecord();
+        return NULL;
+    }
 
-    InterpolatedStateTrajectory::TimeStateList states;
+    InterpolatedStateTrajectory* published = PublishSampledTrajectory(fileName, "xyz", table);
+    if (published)
+    {
+        return published;
+    }
 
-    Scanner scanner(&file);
-    bool ok = true;
-    bool done = false;
-    while (!done)
+    InterpolatedStateTrajectory::TimePositionList positions(table.recordCount());
+    for (unsigned int i = 0; i < table.recordCount(); ++i)
     {
-        double jd = 0.0;
-        Vector3d position = Vector3d::Zero();
-        Vector3d velocity = Vector3d::Zero();
-        if (!readNextDouble(&scanner, &jd))
-        {
-            done = true;
-            if (!scanner.atEnd())
-            {
-                ok = false;
-            }
-        }
-        else
-        {
-            if (!readNextVector3(&scanner, &position) || !readNextVector3(&scanner, &velocity))
-            {
-                ok = false;
-                done = true;
-            }
-        }
+        const double* r = table.record(i);
+        positions[i].tsec = daysToSeconds(r[0] - vesta::J2000);
+        positions[i].position = Vector3d(r[1], r[2], r[3]);
+    }
 
-        if (!done)
-        {
-            double tdbSec = daysToSeconds(jd - vesta::J2000);
-            InterpolatedStateTrajectory::TimeState state;
-            state.tsec = tdbSec;
-            state.state = StateVector(position, velocity);
-            states.push_back(state);
-        }
+    return new InterpolatedStateTrajectory(positions);
+}
+
+
+// Arrays of a binary record file (xyzvb or qb) mapped in place. Both formats
+// have a 32 byte header: an 8 byte file type tag, then uint32 values for
+// the flags, record count, index stride, and index entry count, and 8 bytes
+// of format specific data. The header is followed by arrays of doubles
+// with one entry per record, and then by the coarse index. All values are
+// little endian.
+struct BinaryRecordArrays
+{
+    static const unsigned int HeaderSize = 32;
+    static const unsigned int MaxArrayCount = 7;
+
+    quint32 flags;
+    quint32 recordCount;
+    const double* arrays[MaxArrayCount];
+    const double* index;
+    quint32 indexStride;
+    quint32 indexCount;
+};
+
+
+// Check the tag of a binary record file stored at the given offset in a
+// mapped file and read the flags from its header.
+static bool
+ReadBinaryRecordFlags(const MappedFile* file, qint64 offset, const char* tag, quint32* flags)
+{
+    if (!file->contains(offset, BinaryRecordArrays::HeaderSize) || memcmp(file->data() + offset, tag, strlen(tag)) != 0)
+    {
+        return false;
     }
 
-    if (!ok)
+    *flags = qFromLittleEndian<quint32>(file->data() + offset + 8);
+    return true;
+}
+
+
+// Locate the record arrays and coarse index of a binary record file with
+// the given number of arrays. Returns false if the file is truncated or
+// has no records.
+static bool
+MapBinaryRecordArrays(const MappedFile* file, qint64 offset, unsigned int arrayCount, BinaryRecordArrays* records)
+{
+    const uchar* header = file->data() + offset;
+    records->flags       = qFromLittleEndian<quint32>(header + 8);
+    records->recordCount = qFromLittleEndian<quint32>(header + 12);
+    records->indexStride = qFromLittleEndian<quint32>(header + 16);
+    records->indexCount  = qFromLittleEndian<quint32>(header + 20);
+
+    qint64 arraySize = qint64(records->recordCount) * sizeof(double);
+    qint64 arraysOffset = offset + BinaryRecordArrays::HeaderSize;
+    qint64 indexOffset = arraysOffset + arrayCount * arraySize;
+    if (records->recordCount == 0 || !file->contains(indexOffset, qint64(records->indexCount) * sizeof(double)))
     {
-        qDebug() << "Error in xyzv trajectory file, record " << states.size();
-        return NULL;
+        return false;
     }
-    else
+
+    for (unsigned int i = 0; i < arrayCount; ++i)
     {
-        return new InterpolatedStateTrajectory(states);
+        records->arrays[i] = reinterpret_cast<const double*>(file->data() + arraysOffset + i * arraySize);
     }
+    records->index = records->indexCount > 0 ? reinterpret_cast<const double*>(file->data() + indexOffset) : NULL;
+
+    return true;
 }
 
 
-/** Load a list of time/position records from a file. The values
-  * are stored in ASCII format with newline terminated hash comments
-  * allowed. Dates are given as TDB Julian dates and positions are
-  * in units of kilometers.
+// Read one value from a record array, converting it to host byte order. Used
+// where the arrays can't be referred to in place.
+static double
+BinaryRecordValue(const BinaryRecordArrays& records, unsigned int array, unsigned int record)
+{
+    quint64 bits = qFromLittleEndian<quint64>(reinterpret_cast<const uchar*>(records.arrays[array] + record));
+    double value = 0.0;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+
+/** Load a trajectory from a binary sampled trajectory file (.xyzvb). The
+  * file is memory mapped, and the trajectory refers to the records in place.
+  * Loading is thus independent of the size of the file, and only the pages
+  * that contain records that are actually used are ever read.
+  *
+  * The file begins with a 32 byte header:
+  *
+  * 8 bytes - header "XYZVBIN1"
+  * 4 bytes - uint32 - flags (bit 0 set if velocities are present)
+  * 4 bytes - uint32 - record count
+  * 4 bytes - uint32 - index stride (number of records per coarse index entry, or 0)
+  * 4 bytes - uint32 - index entry count
+  * 8 bytes - double - bounding radius (km)
+  *
+  * The header is followed by arrays of doubles, each with one entry per
+  * record: time (seconds since J2000.0 TDB), x, y, z (km), and, if present,
+  * vx, vy, vz (km/s). Times must not decrease; two consecutive records with
+  * the same time mark a boundary between segments, which interpolation never
+  * crosses. The arrays are followed by the coarse index, which contains the
+  * time of every index stride-th record.
+  *
+  * Byte order is little endian. Files are created from xyzv or xyz files by
+  * the xyzv2bin.py tool.
   */
 InterpolatedStateTrajectory*
-LoadXYZTrajectory(const QString& fileName)
+LoadXYZVBinaryTrajectory(const QString& fileName)
 {
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly))
+    counted_ptr<MappedFile> file(MappedFile::Open(fileName));
+    if (file.isNull())
     {
         qDebug() << "Unable to open trajectory file " << fileName;
         return NULL;
     }
 
-    InterpolatedStateTrajectory::TimePositionList positions;
+    return XYZVBinaryTrajectory(file.ptr(), 0, fileName);
+}
 
-    Scanner scanner(&file);
-    bool ok = true;
-    bool done = false;
-    while (!done)
+
+static const char* XYZVBinaryHeader = "XYZVBIN1";
+static const unsigned int XYZVBinaryHeaderSize = BinaryRecordArrays::HeaderSize;
+static const quint32 XYZVBinaryHasVelocitiesFlag = 0x1;
+static const unsigned int XYZVBinaryIndexStride = 64;
+
+
+// Create a trajectory from the binary sampled trajectory stored at the given
+// offset in a mapped file: either an xyzvb file, or a shared ephemeris cache
+// entry containing the records of an xyzv or xyz file.
+static InterpolatedStateTrajectory*
+XYZVBinaryTrajectory(MappedFile* file, qint64 offset, const QString& fileName)
+{
+    quint32 flags = 0;
+    if (!ReadBinaryRecordFlags(file, offset, XYZVBinaryHeader, &flags))
     {
-        double jd = 0.0;
-        Vector3d position = Vector3d::Zero();
-        if (!readNextDouble(&scanner, &jd))
+        qDebug() << "File " << fileName << " is not a binary sampled trajectory file.";
+        return NULL;
+    }
+
+    bool hasVelocities = (flags & XYZVBinaryHasVelocitiesFlag) != 0;
+    unsigned int arrayCount = hasVelocities ? 7 : 4;
+    BinaryRecordArrays records;
+    if (!MapBinaryRecordArrays(file, offset, arrayCount, &records))
+    {
+        qDebug() << "Binary trajectory file " << fileName << " is truncated or has a bad header.";
+        return NULL;
+    }
+
+    quint64 radiusBits = qFromLittleEndian<quint64>(file->data() + offset + 24);
+    double boundingRadius = 0.0;
+    memcpy(&boundingRadius, &radiusBits, sizeof(boundingRadius));
+
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    // The records can't be used in place on big endian hosts; byte swap them
+    // into an ordinary list of records instead.
+    if (!hasVelocities)
+    {
+        InterpolatedStateTrajectory::TimePositionList positions(records.recordCount);
+        for (unsigned int i = 0; i < records.recordCount; ++i)
         {
-            done = true;
-            if (!scanner.atEnd())
-            {
-                ok = false;
-            }
+            positions[i].tsec = BinaryRecordValue(records, 0, i);
+            positions[i].position = Vector3d(BinaryRecordValue(records, 1, i),
+                                             BinaryRecordValue(records, 2, i),
+                                             BinaryRecordValue(records, 3, i));
         }
-        else
+        return new InterpolatedStateTrajectory(positions);
+    }
+
+    InterpolatedStateTrajectory::TimeStateList states(records.recordCount);
+    for (unsigned int i = 0; i < records.recordCount; ++i)
+    {
+        double values[7];
+        for (unsigned int j = 0; j < arrayCount; ++j)
         {
-            if (!readNextVector3(&scanner, &position))
-            {
-                ok = false;
-                done = true;
-            }
+            values[j] = BinaryRecordValue(records, j, i);
         }
+        states[i].tsec = values[0];
+        states[i].state = StateVector(Vector3d(values[1], values[2], values[3]), Vector3d(values[4], values[5], values[6]));
+    }
 
-        if (!done)
+    return new InterpolatedStateTrajectory(states);
+#else
+    InterpolatedStateTrajectory::StateArrays stateArrays;
+    stateArrays.count = records.recordCount;
+    stateArrays.tsec = records.arrays[0];
+    stateArrays.x = records.arrays[1];
+    stateArrays.y = records.arrays[2];
+    stateArrays.z = records.arrays[3];
+    if (hasVelocities)
+    {
+        stateArrays.vx = records.arrays[4];
+        stateArrays.vy = records.arrays[5];
+        stateArrays.vz = records.arrays[6];
+    }
+
+    stateArrays.index = records.index;
+    stateArrays.indexStride = records.indexStride;
+    stateArrays.indexCount = records.indexCount;
+
+    return new InterpolatedStateTrajectory(stateArrays, file, boundingRadius);
+#endif
+}
+
+
+// Convert the records of an xyzv or xyz table to a binary sampled trajectory
+// image, laid out as in an xyzvb file. Values are stored in host byte order,
+// so images are only created on little endian hosts.
+static QByteArray
+XYZVBinaryImage(const NumericTableReader& table)
+{
+    unsigned int recordCount = table.recordCount();
+    unsigned int arrayCount = table.fieldCount();
+    quint32 indexCount = (recordCount + XYZVBinaryIndexStride - 1) / XYZVBinaryIndexStride;
+    qint64 arraySize = qint64(recordCount) * sizeof(double);
+
+    QByteArray image(int(XYZVBinaryHeaderSize + arrayCount * arraySize + indexCount * sizeof(double)), '\0');
+    uchar* data = reinterpret_cast<uchar*>(image.data());
+    double* arrays = reinterpret_cast<double*>(data + XYZVBinaryHeaderSize);
+
+    double boundingRadius = 0.0;
+    for (unsigned int i = 0; i < recordCount; ++i)
+    {
+        const double* r = table.record(i);
+        arrays[i] = daysToSeconds(r[0] - vesta::J2000);
+        for (unsigned int j = 1; j < arrayCount; ++j)
         {
-            double tdbSec = daysToSeconds(jd - vesta::J2000);
-            InterpolatedStateTrajectory::TimePosition record;
-            record.tsec = tdbSec;
-            record.position = position;
-            positions.push_back(record);
+            arrays[j * recordCount + i] = r[j];
         }
+        boundingRadius = std::max(boundingRadius, Vector3d(r[1], r[2], r[3]).norm());
     }
 
-    if (!ok)
+    double* index = arrays + arrayCount * recordCount;
+    for (unsigned int i = 0; i < indexCount; ++i)
+    {
+        index[i] = arrays[i * XYZVBinaryIndexStride];
+    }
+
+    memcpy(data, XYZVBinaryHeader, strlen(XYZVBinaryHeader));
+    qToLittleEndian<quint32>(arrayCount == 7 ? XYZVBinaryHasVelocitiesFlag : 0, data + 8);
+    qToLittleEndian<quint32>(recordCount, data + 12);
+    qToLittleEndian<quint32>(XYZVBinaryIndexStride, data + 16);
+    qToLittleEndian<quint32>(indexCount, data + 20);
+    memcpy(data + 24, &boundingRadius, sizeof(boundingRadius));
+
+    return image;
+}
+
+
+// Publish the records of an xyzv or xyz file to the shared ephemeris cache,
+// and create a trajectory that uses the published records in place. Returns
+// null if the cache is disabled or the entry couldn't be written.
+static InterpolatedStateTrajectory*
+PublishSampledTrajectory(const QString& fileName, const QString& kind, const NumericTableReader& table)
+{
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    // Binary trajectory images are little endian and can't be used in place
+    return NULL;
+#else
+    if (!SharedEphemerisCache::IsEnabled() || table.recordCount() == 0)
     {
-        qDebug() << "Error in xyz trajectory file, record " << positions.size();
         return NULL;
     }
-    else
+
+    counted_ptr<MappedFile> entry(SharedEphemerisCache::Publish(fileName, kind, XYZVBinaryImage(table)));
+    if (entry.isNull())
     {
-        return new InterpolatedStateTrajectory(positions);
+        return NULL;
     }
+
+    return XYZVBinaryTrajectory(entry.ptr(), SharedEphemerisCache::PayloadOffset, fileName);
+#endif
 }
 
 
@@ -331,77 +538,146 @@ enum RotationConvention
 InterpolatedRotation*
 LoadInterpolatedRotation(const QString& fileName, RotationConvention mode)
 {
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly))
+    NumericTableReader table(5);
+    NumericTableReader::Status status = table.read(fileName);
+    if (status == NumericTableReader::OpenError)
     {
         qDebug() << "Unable to open trajectory file " << fileName;
         return NULL;
     }
+    else if (status == NumericTableReader::ParseError)
+    {
+        qDebug() << "Error in .q orientation file, record " << table.errorRecord();
+        return NULL;
+    }
 
-    InterpolatedRotation::TimeOrientationList orientations;
-
-    Scanner scanner(&file);
-    bool ok = true;
-    bool done = false;
-    while (!done)
+    InterpolatedRotation::TimeOrientationList orientations(table.recordCount());
+    for (unsigned int i = 0; i < table.recordCount(); ++i)
     {
-        double jd = 0.0;
-        Quaterniond q = Quaterniond::Identity();
-        if (!readNextDouble(&scanner, &jd))
+        const double* r = table.record(i);
+        InterpolatedRotation::TimeOrientation& record = orientations[i];
+        record.tsec = daysToSeconds(r[0] - vesta::J2000);
+
+        // All files *should* contain only unit quaternions, but not all of them do
+        Quaterniond q(r[1], r[2], r[3], r[4]);
+        q.normalize();
+
+        if (mode == Celestia_Rotation)
         {
-            done = true;
-            if (!scanner.atEnd())
-            {
-                ok = false;
-            }
+            record.orientation = (xRotation(toRadians(90.0)) * q).conjugate();
         }
         else
         {
-            if (!readNextQuaternion(&scanner, &q))
-            {
-                ok = false;
-                done = true;
-            }
+            // Normal mode
+            record.orientation = q;
         }
+    }
 
-        if (!done)
-        {
-            double tdbSec = daysToSeconds(jd - vesta::J2000);
-            InterpolatedRotation::TimeOrientation record;
-            record.tsec = tdbSec;
+    return new InterpolatedRotation(orientations);
+}
+
+
+/** Load an orientation table from a binary attitude file (.qb). The file is
+  * memory mapped, and the rotation model refers to the records in place.
+  *
+  * The file begins with a 32 byte header:
+  *
+  * 8 bytes - header "QUATBIN1"
+  * 4 bytes - uint32 - flags (currently always 0)
+  * 4 bytes - uint32 - record count
+  * 4 bytes - uint32 - index stride (number of records per coarse index entry, or 0)
+  * 4 bytes - uint32 - index entry count
+  * 8 bytes - reserved
+  *
+  * The header is followed by arrays of doubles, each with one entry per
+  * record: time (seconds since J2000.0 TDB), and the w, x, y, z components
+  * of a unit quaternion. Times must be increasing. The arrays are followed
+  * by the coarse index, which contains the time of every index stride-th
+  * record.
+  *
+  * Byte order is little endian. Files are created from q files by the
+  * q2bin.py tool.
+  */
+InterpolatedRotation*
+LoadBinaryInterpolatedRotation(const QString& fileName, RotationConvention mode)
+{
+    const char* fileHeader = "QUATBIN1";
+    const unsigned int arrayCount = 5;
 
-            // All files *should* contain only unit quaternions, but not all of them do
-            q.normalize();
+    counted_ptr<MappedFile> file(MappedFile::Open(fileName));
+    if (file.isNull())
+    {
+        qDebug() << "Unable to open orientation file " << fileName;
+        return NULL;
+    }
 
+    quint32 flags = 0;
+    if (!ReadBinaryRecordFlags(file.ptr(), 0, fileHeader, &flags))
+    {
+        qDebug() << "File " << fileName << " is not a binary orientation file.";
+        return NULL;
+    }
+
+    BinaryRecordArrays records;
+    if (!MapBinaryRecordArrays(file.ptr(), 0, arrayCount, &records))
+    {
+        qDebug() << "Binary orientation file " << fileName << " is truncated or has a bad header.";
+        return NULL;
+    }
+
+    bool copyRecords = mode == Celestia_Rotation;
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    // The records can't be used in place on big endian hosts
+    copyRecords = true;
+#endif
+
+    if (copyRecords)
+    {
+        // Decode the records into an ordinary list, converting orientations
+        // from the Celestia convention if necessary.
+        InterpolatedRotation::TimeOrientationList orientations(records.recordCount);
+        for (unsigned int i = 0; i < records.recordCount; ++i)
+        {
+            Quaterniond q(BinaryRecordValue(records, 1, i),
+                          BinaryRecordValue(records, 2, i),
+                          BinaryRecordValue(records, 3, i),
+                          BinaryRecordValue(records, 4, i));
+            orientations[i].tsec = BinaryRecordValue(records, 0, i);
             if (mode == Celestia_Rotation)
             {
-                record.orientation = (xRotation(toRadians(90.0)) * q).conjugate();
+                orientations[i].orientation = (xRotation(toRadians(90.0)) * q).conjugate();
             }
             else
             {
-                // Normal mode
-                record.orientation = q;
+                orientations[i].orientation = q;
             }
-
-            orientations.push_back(record);
         }
-    }
 
-    if (!ok)
-    {
-        qDebug() << "Error in .q orientation file, record " << orientations.size();
-        return NULL;
-    }
-    else
-    {
         return new InterpolatedRotation(orientations);
     }
+
+    InterpolatedRotation::OrientationArrays orientationArrays;
+    orientationArrays.count = records.recordCount;
+    orientationArrays.tsec = records.arrays[0];
+    orientationArrays.w = records.arrays[1];
+    orientationArrays.x = records.arrays[2];
+    orientationArrays.y = records.arrays[3];
+    orientationArrays.z = records.arrays[4];
+
+    orientationArrays.index = records.index;
+    orientationArrays.indexStride = records.indexStride;
+    orientationArrays.indexCount = records.indexCount;
+
+    return new InterpolatedRotation(orientationArrays, file.ptr());
 }
 
 
 UniverseLoader::UniverseLoader() :
     m_dataSearchPath("."),
-    m_texturesInModelDirectory(true)
+    m_trajectoryCacheEnabled(false),
+    m_trajectoryCacheTolerance(CachingChebyshevTrajectory::DefaultTolerance),
+    m_texturesInModelDirectory(true),
+    m_geometryLoadingEnabled(true)
 {
 }
 
@@ -1059,20 +1335,64 @@ UniverseLoader::loadInterpolatedStatesTrajectory(const QVariantMap& info)
     {
         QString name = info.value("source").toString();
 
+        // Optional higher order interpolation over a window of records
+        InterpolatedStateTrajectory::InterpolationMethod interpolation = InterpolatedStateTrajectory::CubicHermite;
+        if (info.contains("interpolation"))
+        {
+            QString interpolationName = info.value("interpolation").toString();
+            if (interpolationName == "lagrange")
+            {
+                interpolation = InterpolatedStateTrajectory::Lagrange;
+            }
+            else if (interpolationName == "hermite")
+            {
+                interpolation = InterpolatedStateTrajectory::Hermite;
+            }
+            else if (interpolationName != "cubic")
+            {
+                errorMessage(QString("Unknown interpolation method '%1' for sampled trajectory").arg(interpolationName));
+                return NULL;
+            }
+        }
+
+        unsigned int interpolationOrder = DefaultInterpolationOrder;
+        if (info.contains("interpolationOrder"))
+        {
+            bool ok = false;
+            interpolationOrder = info.value("interpolationOrder").toUInt(&ok);
+            if (!ok || interpolationOrder == 0 || interpolationOrder > InterpolatedStateTrajectory::MaxInterpolationOrder)
+            {
+                errorMessage(QString("Bad interpolation order for sampled trajectory (must be between 1 and %1)").arg(InterpolatedStateTrajectory::MaxInterpolationOrder));
+                return NULL;
+            }
+        }
+
         QString fileName = dataFileName(name);
+        InterpolatedStateTrajectory* trajectory = NULL;
         if (name.toLower().endsWith(".xyzv"))
         {
-            return LoadXYZVTrajectory(fileName);
+            trajectory = LoadXYZVTrajectory(fileName);
+        }
+        else if (name.toLower().endsWith(".xyzvb"))
+        {
+            trajectory = LoadXYZVBinaryTrajectory(fileName);
         }
         else if (name.toLower().endsWith(".xyz"))
         {
-            return LoadXYZTrajectory(fileName);
+            trajectory = LoadXYZTrajectory(fileName);
         }
         else
         {
             errorMessage("Unknown sampled trajectory format.");
             return NULL;
         }
+
+        if (trajectory && interpolation != InterpolatedStateTrajectory::CubicHermite)
+        {
+            trajectory->setInterpolation(interpolation, interpolationOrder);
+        }
+
+        return trajectory;
     }
     else
     {
@@ -1248,6 +1568,15 @@ UniverseLoader::loadLinearCombinationTrajectory(const QVariantMap& map)
         }
     }
 
+    // Combinations of Chebyshev trajectories (e.g. JPL ephemeris orbits) can
+    // be replaced by a single trajectory that's cheaper to evaluate.
+    Trajectory* simplified = ChebyshevCombinationTrajectory::Simplify(lct);
+    if (simplified)
+    {
+        delete lct;
+        return simplified;
+    }
+
     return lct;
 }
 
@@ -1359,9 +1688,7 @@ bool getNAIFCode(const QVariant& v, SpiceInt* code)
     }
     else if (v.canConvert(QVariant::String))
     {
-        SpiceBoolean found = SPICEFALSE;
-        bodn2c_c(v.toString().toLatin1().data(), code, &found);
-        return found == SPICETRUE;
+        return SpiceGateway::instance()->bodyCode(v.toString().toLatin1().data(), code);
     }
     else
     {
@@ -1416,6 +1743,53 @@ UniverseLoader::loadSpiceTrajectory(const QVariantMap& map)
 
     SpiceTrajectory* trajectory = new SpiceTrajectory(targetID, centerID, spiceFrame.toLatin1().data());
 
+    // If resampling is requested, the SPICE trajectory is approximated by a
+    // table of Chebyshev polynomials over the whole SPK coverage window. The
+    // table is used for all subsequent evaluation, so that CSPICE isn't called
+    // during rendering.
+    if (map.contains("resample"))
+    {
+        QVariantMap resampleMap = map.value("resample").toMap();
+
+        bool ok = false;
+        double tolerance = distanceValue(resampleMap.value("tolerance"), Unit_Kilometer, 0.0, &ok);
+        if (!ok || tolerance <= 0.0)
+        {
+            errorMessage("Invalid or missing tolerance for resampled SPICE trajectory.");
+            delete trajectory;
+            return NULL;
+        }
+
+        SpiceTrajectory::TimeIntervalList coverage;
+        if (!trajectory->coverage(&coverage) || coverage.empty())
+        {
+            errorMessage("No SPK coverage found for '" + targetVar.toString() + "'; SPICE trajectory will not be resampled.");
+            return trajectory;
+        }
+
+        AdaptiveChebyshevTrajectory* resampled = new AdaptiveChebyshevTrajectory();
+        for (unsigned int i = 0; i < coverage.size(); ++i)
+        {
+            resampled->fit(trajectory, coverage[i].first, coverage[i].second, tolerance);
+        }
+
+        if (resampled->segmentCount() == 0)
+        {
+            errorMessage("Unable to resample SPICE trajectory for '" + targetVar.toString() + "'.");
+            delete resampled;
+            return trajectory;
+        }
+
+        if (resampled->maxFitError() > tolerance)
+        {
+            qDebug() << "Resampled SPICE trajectory for" << targetVar.toString()
+                     << "exceeds tolerance; maximum error is" << resampled->maxFitError() * 1000.0 << "m";
+        }
+
+        delete trajectory;
+        return resampled;
+    }
+
     return trajectory;
 #endif
 }
@@ -1431,53 +1805,155 @@ UniverseLoader::loadTrajectory(const QVariantMap& map)
         errorMessage("Trajectory definition is missing type.");
     }
 
+    Trajectory* trajectory = NULL;
+
     QString type = typeData.toString();
     if (type == "FixedPoint")
     {
-        return loadFixedPointTrajectory(map);
+        trajectory = loadFixedPointTrajectory(map);
     }
     else if (type == "FixedSpherical")
     {
-        return loadFixedSphericalTrajectory(map);
+        trajectory = loadFixedSphericalTrajectory(map);
     }
     else if (type == "Keplerian")
     {
-        return loadKeplerianTrajectory(map);
+        trajectory = loadKeplerianTrajectory(map);
     }
     else if (type == "Builtin")
     {
-        return loadBuiltinTrajectory(map);
+        trajectory = loadBuiltinTrajectory(map);
     }
     else if (type == "InterpolatedStates")
     {
-        return loadInterpolatedStatesTrajectory(map);
+        trajectory = loadInterpolatedStatesTrajectory(map);
     }
     else if (type == "ChebyshevPoly")
     {
-        return loadChebyshevPolynomialsTrajectory(map);
+        trajectory = loadChebyshevPolynomialsTrajectory(map);
     }
     else if (type == "TLE")
     {
-        return loadTleTrajectory(map);
+        trajectory = loadTleTrajectory(map);
     }
     else if (type == "LinearCombination")
     {
-        return loadLinearCombinationTrajectory(map);
+        trajectory = loadLinearCombinationTrajectory(map);
     }
     else if (type == "Composite")
     {
-        return loadCompositeTrajectory(map);
+        trajectory = loadCompositeTrajectory(map);
     }
     else if (type == "Spice")
     {
-        return loadSpiceTrajectory(map);
+        trajectory = loadSpiceTrajectory(map);
     }
     else
     {
         errorMessage(QString("Unknown trajectory type '%1'").arg(type));
     }
 
-    return NULL;
+    if (trajectory)
+    {
+        trajectory = loadTrajectoryCache(map, trajectory);
+    }
+
+    return trajectory;
+}
+
+
+// Return true if the trajectory is one of the types that is cached by default
+// when trajectory caching is enabled globally. These are the trajectories that
+// are expensive to evaluate. Linear combinations aren't included: combinations
+// of Chebyshev trajectories are baked when they're loaded, and the children of
+// other combinations are cached themselves if they're expensive.
+static bool
+IsExpensiveTrajectory(Trajectory* trajectory)
+{
+    return dynamic_cast<TASS17Orbit*>(trajectory) ||
+           dynamic_cast<L1Orbit*>(trajectory) ||
+           dynamic_cast<Gust86Orbit*>(trajectory) ||
+           dynamic_cast<MarsSatOrbit*>(trajectory) ||
+           dynamic_cast<TleTrajectory*>(trajectory);
+}
+
+
+/** Wrap a trajectory with a CachingChebyshevTrajectory if requested. The
+  * optional cache property of a trajectory definition is either a boolean
+  * or a map with the following optional properties:
+  *
+  *   tolerance - maximum position error (default 10 m)
+  *   window    - length of the time windows that are fit (default 1 day)
+  *
+  * When the cache property is absent, the global setting determines whether
+  * expensive trajectories (analytical satellite theories and TLEs) are
+  * cached.
+  */
+vesta::Trajectory*
+UniverseLoader::loadTrajectoryCache(const QVariantMap& map, vesta::Trajectory* trajectory)
+{
+    QVariant cacheVar = map.value("cache");
+
+    bool enabled = m_trajectoryCacheEnabled && IsExpensiveTrajectory(trajectory);
+    double tolerance = m_trajectoryCacheTolerance;
+    double windowDuration = CachingChebyshevTrajectory::DefaultWindowDuration;
+
+    if (cacheVar.type() == QVariant::Bool)
+    {
+        enabled = cacheVar.toBool();
+    }
+    else if (cacheVar.type() == QVariant::Map)
+    {
+        QVariantMap cacheMap = cacheVar.toMap();
+        enabled = true;
+
+        bool ok = true;
+        if (cacheMap.contains("tolerance"))
+        {
+            tolerance = distanceValue(cacheMap.value("tolerance"), Unit_Kilometer, 0.0, &ok);
+            if (!ok || tolerance <= 0.0)
+            {
+                errorMessage("Invalid tolerance given for trajectory cache.");
+                return trajectory;
+            }
+        }
+
+        if (cacheMap.contains("window"))
+        {
+            windowDuration = durationValue(cacheMap.value("window"), Unit_Day, 0.0, &ok);
+            if (!ok || windowDuration <= 0.0)
+            {
+                errorMessage("Invalid window given for trajectory cache.");
+                return trajectory;
+            }
+        }
+    }
+    else if (cacheVar.isValid())
+    {
+        errorMessage("Trajectory cache must be either a boolean or a map.");
+        return trajectory;
+    }
+
+    if (!enabled)
+    {
+        return trajectory;
+    }
+
+    CachingChebyshevTrajectory* cache = new CachingChebyshevTrajectory(trajectory, tolerance, windowDuration);
+
+    // TLE trajectories may be updated after they're loaded, which makes the
+    // fitted windows stale.
+    if (dynamic_cast<TleTrajectory*>(trajectory))
+    {
+        QString source = map.value("source").toString();
+        if (!source.isEmpty())
+        {
+            m_tleTrajectoryCaches.insert(TleKey(source, map.value("name").toString()),
+                                         counted_ptr<CachingChebyshevTrajectory>(cache));
+        }
+    }
+
+    return cache;
 }
 
 
@@ -1674,16 +2150,43 @@ UniverseLoader::loadInterpolatedRotationModel(const QVariantMap& info)
             rotationConvention = Celestia_Rotation;
         }
 
+        InterpolatedRotation::InterpolationMethod interpolation = InterpolatedRotation::Slerp;
+        if (info.contains("interpolation"))
+        {
+            QString interpolationName = info.value("interpolation").toString();
+            if (interpolationName == "cubic")
+            {
+                interpolation = InterpolatedRotation::Cubic;
+            }
+            else if (interpolationName != "slerp")
+            {
+                errorMessage(QString("Unknown interpolation method '%1' for interpolated rotation").arg(interpolationName));
+                return NULL;
+            }
+        }
+
         QString fileName = dataFileName(name);
+        InterpolatedRotation* rotation = NULL;
         if (name.toLower().endsWith(".q"))
         {
-            return LoadInterpolatedRotation(fileName, rotationConvention);
+            rotation = LoadInterpolatedRotation(fileName, rotationConvention);
+        }
+        else if (name.toLower().endsWith(".qb"))
+        {
+            rotation = LoadBinaryInterpolatedRotation(fileName, rotationConvention);
         }
         else
         {
             errorMessage("Unknown interpolated rotation format.");
             return NULL;
         }
+
+        if (rotation && interpolation != InterpolatedRotation::Slerp)
+        {
+            rotation->setInterpolation(interpolation);
+        }
+
+        return rotation;
     }
     else
     {
@@ -2085,6 +2588,14 @@ UniverseLoader::loadFrame(const QVariantMap& map,
     {
         return loadTwoVectorFrame(map, catalog);
     }
+    else if (type == "MeanEquatorOfDate")
+    {
+        return new EquatorOfDateFrame(EquatorOfDateFrame::MeanEquator);
+    }
+    else if (type == "TrueEquatorOfDate")
+    {
+        return new EquatorOfDateFrame(EquatorOfDateFrame::TrueEquator);
+    }
     else
     {
         Frame* frame = loadInertialFrame(type);
@@ -2102,6 +2613,44 @@ UniverseLoader::loadFrame(const QVariantMap& map,
 }
 
 
+/** Load a frame given either as the name of an inertial frame or as a
+  * frame definition in the same form used in catalog files. Bodies named
+  * in the definition are looked up in the specified catalog.
+  *
+  * \return the frame, or NULL if the frame definition was invalid
+  */
+vesta::Frame*
+UniverseLoader::loadFrameDefinition(const QVariant& frameData,
+                                    const UniverseCatalog* catalog)
+{
+    if (frameData.type() == QVariant::String)
+    {
+        // Inertial frame name
+        return loadInertialFrame(frameData.toString());
+    }
+    else if (frameData.type() == QVariant::Map)
+    {
+        return loadFrame(frameData.toMap(), catalog);
+    }
+    else
+    {
+        errorMessage("Invalid frame definition");
+        return NULL;
+    }
+}
+
+
+/** Convert a date given in any of the forms accepted in catalog files to
+  * seconds since J2000 TDB: a Julian date (TDB) or a calendar date string,
+  * optionally followed by UTC or TDB (the default.)
+  */
+double
+UniverseLoader::parseDate(const QVariant& dateData, bool* ok)
+{
+    return dateValue(dateData, ok);
+}
+
+
 vesta::Arc*
 UniverseLoader::loadArc(const QVariantMap& map,
                         const UniverseCatalog* catalog,
@@ -2968,6 +3517,37 @@ UniverseLoader::loadSwarmGeometry(const QVariantMap& map)
 }
 
 
+/** Load a geometry that shows every object in a file of two-line element
+  * sets as a point.
+  */
+Geometry*
+UniverseLoader::loadTleSwarmGeometry(const QVariantMap& map)
+{
+    QVariant sourceVar = map.value("source");
+    if (!sourceVar.isValid())
+    {
+       errorMessage("Missing source for TLE swarm geometry");
+       return NULL;
+    }
+
+    float particleSize = float(doubleValue(map.value("particleSize"), 1.0));
+    float fadeSize = float(doubleValue(map.value("fadeSize"), 50.0));
+    Spectrum color = colorValue(map.value("color"), Spectrum::White());
+    float opacity = float(doubleValue(map.value("opacity"), 1.0));
+
+    TleSwarm* swarm = LoadTleFile(dataFileName(sourceVar.toString()));
+    if (swarm)
+    {
+        swarm->setColor(color);
+        swarm->setOpacity(opacity);
+        swarm->setPointSize(particleSize);
+        swarm->setFadeSize(fadeSize);
+    }
+
+    return swarm;
+}
+
+
 static InitialStateGenerator*
 loadStripParticleGenerator(const QVariantMap& map)
 {
@@ -3445,6 +4025,10 @@ UniverseLoader::loadGeometry(const QVariantMap& map, const UniverseCatalog* cata
     {
         geometry = loadSwarmGeometry(map);
     }
+    else if (type == "TleSwarm")
+    {
+        geometry = loadTleSwarmGeometry(map);
+    }
     else if (type == "ParticleSystem")
     {
         geometry = loadParticleSystemGeometry(map);
@@ -4345,7 +4929,7 @@ UniverseLoader::loadCatalogItems(const QVariantMap& contentsMap,
                 double startTime = DefaultStartTime;
                 QList<counted_ptr<vesta::Arc> > arcs;
 
-                if (item.contains("geometry"))
+                if (item.contains("geometry") && m_geometryLoadingEnabled)
                 {
                     QVariant geometryValue = item.value("geometry");
                     if (geometryValue.type() == QVariant::Map)
@@ -4531,10 +5115,7 @@ void
 UniverseLoader::loadSpiceKernels(const QStringList& kernelList)
 {
 #ifdef SPICE_ENABLED
-    foreach (QString kernel, kernelList)
-    {
-        furnsh_c(kernel.toLatin1().data());
-    }
+    SpiceGateway::instance()->loadKernels(kernelList);
 #endif
 }
 
@@ -4564,11 +5145,8 @@ void
 UniverseLoader::unloadSpiceKernels(const QStringList& kernelList)
 {
 #ifdef SPICE_ENABLED
-    for (int i = kernelList.length() - 1; i >= 0; --i)
-    {
-        QString kernel = kernelList.at(i);
-        unload_c(kernel.toLatin1().data());
-    }
+    // Kernels are unloaded in reverse order
+    SpiceGateway::instance()->unloadKernels(kernelList);
 #endif
 }
 
@@ -4614,6 +5192,20 @@ UniverseLoader::setDataSearchPath(const QString& path)
 }
 
 
+/** Enable or disable caching of expensive trajectories. When enabled,
+  * analytical satellite theories and TLE trajectories loaded afterward are
+  * approximated by Chebyshev polynomials fit to within the specified
+  * tolerance (in km). Individual trajectories may override this
+  * setting with the cache property.
+  */
+void
+UniverseLoader::setTrajectoryCache(bool enabled, double tolerance)
+{
+    m_trajectoryCacheEnabled = enabled;
+    m_trajectoryCacheTolerance = tolerance;
+}
+
+
 void
 UniverseLoader::setTextureSearchPath(const QString& path)
 {
@@ -4659,7 +5251,8 @@ UniverseLoader::cleanGeometryCache()
 
 
 /** Process all pending object updates, e.g. new TLE sets received from
-  * the network.
+  * the network. All updates are applied at once, so that a frame is never
+  * drawn with only part of a TLE set updated.
   */
 void
 UniverseLoader::processUpdates()
@@ -4668,24 +5261,40 @@ UniverseLoader::processUpdates()
     {
         QString key = TleKey(tleData.source, tleData.name);
 
+        // Skip element sets that are identical to the cached ones
+        QHash<QString, TleRecord>::const_iterator iter = m_tleCache.find(key);
+        if (iter != m_tleCache.end() && iter->line1 == tleData.line1 && iter->line2 == tleData.line2)
+        {
+            continue;
+        }
+
         // Add it to the TLE cache
         m_tleCache.insert(key, tleData);
 
-        // Update all TLE trajectories that refer to this TLE
-        foreach (counted_ptr<TleTrajectory> trajectory, m_tleTrajectories.values(key))
+        QList<counted_ptr<TleTrajectory> > trajectories = m_tleTrajectories.values(key);
+        if (trajectories.isEmpty())
         {
-            // Create a temporary TLE trajectory from the data and use it to udpate the trajectory in
-            // the cache.
-            counted_ptr<TleTrajectory> tempTle(TleTrajectory::Create(tleData.line1.toLatin1().data(),
-                                                                     tleData.line2.toLatin1().data()));
-            if (tempTle.isValid())
-            {
-                trajectory->copy(tempTle.ptr());
-            }
-            else
-            {
-                qDebug() << "Bad TLE received: " << tleData.name << " from " << tleData.source;
-            }
+            continue;
+        }
+
+        // Create a temporary TLE trajectory from the data and use it to update all
+        // TLE trajectories that refer to this TLE.
+        counted_ptr<TleTrajectory> tempTle(TleTrajectory::Create(tleData.line1.toLatin1().data(),
+                                                                 tleData.line2.toLatin1().data()));
+        if (tempTle.isNull())
+        {
+            qDebug() << "Bad TLE received: " << tleData.name << " from " << tleData.source;
+            continue;
+        }
+
+        foreach (counted_ptr<TleTrajectory> trajectory, trajectories)
+        {
+            trajectory->copy(tempTle.ptr());
+        }
+
+        foreach (counted_ptr<CachingChebyshevTrajectory> cache, m_tleTrajectoryCaches.values(key))
+        {
+            cache->invalidate();
         }
     }
 
@@ -4693,32 +5302,14 @@ UniverseLoader::processUpdates()
 }
 
 
-/** Process a new TLE data set.
+/** Apply a list of changed TLE records, typically delivered by a
+  * TleSetRequester running in another thread.
   */
 void
-UniverseLoader::processTleSet(const QString &source, QTextStream& stream)
+UniverseLoader::applyTleUpdates(const QList<TleRecord>& records)
 {
-    QTextStream::Status status = QTextStream::Ok;
-    while (status == QTextStream::Ok)
-    {
-        QString name = stream.readLine();
-        QString tleLine1 = stream.readLine();
-        QString tleLine2 = stream.readLine();
-
-        name = name.trimmed();
-        status = stream.status();
-        if (status == QTextStream::Ok)
-        {
-            if (name.isEmpty())
-            {
-                break;
-            }
-            else
-            {
-                updateTle(source, name, tleLine1, tleLine2);
-            }
-        }
-    }
+    m_tleUpdates << records;
+    processUpdates();
 }
 
 
@@ -18,6 +18,7 @@
 #define _UNIVERSE_LOADER_H_
 
 #include "UniverseCatalog.h"
+#include "../TleSetRequester.h"
 #include <vesta/Entity.h>
 #include <vesta/Frame.h>
 #include <vesta/Trajectory.h>
@@ -32,6 +33,7 @@
 
 
 class TleTrajectory;
+class CachingChebyshevTrajectory;
 
 namespace vesta
 {
@@ -103,6 +105,7 @@ public:
     void setDataSearchPath(const QString& path);
     void setTextureSearchPath(const QString& path);
     void setModelSearchPath(const QString& path);
+    void setTrajectoryCache(bool enabled, double tolerance);
 
     void updateTle(const QString& source, const QString& name, const QString& line1, const QString& line2);
 
@@ -119,16 +122,29 @@ public:
         m_texturesInModelDirectory = enable;
     }
 
+    /** Body geometry is loaded by default. Programs that only need the
+      * positions and orientations of bodies (and that have no texture loader)
+      * may disable it.
+      */
+    void setGeometryLoadingEnabled(bool enable)
+    {
+        m_geometryLoadingEnabled = enable;
+    }
+
     CatalogContents* loadCatalogFile(const QString& fileName,
                                      UniverseCatalog* catalog);
     void unloadSpiceKernels(const QStringList& kernelList);
 
+    vesta::Frame* loadFrameDefinition(const QVariant& frameData,
+                                      const UniverseCatalog* catalog);
+    static double parseDate(const QVariant& dateData, bool* ok);
+
     void clearMessageLog();
     QString messageLog();
 
 public slots:
     void processUpdates();
-    void processTleSet(const QString& source, QTextStream& stream);
+    void applyTleUpdates(const QList<TleRecord>& records);
 
 private:
     vesta::Geometry* loadGeometry(const QVariantMap& map,
@@ -139,6 +155,7 @@ private:
     vesta::Geometry* loadSensorGeometry(const QVariantMap& map,
                                         const UniverseCatalog* catalog);
     vesta::Geometry* loadSwarmGeometry(const QVariantMap& map);
+    vesta::Geometry* loadTleSwarmGeometry(const QVariantMap& map);
     vesta::Geometry* loadParticleSystemGeometry(const QVariantMap& map);
     vesta::Geometry* loadTimeSwitchedGeometry(const QVariantMap& map,
                                               const UniverseCatalog* catalog);
@@ -168,6 +185,7 @@ private:
     vesta::Trajectory* loadLinearCombinationTrajectory(const QVariantMap& info);
     vesta::Trajectory* loadCompositeTrajectory(const QVariantMap& info);
     vesta::Trajectory* loadSpiceTrajectory(const QVariantMap& info);
+    vesta::Trajectory* loadTrajectoryCache(const QVariantMap& map, vesta::Trajectory* trajectory);
 
     vesta::RotationModel* loadRotationModel(const QVariantMap& info);
     vesta::RotationModel* loadBuiltinRotationModel(const QVariantMap& info);
@@ -223,16 +241,9 @@ private:
     QString m_modelSearchPath;
     QString m_currentBodyName;
 
-    struct TleRecord
-    {
-        QString source;
-        QString name;
-        QString line1;
-        QString line2;
-    };
-
     QHash<QString,TleRecord> m_tleCache;
     QMultiHash<QString, vesta::counted_ptr<TleTrajectory> > m_tleTrajectories;
+    QMultiHash<QString, vesta::counted_ptr<CachingChebyshevTrajectory> > m_tleTrajectoryCaches;
     QList<TleRecord> m_tleUpdates;
     QSet<QString> m_resourceRequests;
 
@@ -243,7 +254,11 @@ private:
     QSet<QString> m_loadedCatalogFiles;
     QString m_messageLog;
 
+    bool m_trajectoryCacheEnabled;
+    double m_trajectoryCacheTolerance;
+
     bool m_texturesInModelDirectory;
+    bool m_geometryLoadingEnabled;
 };
 
 #endif // _UNIVERSE_LOADER_H_
@@ -16,6 +16,7 @@
 
 #include "SimpleTrajectoryGeometry.h"
 #include <vesta/RenderContext.h>
+#include <Eigen/StdVector>
 #include <algorithm>
 #include <iomanip>
 
@@ -259,10 +260,20 @@ SimpleTrajectoryGeometry::computeSamples(const vesta::TrajectoryPlotGenerator* g
 
     double invStep = 1.0 / double(stepCount);
 
+    std::vector<double> sampleTimes(stepCount + 1);
     for (unsigned int i = 0; i <= stepCount; ++i)
     {
-        double t = t0 + dt * (i * invStep);
-        addSample(t, generator->state(t));
+        sampleTimes[i] = t0 + dt * (i * invStep);
+    }
+
+    // Evaluate all states in one batch; this is much cheaper than calling state()
+    // for each sample when the trajectory is tabulated.
+    std::vector<StateVector, aligned_allocator<StateVector> > sampleStates(stepCount + 1);
+    generator->states(&sampleTimes[0], sampleTimes.size(), &sampleStates[0]);
+
+    for (unsigned int i = 0; i <= stepCount; ++i)
+    {
+        addSample(sampleTimes[i], sampleStates[i]);
     }
 }
 
@@ -16,9 +16,21 @@
 
 #include <QApplication>
 #include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
 #include <QMessageBox>
 #include <QDebug>
 #include <QDesktopServices>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QThread>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
 
 #if defined(Q_WS_MAC) || defined(Q_OS_MAC)
 #include <CoreFoundation/CFBundle.h>
@@ -26,28 +38,35 @@
 
 #include "Cosmographia.h"
 #include "FileOpenEventFilter.h"
+#include "BuiltinModels.h"
+#include "EphemerisServer.h"
+#include "BatchStateEvaluator.h"
+#include "EventFinder.h"
+#include "SharedEphemerisCache.h"
+#include "CachingChebyshevTrajectory.h"
+#include "TleSetRequester.h"
+#include "catalog/UniverseLoader.h"
+#include "catalog/UniverseCatalog.h"
 
 #define MAS_DEPLOY 0
 
 
-int main(int argc, char *argv[])
+// Set the names used to locate settings and standard directories
+static void setApplicationInfo()
 {
-    QApplication app(argc, argv);
-
-    FileOpenEventFilter* appEventFilter = new FileOpenEventFilter();
-    app.installEventFilter(appEventFilter);
-
 #if MAS_DEPLOY
 #else
     QCoreApplication::setOrganizationName("Periapsis Visual Software");
     QCoreApplication::setOrganizationDomain("periapsisvisual.com");
     QCoreApplication::setApplicationName("Cosmographia");
 #endif
+}
 
-    // Useful when we need to know where the data files are:
-    //   qDebug() << QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
-    //   qDebug() << QDesktopServices::storageLocation(QDesktopServices::DataLocation);
 
+// Find the directory containing the data files. Returns an empty string
+// if it couldn't be found.
+static QString findDataPath()
+{
     // Set current directory so that we find the needed data files. On the Mac, we
     // just look in the app bundle. On other platforms we make some guesses, since we
     // don't know exactly where the executable will be run from.
@@ -102,6 +121,575 @@ int main(int argc, char *argv[])
         foundData = false;
     }
 #endif
+
+    return foundData ? dataPath : QString();
+}
+
+
+// Load a catalog file in a headless mode, reporting any errors
+static void loadHeadlessCatalog(UniverseLoader* loader, UniverseCatalog* catalog, const QString& fileName)
+{
+    QFileInfo info(fileName);
+    if (!info.exists())
+    {
+        qWarning() << "Could not open catalog file" << fileName;
+        return;
+    }
+
+    loader->setDataSearchPath(info.absolutePath());
+    loader->setModelSearchPath(info.absolutePath());
+
+    loader->clearMessageLog();
+    CatalogContents* contents = loader->loadCatalogFile(info.fileName(), catalog);
+    delete contents;
+
+    QString errorMessages = loader->messageLog();
+    if (!errorMessages.isEmpty())
+    {
+        qWarning() << "Errors in catalog" << fileName << ":" << errorMessages;
+    }
+}
+
+
+// Parse the command line of a headless mode. Every argument starting with a
+// dash is a switch followed by a value; the others are catalog files, which
+// are relative to the directory that the program was started from.
+static void parseHeadlessArguments(QHash<QString, QString>* switches, QStringList* catalogFiles)
+{
+    QStringList argList = QCoreApplication::arguments();
+    for (int argIndex = 1; argIndex < argList.size(); ++argIndex)
+    {
+        QString arg = argList.at(argIndex);
+        if (arg.startsWith('-'))
+        {
+            if (argIndex + 1 < argList.size())
+            {
+                switches->insert(arg, argList.at(argIndex + 1));
+            }
+            ++argIndex;
+        }
+        else
+        {
+            *catalogFiles << QFileInfo(arg).absoluteFilePath();
+        }
+    }
+}
+
+
+// Load the builtin models, the Solar System catalog, and then the other
+// catalog files for a headless mode. Body geometry isn't loaded.
+static bool loadHeadlessUniverse(UniverseLoader* loader, UniverseCatalog* catalog, const QStringList& catalogFiles)
+{
+    QString dataPath = findDataPath();
+    if (dataPath.isEmpty() || !QDir::setCurrent(dataPath))
+    {
+        qCritical() << "Data files not found!";
+        return false;
+    }
+
+    QSettings settings;
+    if (settings.value("sharedEphemerisCache", false).toBool())
+    {
+        QString defaultCacheDirectory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/ephemeris";
+        SharedEphemerisCache::SetDirectory(settings.value("sharedEphemerisCacheDirectory", defaultCacheDirectory).toString());
+    }
+
+    loader->setGeometryLoadingEnabled(false);
+    loader->setTrajectoryCache(settings.value("trajectoryCache", false).toBool(),
+                               settings.value("trajectoryCacheTolerance", CachingChebyshevTrajectory::DefaultTolerance).toDouble());
+    AddBuiltinModels(loader);
+
+    loadHeadlessCatalog(loader, catalog, QFileInfo("solarsys.json").absoluteFilePath());
+    foreach (QString fileName, catalogFiles)
+    {
+        loadHeadlessCatalog(loader, catalog, fileName);
+    }
+
+    return true;
+}
+
+
+// Run Cosmographia without a window, answering ephemeris queries on a local
+// socket:
+//
+//   cosmographia -serve <socket name> [-threads <count>] [catalog files]
+static int runEphemerisServer(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    setApplicationInfo();
+
+    QHash<QString, QString> switches;
+    QStringList catalogFiles;
+    parseHeadlessArguments(&switches, &catalogFiles);
+
+    UniverseLoader loader;
+    UniverseCatalog catalog;
+    if (!loadHeadlessUniverse(&loader, &catalog, catalogFiles))
+    {
+        return 1;
+    }
+
+    EphemerisServer server(&loader, &catalog);
+    server.setThreadCount(switches.value("-threads", "0").toUInt());
+
+    // Keep TLE trajectories current. Updates are delivered to the server's
+    // thread and applied between requests.
+    TleSetRequester* tleRequester = new TleSetRequester(QStandardPaths::locate(QStandardPaths::CacheLocation, "catalog", QStandardPaths::LocateDirectory));
+    QObject::connect(tleRequester, SIGNAL(tleRecordsChanged(const QList<TleRecord>&)),
+                     &server, SLOT(applyTleUpdates(const QList<TleRecord>&)));
+    QThread tleRequestThread;
+    tleRequester->moveToThread(&tleRequestThread);
+    tleRequestThread.start();
+    foreach (QString resource, loader.resourceRequests())
+    {
+        QMetaObject::invokeMethod(tleRequester, "requestTleSet", Qt::QueuedConnection, Q_ARG(QString, resource));
+    }
+
+    QString socketName = switches.value("-serve");
+    int result = 1;
+    if (server.listen(socketName))
+    {
+        qDebug() << "Serving ephemeris queries on" << socketName;
+        result = app.exec();
+    }
+    else
+    {
+        qCritical() << "Could not listen on" << socketName << ":" << server.errorString();
+    }
+
+    tleRequestThread.exit();
+    tleRequestThread.wait();
+    delete tleRequester;
+
+    return result;
+}
+
+
+// Parse a date given on the command line: either a Julian date or a
+// calendar date in any of the forms accepted in catalog files
+static double parseDateArgument(const QString& arg, bool* ok)
+{
+    bool isNumber = false;
+    double jd = arg.toDouble(&isNumber);
+    if (isNumber)
+    {
+        return UniverseLoader::parseDate(QVariant(jd), ok);
+    }
+    else
+    {
+        return UniverseLoader::parseDate(QVariant(arg), ok);
+    }
+}
+
+
+// Number of epochs evaluated and written at a time during an export
+static const unsigned int ExportBlockEpochs = 4096;
+
+// Evaluate the states of catalog bodies over a grid of times and write them
+// to a file:
+//
+//   cosmographia -export <file> -start <date> -end <date> [-step <seconds>]
+//                [-bodies <name,name,...>] [-format csv|binary]
+//                [-threads <count>] [catalog files]
+//
+// Dates are Julian dates (TDB) or calendar dates as in catalog files. The
+// default step is one day, and the default is to export every body in the
+// catalogs. States are positions (km) and velocities (km/s) with respect to
+// the Solar System barycenter in the EquatorJ2000 frame, exactly as returned
+// by Entity::state. TLE sets that must be fetched over the network aren't
+// waited for.
+//
+// CSV files have a header line and then one line per epoch and body:
+// time (seconds since J2000 TDB), body name, x, y, z, vx, vy, vz. Values are
+// written with 17 significant digits, enough to reproduce them exactly.
+//
+// Binary files start with a 24 byte header: "COSMOSTA", then the number of
+// bodies, the number of epochs, the length of the body name list, and a
+// reserved word (all 32-bit integers). The body names follow, separated by
+// newlines and padded with zeros to a multiple of 8 bytes. Then for each
+// epoch there is a record of doubles: the time followed by the six state
+// components of each body, in order. Numbers are in host byte order.
+static int runStateExport(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    setApplicationInfo();
+
+    QHash<QString, QString> switches;
+    QStringList catalogFiles;
+    parseHeadlessArguments(&switches, &catalogFiles);
+
+    bool startOk = false;
+    bool endOk = false;
+    double startTime = parseDateArgument(switches.value("-start"), &startOk);
+    double endTime = parseDateArgument(switches.value("-end"), &endOk);
+    double step = switches.value("-step", "86400").toDouble();
+    if (!startOk || !endOk || !(endTime >= startTime) || !(step > 0.0))
+    {
+        qCritical() << "Export requires a valid -start and -end date and a positive -step";
+        return 1;
+    }
+
+    double stepCount = floor((endTime - startTime) / step);
+    if (stepCount >= 4294967295.0)
+    {
+        qCritical() << "Too many epochs for export";
+        return 1;
+    }
+    unsigned int epochCount = unsigned(stepCount) + 1;
+
+    // The output file name is relative to the directory that the program
+    // was started from.
+    QString outputFileName = QFileInfo(switches.value("-export")).absoluteFilePath();
+    bool csv = switches.value("-format", outputFileName.endsWith(".csv", Qt::CaseInsensitive) ? "csv" : "binary") == "csv";
+
+    UniverseLoader loader;
+    UniverseCatalog catalog;
+    if (!loadHeadlessUniverse(&loader, &catalog, catalogFiles))
+    {
+        return 1;
+    }
+
+    QStringList bodyNames = catalog.names();
+    if (switches.contains("-bodies"))
+    {
+        bodyNames = switches.value("-bodies").split(',', QString::SkipEmptyParts);
+    }
+
+    std::vector<const vesta::Entity*> bodies;
+    foreach (QString name, bodyNames)
+    {
+        const vesta::Entity* body = catalog.find(name.trimmed());
+        if (!body)
+        {
+            qCritical() << "Unknown body" << name;
+            return 1;
+        }
+        bodies.push_back(body);
+    }
+
+    if (bodies.empty())
+    {
+        qCritical() << "No bodies to export";
+        return 1;
+    }
+
+    QFile outputFile(outputFileName);
+    if (!outputFile.open(QIODevice::WriteOnly))
+    {
+        qCritical() << "Could not create" << outputFileName << ":" << outputFile.errorString();
+        return 1;
+    }
+
+    // Body names as written to the output, without the spaces that may
+    // surround them in the -bodies list
+    std::vector<QByteArray> utf8Names;
+    foreach (QString name, bodyNames)
+    {
+        utf8Names.push_back(name.trimmed().toUtf8());
+    }
+
+    if (csv)
+    {
+        outputFile.write("time,body,x,y,z,vx,vy,vz\n");
+    }
+    else
+    {
+        QByteArray names;
+        for (unsigned int i = 0; i < utf8Names.size(); ++i)
+        {
+            if (i > 0)
+            {
+                names += '\n';
+            }
+            names += utf8Names[i];
+        }
+        quint32 header[4] = { quint32(bodies.size()), epochCount, quint32(names.size()), 0 };
+        outputFile.write("COSMOSTA", 8);
+        outputFile.write(reinterpret_cast<const char*>(header), sizeof(header));
+        outputFile.write(names);
+        outputFile.write(QByteArray((8 - names.size() % 8) % 8, '\0'));
+    }
+
+    BatchStateEvaluator evaluator;
+    evaluator.setThreadCount(switches.value("-threads", "0").toUInt());
+    evaluator.setBodies(bodies);
+
+    const unsigned int stateSize = BatchStateEvaluator::StateSize;
+    std::vector<double> epochs;
+    std::vector<double> states;
+    std::vector<double> record(1 + bodies.size() * stateSize);
+    for (unsigned int blockStart = 0; blockStart < epochCount; blockStart += ExportBlockEpochs)
+    {
+        unsigned int blockEpochs = std::min(ExportBlockEpochs, epochCount - blockStart);
+        epochs.resize(blockEpochs);
+        states.resize(blockEpochs * bodies.size() * stateSize);
+        for (unsigned int i = 0; i < blockEpochs; ++i)
+        {
+            epochs[i] = startTime + (blockStart + i) * step;
+        }
+
+        evaluator.evaluate(&epochs[0], blockEpochs, &states[0]);
+
+        for (unsigned int i = 0; i < blockEpochs; ++i)
+        {
+            const double* epochStates = &states[0] + size_t(i) * bodies.size() * stateSize;
+            if (csv)
+            {
+                char line[512];
+                for (unsigned int j = 0; j < bodies.size(); ++j)
+                {
+                    const double* s = epochStates + j * stateSize;
+                    int length = snprintf(line, sizeof(line), "%.17g,%s,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g\n",
+                                          epochs[i], utf8Names[j].constData(), s[0], s[1], s[2], s[3], s[4], s[5]);
+                    outputFile.write(line, std::min(length, int(sizeof(line)) - 1));
+                }
+            }
+            else
+            {
+                record[0] = epochs[i];
+                std::copy(epochStates, epochStates + bodies.size() * stateSize, record.begin() + 1);
+                outputFile.write(reinterpret_cast<const char*>(&record[0]), record.size() * sizeof(double));
+            }
+        }
+    }
+
+    if (outputFile.error() != QFile::NoError)
+    {
+        qCritical() << "Error writing" << outputFileName << ":" << outputFile.errorString();
+        return 1;
+    }
+
+    return 0;
+}
+
+
+// Look up the body named by a switch of a headless mode, reporting an error if
+// there isn't one.
+static const vesta::Entity* findSwitchBody(const UniverseCatalog& catalog, const QHash<QString, QString>& switches,
+                                           const QString& switchName, const QString& defaultName = QString())
+{
+    QString name = switches.value(switchName, defaultName);
+    if (name.isEmpty())
+    {
+        qCritical() << "The" << switchName << "switch is required";
+        return NULL;
+    }
+
+    const vesta::Entity* body = catalog.find(name);
+    if (!body)
+    {
+        qCritical() << "Unknown body" << name;
+    }
+
+    return body;
+}
+
+
+// Nominal radius of the Sun in km (IAU 2015 Resolution B3)
+static const double NominalSolarRadius = 695700.0;
+
+// Search catalog bodies for geometric events and write them to a file:
+//
+//   cosmographia -events approach -body <name> -center <name> -start <date> -end <date>
+//                [-distance <km>]
+//   cosmographia -events periapsis|apoapsis -body <name> -center <name> -start <date> -end <date>
+//   cosmographia -events occultation -body <name> -targetRadius <km> -occulter <name>
+//                -occulterRadius <km> -center <name> -start <date> -end <date>
+//   cosmographia -events eclipse -body <name> -occulter <name> -occulterRadius <km>
+//                [-sun <name>] [-sunRadius <km>] -start <date> -end <date>
+//
+// with the options [-output <file>] [-threads <count>] [catalog files]
+//
+// Dates are given as for -export. For closest approaches and apsides, -body
+// is the moving body and -center the body that distances are measured from;
+// closest approaches farther than -distance (unlimited by default) are
+// skipped. For occultations, -body is the target and -center the observer.
+// Eclipses are occultations of the Sun as seen from -body. Radii are in km;
+// geometry isn't loaded in headless modes, so they must be given for
+// occultations and eclipses.
+//
+// The events are written as CSV, to standard output when no file is given:
+// a header line, then one line per event with the type, the start, end, and
+// peak times (seconds since J2000 TDB), and the value: the distance in km
+// for closest approaches and apsides, or the angular separation in radians
+// at the peak of an occultation.
+static int runEventSearch(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    setApplicationInfo();
+
+    QHash<QString, QString> switches;
+    QStringList catalogFiles;
+    parseHeadlessArguments(&switches, &catalogFiles);
+
+    bool startOk = false;
+    bool endOk = false;
+    double startTime = parseDateArgument(switches.value("-start"), &startOk);
+    double endTime = parseDateArgument(switches.value("-end"), &endOk);
+    if (!startOk || !endOk || !(endTime > startTime))
+    {
+        qCritical() << "Event search requires a valid -start and -end date";
+        return 1;
+    }
+
+    QString searchType = switches.value("-events");
+    if (searchType != "approach" && searchType != "periapsis" && searchType != "apoapsis" &&
+        searchType != "occultation" && searchType != "eclipse")
+    {
+        qCritical() << "Unknown event type" << searchType;
+        return 1;
+    }
+
+    QFile outputFile;
+    if (switches.contains("-output"))
+    {
+        // The output file name is relative to the directory that the
+        // program was started from.
+        outputFile.setFileName(QFileInfo(switches.value("-output")).absoluteFilePath());
+        if (!outputFile.open(QIODevice::WriteOnly))
+        {
+            qCritical() << "Could not create" << outputFile.fileName() << ":" << outputFile.errorString();
+            return 1;
+        }
+    }
+    else if (!outputFile.open(stdout, QIODevice::WriteOnly))
+    {
+        return 1;
+    }
+
+    UniverseLoader loader;
+    UniverseCatalog catalog;
+    if (!loadHeadlessUniverse(&loader, &catalog, catalogFiles))
+    {
+        return 1;
+    }
+
+    EventFinder finder;
+    finder.setThreadCount(switches.value("-threads", "0").toUInt());
+
+    const vesta::Entity* body = findSwitchBody(catalog, switches, "-body");
+    if (!body)
+    {
+        return 1;
+    }
+
+    std::vector<EventFinder::Event> events;
+    if (searchType == "eclipse")
+    {
+        const vesta::Entity* occulter = findSwitchBody(catalog, switches, "-occulter");
+        const vesta::Entity* sun = findSwitchBody(catalog, switches, "-sun", "Sun");
+        double occulterRadius = switches.value("-occulterRadius").toDouble();
+        double sunRadius = switches.value("-sunRadius", QString::number(NominalSolarRadius)).toDouble();
+        if (!occulter || !sun || !(occulterRadius > 0.0) || !(sunRadius > 0.0))
+        {
+            qCritical() << "Eclipse search requires an -occulter and a positive -occulterRadius";
+            return 1;
+        }
+        events = finder.findEclipses(body, occulter, occulterRadius, sun, sunRadius, startTime, endTime);
+    }
+    else
+    {
+        const vesta::Entity* center = findSwitchBody(catalog, switches, "-center");
+        if (!center)
+        {
+            return 1;
+        }
+
+        if (searchType == "approach")
+        {
+            double maxDistance = switches.value("-distance", "0").toDouble();
+            if (!(maxDistance > 0.0))
+            {
+                maxDistance = std::numeric_limits<double>::infinity();
+            }
+            events = finder.findClosestApproaches(body, center, startTime, endTime, maxDistance);
+        }
+        else if (searchType == "periapsis")
+        {
+            events = finder.findPeriapses(body, center, startTime, endTime);
+        }
+        else if (searchType == "apoapsis")
+        {
+            events = finder.findApoapses(body, center, startTime, endTime);
+        }
+        else
+        {
+            const vesta::Entity* occulter = findSwitchBody(catalog, switches, "-occulter");
+            double targetRadius = switches.value("-targetRadius").toDouble();
+            double occulterRadius = switches.value("-occulterRadius").toDouble();
+            if (!occulter || !(targetRadius > 0.0) || !(occulterRadius > 0.0))
+            {
+                qCritical() << "Occultation search requires an -occulter, and a positive -targetRadius and -occulterRadius";
+                return 1;
+            }
+            events = finder.findOccultations(body, targetRadius, occulter, occulterRadius, center, startTime, endTime);
+        }
+    }
+
+    outputFile.write("type,start,end,peak,value\n");
+    for (unsigned int i = 0; i < events.size(); ++i)
+    {
+        const EventFinder::Event& event = events[i];
+        const char* typeName = "";
+        switch (event.type)
+        {
+        case EventFinder::ClosestApproach:    typeName = "approach"; break;
+        case EventFinder::Periapsis:          typeName = "periapsis"; break;
+        case EventFinder::Apoapsis:           typeName = "apoapsis"; break;
+        case EventFinder::PartialOccultation: typeName = "partial"; break;
+        case EventFinder::TotalOccultation:   typeName = "total"; break;
+        case EventFinder::AnnularOccultation: typeName = "annular"; break;
+        }
+
+        char line[256];
+        int length = snprintf(line, sizeof(line), "%s,%.17g,%.17g,%.17g,%.17g\n",
+                              typeName, event.startTime, event.endTime, event.peakTime, event.value);
+        outputFile.write(line, std::min(length, int(sizeof(line)) - 1));
+    }
+
+    if (outputFile.error() != QFile::NoError)
+    {
+        qCritical() << "Error writing events:" << outputFile.errorString();
+        return 1;
+    }
+
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+    // The -serve, -export, and -events switches run headless modes instead
+    // of the viewer
+    for (int i = 1; i < argc - 1; ++i)
+    {
+        if (strcmp(argv[i], "-serve") == 0)
+        {
+            return runEphemerisServer(argc, argv);
+        }
+        else if (strcmp(argv[i], "-export") == 0)
+        {
+            return runStateExport(argc, argv);
+        }
+        else if (strcmp(argv[i], "-events") == 0)
+        {
+            return runEventSearch(argc, argv);
+        }
+    }
+
+    QApplication app(argc, argv);
+
+    FileOpenEventFilter* appEventFilter = new FileOpenEventFilter();
+    app.installEventFilter(appEventFilter);
+
+    setApplicationInfo();
+
+    // Useful when we need to know where the data files are:
+    //   qDebug() << QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+    //   qDebug() << QDesktopServices::storageLocation(QDesktopServices::DataLocation);
+
+    QString dataPath = findDataPath();
+    bool foundData = !dataPath.isEmpty();
     if (!foundData || !QDir::setCurrent(dataPath))
     {
         QMessageBox::warning(NULL, "Missing data", "Data files not found!");
@@ -0,0 +1,375 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "SpiceGateway.h"
+#include <QtConcurrentRun>
+#include <QMutexLocker>
+#include <QDebug>
+
+using namespace vesta;
+using namespace Eigen;
+
+
+SpiceGateway::SpiceGateway()
+{
+    // Have CSPICE return from failing calls instead of aborting the program.
+    // Errors are reported by checkError(), so CSPICE's own output is disabled.
+    erract_c("SET", 0, const_cast<SpiceChar*>("RETURN"));
+    errprt_c("SET", 0, const_cast<SpiceChar*>("NONE"));
+}
+
+
+SpiceGateway::~SpiceGateway()
+{
+}
+
+
+/** Get the gateway. The first call should be made from the main thread,
+  * e.g. when the first SPICE kernels are loaded.
+  */
+SpiceGateway*
+SpiceGateway::instance()
+{
+    static SpiceGateway gateway;
+    return &gateway;
+}
+
+
+// Report and clear a CSPICE error. Returns true if no error occurred. Must
+// be called with the lock held.
+bool
+SpiceGateway::checkError()
+{
+    if (failed_c())
+    {
+        char errorMessage[1024];
+        getmsg_c("long", sizeof(errorMessage), errorMessage);
+        qDebug() << "SPICE error:" << errorMessage;
+        reset_c();
+        return false;
+    }
+    else
+    {
+        return true;
+    }
+}
+
+
+/** Load a list of SPICE kernels. Kernels are loaded in order, so that data
+  * in later kernels takes precedence.
+  */
+void
+SpiceGateway::loadKernels(const QStringList& kernelFileNames)
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (int i = 0; i < kernelFileNames.size(); ++i)
+    {
+        furnsh_c(kernelFileNames.at(i).toLatin1().data());
+        checkError();
+    }
+}
+
+
+/** Unload a list of SPICE kernels. Kernels are unloaded in the reverse of
+  * the order in the list (i.e. the reverse of the order in which they were
+  * loaded by loadKernels.)
+  */
+void
+SpiceGateway::unloadKernels(const QStringList& kernelFileNames)
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (int i = kernelFileNames.size() - 1; i >= 0; --i)
+    {
+        unload_c(kernelFileNames.at(i).toLatin1().data());
+        checkError();
+    }
+}
+
+
+/** Look up the NAIF integer code for a body name. Returns false if the name
+  * isn't known.
+  */
+bool
+SpiceGateway::bodyCode(const std::string& name, SpiceInt* code)
+{
+    QMutexLocker locker(&m_mutex);
+
+    SpiceBoolean found = SPICEFALSE;
+    bodn2c_c(name.c_str(), code, &found);
+
+    return checkError() && found == SPICETRUE;
+}
+
+
+bool
+SpiceGateway::stateUnlocked(const StateTarget& target, double et, StateVector* result)
+{
+    SpiceDouble sv[6];
+    SpiceDouble lightTime;
+    spkgeo_c(target.target, et, target.frame.c_str(), target.center, sv, &lightTime);
+    if (checkError())
+    {
+        *result = StateVector(Vector3d(sv[0], sv[1], sv[2]), Vector3d(sv[3], sv[4], sv[5]));
+        return true;
+    }
+    else
+    {
+        *result = StateVector(Vector3d::Zero(), Vector3d::Zero());
+        return false;
+    }
+}
+
+
+/** Get the geometric state of a target relative to a center at the specified
+  * time (TDB seconds since J2000.) If an error occurs, the result is set to
+  * zero and false is returned.
+  */
+bool
+SpiceGateway::state(const StateTarget& target, double et, StateVector* result)
+{
+    QMutexLocker locker(&m_mutex);
+    return stateUnlocked(target, et, result);
+}
+
+
+/** Get the states of a target at a list of times. The lock is held for the
+  * whole list, so this is much cheaper than calling state() for each time.
+  *
+  * \return the number of states that were computed without errors
+  */
+unsigned int
+SpiceGateway::states(const StateTarget& target, const double* et, unsigned int count, StateVector* results)
+{
+    QMutexLocker locker(&m_mutex);
+
+    unsigned int validCount = 0;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        if (stateUnlocked(target, et[i], &results[i]))
+        {
+            ++validCount;
+        }
+    }
+
+    return validCount;
+}
+
+
+/** Evaluate a batch of states for many targets at many epochs.
+  */
+void
+SpiceGateway::states(const StateBatch& batch, StateBatchResult* result)
+{
+    unsigned int targetCount = batch.targets.size();
+    unsigned int epochCount = batch.epochs.size();
+
+    result->epochCount = epochCount;
+    result->states.resize(targetCount * epochCount);
+    result->valid.resize(targetCount * epochCount);
+
+    QMutexLocker locker(&m_mutex);
+
+    for (unsigned int i = 0; i < targetCount; ++i)
+    {
+        for (unsigned int j = 0; j < epochCount; ++j)
+        {
+            unsigned int index = i * epochCount + j;
+            result->valid[index] = stateUnlocked(batch.targets[i], batch.epochs[j], &result->states[index]) ? 1 : 0;
+        }
+    }
+}
+
+
+SpiceGateway::StateBatchResult
+SpiceGateway::evaluateBatch(StateBatch batch)
+{
+    StateBatchResult result;
+    states(batch, &result);
+    return result;
+}
+
+
+/** Submit a batch of states for evaluation on a worker thread. The batch
+  * is copied, so the caller needn't keep it. Batches submitted from
+  * different threads are evaluated one at a time, in no particular order.
+  */
+QFuture<SpiceGateway::StateBatchResult>
+SpiceGateway::submitStates(const StateBatch& batch)
+{
+    return QtConcurrent::run(this, &SpiceGateway::evaluateBatch, batch);
+}
+
+
+/** Get the orientation of toFrame relative to fromFrame at the specified
+  * time. The identity is returned when an error occurs.
+  */
+bool
+SpiceGateway::orientation(const std::string& fromFrame, const std::string& toFrame, double et, Quaterniond* result)
+{
+    QMutexLocker locker(&m_mutex);
+
+    SpiceDouble transform[3][3];
+    pxform_c(fromFrame.c_str(), toFrame.c_str(), et, transform);
+    if (!checkError())
+    {
+        *result = Quaterniond::Identity();
+        return false;
+    }
+
+    Matrix3d R;
+    R << transform[0][0], transform[0][1], transform[0][2],
+         transform[1][0], transform[1][1], transform[1][2],
+         transform[2][0], transform[2][1], transform[2][2];
+    *result = Quaterniond(R);
+
+    return true;
+}
+
+
+/** Get the angular velocity of toFrame relative to fromFrame at the specified
+  * time. Zero is returned when an error occurs.
+  */
+bool
+SpiceGateway::angularVelocity(const std::string& fromFrame, const std::string& toFrame, double et, Vector3d* result)
+{
+    QMutexLocker locker(&m_mutex);
+
+    SpiceDouble transform[6][6];
+    sxform_c(fromFrame.c_str(), toFrame.c_str(), et, transform);
+    if (!checkError())
+    {
+        *result = Vector3d::Zero();
+        return false;
+    }
+
+    // Extract the angular velocity vector from the state transform matrix
+    // Rotation matrix is the top left 3x3 matrix
+    Matrix3d R;
+    R << transform[0][0], transform[0][1], transform[0][2],
+         transform[1][0], transform[1][1], transform[1][2],
+         transform[2][0], transform[2][1], transform[2][2];
+
+    // W*R is the lower left 3x3 matrix
+    Matrix3d WR;
+    WR << transform[3][0], transform[3][1], transform[3][2],
+          transform[4][0], transform[4][1], transform[4][2],
+          transform[5][0], transform[5][1], transform[5][2];
+
+    // Multiply by inverse of R (= transpose, since R is a rotation) to get
+    // the skew-symmetric matrix W*
+    Matrix3d W = WR * R.transpose();
+
+    *result = Vector3d(-W(1, 2), W(0, 2), -W(0, 1));
+
+    return true;
+}
+
+
+// Get the coverage window for an object from all loaded SPK kernels. Must
+// be called with the lock held.
+bool
+SpiceGateway::spkCoverageUnlocked(SpiceInt objectID, SpiceCell* window)
+{
+    const SpiceInt MaxFileNameLength = 1024;
+    const SpiceInt MaxTypeLength = 32;
+    const SpiceInt MaxSourceLength = 1024;
+
+    scard_c(0, window);
+
+    SpiceInt kernelCount = 0;
+    ktotal_c("SPK", &kernelCount);
+    for (SpiceInt i = 0; i < kernelCount; ++i)
+    {
+        SpiceChar fileName[MaxFileNameLength];
+        SpiceChar fileType[MaxTypeLength];
+        SpiceChar source[MaxSourceLength];
+        SpiceInt handle = 0;
+        SpiceBoolean found = SPICEFALSE;
+
+        kdata_c(i, "SPK", MaxFileNameLength, MaxTypeLength, MaxSourceLength, fileName, fileType, source, &handle, &found);
+        if (found)
+        {
+            // spkcov_c adds the coverage for the file to the window
+            spkcov_c(fileName, objectID, window);
+        }
+    }
+
+    return checkError();
+}
+
+
+/** Get the time intervals over which the loaded SPK kernels give the
+  * position of the target. When the center isn't the solar system barycenter,
+  * the intervals are restricted to the times when the center is also
+  * covered. Note that this is only an estimate: states may also be
+  * unavailable within these intervals if some other object in the chain of
+  * centers isn't covered.
+  *
+  * \return false if there was an error reading the coverage from the kernels
+  */
+bool
+SpiceGateway::spkCoverage(SpiceInt target, SpiceInt center, TimeIntervalList* intervals)
+{
+    const SpiceInt MaxIntervals = 2000;
+    SPICEDOUBLE_CELL(targetWindow, MaxIntervals * 2);
+    SPICEDOUBLE_CELL(centerWindow, MaxIntervals * 2);
+    SPICEDOUBLE_CELL(commonWindow, MaxIntervals * 2);
+
+    QMutexLocker locker(&m_mutex);
+
+    if (!spkCoverageUnlocked(target, &targetWindow))
+    {
+        return false;
+    }
+
+    SpiceCell* window = &targetWindow;
+
+    if (center != 0)
+    {
+        if (!spkCoverageUnlocked(center, &centerWindow))
+        {
+            return false;
+        }
+
+        // The center may not appear in any kernel as a target, e.g. when
+        // the target's center is exactly the requested center.
+        if (wncard_c(&centerWindow) > 0)
+        {
+            scard_c(0, &commonWindow);
+            wnintd_c(&targetWindow, &centerWindow, &commonWindow);
+            if (!checkError())
+            {
+                return false;
+            }
+            window = &commonWindow;
+        }
+    }
+
+    intervals->clear();
+    SpiceInt intervalCount = wncard_c(window);
+    for (SpiceInt i = 0; i < intervalCount; ++i)
+    {
+        SpiceDouble begin = 0.0;
+        SpiceDouble end = 0.0;
+        wnfetd_c(window, i, &begin, &end);
+        intervals->push_back(std::make_pair(begin, end));
+    }
+
+    return true;
+}
@@ -0,0 +1,140 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef _SPICE_GATEWAY_H_
+#define _SPICE_GATEWAY_H_
+
+#include <vesta/StateVector.h>
+#include <Eigen/Geometry>
+#include <Eigen/StdVector>
+#include <SpiceUsr.h>
+#include <QMutex>
+#include <QFuture>
+#include <QStringList>
+#include <vector>
+#include <string>
+#include <utility>
+
+
+/** SpiceGateway owns all calls into CSPICE. CSPICE keeps global state (the
+  * kernel pool, the error subsystem used by failed_c and reset_c, and various
+  * internal buffers), so it may only be used from one thread at a time. The
+  * gateway serializes every call with a single lock, which makes it safe to
+  * evaluate SPICE trajectories and rotation models from any thread, and
+  * guarantees that kernels are never loaded or unloaded in the middle of an
+  * evaluation.
+  *
+  * Callers evaluating many states should use one of the batch methods:
+  * they hold the lock once for the whole batch instead of once per state.
+  * submitStates() evaluates a batch in the background and returns a future.
+  *
+  * No code outside of the gateway should call CSPICE functions directly.
+  */
+class SpiceGateway
+{
+public:
+    typedef std::vector<std::pair<double, double> > TimeIntervalList;
+
+    /** The target, center and frame of a state request.
+      */
+    struct StateTarget
+    {
+        StateTarget() :
+            target(0),
+            center(0),
+            frame("J2000")
+        {
+        }
+
+        StateTarget(SpiceInt _target, SpiceInt _center, const std::string& _frame) :
+            target(_target),
+            center(_center),
+            frame(_frame)
+        {
+        }
+
+        SpiceInt target;
+        SpiceInt center;
+        std::string frame;
+    };
+
+    /** A request for the states of any number of targets at any number of
+      * epochs. Epochs are given as TDB seconds since J2000.
+      */
+    struct StateBatch
+    {
+        std::vector<StateTarget> targets;
+        std::vector<double> epochs;
+    };
+
+    /** Results of a batch state request. There is one entry for each
+      * combination of target and epoch; entries for which CSPICE reported an
+      * error are marked invalid and contain a zero state vector.
+      */
+    struct StateBatchResult
+    {
+        StateBatchResult() :
+            epochCount(0)
+        {
+        }
+
+        const vesta::StateVector& state(unsigned int targetIndex, unsigned int epochIndex) const
+        {
+            return states[targetIndex * epochCount + epochIndex];
+        }
+
+        bool isValid(unsigned int targetIndex, unsigned int epochIndex) const
+        {
+            return valid[targetIndex * epochCount + epochIndex] != 0;
+        }
+
+        std::vector<vesta::StateVector, Eigen::aligned_allocator<vesta::StateVector> > states;
+        std::vector<char> valid;
+        unsigned int epochCount;
+    };
+
+    static SpiceGateway* instance();
+
+    void loadKernels(const QStringList& kernelFileNames);
+    void unloadKernels(const QStringList& kernelFileNames);
+
+    bool bodyCode(const std::string& name, SpiceInt* code);
+
+    bool state(const StateTarget& target, double et, vesta::StateVector* result);
+    unsigned int states(const StateTarget& target, const double* et, unsigned int count, vesta::StateVector* results);
+    void states(const StateBatch& batch, StateBatchResult* result);
+    QFuture<StateBatchResult> submitStates(const StateBatch& batch);
+
+    bool orientation(const std::string& fromFrame, const std::string& toFrame, double et, Eigen::Quaterniond* result);
+    bool angularVelocity(const std::string& fromFrame, const std::string& toFrame, double et, Eigen::Vector3d* result);
+
+    bool spkCoverage(SpiceInt target, SpiceInt center, TimeIntervalList* intervals);
+
+private:
+    SpiceGateway();
+    ~SpiceGateway();
+
+    bool checkError();
+    bool stateUnlocked(const StateTarget& target, double et, vesta::StateVector* result);
+    bool spkCoverageUnlocked(SpiceInt objectID, SpiceCell* window);
+    StateBatchResult evaluateBatch(StateBatch batch);
+
+private:
+    QMutex m_mutex;
+};
+
+#endif // _SPICE_GATEWAY_H_
@@ -15,8 +15,8 @@
 // limitations under the License.
 
 #include "SpiceTrajectory.h"
+#include "SpiceGateway.h"
 #include <algorithm>
-#include <iostream>
 
 using namespace vesta;
 using namespace Eigen;
@@ -43,20 +43,27 @@ SpiceTrajectory::state(double tdbSec) const
     // Clamp time to valid range
     double et = std::max(startTime(), std::min(endTime(), tdbSec));
 
-    SpiceDouble sv[6];
-    SpiceDouble lightTime;
-    spkgeo_c(m_targetID, et, m_spiceFrame.c_str(), m_centerID, sv, &lightTime);
-    if (failed_c())
+    StateVector result;
+    SpiceGateway::instance()->state(SpiceGateway::StateTarget(m_targetID, m_centerID, m_spiceFrame), et, &result);
+
+    return result;
+}
+
+
+/** Compute states at many times with a single request to the SPICE gateway.
+  */
+void
+SpiceTrajectory::states(const double* t, std::size_t n, StateVector* out) const
+{
+    std::vector<double> et(n);
+    for (std::size_t i = 0; i < n; ++i)
     {
-        char errorMessage[1024];
-        getmsg_c("long", sizeof(errorMessage), errorMessage);
-        cerr << errorMessage << std::endl;
-        reset_c();
-        return StateVector(Vector3d::Zero(), Vector3d::Zero());
+        et[i] = std::max(startTime(), std::min(endTime(), t[i]));
     }
-    else
+
+    if (n > 0)
     {
-        return StateVector(Vector3d(sv[0], sv[1], sv[2]), Vector3d(sv[3], sv[4], sv[5]));
+        SpiceGateway::instance()->states(SpiceGateway::StateTarget(m_targetID, m_centerID, m_spiceFrame), &et[0], n, out);
     }
 }
 
@@ -90,3 +97,15 @@ SpiceTrajectory::boundingSphereRadius() const
 {
     return 1.0e12;
 }
+
+
+/** Get the time intervals over which the loaded SPK kernels give the
+  * position of the target. See SpiceGateway::spkCoverage.
+  *
+  * \return false if there was an error reading the coverage from the kernels
+  */
+bool
+SpiceTrajectory::coverage(TimeIntervalList* intervals) const
+{
+    return SpiceGateway::instance()->spkCoverage(m_targetID, m_centerID, intervals);
+}
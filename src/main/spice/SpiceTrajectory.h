@@ -19,6 +19,9 @@
 
 #include <vesta/Trajectory.h>
 #include <SpiceUsr.h>
+#include <vector>
+#include <utility>
+#include <string>
 
 class SpiceTrajectory : public vesta::Trajectory
 {
@@ -27,12 +30,16 @@ public:
     ~SpiceTrajectory();
 
     virtual vesta::StateVector state(double tdbSec) const;
+    virtual void states(const double* t, std::size_t n, vesta::StateVector* out) const;
     virtual double boundingSphereRadius() const;
     virtual bool isPeriodic() const;
     virtual double period() const;
 
     void setPeriod(double period);
 
+    typedef std::vector<std::pair<double, double> > TimeIntervalList;
+    bool coverage(TimeIntervalList* intervals) const;
+
 private:
     SpiceInt m_targetID;
     SpiceInt m_centerID;
@@ -29,7 +29,8 @@ CompositeTrajectory::CompositeTrajectory(const vector<Trajectory*>& segments,
                                          double startTime) :
     m_startTime(startTime),
     m_period(0.0),
-    m_boundingRadius(0.0)
+    m_boundingRadius(0.0),
+    m_lastSegment(0)
 {
     assert(segments.size() > 0);
     assert(segments.size() == segmentDurations.size());
@@ -39,11 +40,13 @@ CompositeTrajectory::CompositeTrajectory(const vector<Trajectory*>& segments,
     // just a hint for trajectory plotting.)
     bool isPeriodic = true;
     double periodSum = 0.0;
+    double segmentEndTime = startTime;
 
     for (unsigned int i = 0; i < segments.size(); ++i)
     {
         m_segments.push_back(counted_ptr<Trajectory>(segments[i]));
-        m_segmentDurations.push_back(segmentDurations[i]);
+        segmentEndTime += segmentDurations[i];
+        m_segmentEndTimes.push_back(segmentEndTime);
 
         m_boundingRadius = max(m_boundingRadius, segments[i]->boundingSphereRadius());
 
@@ -76,18 +79,29 @@ CompositeTrajectory::state(double tdbSec) const
         return m_segments.front()->state(m_startTime);
     }
 
-    double segmentStartTime = m_startTime;
-    for (unsigned int i = 0; i < m_segments.size(); ++i)
+    if (tdbSec > m_segmentEndTimes.back())
     {
-        if (tdbSec <= segmentStartTime + m_segmentDurations[i])
+        // Time is after all segments; clamp to end time
+        return m_segments.back()->state(m_segmentEndTimes.back());
+    }
+
+    // Try the segment used last time and the one after it before searching;
+    // trajectories are usually evaluated at steadily increasing times.
+    unsigned int hint = unsigned(m_lastSegment.load());
+    for (unsigned int i = hint; i < hint + 2 && i < m_segments.size(); ++i)
+    {
+        if ((i == 0 || tdbSec > m_segmentEndTimes[i - 1]) && tdbSec <= m_segmentEndTimes[i])
         {
+            m_lastSegment.store(int(i));
             return m_segments[i]->state(tdbSec);
         }
-        segmentStartTime += m_segmentDurations[i];
     }
 
-    // Time is after all segments; clamp to end time
-    return m_segments.back()->state(segmentStartTime);
+    // Find the first segment ending at or after the time
+    unsigned int index = lower_bound(m_segmentEndTimes.begin(), m_segmentEndTimes.end(), tdbSec) - m_segmentEndTimes.begin();
+    m_lastSegment.store(int(index));
+
+    return m_segments[index]->state(tdbSec);
 }
 
 
@@ -18,6 +18,7 @@
 #define _COMPOSITE_TRAJECTORY_H_
 
 #include <vesta/Trajectory.h>
+#include <QAtomicInt>
 #include <vector>
 
 
@@ -53,10 +54,15 @@ public:
                                        double startTime);
 private:
     double m_startTime;
-    std::vector<double> m_segmentDurations;
+    std::vector<double> m_segmentEndTimes;
     std::vector< vesta::counted_ptr<vesta::Trajectory> > m_segments;
     double m_period;
     double m_boundingRadius;
+
+    // Index of the segment used for the last state calculation. Loaded
+    // and stored atomically (relaxed), since a trajectory may be evaluated
+    // from several threads at once.
+    mutable QAtomicInt m_lastSegment;
 };
 
 #endif // _COMPOSITE_TRAJECTORY_H_
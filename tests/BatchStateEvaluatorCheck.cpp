@@ -0,0 +1,101 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Check.h"
+#include "CheckBodies.h"
+#include "BatchStateEvaluator.h"
+#include "TleTrajectory.h"
+#include <vesta/FixedPointTrajectory.h>
+#include <vesta/Units.h>
+#include <vector>
+
+using namespace vesta;
+using namespace Eigen;
+
+
+// Molniya orbit, propagated with SDP4
+static const char* MolniyaTle[2] =
+{
+    "1 08195U 75081A   06176.33215444  .00000099  00000-0  11873-3 0   813",
+    "2 08195  64.1586 279.0717 6877146 264.7651  20.2257  2.00491383225656"
+};
+
+static const unsigned int EpochCount = 4000;
+
+
+// The batch evaluator must give exactly the same states as Entity::state,
+// whether it runs on one thread or several. The bodies include a deep space
+// TLE, which used to share integrator state between threads.
+void
+CheckBatchStateEvaluator()
+{
+    counted_ptr<TleTrajectory> tle(TleTrajectory::Create(MolniyaTle[0], MolniyaTle[1]));
+    if (!CHECK(!tle.isNull()))
+    {
+        return;
+    }
+
+    double year = daysToSeconds(365.25);
+    double tleEpoch = tle->epoch();
+
+    counted_ptr<Entity> sun(CreateCheckBody(new FixedPointTrajectory(Vector3d(100.0, 200.0, 300.0)), NULL, -100.0 * year, 200.0 * year));
+    counted_ptr<Entity> earth(CreateCheckBody(CreateKeplerianTrajectory(1.496e8, 0.0167, 0.41, year), sun.ptr(), -100.0 * year, 200.0 * year));
+    counted_ptr<Entity> moon(CreateCheckBody(CreateKeplerianTrajectory(384400.0, 0.055, 0.09, daysToSeconds(27.32)), earth.ptr(), -100.0 * year, 200.0 * year));
+
+    // The satellite only exists for 60 days around the TLE epoch
+    counted_ptr<Entity> satellite(CreateCheckBody(tle.ptr(), earth.ptr(), tleEpoch - daysToSeconds(30.0), daysToSeconds(60.0)));
+
+    std::vector<const Entity*> bodies;
+    bodies.push_back(satellite.ptr());
+    bodies.push_back(moon.ptr());
+    bodies.push_back(earth.ptr());
+
+    // Cover 90 days, so that some epochs are outside the satellite's arc
+    std::vector<double> epochs(EpochCount);
+    for (unsigned int i = 0; i < EpochCount; ++i)
+    {
+        epochs[i] = tleEpoch + (double(i) / EpochCount - 0.5) * daysToSeconds(90.0);
+    }
+
+    std::vector<double> expected(EpochCount * bodies.size() * BatchStateEvaluator::StateSize);
+    for (unsigned int i = 0; i < EpochCount; ++i)
+    {
+        for (unsigned int j = 0; j < bodies.size(); ++j)
+        {
+            StateVector state = bodies[j]->state(epochs[i]);
+            double* s = &expected[(i * bodies.size() + j) * BatchStateEvaluator::StateSize];
+            for (unsigned int k = 0; k < 3; ++k)
+            {
+                s[k] = state.position()[k];
+                s[k + 3] = state.velocity()[k];
+            }
+        }
+    }
+
+    BatchStateEvaluator evaluator;
+    evaluator.setBodies(bodies);
+    CHECK(evaluator.nodeCount() == 4);
+
+    unsigned int threadCounts[] = { 1, 4, 8 };
+    for (unsigned int i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); ++i)
+    {
+        evaluator.setThreadCount(threadCounts[i]);
+        std::vector<double> states(expected.size());
+        evaluator.evaluate(&epochs[0], EpochCount, &states[0]);
+
+        CHECK(states == expected);
+    }
+}
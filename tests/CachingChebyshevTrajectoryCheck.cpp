@@ -0,0 +1,103 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Check.h"
+#include "CheckBodies.h"
+#include "CachingChebyshevTrajectory.h"
+#include <vesta/Units.h>
+#include <QtConcurrentMap>
+#include <algorithm>
+#include <vector>
+
+using namespace vesta;
+
+
+static const unsigned int EpochCount = 4000;
+static const unsigned int ChunkCount = 16;
+static const double Tolerance = 1.0e-3;
+
+
+struct CacheEvaluationChunk
+{
+    const Trajectory* trajectory;
+    const std::vector<double>* epochs;
+    unsigned int chunk;
+    std::vector<StateVector>* states;
+};
+
+
+// Chunks take every ChunkCount-th epoch, so that all threads keep moving
+// through the same windows and evicting each other's fits.
+struct EvaluateCacheChunk
+{
+    void operator()(const CacheEvaluationChunk& chunk) const
+    {
+        for (unsigned int i = chunk.chunk; i < chunk.epochs->size(); i += ChunkCount)
+        {
+            (*chunk.states)[i] = chunk.trajectory->state((*chunk.epochs)[i]);
+        }
+    }
+};
+
+
+// States from a cache must be within the tolerance of the wrapped trajectory,
+// also when the cache is evaluated from several threads and windows are
+// being replaced while other threads are still using them.
+void
+CheckCachingChebyshevTrajectory()
+{
+    counted_ptr<Trajectory> source(CreateKeplerianTrajectory(7000.0, 0.1, 0.5, daysToSeconds(0.07)));
+    source->setValidTimeRange(0.0, daysToSeconds(30.0));
+
+    counted_ptr<CachingChebyshevTrajectory> cache(new CachingChebyshevTrajectory(source.ptr(), Tolerance, daysToSeconds(0.25), 2));
+
+    std::vector<double> epochs(EpochCount);
+    for (unsigned int i = 0; i < EpochCount; ++i)
+    {
+        epochs[i] = daysToSeconds(30.0) * (i + 0.5) / EpochCount;
+    }
+
+    for (unsigned int pass = 0; pass < 4; ++pass)
+    {
+        std::vector<StateVector> states(EpochCount);
+        std::vector<CacheEvaluationChunk> chunks(ChunkCount);
+        for (unsigned int i = 0; i < ChunkCount; ++i)
+        {
+            chunks[i].trajectory = cache.ptr();
+            chunks[i].epochs = &epochs;
+            chunks[i].chunk = i;
+            chunks[i].states = &states;
+        }
+
+        QtConcurrent::blockingMap(chunks, EvaluateCacheChunk());
+
+        double maxError = 0.0;
+        for (unsigned int i = 0; i < EpochCount; ++i)
+        {
+            maxError = std::max(maxError, (states[i].position() - source->state(epochs[i]).position()).norm());
+        }
+        CHECK(maxError < Tolerance);
+    }
+
+    // Invalidating the cache picks up changes to the valid time range of the
+    // wrapped trajectory, and times outside the range come straight from it.
+    source->setValidTimeRange(0.0, daysToSeconds(10.0));
+    cache->invalidate();
+    CHECK(cache->startTime() == 0.0 && cache->endTime() == daysToSeconds(10.0));
+
+    double t = daysToSeconds(20.0);
+    CHECK(cache->state(t).position() == source->state(t).position());
+}
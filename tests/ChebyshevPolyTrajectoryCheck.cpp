@@ -0,0 +1,195 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Check.h"
+#include "ChebyshevPolyTrajectory.h"
+#include <vesta/Units.h>
+#include <Eigen/Array>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <algorithm>
+#include <vector>
+
+using namespace vesta;
+
+
+static const unsigned int GranuleCount = 64;
+static const double GranuleLength = daysToSeconds(8.0);
+static const double StartTime = daysToSeconds(-1000.0);
+
+// Number of states computed for the timing comparison
+static const unsigned int BenchmarkStateCount = 1000000;
+
+
+// Granule source that decodes the coefficients into the caller's buffer,
+// as compressed sources do.
+class CopyingGranuleSource : public ChebyshevGranuleSource
+{
+public:
+    CopyingGranuleSource(const std::vector<double>& coeffs, unsigned int degree) :
+        m_coeffs(coeffs),
+        m_granuleSize((degree + 1) * 3)
+    {
+    }
+
+    const double* granule(unsigned int index, double* buffer) const
+    {
+        std::copy(m_coeffs.begin() + index * m_granuleSize, m_coeffs.begin() + (index + 1) * m_granuleSize, buffer);
+        return buffer;
+    }
+
+private:
+    std::vector<double> m_coeffs;
+    unsigned int m_granuleSize;
+};
+
+
+// Coefficients that decrease in magnitude with increasing order, like those
+// of a real ephemeris.
+static std::vector<double>
+makeCoefficients(unsigned int degree)
+{
+    std::vector<double> coeffs(GranuleCount * (degree + 1) * 3);
+    unsigned int seed = 12345;
+    for (unsigned int i = 0; i < coeffs.size(); ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        unsigned int order = i % (degree + 1);
+        coeffs[i] = (double((seed >> 8) & 0xffff) / 32768.0 - 1.0) * 1.0e8 / double(1 << std::min(order, 30u));
+    }
+
+    return coeffs;
+}
+
+
+static bool
+sameStates(const ChebyshevPolyTrajectory& trajectory, const std::vector<double>& times)
+{
+    std::vector<StateVector> states(times.size());
+    trajectory.states(&times[0], times.size(), &states[0]);
+
+    for (unsigned int i = 0; i < times.size(); ++i)
+    {
+        StateVector s = trajectory.state(times[i]);
+        if (!(s.position() == states[i].position() && s.velocity() == states[i].velocity()))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// Times at, and on either side of, every granule boundary, plus times
+// outside the span of the trajectory (which are clamped to its ends.)
+static std::vector<double>
+boundaryTimes()
+{
+    std::vector<double> times;
+    times.push_back(StartTime - GranuleLength);
+    for (unsigned int i = 0; i <= GranuleCount; ++i)
+    {
+        double boundary = StartTime + i * GranuleLength;
+        times.push_back(boundary - 1.0e-3);
+        times.push_back(boundary);
+        times.push_back(boundary + 1.0e-3);
+        for (unsigned int j = 1; j < 7; ++j)
+        {
+            times.push_back(boundary + GranuleLength * j / 7.0);
+        }
+    }
+    times.push_back(StartTime + (GranuleCount + 1) * GranuleLength);
+
+    return times;
+}
+
+
+static void
+checkDegree(unsigned int degree)
+{
+    std::vector<double> coeffs = makeCoefficients(degree);
+    ChebyshevPolyTrajectory trajectory(&coeffs[0], degree, GranuleCount, StartTime, GranuleLength);
+    ChebyshevPolyTrajectory sourceTrajectory(new CopyingGranuleSource(coeffs, degree), degree,
+                                             GranuleCount, StartTime, GranuleLength,
+                                             trajectory.boundingSphereRadius());
+
+    // Increasing times, which states() evaluates in runs within each granule
+    std::vector<double> times = boundaryTimes();
+    CHECK(sameStates(trajectory, times));
+    CHECK(sameStates(sourceTrajectory, times));
+
+    // Decreasing and scattered times
+    std::reverse(times.begin(), times.end());
+    CHECK(sameStates(trajectory, times));
+
+    std::vector<double> scattered(times.size());
+    for (unsigned int i = 0; i < times.size(); ++i)
+    {
+        scattered[i] = times[(i * 7919) % times.size()];
+    }
+    CHECK(sameStates(trajectory, scattered));
+}
+
+
+// Compare the time taken to compute states for a sequence of increasing
+// times by calling state() for each time and by calling states() once.
+static void
+reportTimes(unsigned int degree)
+{
+    std::vector<double> coeffs = makeCoefficients(degree);
+    ChebyshevPolyTrajectory trajectory(&coeffs[0], degree, GranuleCount, StartTime, GranuleLength);
+
+    std::vector<double> times(BenchmarkStateCount);
+    for (unsigned int i = 0; i < BenchmarkStateCount; ++i)
+    {
+        times[i] = StartTime + GranuleCount * GranuleLength * (i + 0.5) / BenchmarkStateCount;
+    }
+
+    std::vector<StateVector> states(BenchmarkStateCount);
+    QElapsedTimer timer;
+    timer.start();
+    for (unsigned int i = 0; i < BenchmarkStateCount; ++i)
+    {
+        states[i] = trajectory.state(times[i]);
+    }
+    qint64 stateTime = timer.nsecsElapsed();
+
+    timer.start();
+    trajectory.states(&times[0], BenchmarkStateCount, &states[0]);
+    qint64 statesTime = timer.nsecsElapsed();
+
+    qDebug() << "ChebyshevPolyTrajectory degree" << degree << ": state()" << double(stateTime) / BenchmarkStateCount
+             << "ns, states()" << double(statesTime) / BenchmarkStateCount << "ns per state";
+}
+
+
+// states() must give exactly the same results as state() for every time,
+// whatever the order of the times and wherever they fall with respect to
+// granule boundaries. This covers degrees with specialized evaluators (12
+// is used by the DE ephemerides) and the general one.
+void
+CheckChebyshevPolyTrajectory()
+{
+    const unsigned int degrees[] = { 5, 12, 13, 20 };
+    for (unsigned int i = 0; i < sizeof(degrees) / sizeof(degrees[0]); ++i)
+    {
+        checkDegree(degrees[i]);
+    }
+
+    reportTimes(12);
+    reportTimes(20);
+}
@@ -0,0 +1,37 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _CHECK_H_
+#define _CHECK_H_
+
+// Record the result of a check. A failed check is reported with its source
+// location, but doesn't stop the remaining checks from running.
+#define CHECK(condition) CheckCondition((condition), #condition, __FILE__, __LINE__)
+
+bool CheckCondition(bool passed, const char* condition, const char* file, int line);
+
+// Each check function exercises one component; they're all run by main().
+void CheckBatchStateEvaluator();
+void CheckCachingChebyshevTrajectory();
+void CheckChebyshevPolyTrajectory();
+void CheckEventFinder();
+void CheckGregorianDate();
+void CheckInterpolatedStateTrajectory();
+void CheckKeplerianBatchPropagator();
+void CheckTleBatchPropagator();
+void CheckTleTrajectory();
+
+#endif // _CHECK_H_
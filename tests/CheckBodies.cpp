@@ -0,0 +1,63 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CheckBodies.h"
+#include <vesta/Arc.h>
+#include <vesta/Chronology.h>
+#include <vesta/KeplerianTrajectory.h>
+#include <vesta/OrbitalElements.h>
+#include <vesta/Units.h>
+
+using namespace vesta;
+
+
+/** Create a body with a single arc.
+  */
+Entity*
+CreateCheckBody(Trajectory* trajectory, Entity* center, double startTime, double duration)
+{
+    Arc* arc = new Arc();
+    arc->setTrajectory(trajectory);
+    arc->setCenter(center);
+    arc->setDuration(duration);
+
+    Entity* body = new Entity();
+    body->chronology()->setBeginning(startTime);
+    body->chronology()->addArc(arc);
+
+    return body;
+}
+
+
+/** Create a Keplerian trajectory with its epoch at J2000. Angles are in
+  * radians and the period is in seconds.
+  */
+Trajectory*
+CreateKeplerianTrajectory(double semiMajorAxis, double eccentricity, double inclination, double period,
+                          double ascendingNode, double argumentOfPeriapsis, double meanAnomalyAtEpoch)
+{
+    OrbitalElements elements;
+    elements.periapsisDistance = semiMajorAxis * (1.0 - eccentricity);
+    elements.eccentricity = eccentricity;
+    elements.inclination = inclination;
+    elements.longitudeOfAscendingNode = ascendingNode;
+    elements.argumentOfPeriapsis = argumentOfPeriapsis;
+    elements.meanAnomalyAtEpoch = meanAnomalyAtEpoch;
+    elements.meanMotion = 2.0 * PI / period;
+    elements.epoch = 0.0;
+
+    return new KeplerianTrajectory(elements);
+}
@@ -0,0 +1,34 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _CHECK_BODIES_H_
+#define _CHECK_BODIES_H_
+
+#include <vesta/Entity.h>
+#include <vesta/Trajectory.h>
+
+// Helpers for building small universes to run checks against
+
+vesta::Entity* CreateCheckBody(vesta::Trajectory* trajectory, vesta::Entity* center,
+                               double startTime, double duration);
+
+vesta::Trajectory* CreateKeplerianTrajectory(double semiMajorAxis, double eccentricity, double inclination,
+                                             double period,
+                                             double ascendingNode = 0.3,
+                                             double argumentOfPeriapsis = 1.1,
+                                             double meanAnomalyAtEpoch = 0.2);
+
+#endif // _CHECK_BODIES_H_
@@ -0,0 +1,256 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Check.h"
+#include "CheckBodies.h"
+#include "EventFinder.h"
+#include "ChebyshevPolyTrajectory.h"
+#include <vesta/FixedPointTrajectory.h>
+#include <vesta/Units.h>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <vector>
+#include <limits>
+#include <cmath>
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+// Step used for the brute force search, in seconds
+static const double BruteForceStep = 3600.0;
+
+// Largest allowed difference between the times of the same event found in
+// searches with and without pruning, in seconds
+static const double EventTimeTolerance = 0.1;
+
+
+static double
+distance(const Entity* target, const Entity* observer, double t)
+{
+    return (target->state(t).position() - observer->state(t).position()).norm();
+}
+
+
+// Find the local minima of the distance between two bodies by sampling at a
+// fixed step, then refine each by sampling at progressively finer steps.
+static vector<double>
+bruteForceClosestApproaches(const Entity* target, const Entity* observer, double startTime, double endTime)
+{
+    vector<double> times;
+
+    double d0 = distance(target, observer, startTime);
+    double d1 = distance(target, observer, startTime + BruteForceStep);
+    for (double t = startTime + 2.0 * BruteForceStep; t <= endTime; t += BruteForceStep)
+    {
+        double d2 = distance(target, observer, t);
+        if (d1 < d0 && d1 <= d2)
+        {
+            double best = t - BruteForceStep;
+            for (double step = BruteForceStep / 10.0; step >= 0.001; step /= 10.0)
+            {
+                double center = best;
+                double bestDistance = distance(target, observer, best);
+                for (int i = -10; i <= 10; ++i)
+                {
+                    double d = distance(target, observer, center + i * step);
+                    if (d < bestDistance)
+                    {
+                        bestDistance = d;
+                        best = center + i * step;
+                    }
+                }
+            }
+            times.push_back(best);
+        }
+
+        d0 = d1;
+        d1 = d2;
+    }
+
+    return times;
+}
+
+
+// Approximate a trajectory over a span of time with a Chebyshev polynomial
+// trajectory, interpolating it at the Chebyshev nodes of each granule.
+static ChebyshevPolyTrajectory*
+CreateChebyshevFit(const Trajectory* trajectory, unsigned int degree,
+                   double startTime, unsigned int granuleCount, double granuleLength)
+{
+    unsigned int n = degree + 1;
+    vector<double> coeffs(granuleCount * n * 3, 0.0);
+    vector<Vector3d> samples(n);
+    for (unsigned int granule = 0; granule < granuleCount; ++granule)
+    {
+        double granuleStart = startTime + granule * granuleLength;
+        for (unsigned int k = 0; k < n; ++k)
+        {
+            double u = cos(PI * (k + 0.5) / n);
+            samples[k] = trajectory->state(granuleStart + 0.5 * (u + 1.0) * granuleLength).position();
+        }
+
+        double* c = &coeffs[granule * n * 3];
+        for (unsigned int j = 0; j < n; ++j)
+        {
+            Vector3d sum = Vector3d::Zero();
+            for (unsigned int k = 0; k < n; ++k)
+            {
+                sum += samples[k] * cos(PI * j * (k + 0.5) / n);
+            }
+            sum *= (j == 0 ? 1.0 : 2.0) / n;
+            for (unsigned int axis = 0; axis < 3; ++axis)
+            {
+                c[axis * n + j] = sum[axis];
+            }
+        }
+    }
+
+    return new ChebyshevPolyTrajectory(&coeffs[0], degree, granuleCount, startTime, granuleLength);
+}
+
+
+// Search a century for lunar eclipses with pruning enabled and disabled.
+// The Earth and Moon have Chebyshev trajectories as in a JPL ephemeris, so
+// that the search can skip the spans between eclipse seasons. Both searches
+// must find the same eclipses; the time taken by each is reported.
+static void
+CheckLunarEclipseSearch()
+{
+    double year = daysToSeconds(365.25);
+    double startTime = 0.0;
+    double endTime = 100.0 * year;
+
+    // Granule lengths and degrees are those of the Earth-Moon barycenter
+    // and Moon in the DE ephemerides.
+    counted_ptr<Trajectory> earthOrbit(CreateKeplerianTrajectory(1.496e8, 0.0167, 0.0, daysToSeconds(365.256363), 0.0, 1.8, 6.24));
+    counted_ptr<Trajectory> moonOrbit(CreateKeplerianTrajectory(384400.0, 0.0549, toRadians(5.145), daysToSeconds(27.321661), 2.18, 5.55, 2.36));
+    unsigned int earthGranules = unsigned(ceil((endTime - startTime) / daysToSeconds(16.0)));
+    unsigned int moonGranules = unsigned(ceil((endTime - startTime) / daysToSeconds(4.0)));
+
+    counted_ptr<Entity> sun(CreateCheckBody(new FixedPointTrajectory(Vector3d::Zero()), NULL, startTime, endTime));
+    counted_ptr<Entity> earth(CreateCheckBody(CreateChebyshevFit(earthOrbit.ptr(), 13, startTime, earthGranules, daysToSeconds(16.0)),
+                                              sun.ptr(), startTime, endTime));
+    counted_ptr<Entity> moon(CreateCheckBody(CreateChebyshevFit(moonOrbit.ptr(), 12, startTime, moonGranules, daysToSeconds(4.0)),
+                                             earth.ptr(), startTime, endTime));
+
+    const double sunRadius = 696000.0;
+    const double earthRadius = 6378.0;
+
+    vector<EventFinder::Event> eclipses[2];
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+        EventFinder finder;
+        finder.setPruningEnabled(i == 0);
+
+        QElapsedTimer timer;
+        timer.start();
+        eclipses[i] = finder.findEclipses(moon.ptr(), earth.ptr(), earthRadius, sun.ptr(), sunRadius, startTime, endTime);
+        qDebug() << "Lunar eclipses over 100 years, pruning" << (i == 0 ? "on:" : "off:")
+                 << eclipses[i].size() << "found in" << timer.elapsed() << "ms";
+    }
+
+    // There are about two eclipse seasons a year
+    CHECK(eclipses[0].size() > 150);
+
+    if (CHECK(eclipses[0].size() == eclipses[1].size()))
+    {
+        bool sameEclipses = true;
+        for (unsigned int j = 0; j < eclipses[0].size(); ++j)
+        {
+            const EventFinder::Event& pruned = eclipses[0][j];
+            const EventFinder::Event& unpruned = eclipses[1][j];
+            sameEclipses = sameEclipses &&
+                           pruned.type == unpruned.type &&
+                           abs(pruned.startTime - unpruned.startTime) < EventTimeTolerance &&
+                           abs(pruned.endTime - unpruned.endTime) < EventTimeTolerance &&
+                           abs(pruned.peakTime - unpruned.peakTime) < EventTimeTolerance;
+        }
+        CHECK(sameEclipses);
+    }
+}
+
+
+// Check closest approaches and apsides in a system of two planets on
+// Keplerian orbits about a fixed Sun. Closest approaches are compared with
+// a brute force search, and apsides with the times computed from the
+// orbital elements.
+void
+CheckEventFinder()
+{
+    double year = daysToSeconds(365.25);
+    double startTime = 0.0;
+    double endTime = 6.0 * year;
+
+    double innerPeriod = year;
+    double outerPeriod = 1.88 * year;
+    double outerMeanAnomaly = 0.2;
+
+    counted_ptr<Entity> sun(CreateCheckBody(new FixedPointTrajectory(Vector3d::Zero()), NULL, -100.0 * year, 200.0 * year));
+    counted_ptr<Entity> inner(CreateCheckBody(CreateKeplerianTrajectory(1.496e8, 0.0167, 0.0, innerPeriod, 0.0, 1.8, 1.0),
+                                              sun.ptr(), -100.0 * year, 200.0 * year));
+    counted_ptr<Entity> outer(CreateCheckBody(CreateKeplerianTrajectory(2.279e8, 0.0934, 0.0323, outerPeriod, 0.86, 5.0, outerMeanAnomaly),
+                                              sun.ptr(), -100.0 * year, 200.0 * year));
+
+    vector<double> expected = bruteForceClosestApproaches(outer.ptr(), inner.ptr(), startTime, endTime);
+    CHECK(expected.size() >= 2);
+
+    unsigned int threadCounts[] = { 1, 4 };
+    for (unsigned int i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); ++i)
+    {
+        EventFinder finder;
+        finder.setThreadCount(threadCounts[i]);
+
+        vector<EventFinder::Event> approaches =
+                finder.findClosestApproaches(outer.ptr(), inner.ptr(), startTime, endTime, numeric_limits<double>::infinity());
+        if (CHECK(approaches.size() == expected.size()))
+        {
+            for (unsigned int j = 0; j < approaches.size(); ++j)
+            {
+                CHECK(approaches[j].type == EventFinder::ClosestApproach);
+                CHECK(abs(approaches[j].peakTime - expected[j]) < 1.0);
+                CHECK(abs(approaches[j].value - distance(outer.ptr(), inner.ptr(), expected[j])) < 1.0e-3);
+            }
+        }
+
+        // Periapsis passages of the outer planet occur when its mean anomaly
+        // is a multiple of 2 pi.
+        vector<EventFinder::Event> periapses = finder.findPeriapses(outer.ptr(), sun.ptr(), startTime, endTime);
+        double firstPeriapsis = (2.0 * PI - outerMeanAnomaly) / (2.0 * PI) * outerPeriod;
+        unsigned int periapsisCount = unsigned(floor((endTime - firstPeriapsis) / outerPeriod)) + 1;
+        if (CHECK(periapses.size() == periapsisCount))
+        {
+            for (unsigned int j = 0; j < periapses.size(); ++j)
+            {
+                CHECK(abs(periapses[j].peakTime - (firstPeriapsis + j * outerPeriod)) < 1.0);
+            }
+        }
+
+        vector<EventFinder::Event> apoapses = finder.findApoapses(outer.ptr(), sun.ptr(), startTime, endTime);
+        double firstApoapsis = (PI - outerMeanAnomaly) / (2.0 * PI) * outerPeriod;
+        unsigned int apoapsisCount = unsigned(floor((endTime - firstApoapsis) / outerPeriod)) + 1;
+        if (CHECK(apoapses.size() == apoapsisCount))
+        {
+            for (unsigned int j = 0; j < apoapses.size(); ++j)
+            {
+                CHECK(abs(apoapses[j].peakTime - (firstApoapsis + j * outerPeriod)) < 1.0);
+            }
+        }
+    }
+
+    CheckLunarEclipseSearch();
+}
@@ -0,0 +1,156 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Check.h"
+#include <vesta/GregorianDate.h>
+#include <vesta/Units.h>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <cmath>
+#include <vector>
+
+using namespace vesta;
+
+
+// Enough dates to time the conversions, spread over the years 1904 to 2095
+// so that the whole leap second table is used.
+static const unsigned int DateCount = 200000;
+
+// Largest allowed difference (in seconds) between conversions of seconds and
+// of calendar dates. Dates are converted through Julian dates, which have a
+// precision of about 40 microseconds.
+static const double SecondsTolerance = 1.0e-4;
+
+
+static bool
+sameDate(const GregorianDate& d0, const GregorianDate& d1)
+{
+    return d0.year() == d1.year() && d0.month() == d1.month() && d0.day() == d1.day() &&
+           d0.hour() == d1.hour() && d0.minute() == d1.minute() && d0.second() == d1.second() &&
+           d0.usec() == d1.usec() && d0.timeScale() == d1.timeScale();
+}
+
+
+// Print the time per date taken by a conversion
+static void
+reportTime(const char* name, qint64 nsec)
+{
+    qDebug() << name << ":" << double(nsec) / DateCount << "ns per date";
+}
+
+
+// The batch time scale conversions must give exactly the same results as
+// the scalar ones. The time taken by each is reported.
+void
+CheckGregorianDate()
+{
+    double startTime = GregorianDate(1904, 1, 1, 0, 0, 0, 0, TimeScale_TDB).toTDBSec();
+    double endTime = GregorianDate(2095, 12, 31, 0, 0, 0, 0, TimeScale_TDB).toTDBSec();
+
+    std::vector<double> tdbSec(DateCount);
+    for (unsigned int i = 0; i < DateCount; ++i)
+    {
+        // Add a fraction of a second so that the times aren't all whole seconds
+        tdbSec[i] = startTime + (endTime - startTime) * i / DateCount + 0.001 * (i % 1000);
+    }
+
+    QElapsedTimer timer;
+
+    // Seconds to calendar dates
+    std::vector<GregorianDate> utcDates(DateCount);
+    std::vector<GregorianDate> tdbDates(DateCount);
+    timer.start();
+    for (unsigned int i = 0; i < DateCount; ++i)
+    {
+        utcDates[i] = GregorianDate::UTCDateFromTDBSec(tdbSec[i]);
+    }
+    reportTime("UTCDateFromTDBSec", timer.nsecsElapsed());
+
+    for (unsigned int i = 0; i < DateCount; ++i)
+    {
+        tdbDates[i] = GregorianDate::TDBDateFromTDBSec(tdbSec[i]);
+    }
+
+    std::vector<GregorianDate> batchDates(DateCount);
+    timer.start();
+    GregorianDate::UTCDatesFromTDBSec(DateCount, &tdbSec[0], &batchDates[0]);
+    reportTime("UTCDatesFromTDBSec", timer.nsecsElapsed());
+
+    bool utcDatesIdentical = true;
+    for (unsigned int i = 0; i < DateCount; ++i)
+    {
+        utcDatesIdentical = utcDatesIdentical && sameDate(utcDates[i], batchDates[i]);
+    }
+    CHECK(utcDatesIdentical);
+
+    GregorianDate::TDBDatesFromTDBSec(DateCount, &tdbSec[0], &batchDates[0]);
+    bool tdbDatesIdentical = true;
+    for (unsigned int i = 0; i < DateCount; ++i)
+    {
+        tdbDatesIdentical = tdbDatesIdentical && sameDate(tdbDates[i], batchDates[i]);
+    }
+    CHECK(tdbDatesIdentical);
+
+    // Calendar dates to seconds
+    std::vector<double> scalarSec(DateCount);
+    std::vector<double> batchSec(DateCount);
+    timer.start();
+    for (unsigned int i = 0; i < DateCount; ++i)
+    {
+        scalarSec[i] = utcDates[i].toTDBSec();
+    }
+    reportTime("toTDBSec", timer.nsecsElapsed());
+
+    timer.start();
+    GregorianDate::toTDBSec(DateCount, &utcDates[0], &batchSec[0]);
+    reportTime("toTDBSec (batch)", timer.nsecsElapsed());
+
+    CHECK(scalarSec == batchSec);
+
+    std::vector<double> ttSec(DateCount);
+    for (unsigned int i = 0; i < DateCount; ++i)
+    {
+        scalarSec[i] = tdbDates[i].toTTSec();
+    }
+    GregorianDate::toTTSec(DateCount, &tdbDates[0], &ttSec[0]);
+    CHECK(scalarSec == ttSec);
+
+    // Uniform time scales. TT is computed from TDB dates above, so the
+    // seconds conversion must agree with it to the precision of the dates.
+    timer.start();
+    GregorianDate::convertSec(DateCount, &tdbSec[0], TimeScale_TDB, &batchSec[0], TimeScale_TT);
+    reportTime("convertSec TDB to TT", timer.nsecsElapsed());
+
+    bool ttMatches = true;
+    for (unsigned int i = 0; i < DateCount; ++i)
+    {
+        ttMatches = ttMatches && std::abs(batchSec[i] - ttSec[i]) <= SecondsTolerance;
+    }
+    CHECK(ttMatches);
+
+    // Converting in place gives the same result
+    std::vector<double> inPlace(tdbSec);
+    GregorianDate::convertSec(DateCount, &inPlace[0], TimeScale_TDB, &inPlace[0], TimeScale_TT);
+    CHECK(inPlace == batchSec);
+
+    GregorianDate::convertSec(DateCount, &batchSec[0], TimeScale_TT, &batchSec[0], TimeScale_TDB);
+    bool tdbMatches = true;
+    for (unsigned int i = 0; i < DateCount; ++i)
+    {
+        tdbMatches = tdbMatches && std::abs(batchSec[i] - tdbSec[i]) <= SecondsTolerance;
+    }
+    CHECK(tdbMatches);
+}
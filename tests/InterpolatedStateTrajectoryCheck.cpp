@@ -0,0 +1,182 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Check.h"
+#include "InterpolatedStateTrajectory.h"
+#include <cmath>
+#include <vector>
+
+using namespace vesta;
+using namespace Eigen;
+
+
+static const double Tolerance = 1.0e-9;
+
+// The table has two segments of uniform motion that meet at BoundaryTime,
+// where the velocity changes abruptly (e.g. an impulsive maneuver.)
+static const double BoundaryTime = 10.0;
+
+
+static Vector3d
+expectedPosition(double t)
+{
+    if (t <= BoundaryTime)
+    {
+        return Vector3d(t, 0.5 * t, 0.0);
+    }
+    else
+    {
+        return Vector3d(BoundaryTime + 2.0 * (t - BoundaryTime), 0.5 * BoundaryTime, -(t - BoundaryTime));
+    }
+}
+
+
+static Vector3d
+expectedVelocity(double t)
+{
+    if (t < BoundaryTime)
+    {
+        return Vector3d(1.0, 0.5, 0.0);
+    }
+    else
+    {
+        return Vector3d(2.0, 0.0, -1.0);
+    }
+}
+
+
+static bool
+isFinite(const StateVector& s)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        if (!(std::abs(s.position()[i]) < 1.0e300 && std::abs(s.velocity()[i]) < 1.0e300))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// Sample the trajectory on both sides of the segment boundary. Both segments
+// are linear, so the interpolated states must be exact when the velocities
+// are estimated only from records within the same segment.
+static bool
+matchesSegments(const InterpolatedStateTrajectory& trajectory)
+{
+    const double times[] = { 0.0, 0.25, 8.5, 9.0, 9.75, 10.25, 11.0, 11.5, 19.75, 20.0 };
+    for (unsigned int i = 0; i < sizeof(times) / sizeof(times[0]); ++i)
+    {
+        double t = times[i];
+        StateVector s = trajectory.state(t);
+        if (!isFinite(s) ||
+            (s.position() - expectedPosition(t)).norm() > Tolerance ||
+            (s.velocity() - expectedVelocity(t)).norm() > Tolerance)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// Velocities estimated for position-only tables must not be computed across
+// a segment boundary, where two records have the same time.
+void
+CheckInterpolatedStateTrajectory()
+{
+    InterpolatedStateTrajectory::TimePositionList records;
+    for (unsigned int i = 0; i <= 20; ++i)
+    {
+        InterpolatedStateTrajectory::TimePosition record;
+        record.tsec = double(i);
+        record.position = expectedPosition(record.tsec);
+        records.push_back(record);
+
+        // Repeat the record at the boundary to start the second segment
+        if (record.tsec == BoundaryTime)
+        {
+            records.push_back(record);
+        }
+    }
+
+    InterpolatedStateTrajectory listTrajectory(records);
+    CHECK(matchesSegments(listTrajectory));
+
+    // Same records stored in separate arrays
+    std::vector<double> t;
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> z;
+    for (unsigned int i = 0; i < records.size(); ++i)
+    {
+        t.push_back(records[i].tsec);
+        x.push_back(records[i].position.x());
+        y.push_back(records[i].position.y());
+        z.push_back(records[i].position.z());
+    }
+
+    InterpolatedStateTrajectory::StateArrays arrays;
+    arrays.count = t.size();
+    arrays.tsec = &t[0];
+    arrays.x = &x[0];
+    arrays.y = &y[0];
+    arrays.z = &z[0];
+
+    InterpolatedStateTrajectory arrayTrajectory(arrays, NULL, 0.0);
+    CHECK(matchesSegments(arrayTrajectory));
+
+    // With a coarse index of every fourth record time
+    const unsigned int IndexStride = 4;
+    std::vector<double> index;
+    for (unsigned int i = 0; i < t.size(); i += IndexStride)
+    {
+        index.push_back(t[i]);
+    }
+
+    arrays.index = &index[0];
+    arrays.indexStride = IndexStride;
+    arrays.indexCount = index.size();
+
+    InterpolatedStateTrajectory indexedTrajectory(arrays, NULL, 0.0);
+    CHECK(matchesSegments(indexedTrajectory));
+
+    // An index that doesn't match the record times must be ignored rather
+    // than used to direct the search.
+    for (unsigned int i = 0; i < index.size(); ++i)
+    {
+        index[i] = t[t.size() - 1] - index[i];
+    }
+
+    InterpolatedStateTrajectory badIndexTrajectory(arrays, NULL, 0.0);
+    CHECK(matchesSegments(badIndexTrajectory));
+
+    // A segment consisting of a single record has no velocity estimate
+    InterpolatedStateTrajectory::TimePositionList isolated;
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        InterpolatedStateTrajectory::TimePosition record;
+        record.tsec = 0.0;
+        record.position = Vector3d(double(i), 0.0, 0.0);
+        isolated.push_back(record);
+    }
+
+    InterpolatedStateTrajectory isolatedTrajectory(isolated);
+    CHECK(isFinite(isolatedTrajectory.state(0.0)));
+}
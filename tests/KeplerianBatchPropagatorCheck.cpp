@@ -0,0 +1,135 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Check.h"
+#include "KeplerianBatchPropagator.h"
+#include "astro/OsculatingElements.h"
+#include <vesta/Units.h>
+#include <cmath>
+#include <vector>
+
+using namespace vesta;
+using namespace Eigen;
+
+
+// Eccentricities of the test orbits. Four Newton iterations are only
+// accurate to single precision for e < 0.9, so nearly parabolic ellipses
+// aren't included.
+static const double EllipticEccentricities[] = { 0.0, 0.05, 0.2, 0.5, 0.85 };
+static const double HyperbolicEccentricities[] = { 1.01, 1.2, 2.0, 5.0 };
+
+// Enough objects that the propagation is split among several threads
+static const unsigned int ObjectCount = 40000;
+
+static const double AU = 149597870.691;
+static const double SunGM = 1.32712440018e11;
+
+// Largest allowed difference from ElementsToStateVector, relative to the
+// distance of the object. The propagator stores the mean motion in single
+// precision, so the error grows with the number of orbits since the epoch;
+// this allows for about 50 orbits.
+static const double PositionTolerance = 1.0e-4;
+
+
+static std::vector<OrbitalElements>
+makeElements(const double* eccentricities, unsigned int eccentricityCount, double epoch)
+{
+    std::vector<OrbitalElements> elements(ObjectCount);
+    for (unsigned int i = 0; i < ObjectCount; ++i)
+    {
+        OrbitalElements& el = elements[i];
+        double q = AU * (0.3 + 0.0001 * (i % 30011));
+        el.eccentricity = eccentricities[i % eccentricityCount];
+        el.periapsisDistance = q;
+        el.inclination = toRadians(double(i % 179) + 0.5);
+        el.longitudeOfAscendingNode = toRadians(double((i * 7) % 360));
+        el.argumentOfPeriapsis = toRadians(double((i * 13) % 360));
+        el.meanAnomalyAtEpoch = toRadians(double((i * 31) % 360) - 180.0);
+        el.meanMotion = sqrt(SunGM / pow(std::abs(q / (1.0 - el.eccentricity)), 3.0));
+        el.epoch = epoch + daysToSeconds(double(i % 101) - 50.0);
+    }
+
+    return elements;
+}
+
+
+static bool
+positionsMatch(const std::vector<OrbitalElements>& elements, const std::vector<float>& positions, double t)
+{
+    for (unsigned int i = 0; i < elements.size(); ++i)
+    {
+        Vector3d expected = ElementsToStateVector(elements[i], t).position();
+        Vector3d actual(positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2]);
+        if (!((actual - expected).norm() <= PositionTolerance * expected.norm()))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// The positions computed by the propagator (and thus by the KeplerianSwarm
+// CPU path) must match ElementsToStateVector for both elliptical and
+// hyperbolic orbits.
+void
+CheckKeplerianBatchPropagator()
+{
+    const double epoch = daysToSeconds(2456000.5 - J2000);
+    const double times[] = { -3650.0, -1.0, 0.0, 0.37, 200.0, 3650.0 };
+
+    std::vector<OrbitalElements> elliptic = makeElements(EllipticEccentricities, sizeof(EllipticEccentricities) / sizeof(EllipticEccentricities[0]), epoch);
+    std::vector<OrbitalElements> hyperbolic = makeElements(HyperbolicEccentricities, sizeof(HyperbolicEccentricities) / sizeof(HyperbolicEccentricities[0]), epoch);
+
+    KeplerianBatchPropagator ellipticPropagator;
+    KeplerianBatchPropagator hyperbolicPropagator;
+    ellipticPropagator.setEpoch(epoch);
+    hyperbolicPropagator.setEpoch(epoch);
+    for (unsigned int i = 0; i < ObjectCount; ++i)
+    {
+        ellipticPropagator.addObject(elliptic[i], 0.0);
+        hyperbolicPropagator.addObject(hyperbolic[i], 0.0);
+    }
+
+    CHECK(ellipticPropagator.objectCount() == ObjectCount);
+
+    std::vector<float> positions(ObjectCount * 3);
+    for (unsigned int i = 0; i < sizeof(times) / sizeof(times[0]); ++i)
+    {
+        double t = epoch + daysToSeconds(times[i]);
+
+        ellipticPropagator.propagate(t, &positions[0]);
+        CHECK(positionsMatch(elliptic, positions, t));
+
+        hyperbolicPropagator.propagate(t, &positions[0]);
+        CHECK(positionsMatch(hyperbolic, positions, t));
+    }
+
+    // Positions written with a stride must be the same as packed ones
+    std::vector<float> strided(ObjectCount * 4);
+    ellipticPropagator.propagate(epoch, &positions[0]);
+    ellipticPropagator.propagate(epoch, &strided[0], 4);
+    bool sameStrided = true;
+    for (unsigned int i = 0; i < ObjectCount; ++i)
+    {
+        for (unsigned int j = 0; j < 3; ++j)
+        {
+            sameStrided = sameStrided && positions[i * 3 + j] == strided[i * 4 + j];
+        }
+    }
+    CHECK(sameStrided);
+}
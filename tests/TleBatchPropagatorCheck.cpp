@@ -0,0 +1,178 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Check.h"
+#include "TleBatchPropagator.h"
+#include "TleTrajectory.h"
+#include <vesta/Units.h>
+#include <QtConcurrentMap>
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace vesta;
+using namespace Eigen;
+
+
+// A low Earth orbit (ISS elements moved to an epoch near the others),
+// propagated with SGP4, and the resonant Molniya and geosynchronous orbits
+// from TleTrajectoryCheck, which are propagated with SDP4.
+static const char* Tles[][2] =
+{
+    { "1 25544U 98067A   06176.51782528 -.00002182  00000-0 -11606-4 0  2927",
+      "2 25544  51.6416 247.4627 0006703 130.5360 325.0288 15.72125391563537" },
+    { "1 08195U 75081A   06176.33215444  .00000099  00000-0  11873-3 0   813",
+      "2 08195  64.1586 279.0717 6877146 264.7651  20.2257  2.00491383225656" },
+    { "1 28626U 05008A   06176.46683397 -.00000205  00000-0  10000-3 0  2190",
+      "2 28626   0.0019 286.9433 0000335  13.7918  55.6504  1.00270176  4891" },
+};
+
+static const unsigned int TleCount = sizeof(Tles) / sizeof(Tles[0]);
+
+// Each element set is added this many times, so that propagation is split
+// among several tasks.
+static const unsigned int CopyCount = 1000;
+
+static const unsigned int EpochCount = 200;
+static const unsigned int ChunkCount = 8;
+
+// Largest allowed difference from TleTrajectory in km. SGP4 is evaluated by
+// different code in the batch propagator, so it's only equal up to roundoff.
+static const double PositionTolerance = 1.0e-6;
+
+
+struct TleBatchChunk
+{
+    const TleBatchPropagator* propagator;
+    const std::vector<double>* epochs;
+    unsigned int firstEpoch;
+    unsigned int endEpoch;
+    std::vector<double>* positions;
+};
+
+
+struct PropagateTleBatchChunk
+{
+    void operator()(const TleBatchChunk& chunk) const
+    {
+        unsigned int objectCount = chunk.propagator->objectCount();
+        for (unsigned int i = chunk.firstEpoch; i < chunk.endEpoch; ++i)
+        {
+            chunk.propagator->propagate((*chunk.epochs)[i], &(*chunk.positions)[i * objectCount * 3]);
+        }
+    }
+};
+
+
+// Positions computed by the batch propagator must not depend on the order in
+// which times are evaluated or on concurrent calls from other threads, and
+// they must match TleTrajectory.
+void
+CheckTleBatchPropagator()
+{
+    TleBatchPropagator propagator;
+    std::vector<counted_ptr<TleTrajectory> > trajectories;
+    for (unsigned int tleIndex = 0; tleIndex < TleCount; ++tleIndex)
+    {
+        trajectories.push_back(counted_ptr<TleTrajectory>(TleTrajectory::Create(Tles[tleIndex][0], Tles[tleIndex][1])));
+        if (!CHECK(!trajectories.back().isNull()))
+        {
+            return;
+        }
+    }
+
+    // Add the element sets in one batch, so that their epochs are converted
+    // together; an element set that can't be parsed is skipped.
+    std::vector<std::string> lines1;
+    std::vector<std::string> lines2;
+    for (unsigned int copy = 0; copy < CopyCount; ++copy)
+    {
+        for (unsigned int tleIndex = 0; tleIndex < TleCount; ++tleIndex)
+        {
+            lines1.push_back(Tles[tleIndex][0]);
+            lines2.push_back(Tles[tleIndex][1]);
+        }
+    }
+    lines1.push_back("1 bad element set");
+    lines2.push_back("2 bad element set");
+
+    CHECK(propagator.addObjects(&lines1[0], &lines2[0], lines1.size()) == TleCount * CopyCount);
+
+    unsigned int objectCount = propagator.objectCount();
+    CHECK(objectCount == TleCount * CopyCount);
+    CHECK(propagator.deepSpaceObjectCount() == 2 * CopyCount);
+
+    // Cover 120 days around the epoch of the deep space elements
+    std::vector<double> epochs(EpochCount);
+    for (unsigned int i = 0; i < EpochCount; ++i)
+    {
+        epochs[i] = trajectories[1]->epoch() + (double(i) / EpochCount - 0.5) * daysToSeconds(120.0);
+    }
+
+    unsigned int recordSize = objectCount * 3;
+    std::vector<double> forward(EpochCount * recordSize);
+    for (unsigned int i = 0; i < EpochCount; ++i)
+    {
+        propagator.propagate(epochs[i], &forward[i * recordSize]);
+    }
+
+    std::vector<double> backward(EpochCount * recordSize);
+    for (unsigned int i = EpochCount; i-- > 0; )
+    {
+        propagator.propagate(epochs[i], &backward[i * recordSize]);
+    }
+
+    CHECK(forward == backward);
+
+    std::vector<double> threaded(EpochCount * recordSize);
+    std::vector<TleBatchChunk> chunks(ChunkCount);
+    for (unsigned int i = 0; i < ChunkCount; ++i)
+    {
+        chunks[i].propagator = &propagator;
+        chunks[i].epochs = &epochs;
+        chunks[i].firstEpoch = EpochCount * i / ChunkCount;
+        chunks[i].endEpoch = EpochCount * (i + 1) / ChunkCount;
+        chunks[i].positions = &threaded;
+    }
+    QtConcurrent::blockingMap(chunks, PropagateTleBatchChunk());
+
+    CHECK(forward == threaded);
+
+    // Compare every copy of each element set with TleTrajectory. The deep
+    // space model is the same code in both, so it must match exactly.
+    bool matches = true;
+    bool deepSpaceIdentical = true;
+    for (unsigned int i = 0; i < EpochCount; ++i)
+    {
+        for (unsigned int tleIndex = 0; tleIndex < TleCount; ++tleIndex)
+        {
+            Vector3d expected = trajectories[tleIndex]->state(epochs[i]).position();
+            for (unsigned int copy = 0; copy < CopyCount; ++copy)
+            {
+                const double* p = &forward[i * recordSize + (copy * TleCount + tleIndex) * 3];
+                Vector3d actual(p[0], p[1], p[2]);
+                matches = matches && (actual - expected).norm() <= PositionTolerance;
+                if (tleIndex > 0)
+                {
+                    deepSpaceIdentical = deepSpaceIdentical && actual == expected;
+                }
+            }
+        }
+    }
+
+    CHECK(matches);
+    CHECK(deepSpaceIdentical);
+}
@@ -0,0 +1,132 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Check.h"
+#include "TleTrajectory.h"
+#include <vesta/Units.h>
+#include <QtConcurrentMap>
+#include <vector>
+
+using namespace vesta;
+
+
+// Deep space test cases from the SGP4 verification set: a 12 hour resonant
+// Molniya orbit and a geosynchronous orbit. Both are propagated with SDP4,
+// including the resonance integrator.
+static const char* DeepSpaceTles[][2] =
+{
+    { "1 08195U 75081A   06176.33215444  .00000099  00000-0  11873-3 0   813",
+      "2 08195  64.1586 279.0717 6877146 264.7651  20.2257  2.00491383225656" },
+    { "1 28626U 05008A   06176.46683397 -.00000205  00000-0  10000-3 0  2190",
+      "2 28626   0.0019 286.9433 0000335  13.7918  55.6504  1.00270176  4891" },
+};
+
+static const unsigned int EpochCount = 2000;
+static const unsigned int ChunkCount = 16;
+
+
+struct TleEvaluationChunk
+{
+    const TleTrajectory* trajectory;
+    const std::vector<double>* epochs;
+    unsigned int firstEpoch;
+    unsigned int endEpoch;
+    std::vector<StateVector>* states;
+};
+
+
+struct EvaluateTleChunk
+{
+    void operator()(const TleEvaluationChunk& chunk) const
+    {
+        for (unsigned int i = chunk.firstEpoch; i < chunk.endEpoch; ++i)
+        {
+            (*chunk.states)[i] = chunk.trajectory->state((*chunk.epochs)[i]);
+        }
+    }
+};
+
+
+static bool
+identicalStates(const std::vector<StateVector>& a, const std::vector<StateVector>& b)
+{
+    for (unsigned int i = 0; i < a.size(); ++i)
+    {
+        if (a[i].position() != b[i].position() || a[i].velocity() != b[i].velocity())
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// Evaluating a deep space TLE from several threads at once must give the
+// same results as evaluating it on one thread, and the result at a time
+// must not depend on the order in which times are evaluated.
+void
+CheckTleTrajectory()
+{
+    for (unsigned int tleIndex = 0; tleIndex < sizeof(DeepSpaceTles) / sizeof(DeepSpaceTles[0]); ++tleIndex)
+    {
+        counted_ptr<TleTrajectory> trajectory(TleTrajectory::Create(DeepSpaceTles[tleIndex][0], DeepSpaceTles[tleIndex][1]));
+        if (!CHECK(!trajectory.isNull()))
+        {
+            continue;
+        }
+
+        // Cover 120 days around the epoch of the elements
+        std::vector<double> epochs(EpochCount);
+        for (unsigned int i = 0; i < EpochCount; ++i)
+        {
+            epochs[i] = trajectory->epoch() + (double(i) / EpochCount - 0.5) * daysToSeconds(120.0);
+        }
+
+        std::vector<StateVector> forward(EpochCount);
+        for (unsigned int i = 0; i < EpochCount; ++i)
+        {
+            forward[i] = trajectory->state(epochs[i]);
+        }
+
+        std::vector<StateVector> backward(EpochCount);
+        for (unsigned int i = EpochCount; i-- > 0; )
+        {
+            backward[i] = trajectory->state(epochs[i]);
+        }
+
+        CHECK(identicalStates(forward, backward));
+
+        // Several passes, since a race might not show up every time
+        for (unsigned int pass = 0; pass < 4; ++pass)
+        {
+            std::vector<StateVector> threaded(EpochCount);
+            std::vector<TleEvaluationChunk> chunks(ChunkCount);
+            for (unsigned int i = 0; i < ChunkCount; ++i)
+            {
+                chunks[i].trajectory = trajectory.ptr();
+                chunks[i].epochs = &epochs;
+                chunks[i].firstEpoch = EpochCount * i / ChunkCount;
+                chunks[i].endEpoch = EpochCount * (i + 1) / ChunkCount;
+                chunks[i].states = &threaded;
+            }
+
+            QtConcurrent::blockingMap(chunks, EvaluateTleChunk());
+
+            CHECK(identicalStates(forward, threaded));
+        }
+    }
+}
@@ -0,0 +1,98 @@
+# Qt project file for the Cosmographia consistency checks. The checks are a
+# console program that exits with a nonzero status when any check fails.
+
+TEMPLATE = app
+TARGET = cosmographia-checks
+DESTDIR = build
+OBJECTS_DIR = obj
+CONFIG += console
+CONFIG -= app_bundle
+
+QT -= gui
+greaterThan(QT_MAJOR_VERSION, 4): QT += concurrent
+
+
+#### Checks ####
+
+CHECK_SOURCES = \
+    main.cpp \
+    CheckBodies.cpp \
+    BatchStateEvaluatorCheck.cpp \
+    CachingChebyshevTrajectoryCheck.cpp \
+    ChebyshevPolyTrajectoryCheck.cpp \
+    EventFinderCheck.cpp \
+    GregorianDateCheck.cpp \
+    InterpolatedStateTrajectoryCheck.cpp \
+    KeplerianBatchPropagatorCheck.cpp \
+    TleBatchPropagatorCheck.cpp \
+    TleTrajectoryCheck.cpp
+
+CHECK_HEADERS = \
+    Check.h \
+    CheckBodies.h
+
+
+#### Sources under test ####
+
+MAIN_PATH = ../src/main
+VESTA_PATH = ../thirdparty/vesta
+NORADTLE_PATH = ../thirdparty/noradtle
+
+APP_SOURCES = \
+    $$MAIN_PATH/AdaptiveChebyshevTrajectory.cpp \
+    $$MAIN_PATH/BatchStateEvaluator.cpp \
+    $$MAIN_PATH/CachingChebyshevTrajectory.cpp \
+    $$MAIN_PATH/ChebyshevPolyTrajectory.cpp \
+    $$MAIN_PATH/EpochRanges.cpp \
+    $$MAIN_PATH/EventFinder.cpp \
+    $$MAIN_PATH/InterpolatedStateTrajectory.cpp \
+    $$MAIN_PATH/KeplerianBatchPropagator.cpp \
+    $$MAIN_PATH/SampledTimeIndex.cpp \
+    $$MAIN_PATH/TleBatchPropagator.cpp \
+    $$MAIN_PATH/TleTrajectory.cpp \
+    $$MAIN_PATH/astro/OsculatingElements.cpp
+
+VESTA_SOURCES = \
+    $$VESTA_PATH/Arc.cpp \
+    $$VESTA_PATH/Chronology.cpp \
+    $$VESTA_PATH/Debug.cpp \
+    $$VESTA_PATH/Entity.cpp \
+    $$VESTA_PATH/FixedPointTrajectory.cpp \
+    $$VESTA_PATH/FixedRotationModel.cpp \
+    $$VESTA_PATH/Frame.cpp \
+    $$VESTA_PATH/GregorianDate.cpp \
+    $$VESTA_PATH/InertialFrame.cpp \
+    $$VESTA_PATH/KeplerianTrajectory.cpp \
+    $$VESTA_PATH/OrbitalElements.cpp
+
+NORADTLE_SOURCES = \
+    $$NORADTLE_PATH/basics.cpp \
+    $$NORADTLE_PATH/common.cpp \
+    $$NORADTLE_PATH/deep.cpp \
+    $$NORADTLE_PATH/get_el.cpp \
+    $$NORADTLE_PATH/sdp4.cpp \
+    $$NORADTLE_PATH/sdp8.cpp \
+    $$NORADTLE_PATH/sgp.cpp \
+    $$NORADTLE_PATH/sgp4.cpp \
+    $$NORADTLE_PATH/sgp8.cpp
+
+SOURCES = \
+    $$CHECK_SOURCES \
+    $$APP_SOURCES \
+    $$VESTA_SOURCES \
+    $$NORADTLE_SOURCES
+
+HEADERS = \
+    $$CHECK_HEADERS
+
+INCLUDEPATH += ../thirdparty $$MAIN_PATH
+
+DEFINES += EIGEN_USE_NEW_STDVECTOR
+
+win32-g++ {
+    DEFINES += EIGEN_DISABLE_UNALIGNED_ARRAY_ASSERT
+}
+
+win32 {
+    DEFINES += NOMINMAX
+}
@@ -0,0 +1,66 @@
+// This file is part of Cosmographia.
+//
+// Copyright (C) 2013 Chris Laurel <claurel@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Check.h"
+#include <QCoreApplication>
+#include <QThread>
+#include <QThreadPool>
+#include <QDebug>
+#include <algorithm>
+
+static unsigned int FailureCount = 0;
+
+
+bool
+CheckCondition(bool passed, const char* condition, const char* file, int line)
+{
+    if (!passed)
+    {
+        qDebug() << "FAILED:" << file << ":" << line << ":" << condition;
+        ++FailureCount;
+    }
+
+    return passed;
+}
+
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // Several checks compare threaded and serial evaluation, so make sure
+    // that there really are multiple threads even on a single processor.
+    QThreadPool::globalInstance()->setMaxThreadCount(std::max(4, QThread::idealThreadCount()));
+
+    CheckBatchStateEvaluator();
+    CheckCachingChebyshevTrajectory();
+    CheckChebyshevPolyTrajectory();
+    CheckEventFinder();
+    CheckGregorianDate();
+    CheckInterpolatedStateTrajectory();
+    CheckKeplerianBatchPropagator();
+    CheckTleBatchPropagator();
+    CheckTleTrajectory();
+
+    if (FailureCount > 0)
+    {
+        qDebug() << FailureCount << "checks failed";
+        return 1;
+    }
+
+    qDebug() << "All checks passed";
+    return 0;
+}
@@ -10,6 +10,7 @@
 
 #include "Chronology.h"
 #include "Arc.h"
+#include <algorithm>
 
 using namespace vesta;
 using namespace std;
@@ -17,7 +18,8 @@ using namespace std;
 
 Chronology::Chronology() :
     m_beginning(0.0),
-    m_duration(0.0)
+    m_duration(0.0),
+    m_lastActiveArc(0)
 {
 }
 
@@ -36,6 +38,8 @@ Chronology::clearArcs()
     m_beginning = 0.0;
     m_duration = 0.0;
     m_arcSequence.clear();
+    m_arcStartTimes.clear();
+    m_lastActiveArc.storeRelaxed(0);
 }
 
 
@@ -47,6 +51,13 @@ void
 Chronology::setBeginning(double t)
 {
     m_beginning = t;
+
+    double arcStartTime = m_beginning;
+    for (unsigned int i = 0; i < m_arcSequence.size(); ++i)
+    {
+        m_arcStartTimes[i] = arcStartTime;
+        arcStartTime += m_arcSequence[i]->duration();
+    }
 }
 
 
@@ -63,23 +74,47 @@ Chronology::activeArc(double t) const
     {
         return NULL;
     }
-    else
+
+    unsigned int arcCount = m_arcSequence.size();
+
+    // Check the most recently found arc and the one following it before
+    // searching. The hint is range checked, so a stale value written by
+    // another thread costs only a search.
+    unsigned int index = unsigned(m_lastActiveArc.loadRelaxed());
+    if (index >= arcCount || !arcIncludesTime(index, t))
     {
-        double m_arcBeginning = m_beginning;
-        for (vector<counted_ptr<Arc> >::const_iterator iter = m_arcSequence.begin(); iter != m_arcSequence.end(); iter++)
+        if (index + 1 < arcCount && arcIncludesTime(index + 1, t))
         {
-            counted_ptr<Arc> arc = *iter;
-            if (t - m_arcBeginning < arc->duration())
-            {
-                return &*arc;
-            }
-
-            m_arcBeginning += arc->duration();
+            ++index;
+        }
+        else
+        {
+            // Find the last arc starting at or before t
+            index = upper_bound(m_arcStartTimes.begin(), m_arcStartTimes.end(), t) - m_arcStartTimes.begin();
+            index = index == 0 ? 0 : index - 1;
         }
+    }
+
+    // Adjust for roundoff and zero duration arcs so that the result is
+    // always the first arc that includes t.
+    while (index > 0 && (arcIncludesTime(index - 1, t) || m_arcStartTimes[index - 1] == m_arcStartTimes[index]))
+    {
+        --index;
+    }
+    while (index < arcCount && !arcIncludesTime(index, t))
+    {
+        ++index;
+    }
 
+    if (index == arcCount)
+    {
         // Only reached when t == ending
-        return &*m_arcSequence.back();
+        index = arcCount - 1;
     }
+
+    m_lastActiveArc.storeRelaxed(int(index));
+
+    return m_arcSequence[index].ptr();
 }
 
 
@@ -137,6 +172,17 @@ Chronology::arcCount() const
 void
 Chronology::addArc(Arc* arc)
 {
+    m_arcStartTimes.push_back(m_arcStartTimes.empty() ? m_beginning : m_arcStartTimes.back() + m_arcSequence.back()->duration());
     m_arcSequence.push_back(counted_ptr<Arc>(arc));
     m_duration += arc->duration();
 }
+
+
+// Return true if the arc at the specified index is active at time t. The
+// start time is accumulated from the arc durations, so the arcs that
+// include the time are adjacent but may overlap slightly due to roundoff.
+bool
+Chronology::arcIncludesTime(unsigned int index, double t) const
+{
+    return t - m_arcStartTimes[index] < m_arcSequence[index]->duration();
+}
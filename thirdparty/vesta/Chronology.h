@@ -12,6 +12,7 @@
 #define _VESTA_CHRONOLOGY_H_
 
 #include "Object.h"
+#include "internal/AtomicInt.h"
 #include <vector>
 
 
@@ -83,10 +84,21 @@ public:
 
     void clearArcs();
 
+private:
+    bool arcIncludesTime(unsigned int index, double t) const;
+
 private:
     std::vector<counted_ptr<Arc> > m_arcSequence;
+    std::vector<double> m_arcStartTimes;
     double m_beginning;
     double m_duration;
+
+    // Index of the arc found by the last call to activeArc(). Arcs are
+    // usually looked up at steadily increasing times, so the next arc
+    // requested is likely to be the same one or the one following it.
+    // Chronologies may be evaluated from several threads at once, so the
+    // hint is read and written atomically.
+    mutable AtomicInt m_lastActiveArc;
 };
 
 } // namespace
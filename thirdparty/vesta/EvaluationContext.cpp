@@ -0,0 +1,310 @@
+/*
+ * $Revision$ $Date$
+ *
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#include "EvaluationContext.h"
+#include "Entity.h"
+#include "Arc.h"
+#include "Frame.h"
+#include "Observer.h"
+#include "Trajectory.h"
+#include "RotationModel.h"
+
+using namespace vesta;
+using namespace Eigen;
+using namespace std;
+
+
+// Note that entries are always looked up again after evaluating another
+// entity or frame: evaluation may add entries and reallocate the entry
+// vectors.
+
+
+/** Create a new evaluation context with the time set to J2000.
+  */
+EvaluationContext::EvaluationContext() :
+    m_time(0.0),
+    m_hitCount(0),
+    m_missCount(0)
+{
+}
+
+
+EvaluationContext::~EvaluationContext()
+{
+}
+
+
+/** Set the time at which quantities are evaluated. This discards all
+  * cached values, even if the time is unchanged.
+  *
+  * \param t time in seconds since J2000 TDB
+  */
+void
+EvaluationContext::setTime(double t)
+{
+    m_time = t;
+    clear();
+}
+
+
+/** Discard all cached values. This must be called whenever an entity
+  * is modified.
+  */
+void
+EvaluationContext::clear()
+{
+    m_entities.clear();
+    m_entityIndex.clear();
+    m_frames.clear();
+    m_frameIndex.clear();
+}
+
+
+/** Reset the hit and miss counters to zero.
+  */
+void
+EvaluationContext::resetCounters()
+{
+    m_hitCount = 0;
+    m_missCount = 0;
+}
+
+
+/** Get the position of an entity in universal coordinates. The result is
+  * identical to entity->position(time()).
+  */
+Vector3d
+EvaluationContext::position(const Entity* entity)
+{
+    {
+        const EntityEntry& entry = entityEntry(entity);
+        if (entry.positionValid)
+        {
+            ++m_hitCount;
+            return entry.position;
+        }
+        else if (entry.stateValid)
+        {
+            ++m_hitCount;
+            return entry.state.position();
+        }
+    }
+
+    ++m_missCount;
+
+    Vector3d position = Vector3d::Zero();
+    Arc* arc = entity->chronology()->activeArc(m_time);
+    if (arc)
+    {
+        Vector3d centerPosition = Vector3d::Zero();
+        if (arc->center())
+        {
+            centerPosition = this->position(arc->center());
+        }
+        position = centerPosition + frameOrientation(arc->trajectoryFrame()) * arc->trajectory()->position(m_time);
+    }
+
+    EntityEntry& entry = entityEntry(entity);
+    entry.position = position;
+    entry.positionValid = true;
+
+    return position;
+}
+
+
+/** Get the state vector of an entity in the fundamental coordinate
+  * system. The result is identical to entity->state(time()).
+  */
+StateVector
+EvaluationContext::state(const Entity* entity)
+{
+    {
+        const EntityEntry& entry = entityEntry(entity);
+        if (entry.stateValid)
+        {
+            ++m_hitCount;
+            return entry.state;
+        }
+    }
+
+    ++m_missCount;
+
+    StateVector result(Vector3d::Zero(), Vector3d::Zero());
+    Arc* arc = entity->chronology()->activeArc(m_time);
+    if (arc)
+    {
+        StateVector centerState(Vector3d::Zero(), Vector3d::Zero());
+        if (arc->center())
+        {
+            centerState = this->state(arc->center());
+        }
+
+        StateVector state = arc->trajectory()->state(m_time);
+
+        Matrix3d m = frameOrientation(arc->trajectoryFrame()).toRotationMatrix();
+        Vector3d omega = frameAngularVelocity(arc->trajectoryFrame());
+        Vector3d position = m * state.position();
+        Vector3d velocity = m * state.velocity() + omega.cross(state.position());
+
+        result = centerState + StateVector(position, velocity);
+    }
+
+    EntityEntry& entry = entityEntry(entity);
+    entry.state = result;
+    entry.stateValid = true;
+
+    return result;
+}
+
+
+/** Get the orientation of an entity in universal coordinates. The result
+  * is identical to entity->orientation(time()).
+  */
+Quaterniond
+EvaluationContext::orientation(const Entity* entity)
+{
+    {
+        const EntityEntry& entry = entityEntry(entity);
+        if (entry.orientationValid)
+        {
+            ++m_hitCount;
+            return entry.orientation;
+        }
+    }
+
+    ++m_missCount;
+
+    Quaterniond orientation = Quaterniond::Identity();
+    Arc* arc = entity->chronology()->activeArc(m_time);
+    if (arc)
+    {
+        orientation = frameOrientation(arc->bodyFrame()) * arc->rotationModel()->orientation(m_time);
+    }
+
+    EntityEntry& entry = entityEntry(entity);
+    entry.orientation = orientation;
+    entry.orientationValid = true;
+
+    return orientation;
+}
+
+
+/** Get the orientation of a frame with respect to the ICRF.
+  */
+Quaterniond
+EvaluationContext::frameOrientation(const Frame* frame)
+{
+    {
+        const FrameEntry& entry = frameEntry(frame);
+        if (entry.orientationValid)
+        {
+            ++m_hitCount;
+            return entry.orientation;
+        }
+    }
+
+    ++m_missCount;
+
+    Quaterniond orientation = frame->orientation(m_time);
+
+    FrameEntry& entry = frameEntry(frame);
+    entry.orientation = orientation;
+    entry.orientationValid = true;
+
+    return orientation;
+}
+
+
+/** Get the angular velocity of a frame in radians per second.
+  */
+Vector3d
+EvaluationContext::frameAngularVelocity(const Frame* frame)
+{
+    {
+        const FrameEntry& entry = frameEntry(frame);
+        if (entry.angularVelocityValid)
+        {
+            ++m_hitCount;
+            return entry.angularVelocity;
+        }
+    }
+
+    ++m_missCount;
+
+    Vector3d angularVelocity = frame->angularVelocity(m_time);
+
+    FrameEntry& entry = frameEntry(frame);
+    entry.angularVelocity = angularVelocity;
+    entry.angularVelocityValid = true;
+
+    return angularVelocity;
+}
+
+
+/** Get the position of an observer in universal coordinates. The result is
+  * identical to observer->absolutePosition(time()). Observers are moved
+  * constantly, so only the center position and frame orientation are cached.
+  */
+Vector3d
+EvaluationContext::observerPosition(const Observer* observer)
+{
+    return position(observer->center()) + frameOrientation(observer->positionFrame()) * observer->position();
+}
+
+
+/** Get the orientation of an observer in universal coordinates. The result
+  * is identical to observer->absoluteOrientation(time()).
+  */
+Quaterniond
+EvaluationContext::observerOrientation(const Observer* observer)
+{
+    return frameOrientation(observer->pointingFrame()) * observer->orientation();
+}
+
+
+EvaluationContext::EntityEntry&
+EvaluationContext::entityEntry(const Entity* entity)
+{
+    map<const Entity*, unsigned int>::const_iterator iter = m_entityIndex.find(entity);
+    if (iter != m_entityIndex.end())
+    {
+        return m_entities[iter->second];
+    }
+
+    EntityEntry entry;
+    entry.positionValid = false;
+    entry.stateValid = false;
+    entry.orientationValid = false;
+
+    m_entityIndex[entity] = m_entities.size();
+    m_entities.push_back(entry);
+
+    return m_entities.back();
+}
+
+
+EvaluationContext::FrameEntry&
+EvaluationContext::frameEntry(const Frame* frame)
+{
+    map<const Frame*, unsigned int>::const_iterator iter = m_frameIndex.find(frame);
+    if (iter != m_frameIndex.end())
+    {
+        return m_frames[iter->second];
+    }
+
+    FrameEntry entry;
+    entry.orientationValid = false;
+    entry.angularVelocityValid = false;
+
+    m_frameIndex[frame] = m_frames.size();
+    m_frames.push_back(entry);
+
+    return m_frames.back();
+}
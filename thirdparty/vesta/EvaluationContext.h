@@ -0,0 +1,127 @@
+/*
+ * $Revision$ $Date$
+ *
+ * Copyright by Astos Solutions GmbH, Germany
+ *
+ * this file is published under the Astos Solutions Free Public License
+ * For details on copyright and terms of use see
+ * http://www.astos.de/Astos_Solutions_Free_Public_License.html
+ */
+
+#ifndef _VESTA_EVALUATION_CONTEXT_H_
+#define _VESTA_EVALUATION_CONTEXT_H_
+
+#include "StateVector.h"
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <vector>
+#include <map>
+
+
+namespace vesta
+{
+class Entity;
+class Frame;
+class Observer;
+
+/** EvaluationContext remembers the positions, states, and orientations of
+  * entities and the orientations of frames at a single instant. The renderer
+  * and user interface ask for the same quantities many times per frame: an
+  * entity's position is needed for culling, lighting, eclipse shadows, and
+  * labels, and computing it requires the positions of every entity up the
+  * chain of centers. Going through an evaluation context, each of these is
+  * computed at most once for the context's time.
+  *
+  * The cached values are only valid as long as the universe doesn't change;
+  * call setTime() or clear() after modifying entities or their chronologies.
+  * An EvaluationContext is not safe to use from multiple threads.
+  */
+class EvaluationContext
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    EvaluationContext();
+    ~EvaluationContext();
+
+    /** Get the time at which quantities are evaluated, in seconds
+      * since J2000 TDB.
+      */
+    double time() const
+    {
+        return m_time;
+    }
+
+    void setTime(double t);
+    void clear();
+
+    Eigen::Vector3d position(const Entity* entity);
+    StateVector state(const Entity* entity);
+    Eigen::Quaterniond orientation(const Entity* entity);
+    Eigen::Quaterniond frameOrientation(const Frame* frame);
+    Eigen::Vector3d frameAngularVelocity(const Frame* frame);
+
+    Eigen::Vector3d observerPosition(const Observer* observer);
+    Eigen::Quaterniond observerOrientation(const Observer* observer);
+
+    /** Get the number of requests that were answered from the cache since
+      * the counters were last reset.
+      */
+    unsigned int hitCount() const
+    {
+        return m_hitCount;
+    }
+
+    /** Get the number of requests that required evaluating a trajectory,
+      * rotation model, or frame since the counters were last reset.
+      */
+    unsigned int missCount() const
+    {
+        return m_missCount;
+    }
+
+    void resetCounters();
+
+private:
+    struct EntityEntry
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        Eigen::Vector3d position;
+        StateVector state;
+        Eigen::Quaterniond orientation;
+        bool positionValid;
+        bool stateValid;
+        bool orientationValid;
+    };
+
+    struct FrameEntry
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        Eigen::Quaterniond orientation;
+        Eigen::Vector3d angularVelocity;
+        bool orientationValid;
+        bool angularVelocityValid;
+    };
+
+    EntityEntry& entityEntry(const Entity* entity);
+    FrameEntry& frameEntry(const Frame* frame);
+
+private:
+    double m_time;
+
+    // Entries are stored in vectors and located through an index, so that
+    // the storage can be reused from one frame to the next.
+    std::vector<EntityEntry, Eigen::aligned_allocator<EntityEntry> > m_entities;
+    std::map<const Entity*, unsigned int> m_entityIndex;
+    std::vector<FrameEntry, Eigen::aligned_allocator<FrameEntry> > m_frames;
+    std::map<const Frame*, unsigned int> m_frameIndex;
+
+    unsigned int m_hitCount;
+    unsigned int m_missCount;
+};
+
+}
+
+#endif // _VESTA_EVALUATION_CONTEXT_H_
@@ -47,11 +47,64 @@ static const double TDB_EB = 1.671e-2;
 static const double TDB_M0 = 6.239996;
 static const double TDB_M1 = 1.99096871e-7;
 
+// TDB - TT is a periodic function of the Earth's mean anomaly, so it is
+// tabulated over one orbit and interpolated with cubic polynomials instead of
+// evaluating the series for every conversion. The interpolation error is at
+// most 3/128 * h^4 * max|f''''| (h = 2*pi / 1024, max|f''''| < 1.04 * TDB_K),
+// or about 6e-14 seconds.
+class TDBMinusTTTable
+{
+public:
+    TDBMinusTTTable()
+    {
+        for (unsigned int i = 0; i < Size; ++i)
+        {
+            double m = 2.0 * PI * i / Size;
+            m_values[i] = TDB_K * sin(m + TDB_EB * sin(m));
+        }
+    }
+
+    // Get TDB - TT in seconds at the specified time (TT seconds since J2000)
+    double value(double ttSec) const
+    {
+        double phase = (TDB_M0 + TDB_M1 * ttSec) * (1.0 / (2.0 * PI));
+        double x = (phase - floor(phase)) * Size;
+        double k = floor(x);
+        double s = x - k;
+        unsigned int i = unsigned(k);
+
+        double w0 = -s * (s - 1.0) * (s - 2.0) * (1.0 / 6.0);
+        double w1 = (s + 1.0) * (s - 1.0) * (s - 2.0) * 0.5;
+        double w2 = -(s + 1.0) * s * (s - 2.0) * 0.5;
+        double w3 = (s + 1.0) * s * (s - 1.0) * (1.0 / 6.0);
+
+        return w0 * m_values[(i - 1) & Mask] +
+               w1 * m_values[i & Mask] +
+               w2 * m_values[(i + 1) & Mask] +
+               w3 * m_values[(i + 2) & Mask];
+    }
+
+private:
+    static const unsigned int Size = 1024;
+    static const unsigned int Mask = Size - 1;
+    double m_values[Size];
+};
+
+// The table is built on first use rather than being a namespace scope static,
+// since dates may be converted while other static objects are constructed,
+// possibly before this file's statics have been initialized.
+static const TDBMinusTTTable& TDBMinusTT()
+{
+    static const TDBMinusTTTable table;
+    return table;
+}
+
+
 // Convert from Terrestrial Time to Barycentric Dynamical Time. The argument and return
 // value are both the number of seconds since J2000.0.
 static double convertTTtoTDB(double ttSec)
 {
-    return ttSec + TDB_K * sin(TDB_M0 + TDB_M1 * ttSec + TDB_EB * sin(TDB_M0 + TDB_M1 * ttSec));
+    return ttSec + TDBMinusTT().value(ttSec);
 }
 
 // Convert from Barycentric Dynamical Time to Terrestrial Time. The argument and return
@@ -65,7 +118,7 @@ static double convertTDBtoTT(double tdbSec)
     double ttSec = tdbSec;
     for (unsigned int i = 0; i < 3; ++i)
     {
-        ttSec = tdbSec - TDB_K * sin(TDB_M0 + TDB_M1 * ttSec + TDB_EB * sin(TDB_M0 + TDB_M1 * ttSec));
+        ttSec = tdbSec - TDBMinusTT().value(ttSec);
     }
 
     return ttSec;
@@ -350,6 +403,14 @@ static unsigned int dateHash(int year, unsigned int month, unsigned int day)
 }
 
 
+// Get an integer key for a date such that keys are ordered the same as
+// the dates.
+static int dateKey(int year, unsigned int month, unsigned int day)
+{
+    return int(day) + 100 * (int(month) + 100 * year);
+}
+
+
 struct UTCDifferenceRecord
 {
     double tai;
@@ -404,6 +465,7 @@ public:
         {
             const LeapSecond& ls = leapSeconds[i];
             m_leapSeconds.push_back(ls);
+            m_leapSecondKeys.push_back(dateKey(ls.year, ls.month, ls.day));
             m_calendarOffsets[dateHash(ls.year, ls.month, ls.day)] = ls.taiOffset;
 
             UTCDifferenceRecord utcDiff;
@@ -508,44 +570,45 @@ public:
 
 
    // Get the difference betweeen UTC and TAI at the specified UTC
-   // calendar day.
-   double utcDifference(int year, unsigned int month, unsigned int day)
+   // calendar day. If hint is not null, it should point to the index
+   // of the leap second found by a previous lookup; it's updated with
+   // the index found for this date. Lookups for nearby dates then
+   // usually don't require a search.
+   double utcDifference(int year, unsigned int month, unsigned int day, unsigned int* hint = NULL)
    {
        if (m_utcDiffs.empty())
        {
            return 0.0;
        }
 
-       LeapSecond ls;
-       ls.year = year;
-       ls.month = month;
-       ls.day = day;
-       vector<LeapSecond>::const_iterator iter = lower_bound(m_leapSeconds.begin(), m_leapSeconds.end(), ls);
+       int key = dateKey(year, month, day);
+       unsigned int count = m_leapSecondKeys.size();
 
-       if (iter == m_leapSeconds.end())
+       unsigned int index = 0;
+       if (hint && *hint < count &&
+           m_leapSecondKeys[*hint] <= key && (*hint + 1 == count || key < m_leapSecondKeys[*hint + 1]))
        {
-           return m_leapSeconds.back().taiOffset;
+           index = *hint;
        }
-       else if (ls < *iter)
+       else
        {
-           if (iter == m_leapSeconds.begin())
-           {
-               return iter->taiOffset;
-           }
-           else
-           {
-               --iter;
-               return iter->taiOffset;
-           }
+           // Find the last leap second on or before the date. Dates before
+           // the first leap second use the first offset.
+           index = upper_bound(m_leapSecondKeys.begin(), m_leapSecondKeys.end(), key) - m_leapSecondKeys.begin();
+           index = index == 0 ? 0 : index - 1;
        }
-       else
+
+       if (hint)
        {
-           return iter->taiOffset;
+           *hint = index;
        }
+
+       return m_leapSeconds[index].taiOffset;
    }
 
 private:
     vector<LeapSecond> m_leapSeconds;
+    vector<int> m_leapSecondKeys;
     map<unsigned int, unsigned int> m_calendarOffsets;
     vector<UTCDifferenceRecord> m_utcDiffs;
 };
@@ -737,6 +800,15 @@ GregorianDate::toTDBJD() const
   */
 double
 GregorianDate::toTAIJD() const
+{
+    return toTAIJD(NULL);
+}
+
+
+// Convert the date to a TAI Julian day number, passing a leap second
+// table hint through to the lookup.
+double
+GregorianDate::toTAIJD(unsigned int* leapSecondHint) const
 {
     double second = m_second + m_usec * 1.0e-6;
 
@@ -744,7 +816,7 @@ GregorianDate::toTAIJD() const
     TimeScale timeScale = m_timeScale;
     if (m_timeScale == TimeScale_UTC)
     {
-        double utcOffset = s_DefaultLeapSecondTable->utcDifference(m_year, m_month, m_day);
+        double utcOffset = s_DefaultLeapSecondTable->utcDifference(m_year, m_month, m_day, leapSecondHint);
         uniformTime += secondsToDays(utcOffset);
         timeScale = TimeScale_TAI;
     }
@@ -850,6 +922,108 @@ GregorianDate::TDBDateFromTDBSec(double tdbsec)
 }
 
 
+/** Convert an array of dates to times in seconds since J2000.0 TDB. The
+  * result is identical to calling toTDBSec() for each date, but leap second
+  * lookups are faster when the dates are in order.
+  *
+  * \param count number of dates to convert
+  * \param dates array of dates (in any time scale)
+  * \param tdbSec array that receives the converted times
+  */
+void
+GregorianDate::toTDBSec(unsigned int count, const GregorianDate* dates, double* tdbSec)
+{
+    unsigned int hint = 0;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        tdbSec[i] = convertTAItoTDB(convertJDToSec(dates[i].toTAIJD(&hint)));
+    }
+}
+
+
+/** Convert an array of dates to times in seconds since J2000.0 TT. The
+  * result is identical to calling toTTSec() for each date.
+  *
+  * \param count number of dates to convert
+  * \param dates array of dates (in any time scale)
+  * \param ttSec array that receives the converted times
+  */
+void
+GregorianDate::toTTSec(unsigned int count, const GregorianDate* dates, double* ttSec)
+{
+    unsigned int hint = 0;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        ttSec[i] = convertTAItoTT(convertJDToSec(dates[i].toTAIJD(&hint)));
+    }
+}
+
+
+/** Convert an array of times in seconds since J2000.0 TDB to UTC calendar
+  * dates. The result is identical to calling UTCDateFromTDBSec() for each
+  * time.
+  */
+void
+GregorianDate::UTCDatesFromTDBSec(unsigned int count, const double* tdbSec, GregorianDate* dates)
+{
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        dates[i] = UTCDateFromTDBJD(convertSecToJD(tdbSec[i]));
+    }
+}
+
+
+/** Convert an array of times in seconds since J2000.0 TDB to TDB calendar
+  * dates. The result is identical to calling TDBDateFromTDBSec() for each
+  * time.
+  */
+void
+GregorianDate::TDBDatesFromTDBSec(unsigned int count, const double* tdbSec, GregorianDate* dates)
+{
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        dates[i] = TDBDateFromTDBJD(convertSecToJD(tdbSec[i]));
+    }
+}
+
+
+/** Convert an array of times in seconds since J2000.0 from one uniform
+  * time scale to another. UTC is not a uniform time scale and may not be
+  * used here; convert calendar dates instead.
+  *
+  * \param count number of times to convert
+  * \param fromSec array of times in the fromScale time scale
+  * \param fromScale time scale of the input times (TDB, TT, or TAI)
+  * \param toSec array that receives the converted times; may be the same as fromSec
+  * \param toScale time scale of the output times (TDB, TT, or TAI)
+  */
+void
+GregorianDate::convertSec(unsigned int count, const double* fromSec, TimeScale fromScale, double* toSec, TimeScale toScale)
+{
+    if (fromScale == TimeScale_TT && toScale == TimeScale_TDB)
+    {
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            toSec[i] = convertTTtoTDB(fromSec[i]);
+        }
+    }
+    else if (fromScale == TimeScale_TDB && toScale == TimeScale_TT)
+    {
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            toSec[i] = convertTDBtoTT(fromSec[i]);
+        }
+    }
+    else
+    {
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            toSec[i] = convertUniformSec(fromSec[i], fromScale, toScale);
+        }
+    }
+}
+
+
 /** Convert the date to a string with the specified format.
   */
 string
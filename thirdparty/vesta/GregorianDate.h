@@ -140,6 +140,15 @@ public:
     static GregorianDate UTCDateFromTDBSec(double tdbsec);
     static GregorianDate TDBDateFromTDBSec(double tdbsec);
 
+    static void toTDBSec(unsigned int count, const GregorianDate* dates, double* tdbSec);
+    static void toTTSec(unsigned int count, const GregorianDate* dates, double* ttSec);
+    static void UTCDatesFromTDBSec(unsigned int count, const double* tdbSec, GregorianDate* dates);
+    static void TDBDatesFromTDBSec(unsigned int count, const double* tdbSec, GregorianDate* dates);
+    static void convertSec(unsigned int count, const double* fromSec, TimeScale fromScale, double* toSec, TimeScale toScale);
+
+private:
+    double toTAIJD(unsigned int* leapSecondHint) const;
+
 private:
     int m_year;
     unsigned int m_month;
@@ -15,6 +15,7 @@
 #include "StateVector.h"
 #include <Eigen/Core>
 #include <limits>
+#include <cstddef>
 
 
 namespace vesta
@@ -36,6 +37,21 @@ public:
      */
     virtual StateVector state(double t) const = 0;
 
+    /*! Compute state vectors at n different times. The results are stored
+     *  in out, which must have room for n state vectors. The default
+     *  implementation just calls state() for each time. Subclasses may
+     *  override this method when evaluating many states in one call is
+     *  cheaper, e.g. when consecutive times share a polynomial granule.
+     *  Callers should give times in increasing order when possible.
+     */
+    virtual void states(const double* t, std::size_t n, StateVector* out) const
+    {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            out[i] = state(t[i]);
+        }
+    }
+
     /*! Return the radius of a sphere centered at the origin that can
      *  contain the entire orbit. This sphere used to avoid calculating
      *  positions of objects that can't possible be visible.
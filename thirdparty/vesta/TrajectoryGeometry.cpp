@@ -15,6 +15,7 @@
 #include "Debug.h"
 #include <curveplot/curveplot.h>
 #include <Eigen/LU>
+#include <Eigen/StdVector>
 #include <algorithm>
 
 using namespace vesta;
@@ -218,6 +219,11 @@ public:
         return m_trajectory->state(t);
     }
 
+    void states(const double* t, std::size_t n, StateVector* out) const
+    {
+        m_trajectory->states(t, n, out);
+    }
+
     double startTime() const
     {
         return m_trajectory->startTime();
@@ -299,11 +305,19 @@ TrajectoryGeometry::computeSamples(const TrajectoryPlotGenerator* generator, dou
     m_endTime = endTime;
     double dt = (endTime - startTime) / steps;
 
+    // Compute all of the states in a single batch
+    vector<double> sampleTimes(steps + 1);
+    for (unsigned int i = 0; i <= steps; ++i)
+    {
+        sampleTimes[i] = m_startTime + i * dt;
+    }
+
+    vector<StateVector, aligned_allocator<StateVector> > sampleStates(steps + 1);
+    generator->states(&sampleTimes[0], sampleTimes.size(), &sampleStates[0]);
+
     for (unsigned int i = 0; i <= steps; ++i)
     {
-        double t = m_startTime + i * dt;
-        StateVector state = generator->state(t);
-        addSample(t, state);
+        addSample(sampleTimes[i], sampleStates[i]);
     }
 
     // Adjust the bounding radius slightly to prevent culling when the
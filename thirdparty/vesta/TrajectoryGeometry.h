@@ -15,6 +15,7 @@
 #include "Spectrum.h"
 #include "Frame.h"
 #include <Eigen/Core>
+#include <cstddef>
 
 class CurvePlot;
 
@@ -30,6 +31,17 @@ public:
     virtual StateVector state(double tsec) const = 0;
     virtual double startTime() const = 0;
     virtual double endTime() const = 0;
+
+    /** Compute states at n times; the default implementation calls
+      * state() for each time.
+      */
+    virtual void states(const double* tsec, std::size_t n, StateVector* out) const
+    {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            out[i] = state(tsec[i]);
+        }
+    }
 };
 
 
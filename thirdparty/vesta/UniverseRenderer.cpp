@@ -11,6 +11,7 @@
 #include "UniverseRenderer.h"
 #include "RenderContext.h"
 #include "Observer.h"
+#include "EvaluationContext.h"
 #include "Geometry.h"
 #include "Debug.h"
 #include "BoundingSphere.h"
@@ -80,6 +81,7 @@ UniverseRenderer::UniverseRenderer() :
     m_renderContext(NULL),
     m_universe(NULL),
     m_currentTime(0.0),
+    m_evaluationContext(NULL),
     m_shadowsEnabled(false),
     m_eclipseShadowsEnabled(false),
     m_visualizersEnabled(true),
@@ -92,12 +94,14 @@ UniverseRenderer::UniverseRenderer() :
     m_sun = new LightSource();
     m_sun->setLightType(LightSource::Sun);
     m_eclipseShadows = new EclipseShadowVolumeSet();
+    m_evaluationContext = new EvaluationContext();
 }
 
 
 UniverseRenderer::~UniverseRenderer()
 {
     delete m_renderContext;
+    delete m_evaluationContext;
 }
 
 
@@ -378,6 +382,11 @@ UniverseRenderer::beginViewSet(const Universe* universe, double tsec)
     m_universe = universe;
     m_currentTime = tsec;
 
+    // Objects may have changed since the last view set, so cached states
+    // can't be reused even when the time is the same.
+    m_evaluationContext->setTime(tsec);
+    m_evaluationContext->resetCounters();
+
     // TODO: maintain a bounding sphere hierarchy in order to avoid having to do a linear
     // traversal of all objects.
 
@@ -403,7 +412,7 @@ UniverseRenderer::beginViewSet(const Universe* universe, double tsec)
 
         if (light && entity->isVisible(m_currentTime))
         {
-            Vector3d position = entity->position(m_currentTime);
+            Vector3d position = m_evaluationContext->position(entity);
 
             LightSourceItem lsi;
             lsi.lightSource = light;
@@ -665,7 +674,7 @@ UniverseRenderer::renderView(const LightingEnvironment* lighting,
 
         if (entity->isVisible(m_currentTime))
         {
-            Vector3d position = entity->position(m_currentTime);
+            Vector3d position = m_evaluationContext->position(entity);
 
             // Calculate the difference at double precision, then convert to single
             // precision for the rest of the work.
@@ -697,7 +706,7 @@ UniverseRenderer::renderView(const LightingEnvironment* lighting,
             {
                 addVisibleItem(entity, entity->geometry(),
                                position, cameraRelativePosition, cameraSpacePosition,
-                               entity->orientation(m_currentTime).cast<float>(),
+                               m_evaluationContext->orientation(entity).cast<float>(),
                                nearPlaneFovAdjustment);
             }
 
@@ -716,7 +725,7 @@ UniverseRenderer::renderView(const LightingEnvironment* lighting,
                 {
                     m_eclipseShadows->addShadow(entity,
                                                 position,
-                                                entity->orientation(m_currentTime).cast<float>(),
+                                                m_evaluationContext->orientation(entity).cast<float>(),
                                                 m_lightSources.front().position,
                                                 m_lightSources.front().radius);
                 }
@@ -927,8 +936,8 @@ UniverseRenderer::renderView(const LightingEnvironment* lighting,
                              Framebuffer* renderSurface)
 {
     return renderView(lighting,
-                      observer->absolutePosition(m_currentTime),
-                      observer->absoluteOrientation(m_currentTime),
+                      m_evaluationContext->observerPosition(observer),
+                      m_evaluationContext->observerOrientation(observer),
                       PlanarProjection::CreatePerspective(static_cast<float>(fieldOfView), viewport.aspectRatio(), MinimumNearPlaneDistance, MaximumFarPlaneDistance),
                       viewport,
                       renderSurface);
@@ -31,6 +31,7 @@ class CubeMapFramebuffer;
 class EclipseShadowVolumeSet;
 class TextureFont;
 class GlareOverlay;
+class EvaluationContext;
 
 /** UniverseRenderer draws views of a VESTA Universe using a 3D rendering
   * library. Views are drawn as sets at a particular time. A typical usage
@@ -172,6 +173,17 @@ public:
 
     GlareOverlay* createGlareOverlay();
 
+    /** Get the evaluation context holding the positions and orientations
+      * computed for the current view set. Code that draws along with the
+      * renderer (such as labels and info text) can use it to avoid
+      * evaluating trajectories again. The context is reset by each call
+      * to beginViewSet().
+      */
+    EvaluationContext* evaluationContext() const
+    {
+        return m_evaluationContext;
+    }
+
 public:
     struct VisibleItem
     {
@@ -256,6 +268,7 @@ private:
 
     const Universe* m_universe;
     double m_currentTime;
+    EvaluationContext* m_evaluationContext;
 
     VisibleItemVector m_visibleItems;
     VisibleItemVector m_splittableItems;
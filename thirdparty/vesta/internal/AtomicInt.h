@@ -72,6 +72,33 @@ public:
         return m_value;
     }
 
+    /** Atomically read the value without ordering any other memory
+      * operations. Suitable for hints and statistics that are shared between
+      * threads but don't guard other data.
+      */
+    inline int loadRelaxed() const
+    {
+#if USE_GCC_ATOMIC_INTRINSICS
+        return __atomic_load_n(&m_value, __ATOMIC_RELAXED);
+#else
+        // Aligned reads of a volatile int are atomic on all platforms
+        // supported by MSVC.
+        return m_value;
+#endif
+    }
+
+    /** Atomically write the value without ordering any other memory
+      * operations.
+      */
+    inline void storeRelaxed(int value)
+    {
+#if USE_GCC_ATOMIC_INTRINSICS
+        __atomic_store_n(&m_value, value, __ATOMIC_RELAXED);
+#else
+        m_value = value;
+#endif
+    }
+
 private:
     volatile int m_value;
 };
@@ -0,0 +1,190 @@
+#!/usr/bin/python
+
+# Convert Chebyshev polynomial trajectory files (.cheb, CHEBPOLY format) to
+# the compact CHEBCOMP format and report the accuracy lost and the memory
+# saved for each file.
+#
+# The high order Chebyshev coefficients of a trajectory are tiny compared to
+# the leading terms and need much less precision. A compact file keeps the
+# first few coefficients of each component as doubles and stores the rest
+# in 32 bits, either as floats or as int32 values multiplied by a scale
+# factor (one per component per granule.) For each file, the layout with
+# the smallest records whose error is within the tolerance is chosen.
+#
+# Since |T_i(u)| <= 1 on [-1, 1], the position error in a granule is at most
+# the sum of the rounding errors of the coefficients; that bound is what's
+# compared against the tolerance. The report also lists the largest error
+# actually observed at a few points in each granule, and a bound on the
+# velocity error (|T_i'(u)| <= i^2.)
+#
+# With no output directory, only the report is printed. Cosmographia loads
+# compact files wherever a .cheb file is accepted.
+#
+# The output file has the following format:
+#
+# 8 bytes - header "CHEBCOMP"
+# 4 bytes - uint32 - record count
+# 4 bytes - uint32 - polynomial degree
+# 8 bytes - double - start time (seconds since J2000.0 TDB)
+# 8 bytes - double - interval covered by each polynomial (in seconds)
+# 4 bytes - uint32 - number of coefficients per component stored as doubles (k)
+# 4 bytes - uint32 - encoding of the other coefficients: 0 = float, 1 = scaled int32
+#
+# Each record contains 3 * k doubles (x0 ... y0 ... z0 ...), then for
+# scaled int32 records three doubles with the scale factors for x, y, and z,
+# then 3 * (degree + 1 - k) floats or int32s, padded to a multiple of 8 bytes.
+#
+# Byte order is little endian.
+
+import struct
+import sys
+import os
+import math
+from optparse import OptionParser
+
+parser = OptionParser(usage="usage: %prog [options] input-file...")
+parser.add_option("-t", "--tolerance", type="float", dest="tolerance", default=0.001,
+                  help="Maximum position error in kilometers (default 0.001)")
+parser.add_option("-o", "--output-dir", type="string", dest="outputDir", default=None,
+                  help="Write compact files with the same names to this directory")
+
+(options, args) = parser.parse_args()
+if len(args) == 0:
+    parser.error("no input files specified")
+
+Float32 = 0
+ScaledInt32 = 1
+MaxInt32 = 2147483647
+
+
+def recordSize(n, k, encoding):
+    size = 3 * k * 8 + 3 * (n - k) * 4
+    if encoding == ScaledInt32:
+        size += 3 * 8
+    return (size + 7) & ~7
+
+
+def toFloat32(x):
+    return struct.unpack('<f', struct.pack('<f', x))[0]
+
+
+def int32Scale(coeffs, k):
+    largest = max([abs(c) for c in coeffs[k:]] + [0.0])
+    return largest / MaxInt32
+
+
+# Encode the coefficients of one component and return the values that the
+# loader will decode.
+def decodedComponent(coeffs, k, encoding):
+    if encoding == Float32:
+        return coeffs[:k] + [toFloat32(c) for c in coeffs[k:]]
+    else:
+        scale = int32Scale(coeffs, k)
+        if scale == 0.0:
+            return coeffs[:k] + [0.0] * (len(coeffs) - k)
+        return coeffs[:k] + [scale * int(round(c / scale)) for c in coeffs[k:]]
+
+
+def chebyshev(coeffs, u):
+    b1 = 0.0
+    b2 = 0.0
+    for c in reversed(coeffs[1:]):
+        b0 = c + 2.0 * u * b1 - b2
+        b2 = b1
+        b1 = b0
+    return coeffs[0] + u * b1 - b2
+
+
+def compactFile(fileName):
+    data = open(fileName, 'rb').read()
+    if data[:8] != b'CHEBPOLY':
+        sys.stderr.write("%s is not a Chebyshev polynomial file\n" % fileName)
+        return None
+
+    recordCount, degree, startTime, interval = struct.unpack('<IIdd', data[8:32])
+    n = degree + 1
+    values = struct.unpack('<%dd' % (recordCount * 3 * n), data[32:32 + recordCount * 3 * n * 8])
+    granules = [[list(values[(r * 3 + c) * n:(r * 3 + c + 1) * n]) for c in range(3)] for r in range(recordCount)]
+
+    # Find the layout with the smallest record that meets the tolerance.
+    # Doubles for every term always qualify.
+    best = (3 * n * 8, n, Float32, 0.0, 0.0)
+    for encoding in (Float32, ScaledInt32):
+        for k in range(n):
+            size = recordSize(n, k, encoding)
+            if size >= best[0]:
+                continue
+
+            maxError = 0.0
+            maxVelocityError = 0.0
+            for g in granules:
+                position = []
+                velocity = []
+                for coeffs in g:
+                    decoded = decodedComponent(coeffs, k, encoding)
+                    errors = [abs(a - b) for a, b in zip(coeffs, decoded)]
+                    position.append(sum(errors))
+                    velocity.append(sum([i * i * e for i, e in enumerate(errors)]))
+                maxError = max(maxError, math.sqrt(sum([e * e for e in position])))
+                maxVelocityError = max(maxVelocityError, math.sqrt(sum([e * e for e in velocity])) * 2.0 / interval)
+                if maxError > options.tolerance:
+                    break
+
+            if maxError <= options.tolerance:
+                best = (size, k, encoding, maxError, maxVelocityError)
+
+    size, k, encoding, maxError, maxVelocityError = best
+
+    # Measure the actual error at a few points in each granule
+    observedError = 0.0
+    for g in granules:
+        decoded = [decodedComponent(coeffs, k, encoding) for coeffs in g]
+        for u in (-1.0, -0.5, 0.0, 0.5, 1.0):
+            d = [chebyshev(a, u) - chebyshev(b, u) for a, b in zip(g, decoded)]
+            observedError = max(observedError, math.sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]))
+
+    originalSize = 32 + recordCount * 3 * n * 8
+    compactSize = 40 + recordCount * size
+    print("%-24s degree %2d  %6d granules  %-5s k=%-2d  error %.3g km (observed %.3g km)  velocity error %.3g km/s  %8d -> %8d bytes (%.0f%% saved)" %
+          (os.path.basename(fileName), degree, recordCount,
+           ("float", "int32")[encoding], k,
+           maxError, observedError, maxVelocityError,
+           originalSize, compactSize, 100.0 * (originalSize - compactSize) / originalSize))
+
+    if options.outputDir:
+        out = open(os.path.join(options.outputDir, os.path.basename(fileName)), 'wb')
+        out.write(b'CHEBCOMP')
+        out.write(struct.pack('<IIddII', recordCount, degree, startTime, interval, k, encoding))
+        for g in granules:
+            record = b''
+            for coeffs in g:
+                record += struct.pack('<%dd' % k, *coeffs[:k])
+            if encoding == Float32:
+                for coeffs in g:
+                    record += struct.pack('<%df' % (n - k), *coeffs[k:])
+            else:
+                scales = [int32Scale(coeffs, k) for coeffs in g]
+                record += struct.pack('<3d', *scales)
+                for coeffs, scale in zip(g, scales):
+                    if scale == 0.0:
+                        record += struct.pack('<%di' % (n - k), *([0] * (n - k)))
+                    else:
+                        record += struct.pack('<%di' % (n - k), *[int(round(c / scale)) for c in coeffs[k:]])
+            record += b'\0' * (size - len(record))
+            out.write(record)
+        out.close()
+
+    return (originalSize, compactSize)
+
+
+totalOriginal = 0
+totalCompact = 0
+for fileName in args:
+    sizes = compactFile(fileName)
+    if sizes:
+        totalOriginal += sizes[0]
+        totalCompact += sizes[1]
+
+if len(args) > 1 and totalOriginal > 0:
+    print("Total: %d -> %d bytes (%.0f%% saved)" %
+          (totalOriginal, totalCompact, 100.0 * (totalOriginal - totalCompact) / totalOriginal))
@@ -0,0 +1,101 @@
+#!/usr/bin/python
+
+# Convert an orientation table in the ASCII q format into the binary qb
+# format used by Cosmographia. Binary files are memory mapped when loaded,
+# so they load instantly no matter how large they are.
+#
+# Input files contain one record per line: a TDB Julian date followed by
+# a quaternion with components ordered w, x, y, z. Lines starting with #
+# are comments.
+#
+# Densely sampled attitude histories can usually be decimated when the
+# rotation model uses cubic interpolation ("interpolation": "cubic" in the
+# catalog file.) The --decimate option keeps only every n-th record (the
+# last record is always kept.)
+#
+# The output file has the following format:
+#
+# 8 bytes - header "QUATBIN1"
+# 4 bytes - uint32 - flags (currently always 0)
+# 4 bytes - uint32 - record count
+# 4 bytes - uint32 - index stride (number of records per coarse index entry, or 0)
+# 4 bytes - uint32 - index entry count
+# 8 bytes - reserved
+#
+# The header is followed by arrays of doubles with one entry per record:
+# time (seconds since J2000.0 TDB), w, x, y, z. Quaternions are normalized.
+# The arrays are followed by the coarse index: the time of every index
+# stride-th record.
+#
+# Byte order is little endian.
+
+import struct
+import sys
+import math
+from optparse import OptionParser
+
+parser = OptionParser(usage="usage: %prog [options] input-file output-file")
+parser.add_option("-d", "--decimate", type="int", dest="decimate", default=1,
+                  help="Keep only every n-th record")
+parser.add_option("-s", "--stride", type="int", dest="indexStride", default=64,
+                  help="Number of records per coarse index entry (0 for no index)")
+
+(options, args) = parser.parse_args()
+if len(args) != 2:
+    parser.error("input and output files must be specified")
+
+J2000 = 2451545.0
+SecondsPerDay = 86400.0
+fieldCount = 5
+
+# Read all numbers, ignoring comments. As in Cosmographia's loader, records
+# may span lines, so values are read as a stream.
+values = []
+for line in open(args[0], 'r'):
+    line = line.split('#', 1)[0]
+    values.extend([float(v) for v in line.split()])
+
+if len(values) % fieldCount != 0:
+    sys.stderr.write("Error in .q orientation file, record %d\n" % (len(values) // fieldCount))
+    sys.exit(1)
+
+records = [values[i:i + fieldCount] for i in range(0, len(values), fieldCount)]
+if len(records) == 0:
+    sys.stderr.write("No records in orientation file\n")
+    sys.exit(1)
+
+decimate = max(1, options.decimate)
+if decimate > 1:
+    last = records[-1]
+    records = records[::decimate]
+    if records[-1] is not last:
+        records.append(last)
+
+for i in range(1, len(records)):
+    if records[i][0] <= records[i - 1][0]:
+        sys.stderr.write("Record times are not increasing at record %d\n" % i)
+        sys.exit(1)
+
+recordCount = len(records)
+times = [(r[0] - J2000) * SecondsPerDay for r in records]
+columns = [times, [], [], [], []]
+for r in records:
+    length = math.sqrt(r[1] * r[1] + r[2] * r[2] + r[3] * r[3] + r[4] * r[4])
+    if length == 0.0:
+        sys.stderr.write("Zero length quaternion at record %d\n" % len(columns[1]))
+        sys.exit(1)
+    for i in range(1, 5):
+        columns[i].append(r[i] / length)
+
+indexStride = max(0, options.indexStride)
+index = []
+if indexStride > 0:
+    index = times[::indexStride]
+
+out = open(args[1], 'wb')
+out.write(b'QUATBIN1')
+out.write(struct.pack('<IIIId', 0, recordCount, indexStride, len(index), 0.0))
+for column in columns:
+    out.write(struct.pack('<%dd' % recordCount, *column))
+out.write(struct.pack('<%dd' % len(index), *index))
+out.close()
@@ -0,0 +1,90 @@
+#!/usr/bin/python
+
+# Convert a sampled trajectory in the ASCII xyzv or xyz format into the
+# binary xyzvb format used by Cosmographia. Binary files are memory mapped
+# when loaded, so they load instantly no matter how large they are.
+#
+# Input files contain one record per line: a TDB Julian date followed by
+# a position in kilometers and (for xyzv files) a velocity in km/s. Lines
+# starting with # are comments.
+#
+# The output file has the following format:
+#
+# 8 bytes - header "XYZVBIN1"
+# 4 bytes - uint32 - flags (bit 0 set if velocities are present)
+# 4 bytes - uint32 - record count
+# 4 bytes - uint32 - index stride (number of records per coarse index entry, or 0)
+# 4 bytes - uint32 - index entry count
+# 8 bytes - double - bounding radius (km)
+#
+# The header is followed by arrays of doubles with one entry per record:
+# time (seconds since J2000.0 TDB), x, y, z, and (if present) vx, vy, vz.
+# Times must not decrease. Two consecutive records with the same time mark
+# a boundary between segments (e.g. before and after a maneuver), and
+# Cosmographia never interpolates across one.
+# The arrays are followed by the coarse index: the time of every index
+# stride-th record.
+#
+# Byte order is little endian.
+
+import struct
+import sys
+import math
+from optparse import OptionParser
+
+parser = OptionParser(usage="usage: %prog [options] input-file output-file")
+parser.add_option("-p", "--positions", action="store_true", dest="positionsOnly", default=False,
+                  help="Input contains only positions (xyz format)")
+parser.add_option("-s", "--stride", type="int", dest="indexStride", default=64,
+                  help="Number of records per coarse index entry (0 for no index)")
+
+(options, args) = parser.parse_args()
+if len(args) != 2:
+    parser.error("input and output files must be specified")
+
+J2000 = 2451545.0
+SecondsPerDay = 86400.0
+
+positionsOnly = options.positionsOnly or args[0].lower().endswith('.xyz')
+fieldCount = 4 if positionsOnly else 7
+
+# Read all numbers, ignoring comments. As in Cosmographia's loader, records
+# may span lines, so values are read as a stream.
+values = []
+for line in open(args[0], 'r'):
+    line = line.split('#', 1)[0]
+    values.extend([float(v) for v in line.split()])
+
+if len(values) % fieldCount != 0:
+    sys.stderr.write("Error in trajectory file, record %d\n" % (len(values) // fieldCount))
+    sys.exit(1)
+
+recordCount = len(values) // fieldCount
+if recordCount == 0:
+    sys.stderr.write("No records in trajectory file\n")
+    sys.exit(1)
+
+columns = [values[i::fieldCount] for i in range(fieldCount)]
+columns[0] = [(jd - J2000) * SecondsPerDay for jd in columns[0]]
+
+for i in range(1, recordCount):
+    if columns[0][i] < columns[0][i - 1]:
+        sys.stderr.write("Record times decrease at record %d\n" % i)
+        sys.exit(1)
+
+boundingRadius = max([math.sqrt(x * x + y * y + z * z) for x, y, z in zip(columns[1], columns[2], columns[3])])
+
+indexStride = max(0, options.indexStride)
+index = []
+if indexStride > 0:
+    index = columns[0][::indexStride]
+
+flags = 0 if positionsOnly else 1
+
+out = open(args[1], 'wb')
+out.write(b'XYZVBIN1')
+out.write(struct.pack('<IIIId', flags, recordCount, indexStride, len(index), boundingRadius))
+for column in columns:
+    out.write(struct.pack('<%dd' % recordCount, *column))
+out.write(struct.pack('<%dd' % len(index), *index))
+out.close()
@@ -0,0 +1,242 @@
+#!/usr/bin/python
+
+# Thin out a sampled trajectory in the ASCII xyzv or xyz format so that it
+# can be interpolated with higher order polynomials from far fewer records.
+#
+# Cosmographia normally interpolates sampled trajectories with cubic Hermite
+# polynomials between adjacent records. A sampled trajectory in the catalog
+# may instead request Lagrange or Hermite interpolation over a sliding
+# window of records (like SPK types 9 and 13):
+#
+#     "type" : "InterpolatedStates",
+#     "source" : "trajectory.xyzv",
+#     "interpolation" : "hermite",
+#     "interpolationOrder" : 7
+#
+# Lagrange interpolation uses positions only (order + 1 records); Hermite
+# interpolation also uses velocities and needs (order + 1) / 2 records, with
+# the order rounded up to an odd number. The window is centered on the
+# interval containing the time, and is shifted inward at the ends of the
+# trajectory. Two records with the same time mark a boundary between
+# segments (e.g. before and after a maneuver); windows never extend across
+# a boundary, and the records on both sides of it are always kept.
+#
+# This script keeps every nth record of the input (and the last record),
+# evaluates the chosen interpolation at the records that were dropped, and
+# picks the largest n for which the position error stays within the
+# tolerance. The errors of cubic interpolation of the same records are
+# printed for comparison. Smooth trajectories can usually be sampled several
+# times more sparsely with higher order interpolation; trajectories with
+# maneuvers or close encounters should be checked with a small tolerance.
+#
+# Input files contain one record per line: a TDB Julian date followed by
+# a position in kilometers and (for xyzv files) a velocity in km/s. Lines
+# starting with # are comments. The output has the same format as the input.
+
+import sys
+import math
+import bisect
+from optparse import OptionParser
+
+parser = OptionParser(usage="usage: %prog [options] input-file [output-file]")
+parser.add_option("-p", "--positions", action="store_true", dest="positionsOnly", default=False,
+                  help="Input contains only positions (xyz format)")
+parser.add_option("-m", "--method", type="choice", choices=["cubic", "lagrange", "hermite"], dest="method", default=None,
+                  help="Interpolation method: cubic, lagrange, or hermite (default hermite for xyzv, lagrange for xyz)")
+parser.add_option("-n", "--order", type="int", dest="order", default=8,
+                  help="Degree of the interpolating polynomials (default 8)")
+parser.add_option("-t", "--tolerance", type="float", dest="tolerance", default=0.001,
+                  help="Maximum position error in kilometers (default 0.001)")
+parser.add_option("-c", "--checks", type="int", dest="checks", default=2000,
+                  help="Maximum number of dropped records checked for each spacing (default 2000)")
+parser.add_option("-x", "--max-factor", type="int", dest="maxFactor", default=64,
+                  help="Largest decimation factor tried (default 64)")
+
+(options, args) = parser.parse_args()
+if len(args) < 1 or len(args) > 2:
+    parser.error("an input file and optional output file must be specified")
+
+MaxInterpolationOrder = 31
+
+positionsOnly = options.positionsOnly or args[0].lower().endswith('.xyz')
+fieldCount = 4 if positionsOnly else 7
+
+method = options.method
+if method is None:
+    method = "lagrange" if positionsOnly else "hermite"
+if method == "hermite" and positionsOnly:
+    parser.error("Hermite interpolation requires velocities")
+
+# Mirror InterpolatedStateTrajectory::setInterpolation()
+order = min(max(1, options.order), MaxInterpolationOrder)
+if method == "lagrange":
+    windowSize = order + 1
+elif method == "hermite":
+    order = max(3, order | 1)
+    windowSize = (order + 1) // 2
+else:
+    order = 3
+    windowSize = 2
+
+# Read all numbers, ignoring comments. As in Cosmographia's loader, records
+# may span lines, so values are read as a stream.
+values = []
+for line in open(args[0], 'r'):
+    line = line.split('#', 1)[0]
+    values.extend([float(v) for v in line.split()])
+
+if len(values) % fieldCount != 0:
+    sys.stderr.write("Error in trajectory file, record %d\n" % (len(values) // fieldCount))
+    sys.exit(1)
+
+recordCount = len(values) // fieldCount
+records = [values[i * fieldCount:(i + 1) * fieldCount] for i in range(recordCount)]
+if recordCount < 2:
+    sys.stderr.write("Trajectory file needs at least two records\n")
+    sys.exit(1)
+
+for i in range(1, recordCount):
+    if records[i][0] < records[i - 1][0]:
+        sys.stderr.write("Record times are decreasing at record %d\n" % i)
+        sys.exit(1)
+
+# Records that must be kept: the first and last, and those at segment boundaries
+boundary = [i == 0 or i == recordCount - 1 or
+            (i > 0 and records[i][0] == records[i - 1][0]) or
+            (i < recordCount - 1 and records[i][0] == records[i + 1][0])
+            for i in range(recordCount)]
+
+
+# Newton divided differences, with nodes doubled for Hermite interpolation.
+# Returns the value and derivative of the interpolating polynomial at 0.
+def newtonInterpolate(z, c, derivatives):
+    n = len(z)
+    c = list(c)
+    for j in range(1, n):
+        for i in range(n - 1, j - 1, -1):
+            if derivatives is not None and j == 1 and (i & 1) != 0:
+                c[i] = derivatives[i // 2]
+            else:
+                c[i] = (c[i] - c[i - 1]) / (z[i] - z[i - j])
+    p = c[n - 1]
+    dp = 0.0
+    for j in range(n - 2, -1, -1):
+        dp = dp * -z[j] + p
+        p = p * -z[j] + c[j]
+    return p, dp
+
+
+def cubicHermite(p0, v0, p1, v1, t):
+    t2 = t * t
+    t3 = t2 * t
+    return (2 * t3 - 3 * t2 + 1) * p0 + (t3 - 2 * t2 + t) * v0 + (-2 * t3 + 3 * t2) * p1 + (t3 - t2) * v1
+
+
+# Estimate a velocity for positions only trajectories the same way that
+# InterpolatedStateTrajectory::estimateVelocity() does.
+def velocity(sampled, i, axis):
+    if not positionsOnly:
+        return sampled[i][4 + axis]
+    if i == 0:
+        return (sampled[1][1 + axis] - sampled[0][1 + axis]) / (sampled[1][0] - sampled[0][0])
+    if i == len(sampled) - 1:
+        return (sampled[i][1 + axis] - sampled[i - 1][1 + axis]) / (sampled[i][0] - sampled[i - 1][0])
+    return (sampled[i + 1][1 + axis] - sampled[i - 1][1 + axis]) / (sampled[i + 1][0] - sampled[i - 1][0])
+
+
+# Interpolate the position at time t (a Julian date) from the sampled records.
+# Velocities are in km/s and times in days, so derivatives are scaled by
+# 86400.
+def interpolate(sampled, times, t, method):
+    interval = bisect.bisect_right(times, t) - 1
+    interval = min(max(interval, 0), len(sampled) - 2)
+    h = times[interval + 1] - times[interval]
+
+    if method == "cubic":
+        u = (t - times[interval]) / h
+        return [cubicHermite(sampled[interval][1 + axis], velocity(sampled, interval, axis) * h * 86400.0,
+                             sampled[interval + 1][1 + axis], velocity(sampled, interval + 1, axis) * h * 86400.0, u)
+                for axis in range(3)]
+
+    # Mirror InterpolatedStateTrajectory::interpolateWindow()
+    segmentStart = interval
+    while segmentStart > 0 and interval - segmentStart + 2 < windowSize and times[segmentStart - 1] < times[segmentStart]:
+        segmentStart -= 1
+    segmentEnd = interval + 1
+    while segmentEnd < len(sampled) - 1 and segmentEnd - interval + 1 < windowSize and times[segmentEnd] < times[segmentEnd + 1]:
+        segmentEnd += 1
+
+    n = min(windowSize, segmentEnd - segmentStart + 1)
+    first = max(segmentStart, interval + 1 - n // 2)
+    first = min(first, segmentEnd + 1 - n)
+    window = sampled[first:first + n]
+
+    position = []
+    for axis in range(3):
+        if method == "hermite":
+            z = []
+            c = []
+            for r in window:
+                x = (r[0] - t) / h
+                z += [x, x]
+                c += [r[1 + axis], r[1 + axis]]
+            derivatives = [r[4 + axis] * h * 86400.0 for r in window]
+            p, dp = newtonInterpolate(z, c, derivatives)
+        else:
+            z = [(r[0] - t) / h for r in window]
+            c = [r[1 + axis] for r in window]
+            p, dp = newtonInterpolate(z, c, None)
+        position.append(p)
+    return position
+
+
+# Largest position error over the dropped records
+def decimationError(factor, method):
+    kept = [i % factor == 0 or boundary[i] for i in range(recordCount)]
+    sampled = [records[i] for i in range(recordCount) if kept[i]]
+    times = [r[0] for r in sampled]
+
+    dropped = [i for i in range(recordCount) if not kept[i]]
+    if len(dropped) > options.checks:
+        step = float(len(dropped)) / options.checks
+        dropped = [dropped[int(k * step)] for k in range(options.checks)]
+
+    maxError = 0.0
+    for i in dropped:
+        p = interpolate(sampled, times, records[i][0], method)
+        d = [p[axis] - records[i][1 + axis] for axis in range(3)]
+        maxError = max(maxError, math.sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]))
+    return sampled, maxError
+
+
+best = (1, records, 0.0)
+factor = 2
+while factor <= options.maxFactor and (recordCount - 1) // factor >= 1:
+    sampled, maxError = decimationError(factor, method)
+    if method == "cubic":
+        print("every %3d records (%7d kept): cubic error %.3g km" % (factor, len(sampled), maxError))
+    else:
+        cubicError = decimationError(factor, "cubic")[1]
+        print("every %3d records (%7d kept): %s error %.3g km, cubic error %.3g km" %
+              (factor, len(sampled), method, maxError, cubicError))
+    if maxError <= options.tolerance:
+        best = (factor, sampled, maxError)
+    factor += 1
+
+factor, sampled, maxError = best
+print("")
+if factor == 1:
+    print("No spacing meets the tolerance of %g km; keeping all %d records" % (options.tolerance, recordCount))
+else:
+    print("Keeping every %d records: %d -> %d records, error %.3g km" % (factor, recordCount, len(sampled), maxError))
+if method != "cubic":
+    print('Catalog settings: "interpolation" : "%s", "interpolationOrder" : %d' % (method, order))
+
+if len(args) == 2:
+    out = open(args[1], 'w')
+    for r in sampled:
+        if positionsOnly:
+            out.write("%.9f %.15e %.15e %.15e\n" % tuple(r))
+        else:
+            out.write("%.9f %.15e %.15e %.15e %.15e %.15e %.15e\n" % tuple(r))
+    out.close()